@@ -91,6 +91,13 @@ SRCS_COMMON-$(FTP)                   += stream/stream_ftp.c
 SRCS_COMMON-$(GIF)                   += libmpdemux/demux_gif.c
 SRCS_COMMON-$(HAVE_POSIX_SELECT)     += libmpcodecs/vf_bmovl.c
 SRCS_COMMON-$(HAVE_SYS_MMAN_H)       += libaf/af_export.c osdep/mmap_anon.c
+# the .neon suffix builds just this file with -mfpu=neon, ndk-build only
+# takes it for armeabi-v7a; elsewhere af_neon.c compiles to a stub
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+SRCS_COMMON-$(ARCH_ARM)              += libaf/af_neon.c.neon
+else
+SRCS_COMMON-$(ARCH_ARM)              += libaf/af_neon.c
+endif
 SRCS_COMMON-$(JPEG)                  += libmpcodecs/vd_ijpg.c
 SRCS_COMMON-$(LADSPA)                += libaf/af_ladspa.c
 SRCS_COMMON-$(LIBA52)                += libmpcodecs/ad_liba52.c
@@ -241,7 +248,8 @@ SRCS_COMMON-$(RADIO_CAPTURE)         += stream/audio_in.c
 SRCS_COMMON-$(REAL_CODECS)           += libmpcodecs/ad_realaud.c \
                                         libmpcodecs/vd_realvid.c
 SRCS_COMMON-$(SPEEX)                 += libmpcodecs/ad_speex.c
-SRCS_COMMON-$(STREAM_CACHE)          += stream/cache2.c
+SRCS_COMMON-$(STREAM_CACHE)          += stream/cache2.c \
+                                        stream/cache_disk.c
 
 SRCS_COMMON-$(TREMOR_INTERNAL)       += tremor/bitwise.c \
                                         tremor/block.c \
@@ -356,6 +364,7 @@ SRCS_COMMON = asxparser.c \
               libaf/af_pan.c \
               libaf/af_resample.c \
               libaf/af_scaletempo.c \
+              libaf/af_simd.c \
               libaf/af_sinesuppress.c \
               libaf/af_stats.c \
               libaf/af_sub.c \
@@ -464,6 +473,7 @@ SRCS_COMMON = asxparser.c \
               libmpdemux/demux_asf.c \
               libmpdemux/demux_audio.c \
               libmpdemux/demux_avi.c \
+              libmpdemux/demux_concat.c \
               libmpdemux/demux_demuxers.c \
               libmpdemux/demux_film.c \
               libmpdemux/demux_fli.c \
@@ -488,10 +498,12 @@ SRCS_COMMON = asxparser.c \
               libmpdemux/demux_y4m.c \
               libmpdemux/ebml.c \
               libmpdemux/extension.c \
+              libmpdemux/framemap.c \
               libmpdemux/mf.c \
               libmpdemux/mp3_hdr.c \
               libmpdemux/mp_taglists.c \
               libmpdemux/mpeg_hdr.c \
+              libmpdemux/seekidx.c \
               libmpdemux/mpeg_packetizer.c \
               libmpdemux/parse_es.c \
               libmpdemux/parse_mp4.c \
@@ -505,6 +517,7 @@ SRCS_COMMON = asxparser.c \
               stream/open.c \
               stream/stream.c \
               stream/stream_bd.c \
+              stream/stream_concat.c \
               stream/stream_cue.c \
               stream/stream_file.c \
               stream/stream_mf.c \
@@ -533,6 +546,7 @@ SRCS_MPLAYER-$(DIRECTFB)     += libvo/vo_directfb2.c
 SRCS_MPLAYER-$(DIRECTX)      += libao2/ao_dsound.c libvo/vo_directx.c
 SRCS_MPLAYER-$(DXR2)         += libao2/ao_dxr2.c libvo/vo_dxr2.c
 SRCS_MPLAYER-$(DXR3)         += libvo/vo_dxr3.c
+SRCS_MPLAYER-$(EMBED_VO)     += libvo/vo_embed.c
 SRCS_MPLAYER-$(ESD)          += libao2/ao_esd.c
 SRCS_MPLAYER-$(FBDEV)        += libvo/vo_fbdev.c libvo/vo_fbdev2.c
 SRCS_MPLAYER-$(GGI)          += libvo/vo_ggi.c
@@ -610,6 +624,7 @@ SRCS_MPLAYER-$(PULSE)         += libao2/ao_pulse.c
 SRCS_MPLAYER-$(QUARTZ)        += libvo/vo_quartz.c libvo/osx_common.c
 SRCS_MPLAYER-$(S3FB)          += libvo/vo_s3fb.c
 SRCS_MPLAYER-$(SDL)           += libao2/ao_sdl.c libvo/vo_sdl.c libvo/sdl_common.c
+SRCS_MPLAYER-$(SHM_VO)        += libvo/vo_shm.c
 SRCS_MPLAYER-$(SGIAUDIO)      += libao2/ao_sgi.c
 SRCS_MPLAYER-$(SUNAUDIO)      += libao2/ao_sun.c
 SRCS_MPLAYER-$(SVGA)          += libvo/vo_svga.c
@@ -658,11 +673,13 @@ SRCS_MPLAYER-$(YUV4MPEG)      += libvo/vo_yuv4mpeg.c
 SRCS_MPLAYER-$(ZR)            += libvo/jpeg_enc.c libvo/vo_zr.c libvo/vo_zr2.c
 
 SRCS_MPLAYER = command.c \
+               libmplayer.c \
                m_property.c \
                mixer.c \
                mp_fifo.c \
                mplayer.c \
                parser-mpcmd.c \
+               prefetch.c \
                input/input.c \
                libao2/ao_mpegpes.c \
                libao2/ao_null.c \
@@ -693,6 +710,7 @@ SRCS_MENCODER-$(X264)             += libmpcodecs/ve_x264.c
 SRCS_MENCODER-$(XVID4)            += libmpcodecs/ve_xvid4.c
 
 SRCS_MENCODER = mencoder.c \
+                batch.c \
                 parser-mecmd.c \
                 xvid_vbr.c \
                 libmpcodecs/ae.c \
@@ -815,3 +833,12 @@ LOCAL_SRC_FILES := $(SRCS_MPLAYER)
 LOCAL_LDLIBS := -Wl,-z,noexecstack  -ffast-math -ldl -rdynamic -lm 
 LOCAL_CFLAGS += -D_ISOC99_SOURCE -D_POSIX_C_SOURCE=200112 -O3 -std=c99 -D__linux__ -DCONFIG_ANDROID
 include $(BUILD_EXECUTABLE)
+
+# The player as a library for in-process use from Java, see libmplayer.h.
+include $(CLEAR_VARS)
+LOCAL_MODULE := mplayer_jni
+
+LOCAL_SRC_FILES := $(SRCS_MPLAYER) libmplayer_jni.c
+LOCAL_LDLIBS := -Wl,-z,noexecstack  -ffast-math -ldl -lm
+LOCAL_CFLAGS += -D_ISOC99_SOURCE -D_POSIX_C_SOURCE=200112 -O3 -std=c99 -D__linux__ -DCONFIG_ANDROID
+include $(BUILD_SHARED_LIBRARY)
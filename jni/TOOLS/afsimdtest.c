@@ -0,0 +1,209 @@
+/*
+ * checks the libaf sample kernels picked for this CPU against the C ones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cpudetect.h"
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "libaf/af_simd.h"
+
+// odd on purpose, so the kernels have to finish the tail
+#define SAMPLES (48000 * 2 + 7)
+#define ROUNDS  50
+
+static float   fin[SAMPLES], fref[SAMPLES], fout[SAMPLES];
+static int16_t sin16[SAMPLES], sref[SAMPLES], sout[SAMPLES];
+static int32_t sin32[SAMPLES];
+static int failed;
+
+static float frand(void)
+{
+    return 2.0f * rand() / RAND_MAX - 1.0f;
+}
+
+static void check_s16(const char *name, unsigned ref_us, unsigned us,
+                      int len, int tolerance)
+{
+    int i, diff = 0;
+
+    for (i = 0; i < len; i++)
+        if (abs(sref[i] - sout[i]) > diff)
+            diff = abs(sref[i] - sout[i]);
+    printf("%-16s max diff %5d  C %6u us  now %6u us\n", name, diff,
+           ref_us, us);
+    if (diff > tolerance)
+        failed = 1;
+}
+
+static void check_float(const char *name, unsigned ref_us, unsigned us,
+                        int len, float tolerance)
+{
+    float diff = 0;
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (fabsf(fref[i] - fout[i]) > diff)
+            diff = fabsf(fref[i] - fout[i]);
+    printf("%-16s max diff %.2e  C %6u us  now %6u us\n", name, diff,
+           ref_us, us);
+    if (!(diff <= tolerance))
+        failed = 1;
+}
+
+#define TIME(us, code)                       \
+    do {                                     \
+        unsigned t0 = GetTimer();            \
+        int r;                               \
+        for (r = 0; r < ROUNDS; r++) {       \
+            code;                            \
+        }                                    \
+        us = GetTimer() - t0;                \
+    } while (0)
+
+int main(void)
+{
+    static const int vol[AF_NCH] = { 200, 300, 256, 900, 17, 256, 512, 1000 };
+    float level[AF_NCH][AF_NCH], a[10][2], b[10][2], g[10][AF_NCH];
+    float wref[10][2][AF_NCH], wout[10][2][AF_NCH], taps[32];
+    int16_t taps16[32];
+    unsigned ref_us, us;
+    int i, j, nch;
+
+    mp_msg_init();
+    GetCpuCaps(&gCpuCaps);
+    af_simd_init();
+
+    for (i = 0; i < SAMPLES; i++) {
+        fin[i]   = frand();
+        sin16[i] = rand();
+        sin32[i] = (unsigned)rand() << 1 ^ rand();
+    }
+
+    TIME(ref_us, af_simd_c.float_to_s16(sref, fin, SAMPLES));
+    TIME(us, af_simd.float_to_s16(sout, fin, SAMPLES));
+    // rounding of exact halves may differ
+    check_s16("float_to_s16", ref_us, us, SAMPLES, 1);
+
+    TIME(ref_us, af_simd_c.s16_to_float(fref, sin16, SAMPLES));
+    TIME(us, af_simd.s16_to_float(fout, sin16, SAMPLES));
+    check_float("s16_to_float", ref_us, us, SAMPLES, 0);
+
+    TIME(ref_us, af_simd_c.s32_to_s16(sref, sin32, SAMPLES));
+    TIME(us, af_simd.s32_to_s16(sout, sin32, SAMPLES));
+    check_s16("s32_to_s16", ref_us, us, SAMPLES, 0);
+
+    for (nch = 1; nch <= 6; nch++) {
+        char name[32];
+        int len = SAMPLES / nch * nch;
+        sprintf(name, "volume_s16 %dch", nch);
+        TIME(ref_us, memcpy(sref, sin16, sizeof(sref));
+                     af_simd_c.volume_s16(sref, len, nch, vol));
+        TIME(us, memcpy(sout, sin16, sizeof(sout));
+                 af_simd.volume_s16(sout, len, nch, vol));
+        check_s16(name, ref_us, us, len, 0);
+    }
+
+    for (i = 0; i < AF_NCH; i++)
+        for (j = 0; j < AF_NCH; j++)
+            level[i][j] = frand();
+    for (nch = 1; nch <= 6; nch++) {
+        int nchi = nch, ncho = 7 - nch;
+        int frames = SAMPLES / AF_NCH;
+        char name[32];
+        sprintf(name, "pan_float %d>%d", nchi, ncho);
+        TIME(ref_us, af_simd_c.pan_float(fref, fin, frames, nchi, ncho,
+                                           (const float (*)[AF_NCH])level));
+        TIME(us, af_simd.pan_float(fout, fin, frames, nchi, ncho,
+                                     (const float (*)[AF_NCH])level));
+        check_float(name, ref_us, us, frames * ncho, 1e-5);
+    }
+
+    // the equalizer's band-pass stages at 44.1 kHz
+    for (i = 0; i < 10; i++) {
+        double th = 2.0 * M_PI * 31.25 * (1 << i) / 44100;
+        double C  = (1.0 - tan(th * 1.2247449 / 2.0)) / (1.0 + tan(th * 1.2247449 / 2.0));
+        a[i][0] = (1.0 + C) * cos(th);
+        a[i][1] = -C;
+        b[i][0] = (1.0 - C) / 2.0;
+        b[i][1] = -1.0050;
+        for (j = 0; j < AF_NCH; j++)
+            g[i][j] = 0.5 * frand();
+    }
+    for (nch = 1; nch <= 6; nch++) {
+        int frames = SAMPLES / nch;
+        char name[32];
+        sprintf(name, "equalizer %dch", nch);
+        memset(wref, 0, sizeof(wref));
+        memset(wout, 0, sizeof(wout));
+        // the filters carry state from one call to the next
+        TIME(ref_us, memcpy(fref, fin, sizeof(fref));
+                     af_simd_c.equalizer_float(fref, frames, nch, 10, a[0], b[0],
+                                               g[0], wref[0][0], 0.7));
+        TIME(us, memcpy(fout, fin, sizeof(fout));
+                 af_simd.equalizer_float(fout, frames, nch, 10, a[0], b[0],
+                                         g[0], wout[0][0], 0.7));
+        check_float(name, ref_us, us, frames * nch, 1e-3);
+    }
+
+    // small enough that 32 products cannot overflow
+    for (i = 0; i < 32; i++) {
+        taps16[i] = rand() % 2048 - 1024;
+        taps[i]   = frand();
+    }
+    // the resampler's filter lengths, one output sample per input sample
+    for (j = 8; j <= 32; j *= 2) {
+        int len = SAMPLES - j;
+        char name[32];
+        sprintf(name, "dot_s16 %d", j);
+        TIME(ref_us, for (i = 0; i < len; i++)
+                         sref[i] = af_simd_c.dot_s16(sin16 + i, taps16, j) >> 16);
+        TIME(us, for (i = 0; i < len; i++)
+                     sout[i] = af_simd.dot_s16(sin16 + i, taps16, j) >> 16);
+        check_s16(name, ref_us, us, len, 0);
+        sprintf(name, "dot_float %d", j);
+        TIME(ref_us, for (i = 0; i < len; i++)
+                         fref[i] = af_simd_c.dot_float(fin + i, taps, j));
+        TIME(us, for (i = 0; i < len; i++)
+                     fout[i] = af_simd.dot_float(fin + i, taps, j));
+        check_float(name, ref_us, us, len, 1e-5);
+    }
+
+    // scaletempo's overlap search: 17 bit window against 672 stereo offsets
+    {
+        static int64_t lref[672], lout[672];
+        int diff = 0;
+        for (i = 0; i < 1152; i++)
+            sin32[i] = sin32[i] >> 15;
+        TIME(ref_us, for (i = 0; i < 672; i++)
+                         lref[i] = af_simd_c.dot_s16_s32(sin16 + 2 * i, sin32, 1152));
+        TIME(us, for (i = 0; i < 672; i++)
+                     lout[i] = af_simd.dot_s16_s32(sin16 + 2 * i, sin32, 1152));
+        for (i = 0; i < 672; i++)
+            diff |= lref[i] != lout[i];
+        printf("%-16s %s  C %6u us  now %6u us\n", "dot_s16_s32",
+               diff ? "differs      " : "same         ", ref_us, us);
+        failed |= diff;
+    }
+
+    printf("%s\n", failed ? "FAILED" : "all kernels match");
+    return failed;
+}
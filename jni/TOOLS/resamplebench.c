@@ -0,0 +1,148 @@
+/*
+ * speed and quality of the resampling filters at 44.1 -> 48 kHz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cpudetect.h"
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "libavutil/common.h"
+#include "libaf/af.h"
+
+#define IN_RATE  44100
+#define OUT_RATE 48000
+#define NCH      2
+#define BLOCK    4096   // frames per af_play() call
+#define SETTLE   4800   // output frames skipped before measuring
+
+static const char *const filters[] = {
+    "resample=48000:0:0",
+    "resample=48000:0:1:8",
+    "resample=48000:0:1:16",
+    "resample=48000:0:1:32",
+    "resample=48000:0:2:8",
+    "resample=48000:0:2:16",
+    "resample=48000:0:2:32",
+    "lavcresample=48000",
+};
+
+/* The part of the output that is not a sine of the input frequency, the
+   amplitude and phase are fitted by least squares over whole periods. */
+static double snr(const float *y, int n, double freq)
+{
+    double w = 2 * M_PI * freq / OUT_RATE;
+    double s = 0, c = 0, sig = 0, err = 0;
+    int i, periods = n * freq / OUT_RATE;
+
+    n = lrint(periods * OUT_RATE / freq);
+    for (i = 0; i < n; i++) {
+        s += y[i * NCH] * sin(w * i);
+        c += y[i * NCH] * cos(w * i);
+    }
+    s *= 2.0 / n;
+    c *= 2.0 / n;
+    for (i = 0; i < n; i++) {
+        double fit = s * sin(w * i) + c * cos(w * i);
+        sig += fit * fit;
+        err += (y[i * NCH] - fit) * (y[i * NCH] - fit);
+    }
+    return 10 * log10(sig / err);
+}
+
+static int run(const char *filter, const int16_t *in, int frames,
+               double freq, float *out, int out_max)
+{
+    char *list[2] = { (char *)filter, NULL };
+    af_stream_t s;
+    af_data_t d, *o;
+    unsigned start, usec;
+    int i, len = 0;
+
+    memset(&s, 0, sizeof(s));
+    s.input.rate    = IN_RATE;
+    s.input.nch     = NCH;
+    s.input.format  = AF_FORMAT_S16_NE;
+    s.input.bps     = 2;
+    s.output.rate   = OUT_RATE;
+    s.output.nch    = NCH;
+    s.output.format = AF_FORMAT_FLOAT_NE;
+    s.output.bps    = 4;
+    s.cfg.list      = list;
+    if (af_init(&s)) {
+        printf("%-24s could not be set up\n", filter);
+        return 1;
+    }
+
+    start = GetTimer();
+    for (i = 0; i < frames; i += BLOCK) {
+        d        = s.input;
+        d.audio  = (int16_t *)in + i * NCH;
+        d.len    = FFMIN(BLOCK, frames - i) * NCH * 2;
+        o = af_play(&s, &d);
+        if (!o) {
+            printf("%-24s failed\n", filter);
+            af_uninit(&s);
+            return 1;
+        }
+        o->len = FFMIN(o->len, (out_max - len) * 4);
+        memcpy(out + len, o->audio, o->len);
+        len += o->len / 4;
+    }
+    usec = GetTimer() - start;
+    af_uninit(&s);
+
+    printf("%-24s %6.1f ns/sample  SNR %5.1f dB\n", filter,
+           usec * 1000.0 / ((double)frames * NCH),
+           snr(out + SETTLE * NCH, len / NCH - 2 * SETTLE, freq));
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    double freq = argc > 1 ? atof(argv[1]) : 1000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    int frames  = IN_RATE * seconds;
+    int out_max = (OUT_RATE * seconds + BLOCK) * NCH;
+    int16_t *in = malloc(frames * NCH * sizeof(*in));
+    float *out  = malloc(out_max * sizeof(*out));
+    int i, failed = 0;
+
+    mp_msg_init();
+    GetCpuCaps(&gCpuCaps);
+    if (freq <= 0 || freq >= IN_RATE / 2 || seconds < 1) {
+        fprintf(stderr, "Usage: resamplebench [frequency [seconds]]\n");
+        return 1;
+    }
+    if (!in || !out)
+        return 1;
+
+    // -6 dB, so the integer filters have headroom for the overshoot
+    for (i = 0; i < frames; i++)
+        in[i * NCH] = in[i * NCH + 1] =
+            lrint(16384 * sin(2 * M_PI * freq * i / IN_RATE));
+
+    printf("%d s of %.0f Hz, %d -> %d Hz\n", seconds, freq, IN_RATE, OUT_RATE);
+    for (i = 0; i < sizeof(filters) / sizeof(*filters); i++)
+        failed |= run(filters[i], in, frames, freq, out, out_max);
+    free(in);
+    free(out);
+    return failed;
+}
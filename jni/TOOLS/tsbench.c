@@ -0,0 +1,193 @@
+/*
+ * demux_ts throughput on a synthetic multi-program transport stream
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "stream/stream.h"
+#include "libmpdemux/demuxer.h"
+
+#define PACKET_SIZE 188
+#define PAT_PID     0
+#define PMT_PID(i)  (0x100 + (i))
+#define VIDEO_PID(i) (0x200 + (i))
+#define AUDIO_PID(i) (0x300 + (i))
+// the PAT is written as one section in one packet: header, pointer field,
+// 8 bytes of section header and the CRC around 4 bytes per program
+#define MAX_PROGS   ((PACKET_SIZE - 4 - 1 - 8 - 4) / 4)
+
+static uint8_t cc[8192];
+
+static uint8_t *ts_header(uint8_t *p, int pid, int start)
+{
+    p[0] = 0x47;
+    p[1] = (start ? 0x40 : 0) | pid >> 8;
+    p[2] = pid & 0xff;
+    p[3] = 0x10 | (cc[pid]++ & 15);
+    return p + 4;
+}
+
+static void write_section(FILE *f, int pid, const uint8_t *sec, int len)
+{
+    uint8_t pkt[PACKET_SIZE], *p;
+
+    memset(pkt, 0xff, sizeof(pkt));
+    p = ts_header(pkt, pid, 1);
+    *p++ = 0;   // pointer field
+    memcpy(p, sec, len);
+    fwrite(pkt, PACKET_SIZE, 1, f);
+}
+
+static void write_tables(FILE *f, int progs)
+{
+    uint8_t sec[PACKET_SIZE], *p;
+    int i, len;
+
+    // PAT, the CRC is not checked
+    len = 5 + 4 * progs + 4;
+    p = sec;
+    *p++ = 0x00;
+    *p++ = 0xb0 | len >> 8;
+    *p++ = len & 0xff;
+    *p++ = 0; *p++ = 1; *p++ = 0xc1; *p++ = 0; *p++ = 0;
+    for (i = 0; i < progs; i++) {
+        *p++ = (i + 1) >> 8;
+        *p++ = (i + 1) & 0xff;
+        *p++ = 0xe0 | PMT_PID(i) >> 8;
+        *p++ = PMT_PID(i) & 0xff;
+    }
+    memset(p, 0, 4);
+    write_section(f, PAT_PID, sec, p + 4 - sec);
+
+    for (i = 0; i < progs; i++) {
+        len = 9 + 2 * 5 + 4;
+        p = sec;
+        *p++ = 0x02;
+        *p++ = 0xb0 | len >> 8;
+        *p++ = len & 0xff;
+        *p++ = (i + 1) >> 8; *p++ = (i + 1) & 0xff;
+        *p++ = 0xc1; *p++ = 0; *p++ = 0;
+        *p++ = 0xe0 | VIDEO_PID(i) >> 8; *p++ = VIDEO_PID(i) & 0xff;
+        *p++ = 0xf0; *p++ = 0;
+        // MPEG-2 video and MPEG-1 audio
+        *p++ = 0x02; *p++ = 0xe0 | VIDEO_PID(i) >> 8; *p++ = VIDEO_PID(i) & 0xff;
+        *p++ = 0xf0; *p++ = 0;
+        *p++ = 0x03; *p++ = 0xe0 | AUDIO_PID(i) >> 8; *p++ = AUDIO_PID(i) & 0xff;
+        *p++ = 0xf0; *p++ = 0;
+        memset(p, 0, 4);
+        write_section(f, PMT_PID(i), sec, p + 4 - sec);
+    }
+}
+
+static void write_pes(FILE *f, int pid, int stream_id, int start, uint64_t pts)
+{
+    uint8_t pkt[PACKET_SIZE], *p;
+
+    memset(pkt, 0, sizeof(pkt));
+    p = ts_header(pkt, pid, start);
+    if (start) {
+        *p++ = 0; *p++ = 0; *p++ = 1; *p++ = stream_id;
+        *p++ = 0; *p++ = 0;
+        *p++ = 0x80; *p++ = 0x80; *p++ = 5;
+        *p++ = 0x21 | (pts >> 29 & 0x0e);
+        *p++ = pts >> 22;
+        *p++ = (pts >> 14) | 1;
+        *p++ = pts >> 7;
+        *p++ = (pts << 1) | 1;
+    }
+    fwrite(pkt, PACKET_SIZE, 1, f);
+}
+
+/// 40 video and 4 audio packets per program and frame, 25 frames a second
+static int write_mux(const char *name, int progs, int seconds)
+{
+    FILE *f = fopen(name, "wb");
+    int frame, i, j, packets = 0;
+
+    if (!f) {
+        perror(name);
+        return -1;
+    }
+    for (frame = 0; frame < 25 * seconds; frame++) {
+        uint64_t pts = 90000 + frame * 3600;
+        if (frame % 3 == 0) {
+            write_tables(f, progs);
+            packets += 1 + progs;
+        }
+        for (j = 0; j < 40; j++)
+            for (i = 0; i < progs; i++) {
+                write_pes(f, VIDEO_PID(i), 0xe0, j == 0, pts);
+                if (j % 10 == 0)
+                    write_pes(f, AUDIO_PID(i), 0xc0, j == 0, pts);
+                packets += 1 + (j % 10 == 0);
+            }
+    }
+    fclose(f);
+    return packets;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = argc > 1 ? argv[1] : "tsbench.ts";
+    int progs = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 60;
+    int file_format = DEMUXER_TYPE_MPEG_TS, packets, frames = 0;
+    unsigned int start, usec;
+    stream_t *stream;
+    demuxer_t *demuxer;
+
+    mp_msg_init();
+    if (progs < 1 || progs > MAX_PROGS || seconds < 1) {
+        fprintf(stderr, "Usage: tsbench [file [programs (1-%d) [seconds]]]\n",
+                MAX_PROGS);
+        return 1;
+    }
+    packets = write_mux(name, progs, seconds);
+    if (packets < 0)
+        return 1;
+
+    stream = open_stream(name, NULL, &file_format);
+    if (!stream)
+        return 1;
+    demuxer = demux_open(stream, DEMUXER_TYPE_MPEG_TS, -1, -1, -2, (char *)name);
+    if (!demuxer) {
+        fprintf(stderr, "%s: not detected as MPEG-TS\n", name);
+        return 1;
+    }
+
+    // only the first program is selected, the others are dropped
+    start = GetTimer();
+    while (ds_fill_buffer(demuxer->video)) {
+        ds_free_packs(demuxer->audio);
+        frames++;
+    }
+    usec = GetTimer() - start;
+
+    printf("%d programs, %d packets (%d MB), %d video packets of program 1\n",
+           progs, packets, packets * PACKET_SIZE >> 20, frames);
+    printf("%.1f ms, %.0f packets/s, %.1f MB/s\n", usec / 1000.0,
+           packets * 1e6 / (usec ? usec : 1),
+           packets * (double)PACKET_SIZE / (usec ? usec : 1));
+    free_demuxer(demuxer);
+    free_stream(stream);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * reference reader for -vo shm, prints one line per received frame
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "libvo/vo_shm.h"
+
+/* hold each frame this long, to provoke drops in the player */
+static int hold_ms;
+
+static uint32_t checksum(const uint8_t *p, int w, int h, int stride)
+{
+    uint32_t sum = 0;
+    int x, y;
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++)
+            sum = sum * 31 + p[y * stride + x];
+    return sum;
+}
+
+static void wait_frame(struct vo_shm_header *hdr, uint32_t seen)
+{
+    struct timespec timeout = { 1, 0 };
+    // a timeout lets us notice the player going away (magic cleared)
+    syscall(SYS_futex, &hdr->write_seq, FUTEX_WAIT, seen, &timeout, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/shm/mplayer-vo";
+    struct vo_shm_header *hdr;
+    uint8_t *base = NULL;
+    size_t size = 0;
+    uint32_t generation = ~0;
+    int fd;
+
+    if (argc > 2)
+        hold_ms = atoi(argv[2]);
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    for (;;) {
+        struct stat st;
+        uint32_t seq;
+
+        if (fstat(fd, &st) < 0)
+            return 1;
+        // the player grows the file when the video size increases
+        if ((size_t)st.st_size > size) {
+            if (base)
+                munmap(base, size);
+            size = st.st_size;
+            base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED) {
+                perror("mmap");
+                return 1;
+            }
+        }
+        if (size < VO_SHM_HEADER_SIZE) {
+            usleep(100000);
+            continue;
+        }
+        hdr = (struct vo_shm_header *)base;
+        if (hdr->magic != VO_SHM_MAGIC || hdr->version != VO_SHM_VERSION) {
+            usleep(100000);
+            continue;
+        }
+        if (hdr->generation != generation) {
+            generation = hdr->generation;
+            printf("config %u: format 0x%x, %u buffers of %u bytes\n",
+                   generation, hdr->format, hdr->num_buffers, hdr->buffer_size);
+            if (VO_SHM_HEADER_SIZE + (size_t)hdr->num_buffers * hdr->buffer_size > size)
+                continue;
+        }
+
+        seq = hdr->read_seq;
+        if (seq == hdr->write_seq) {
+            wait_frame(hdr, seq);
+            continue;
+        }
+        __sync_synchronize();
+        while (seq != hdr->write_seq) {
+            struct vo_shm_slot *s = &hdr->slot[seq % hdr->num_buffers];
+            printf("frame %u: %ux%u pts %.3f sum %08x dropped %u\n",
+                   s->seq, s->width, s->height, s->pts,
+                   checksum(base + s->offset[0], s->width, s->height,
+                            s->stride[0]), hdr->dropped);
+            if (hold_ms)
+                usleep(hold_ms * 1000);
+            seq++;
+            __sync_synchronize();
+            hdr->read_seq = seq;
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * running a list of encodes in parallel worker processes
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* MEncoder keeps its whole state in globals, so the jobs run in forked
+   processes rather than threads. The parent has parsed codecs.conf and
+   the config files by then and the workers share those pages with it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include "config.h"
+#ifndef __MINGW32__
+#include <sys/wait.h>
+#endif
+
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "libavutil/avstring.h"
+#include "batch.h"
+
+#define MAX_LINE 4096
+
+typedef struct {
+    pid_t pid;              ///< 0 if the slot is free
+    int fd;                 ///< read end of the worker's report pipe
+    int job;
+    unsigned int start;     ///< GetTimerMS() when it was forked
+} worker_t;
+
+static int report_fd = -1;
+static volatile int stop;
+
+static void batch_sighandler(int x)
+{
+    stop = 1;
+}
+
+/// split a line at white space, "..." and '...' group words
+static int split_line(char *line, char **argv, int max)
+{
+    char *in = line, *out = line;
+    int argc = 0;
+
+    for (;;) {
+        char quote = 0;
+        while (isspace((unsigned char)*in))
+            in++;
+        if (!*in)
+            break;
+        if (argc == max)
+            return -1;
+        argv[argc++] = out;
+        while (*in && (quote || !isspace((unsigned char)*in))) {
+            if (*in == quote)
+                quote = 0;
+            else if (!quote && (*in == '"' || *in == '\''))
+                quote = *in;
+            else
+                *out++ = *in;
+            in++;
+        }
+        if (quote)
+            return -1;
+        if (*in)
+            in++;
+        *out++ = 0;
+    }
+    return argc;
+}
+
+static void free_jobs(char **jobs, int count)
+{
+    while (count--)
+        free(jobs[count]);
+    free(jobs);
+}
+
+/// the jobs of the file, blank lines and # comments left out
+static char **read_jobs(const char *jobfile, int *count)
+{
+    FILE *f = strcmp(jobfile, "-") ? fopen(jobfile, "r") : stdin;
+    char line[MAX_LINE], buf[MAX_LINE], *argv[MAX_LINE / 2], **jobs = NULL;
+    int n = 0, lineno = 0;
+
+    if (!f) {
+        mp_msg(MSGT_MENCODER, MSGL_FATAL, "[batch] Cannot open job file %s: %s\n",
+               jobfile, strerror(errno));
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line, **tmp;
+        int len;
+        lineno++;
+        while (isspace((unsigned char)*p))
+            p++;
+        len = strlen(p);
+        if (len && p[len - 1] != '\n' && !feof(f)) {
+            mp_msg(MSGT_MENCODER, MSGL_FATAL, "[batch] %s:%d: line too long\n",
+                   jobfile, lineno);
+            goto err_out;
+        }
+        while (len && isspace((unsigned char)p[len - 1]))
+            p[--len] = 0;
+        if (!len || *p == '#')
+            continue;
+        strcpy(buf, p);
+        if (split_line(buf, argv, MAX_LINE / 2) < 0) {
+            mp_msg(MSGT_MENCODER, MSGL_FATAL, "[batch] %s:%d: unbalanced quotes\n",
+                   jobfile, lineno);
+            goto err_out;
+        }
+        tmp = realloc(jobs, (n + 1) * sizeof(*jobs));
+        if (!tmp)
+            goto err_out;
+        jobs = tmp;
+        jobs[n++] = strdup(p);
+    }
+    if (f != stdin)
+        fclose(f);
+    *count = n;
+    return jobs;
+
+err_out:
+    if (f != stdin)
+        fclose(f);
+    free_jobs(jobs, n);
+    return NULL;
+}
+
+/// the output file of a job for the messages, its line number otherwise
+static void job_name(const char *job, char *name, int size, int num)
+{
+    char buf[MAX_LINE], *argv[MAX_LINE / 2];
+    int i, argc;
+
+    av_strlcpy(buf, job, sizeof(buf));
+    argc = split_line(buf, argv, MAX_LINE / 2);
+    for (i = argc - 2; i >= 0; i--)
+        if (!strcmp(argv[i], "-o")) {
+            av_strlcpy(name, argv[i + 1], size);
+            return;
+        }
+    snprintf(name, size, "job %d", num + 1);
+}
+
+#ifndef __MINGW32__
+/// fork a worker, 1 in the worker, 0 in the parent and -1 on failure
+static int start_worker(worker_t *w, int job)
+{
+    int fds[2];
+
+    if (pipe(fds) < 0)
+        return -1;
+    fflush(stdout);
+    fflush(stderr);
+    w->pid = fork();
+    if (w->pid < 0) {
+        w->pid = 0;
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (w->pid == 0) {
+        close(fds[0]);
+        report_fd = fds[1];
+        return 1;
+    }
+    close(fds[1]);
+    w->fd    = fds[0];
+    w->job   = job;
+    w->start = GetTimerMS();
+    return 0;
+}
+#endif
+
+int batch_run(const char *jobfile, int jobs, int *argc, char ***argv)
+{
+#ifdef __MINGW32__
+    mp_msg(MSGT_MENCODER, MSGL_FATAL, "[batch] Not supported on this system.\n");
+    return 1;
+#else
+    char **list, name[256];
+    worker_t *workers;
+    double media_total = 0;
+    unsigned int start = GetTimerMS();
+    int njobs, next = 0, running = 0, failed = 0, i;
+
+    list = read_jobs(jobfile, &njobs);
+    if (!list)
+        return 1;
+    if (jobs <= 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (jobs <= 0)
+            jobs = 1;
+    }
+    if (jobs > njobs)
+        jobs = njobs;
+    workers = calloc(jobs ? jobs : 1, sizeof(*workers));
+    if (!workers) {
+        free_jobs(list, njobs);
+        return 1;
+    }
+    mp_msg(MSGT_MENCODER, MSGL_INFO, "[batch] %d jobs on %d workers\n",
+           njobs, jobs);
+
+    signal(SIGINT,  batch_sighandler);
+    signal(SIGTERM, batch_sighandler);
+    signal(SIGHUP,  batch_sighandler);
+
+    while (running || (next < njobs && !stop)) {
+        worker_t *w = NULL;
+        double media = 0;
+        int status;
+        pid_t pid;
+
+        for (i = 0; i < jobs && next < njobs && !stop; i++) {
+            if (workers[i].pid)
+                continue;
+            switch (start_worker(&workers[i], next)) {
+            case 1: {
+                // this is the worker now
+                static char *job_argv[MAX_LINE / 2];
+                char *line = list[next];
+                char **args;
+                int n, j;
+                for (j = 0; j < jobs; j++)
+                    if (workers[j].pid)
+                        close(workers[j].fd);
+                signal(SIGINT,  SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                signal(SIGHUP,  SIG_DFL);
+                // read_jobs() has checked the quotes
+                n = split_line(line, job_argv, MAX_LINE / 2);
+                args = malloc((*argc + n + 1) * sizeof(*args));
+                if (!args)
+                    exit(1);
+                memcpy(args, *argv, *argc * sizeof(*args));
+                memcpy(args + *argc, job_argv, n * sizeof(*args));
+                *argc += n;
+                args[*argc] = NULL;
+                *argv = args;
+                // several status lines on one terminal are unreadable
+                if (jobs > 1)
+                    mp_msg_levels[MSGT_STATUSLINE] = MSGL_INFO;
+                return -1;
+            }
+            case 0:
+                running++;
+                next++;
+                break;
+            default:
+                mp_msg(MSGT_MENCODER, MSGL_ERR, "[batch] Cannot start a worker: %s\n",
+                       strerror(errno));
+                stop = 1;
+                break;
+            }
+        }
+        if (!running)
+            break;
+
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (i = 0; i < jobs; i++)
+            if (workers[i].pid == pid)
+                w = &workers[i];
+        if (!w)
+            continue;
+        // the worker has exited, whatever it reported is in the pipe
+        if (read(w->fd, &media, sizeof(media)) != sizeof(media))
+            media = 0;
+        close(w->fd);
+        w->pid = 0;
+        running--;
+
+        job_name(list[w->job], name, sizeof(name), w->job);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            double secs = (GetTimerMS() - w->start) / 1000.0;
+            media_total += media;
+            mp_msg(MSGT_MENCODER, MSGL_INFO,
+                   "[batch] %s: %.1fs of media in %.1fs, %.1fx realtime\n",
+                   name, media, secs, secs > 0 ? media / secs : 0);
+        } else {
+            failed++;
+            mp_msg(MSGT_MENCODER, MSGL_ERR, "[batch] %s failed\n", name);
+        }
+    }
+
+    {
+        double secs = (GetTimerMS() - start) / 1000.0;
+        mp_msg(MSGT_MENCODER, MSGL_INFO,
+               "[batch] %d of %d jobs done, %d failed: %.1fs of media in %.1fs, %.1fx realtime\n",
+               next - failed, njobs, failed, media_total, secs,
+               secs > 0 ? media_total / secs : 0);
+    }
+    free_jobs(list, njobs);
+    free(workers);
+    return stop ? 2 : failed ? 1 : 0;
+#endif
+}
+
+void batch_report(double seconds)
+{
+    if (report_fd < 0)
+        return;
+    if (write(report_fd, &seconds, sizeof(seconds)) != sizeof(seconds))
+        mp_msg(MSGT_MENCODER, MSGL_WARN, "[batch] Cannot report to the parent.\n");
+    close(report_fd);
+    report_fd = -1;
+}
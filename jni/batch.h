@@ -0,0 +1,36 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_BATCH_H
+#define MPLAYER_BATCH_H
+
+/**
+ * \brief run the lines of a job file in up to jobs worker processes
+ *
+ * Each line holds the files, their options and -o of one encode. A
+ * worker returns from here with argc/argv set to the original command
+ * line followed by its line, the parent only returns once every job is
+ * done.
+ * \param jobs number of workers, 0 for one per CPU
+ * \return -1 in a worker, the exit code of mencoder in the parent
+ */
+int batch_run(const char *jobfile, int jobs, int *argc, char ***argv);
+/// hand the seconds of media encoded to the parent, for its statistics
+void batch_report(double seconds);
+
+#endif /* MPLAYER_BATCH_H */
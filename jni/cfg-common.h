@@ -27,6 +27,7 @@
 #include "libmpcodecs/vd.h"
 #include "libmpcodecs/vf_scale.h"
 #include "libmpdemux/demux_audio.h"
+#include "libmpdemux/seekidx.h"
 #include "libmpdemux/demux_mpg.h"
 #include "libmpdemux/demux_ts.h"
 #include "libmpdemux/demux_viv.h"
@@ -318,6 +319,8 @@ const m_option_t common_opts[] = {
     {"nocache", &stream_cache_size, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"cache-min", &stream_cache_min_percent, CONF_TYPE_FLOAT, CONF_RANGE, 0, 99, NULL},
     {"cache-seek-min", &stream_cache_seek_min_percent, CONF_TYPE_FLOAT, CONF_RANGE, 0, 99, NULL},
+    {"cache-dir", &stream_cache_dir, CONF_TYPE_STRING, 0, 0, 0, NULL},
+    {"cache-disk-size", &stream_cache_disk_size, CONF_TYPE_INT, CONF_MIN, 0, 0, NULL},
 #else
     {"cache", "MPlayer was compiled without cache2 support.\n", CONF_TYPE_PRINT, CONF_NOCFG, 0, 0, NULL},
 #endif /* CONFIG_STREAM_CACHE */
@@ -426,6 +429,10 @@ const m_option_t common_opts[] = {
     {"forceidx", &index_mode, CONF_TYPE_FLAG, 0, -1, 2, NULL},
     {"saveidx", &index_file_save, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"loadidx", &index_file_load, CONF_TYPE_STRING, 0, 0, 0, NULL},
+    // keyframe positions learned while playing, reused on the next run
+    {"idxcache", &index_cache, CONF_TYPE_FLAG, 0, 0, 1, NULL},
+    {"noidxcache", &index_cache, CONF_TYPE_FLAG, 0, 1, 0, NULL},
+    {"idxcache-dir", &index_cache_dir, CONF_TYPE_STRING, 0, 0, 0, NULL},
 
     // select audio/video/subtitle stream
     {"aid", &audio_id, CONF_TYPE_INT, CONF_RANGE, -2, 8190, NULL},
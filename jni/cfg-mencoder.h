@@ -173,6 +173,9 @@ const m_option_t mencoder_opts[]={
     // and for 29.97FPS progressive MPEG2 streams
     {"ofps", &force_ofps, CONF_TYPE_DOUBLE, CONF_MIN|CONF_GLOBAL, 0, 0, NULL},
     {"o", &out_filename, CONF_TYPE_STRING, CONF_GLOBAL, 0, 0, NULL},
+    // a file of encodes, each line with its own files, options and -o
+    {"batch", &batch_filename, CONF_TYPE_STRING, CONF_GLOBAL|CONF_NOCFG|CONF_PRE_PARSE, 0, 0, NULL},
+    {"jobs", &batch_jobs, CONF_TYPE_INT, CONF_RANGE|CONF_GLOBAL|CONF_PRE_PARSE, 0, 64, NULL},
 
     // limit number of skippable frames after a non-skipped one
     {"skiplimit", &skip_limit, CONF_TYPE_INT, 0, 0, 0, NULL},
@@ -216,6 +219,7 @@ const m_option_t mencoder_opts[]={
 
     {"odml", &write_odml, CONF_TYPE_FLAG, CONF_GLOBAL, 0, 1, NULL},
     {"noodml", &write_odml, CONF_TYPE_FLAG, CONF_GLOBAL, 1, 0, NULL},
+    {"odmlflush", &odml_flush, CONF_TYPE_FLOAT, CONF_RANGE|CONF_GLOBAL, 0, 3600, NULL},
 
     // info header strings
     {"info", info_conf, CONF_TYPE_SUBCONFIG, CONF_GLOBAL, 0, 0, NULL},
@@ -73,6 +73,10 @@ const m_option_t mplayer_opts[]={
     {"ao", &audio_driver_list, CONF_TYPE_STRING_LIST, 0, 0, 0, NULL},
     {"fixed-vo", &fixed_vo, CONF_TYPE_FLAG,CONF_GLOBAL , 0, 1, NULL},
     {"nofixed-vo", &fixed_vo, CONF_TYPE_FLAG,CONF_GLOBAL, 1, 0, NULL},
+    {"gapless", &gapless_audio, CONF_TYPE_FLAG, CONF_GLOBAL, 0, 1, NULL},
+    {"nogapless", &gapless_audio, CONF_TYPE_FLAG, CONF_GLOBAL, 1, 0, NULL},
+    {"audio-thread", &use_audio_thread, CONF_TYPE_FLAG, CONF_GLOBAL, 0, 1, NULL},
+    {"noaudio-thread", &use_audio_thread, CONF_TYPE_FLAG, CONF_GLOBAL, 1, 0, NULL},
     {"ontop", &vo_ontop, CONF_TYPE_FLAG, 0, 0, 1, NULL},
     {"noontop", &vo_ontop, CONF_TYPE_FLAG, 0, 1, 0, NULL},
     {"rootwin", &vo_rootwin, CONF_TYPE_FLAG, 0, 0, 1, NULL},
@@ -42,6 +42,7 @@
 #include "libao2/audio_out.h"
 #include "mpcommon.h"
 #include "mixer.h"
+#include "libmplayer.h"
 #include "libmpcodecs/dec_video.h"
 #include "libmpcodecs/dec_teletext.h"
 #include "vobsub.h"
@@ -3365,6 +3366,9 @@ int run_command(MPContext *mpctx, mp_cmd_t *cmd)
         af_init(mpctx->mixer.afilter);
         build_afilter_chain(sh_audio, &ao_data);
         break;
+    case MP_CMD_EMBED_CALL:
+        libmplayer_run_call(mpctx, cmd->args[0].v.v);
+        break;
         default:
                 mp_msg(MSGT_CPLAYER, MSGL_V,
                        "Received unknown cmd %s\n", cmd->name);
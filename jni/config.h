@@ -352,6 +352,7 @@
 #undef CONFIG_DVBIN 
 #undef CONFIG_DXR2
 #undef CONFIG_DXR3
+#define CONFIG_EMBED_VO 1
 #define CONFIG_FBDEV 1
 #undef CONFIG_GGI
 #undef CONFIG_GGIWMH
@@ -375,6 +376,7 @@
 #undef CONFIG_S3FB
 #undef CONFIG_SDL
 #undef CONFIG_SDL_SDL_H
+#define CONFIG_SHM_VO 1
 #undef CONFIG_SVGALIB
 #undef CONFIG_TDFXFB
 #undef CONFIG_XVR100
@@ -104,6 +104,7 @@ DVDREAD = no
 DVDREAD_INTERNAL = no
 DXR2 = no
 DXR3 = no
+EMBED_VO = yes
 ESD = no
 FAAC=no
 FAAD = yes
@@ -179,6 +180,7 @@ RADIO_CAPTURE=no
 REAL_CODECS = no
 S3FB = no
 SDL = no
+SHM_VO = yes
 SPEEX = no
 STREAM_CACHE = yes
 SGIAUDIO = auto
@@ -417,6 +417,11 @@ static void check_os_katmai_support( void )
 }
 #else /* ARCH_X86 */
 
+#if ARCH_ARM && defined(__linux__)
+#include <stdio.h>
+#include <string.h>
+#endif
+
 #ifdef __APPLE__
 #include <sys/sysctl.h>
 #elif defined(__AMIGAOS4__)
@@ -456,6 +461,32 @@ void GetCpuCaps( CpuCaps *caps)
     caps->hasSSE4a=0;
     caps->isX86=0;
     caps->hasAltiVec = 0;
+    caps->hasARMv6 = 0;
+    caps->hasNEON = 0;
+#if ARCH_ARM && defined(__linux__)
+/* NEON is optional even on ARMv7 (Tegra 2 has none), so ask the kernel
+   instead of trusting the build flags. */
+    {
+        FILE *f = fopen("/proc/cpuinfo", "r");
+        char line[512], *p;
+
+        while (f && fgets(line, sizeof(line), f)) {
+            if (!strncmp(line, "Features", 8) &&
+                (strstr(line, " neon") || strstr(line, " asimd")))
+                caps->hasNEON = 1;
+            if (!strncmp(line, "CPU architecture", 16) &&
+                (p = strchr(line, ':')) && atoi(p + 1) >= 6)
+                caps->hasARMv6 = 1;
+        }
+        if (f)
+            fclose(f);
+        // "CPU architecture: AArch64" on 64-bit kernels
+        if (caps->hasNEON)
+            caps->hasARMv6 = 1;
+    }
+    mp_msg(MSGT_CPUDETECT,MSGL_V,"ARMv6 %sfound, NEON %sfound\n",
+           caps->hasARMv6 ? "" : "not ", caps->hasNEON ? "" : "not ");
+#endif
 #if HAVE_ALTIVEC
 #ifdef __APPLE__
 /*
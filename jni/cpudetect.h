@@ -45,6 +45,8 @@ typedef struct cpucaps_s {
     unsigned cl_size; /* size of cache line */
     int hasAltiVec;
     int hasTSC;
+    int hasARMv6;
+    int hasNEON;
 } CpuCaps;
 
 extern CpuCaps gCpuCaps;
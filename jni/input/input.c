@@ -501,6 +501,9 @@ static const mp_cmd_bind_t def_cmd_binds[] = {
 
 #define CMD_QUEUE_SIZE 100
 
+// fds that cannot be waited on are still read at least this often (ms)
+#define NO_SELECT_POLL_TIME 20
+
 typedef struct mp_input_fd {
   int fd;
   void* read_func;
@@ -550,6 +553,8 @@ static mp_input_fd_t cmd_fds[MP_MAX_CMD_FD];
 static unsigned int num_cmd_fd = 0;
 static mp_cmd_t* cmd_queue[CMD_QUEUE_SIZE];
 static unsigned int cmd_queue_length = 0,cmd_queue_start = 0, cmd_queue_end = 0;
+// output fd to wait on for writing in addition to the input fds, see mp_input_wait()
+static int wait_out_fd = -1;
 
 // this is the key currently down
 static int key_down[MP_MAX_KEY_DOWN];
@@ -1204,23 +1209,35 @@ static mp_cmd_t *read_events(int time, int paused)
 #ifdef HAVE_POSIX_SELECT
     FD_ZERO(&fds);
     if (!got_cmd) {
-	int max_fd = 0, num_fd = 0;
+	int max_fd = 0, num_fd = 0, polled_fd = 0;
 	for (i = 0; i < num_key_fd; i++) {
-	    if (key_fds[i].no_select)
+	    if (key_fds[i].no_select) {
+		polled_fd = 1;
 		continue;
+	    }
 	    if (key_fds[i].fd > max_fd)
 		max_fd = key_fds[i].fd;
 	    FD_SET(key_fds[i].fd, &fds);
 	    num_fd++;
 	}
 	for (i = 0; i < num_cmd_fd; i++) {
-	    if (cmd_fds[i].no_select)
+	    if (cmd_fds[i].no_select) {
+		polled_fd = 1;
 		continue;
+	    }
 	    if (cmd_fds[i].fd > max_fd)
 		max_fd = cmd_fds[i].fd;
 	    FD_SET(cmd_fds[i].fd, &fds);
 	    num_fd++;
 	}
+	if (wait_out_fd >= 0) {
+	    if (wait_out_fd > max_fd)
+		max_fd = wait_out_fd;
+	    FD_SET(wait_out_fd, &fds);
+	    num_fd++;
+	}
+	if (polled_fd && (time < 0 || time > NO_SELECT_POLL_TIME))
+	    time = NO_SELECT_POLL_TIME;
 	if (num_fd > 0) {
 	    struct timeval tv, *time_val;
 	    if (time >= 0) {
@@ -1236,7 +1253,16 @@ static mp_cmd_t *read_events(int time, int paused)
 			    strerror(errno));
 		FD_ZERO(&fds);
 	    }
+	    if (wait_out_fd >= 0 && FD_ISSET(wait_out_fd, &fds)) {
+		// take the expirations off a timer fd, so the next wait blocks
+		char buf[8];
+		while (read(wait_out_fd, buf, sizeof(buf)) > 0)
+		    ;
+	    }
 	}
+	else if (time > 0)
+	    // nothing to wait on, behave like the non-select variant
+	    usec_sleep(time * 1000);
     }
 #else
     if (!got_cmd && time)
@@ -1374,6 +1400,24 @@ mp_input_get_cmd(int time, int paused, int peek_only) {
   return ret;
 }
 
+/**
+ * \brief single wait primitive for the main loop
+ *
+ * Blocks until input is available, out_fd becomes readable or the
+ * timeout expires, whichever comes first.
+ * \param time maximum time to wait in milliseconds
+ * \param out_fd file descriptor to wait on for reading, -1 for none
+ * \return 1 if a command is ready to be fetched with mp_input_get_cmd()
+ */
+int mp_input_wait(int time, int paused, int out_fd)
+{
+  mp_cmd_t *cmd;
+  wait_out_fd = out_fd;
+  cmd = mp_input_get_cmd(time, paused, 1);
+  wait_out_fd = -1;
+  return cmd != NULL;
+}
+
 void
 mp_cmd_free(mp_cmd_t* cmd) {
   int i;
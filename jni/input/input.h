@@ -158,6 +158,9 @@ typedef enum {
   MP_CMD_AF_DEL,
   MP_CMD_AF_CLR,
 
+  /// internal, posted by libmplayer and never parsed from text
+  MP_CMD_EMBED_CALL,
+
 } mp_command_type;
 
 // The arg types
@@ -270,7 +273,7 @@ int mp_input_get_key_from_name(const char *name);
 
 // This function can be used to put a command in the system again. It's used by libmpdemux
 // when it performs a blocking operation to resend the command it received to the main
-// loop.
+// loop. Main thread only, other threads must use mp_cmd_fifo_put().
 int
 mp_input_queue_cmd(mp_cmd_t* cmd);
 
@@ -279,6 +282,10 @@ mp_input_queue_cmd(mp_cmd_t* cmd);
 mp_cmd_t*
 mp_input_get_cmd(int time, int paused, int peek_only);
 
+// Wait at most time msec for a command or for out_fd (if >= 0) to become
+// readable. Returns 1 if a command is waiting to be fetched.
+int mp_input_wait(int time, int paused, int out_fd);
+
 mp_cmd_t*
 mp_input_parse_cmd(char* str);
 
@@ -23,6 +23,7 @@
 #include "osdep/strsep.h"
 
 #include "af.h"
+#include "af_simd.h"
 
 // Static list of filters
 extern af_info_t af_info_dummy;
@@ -356,8 +357,14 @@ static int af_reinit(af_stream_t* s, af_instance_t* af)
 // Uninit and remove all filters
 void af_uninit(af_stream_t* s)
 {
+  int i;
   while(s->first)
     af_remove(s,s->first);
+  for(i=0;i<2;i++){
+    free(s->scratch[i]);
+    s->scratch[i]=NULL;
+    s->scratch_len[i]=0;
+  }
 }
 
 /**
@@ -435,6 +442,7 @@ int af_init(af_stream_t* s)
   // Figure out how fast the machine is
   if(AF_INIT_AUTO == (AF_INIT_TYPE_MASK & s->cfg.force))
     s->cfg.force = (s->cfg.force & ~AF_INIT_TYPE_MASK) | AF_INIT_TYPE;
+  af_simd_init();
 
   // Check if this is the first call
   if(!s->first){
@@ -543,6 +551,36 @@ af_instance_t* af_add(af_stream_t* s, char* name){
   return new;
 }
 
+/* Lend the scratch buffer that does not hold the input data to af as its
+   output buffer. Both only ever grow, so once they are large enough for
+   the biggest chunk the chain runs without allocating. */
+static int af_lend_scratch(af_stream_t* s, af_instance_t* af, af_data_t* data)
+{
+  int i = data->audio == s->scratch[0];
+  int len = af_lencalc(af->mul,data);
+
+  // Buffer of its own from before it was flagged
+  if(af->data->audio){
+    free(af->data->audio);
+    af->data->audio = NULL;
+  }
+  if(s->scratch_len[i] < len){
+    mp_msg(MSGT_AFILTER, MSGL_V, "[libaf] Growing scratch buffer %d for module %s, "
+	   "old len = %i, new len = %i\n",i,af->info->name,s->scratch_len[i],len);
+    free(s->scratch[i]);
+    s->scratch[i] = malloc(len);
+    if(!s->scratch[i]){
+      s->scratch_len[i] = 0;
+      mp_msg(MSGT_AFILTER, MSGL_FATAL, "[libaf] Could not allocate memory \n");
+      return AF_ERROR;
+    }
+    s->scratch_len[i] = len;
+  }
+  af->data->audio = s->scratch[i];
+  af->data->len = s->scratch_len[i];
+  return AF_OK;
+}
+
 // Filter data chunk through the filters in the list
 af_data_t* af_play(af_stream_t* s, af_data_t* data)
 {
@@ -550,7 +588,16 @@ af_data_t* af_play(af_stream_t* s, af_data_t* data)
   // Iterate through all filters
   do{
     if (data->len <= 0) break;
-    data=af->play(af,data);
+    if(af->flags & AF_BUF_SCRATCH){
+      if(AF_OK != af_lend_scratch(s,af,data))
+	return NULL;
+      data=af->play(af,data);
+      // Take it back before the filter could free it
+      af->data->audio=NULL;
+      af->data->len=0;
+    }
+    else
+      data=af->play(af,data);
     af=af->next;
   }while(af && data);
   return data;
@@ -51,6 +51,13 @@ typedef struct af_data_s
 #define AF_FLAGS_REENTRANT 	0x00000000
 #define AF_FLAGS_NOT_REENTRANT 	0x00000001
 
+/* Output buffer handling of an instance, set by the filter in open or
+   AF_CONTROL_REINIT */
+#define AF_BUF_INPLACE	0x00000001 // play writes its output over its input
+#define AF_BUF_SCRATCH	0x00000002 /* play only writes to af->data->audio and
+				      keeps nothing there between calls, so
+				      the stream may lend it a shared buffer */
+
 /* Audio filter information not specific for current instance, but for
    a specific filter */
 typedef struct af_info_s
@@ -78,6 +85,7 @@ typedef struct af_instance_s
 		 * corresponding output */
   double mul; /* length multiplier: how much does this instance change
 		 the length of the buffer. */
+  int flags; // AF_BUF_* flags
 }af_instance_t;
 
 // Initialization flags
@@ -116,6 +124,9 @@ typedef struct af_stream
   af_data_t output;
   // Configuration for this stream
   af_cfg_t cfg;
+  // Ping-pong buffers lent to AF_BUF_SCRATCH filters
+  void* scratch[2];
+  int scratch_len[2];
 }af_stream_t;
 
 /*********************************************
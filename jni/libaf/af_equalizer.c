@@ -30,6 +30,7 @@
 #include <math.h>
 
 #include "af.h"
+#include "af_simd.h"
 
 #define L   	2      // Storage for filter taps
 #define KM  	10     // Max number of bands
@@ -62,8 +63,8 @@ typedef struct af_equalizer_s
 {
   float   a[KM][L];        	// A weights
   float   b[KM][L];	     	// B weights
-  float   wq[AF_NCH][KM][L];  	// Circular buffer for W data
-  float   g[AF_NCH][KM];      	// Gain factor for each channel and band
+  float   wq[KM][L][AF_NCH];  	// Circular buffer for W data
+  float   g[KM][AF_NCH];      	// Gain factor for each band and channel
   int     K; 		   	// Number of used eq bands
   int     channels;        	// Number of channels
   float   gain_factor;     // applied at output to avoid clipping
@@ -122,7 +123,7 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     {
         for(i=0;i<KM;i++)
         {
-            if(s->gain_factor < s->g[k][i]) s->gain_factor=s->g[k][i];
+            if(s->gain_factor < s->g[i][k]) s->gain_factor=s->g[i][k];
         }
     }
 
@@ -144,7 +145,7 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 	   &g[2], &g[3], &g[4], &g[5], &g[6], &g[7], &g[8] ,&g[9]);
     for(i=0;i<AF_NCH;i++){
       for(j=0;j<KM;j++){
-	((af_equalizer_t*)af->setup)->g[i][j] =
+	((af_equalizer_t*)af->setup)->g[j][i] =
 	  pow(10.0,clamp(g[j],G_MIN,G_MAX)/20.0)-1.0;
       }
     }
@@ -158,7 +159,7 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
       return AF_ERROR;
 
     for(k = 0 ; k<KM ; k++)
-      s->g[ch][k] = pow(10.0,clamp(gain[k],G_MIN,G_MAX)/20.0)-1.0;
+      s->g[k][ch] = pow(10.0,clamp(gain[k],G_MIN,G_MAX)/20.0)-1.0;
 
     return AF_OK;
   }
@@ -170,7 +171,7 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
       return AF_ERROR;
 
     for(k = 0 ; k<KM ; k++)
-      gain[k] = log10(s->g[ch][k]+1.0) * 20.0;
+      gain[k] = log10(s->g[k][ch]+1.0) * 20.0;
 
     return AF_OK;
   }
@@ -192,37 +193,11 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
 {
   af_data_t*       c 	= data;			    	// Current working data
   af_equalizer_t*  s 	= (af_equalizer_t*)af->setup; 	// Setup
-  uint32_t  	   ci  	= af->data->nch; 	    	// Index for channels
-  uint32_t	   nch 	= af->data->nch;   	    	// Number of channels
-
-  while(ci--){
-    float*	g   = s->g[ci];      // Gain factor
-    float*	in  = ((float*)c->audio)+ci;
-    float*	out = ((float*)c->audio)+ci;
-    float* 	end = in + c->len/4; // Block loop end
-
-    while(in < end){
-      register int	k  = 0;		// Frequency band index
-      register float 	yt = *in; 	// Current input sample
-      in+=nch;
-
-      // Run the filters
-      for(;k<s->K;k++){
- 	// Pointer to circular buffer wq
- 	register float* wq = s->wq[ci][k];
- 	// Calculate output from AR part of current filter
- 	register float w=yt*s->b[k][0] + wq[0]*s->a[k][0] + wq[1]*s->a[k][1];
- 	// Calculate output form MA part of current filter
- 	yt+=(w + wq[1]*s->b[k][1])*g[k];
- 	// Update circular buffer
- 	wq[1] = wq[0];
-	wq[0] = w;
-      }
-      // Calculate output
-      *out=yt*s->gain_factor;
-      out+=nch;
-    }
-  }
+  int		   nch 	= af->data->nch;   	    	// Number of channels
+
+  // Run the filters, channel by channel or several at once
+  af_simd.equalizer_float(c->audio, c->len/4/nch, nch, s->K, s->a[0], s->b[0],
+			  s->g[0], s->wq[0][0], s->gain_factor);
   return c;
 }
 
@@ -29,6 +29,7 @@
 
 #include "config.h"
 #include "af.h"
+#include "af_simd.h"
 #include "mpbswap.h"
 #include "libvo/fastmemcpy.h"
 
@@ -140,6 +141,13 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 	   af_fmt2str(af->data->format,buf2,256));
 	af->play = play_s16_float;
     }
+    // Samples that do not grow and need no table are converted over the input
+    if(af->play == play_swapendian ||
+       (af->data->bps <= data->bps &&
+	!((af->data->format | data->format) & AF_FORMAT_SPECIAL_MASK)))
+      af->flags = AF_BUF_INPLACE;
+    else
+      af->flags = AF_BUF_SCRATCH;
     return AF_OK;
   }
   case AF_CONTROL_COMMAND_LINE:{
@@ -175,18 +183,29 @@ static void uninit(struct af_instance_s* af)
   af->setup = 0;
 }
 
+// Output buffer of play, the input itself when converting in place
+static void* out_buffer(struct af_instance_s* af, af_data_t* data)
+{
+  if(af->flags & AF_BUF_INPLACE)
+    return data->audio;
+  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+    return NULL;
+  return af->data->audio;
+}
+
 static af_data_t* play_swapendian(struct af_instance_s* af, af_data_t* data)
 {
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
   int 	       len = c->len/c->bps; // Length in samples of current audio block
+  void*        out = out_buffer(af,data);
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+  if(!out)
     return NULL;
 
-  endian(c->audio,l->audio,len,c->bps);
+  endian(c->audio,out,len,c->bps);
 
-  c->audio = l->audio;
+  c->audio = out;
   c->format = l->format;
 
   return c;
@@ -197,13 +216,14 @@ static af_data_t* play_float_s16(struct af_instance_s* af, af_data_t* data)
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
   int 	       len = c->len/4; // Length in samples of current audio block
+  void*        out = out_buffer(af,data);
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+  if(!out)
     return NULL;
 
-  float2int(c->audio, l->audio, len, 2);
+  float2int(c->audio, out, len, 2);
 
-  c->audio = l->audio;
+  c->audio = out;
   c->len = len*2;
   c->bps = 2;
   c->format = l->format;
@@ -216,13 +236,14 @@ static af_data_t* play_s16_float(struct af_instance_s* af, af_data_t* data)
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
   int 	       len = c->len/2; // Length in samples of current audio block
+  void*        out = out_buffer(af,data);
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+  if(!out)
     return NULL;
 
-  int2float(c->audio, l->audio, len, 2);
+  int2float(c->audio, out, len, 2);
 
-  c->audio = l->audio;
+  c->audio = out;
   c->len = len*4;
   c->bps = 4;
   c->format = l->format;
@@ -236,8 +257,9 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   af_data_t*   l   = af->data;	// Local data
   af_data_t*   c   = data;	// Current working data
   int 	       len = c->len/c->bps; // Length in samples of current audio block
+  void*        out = out_buffer(af,data);
 
-  if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
+  if(!out)
     return NULL;
 
   // Change to cpu native endian format
@@ -246,29 +268,29 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
 
   // Conversion table
   if((c->format & AF_FORMAT_SPECIAL_MASK) == AF_FORMAT_MU_LAW) {
-    from_ulaw(c->audio, l->audio, len, l->bps, l->format&AF_FORMAT_POINT_MASK);
+    from_ulaw(c->audio, out, len, l->bps, l->format&AF_FORMAT_POINT_MASK);
     if(AF_FORMAT_A_LAW == (l->format&AF_FORMAT_SPECIAL_MASK))
-      to_ulaw(l->audio, l->audio, len, 1, AF_FORMAT_SI);
+      to_ulaw(out, out, len, 1, AF_FORMAT_SI);
     if((l->format&AF_FORMAT_SIGN_MASK) == AF_FORMAT_US)
-      si2us(l->audio,len,l->bps);
+      si2us(out,len,l->bps);
   } else if((c->format & AF_FORMAT_SPECIAL_MASK) == AF_FORMAT_A_LAW) {
-    from_alaw(c->audio, l->audio, len, l->bps, l->format&AF_FORMAT_POINT_MASK);
+    from_alaw(c->audio, out, len, l->bps, l->format&AF_FORMAT_POINT_MASK);
     if(AF_FORMAT_A_LAW == (l->format&AF_FORMAT_SPECIAL_MASK))
-      to_alaw(l->audio, l->audio, len, 1, AF_FORMAT_SI);
+      to_alaw(out, out, len, 1, AF_FORMAT_SI);
     if((l->format&AF_FORMAT_SIGN_MASK) == AF_FORMAT_US)
-      si2us(l->audio,len,l->bps);
+      si2us(out,len,l->bps);
   } else if((c->format & AF_FORMAT_POINT_MASK) == AF_FORMAT_F) {
     switch(l->format&AF_FORMAT_SPECIAL_MASK){
     case(AF_FORMAT_MU_LAW):
-      to_ulaw(c->audio, l->audio, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
+      to_ulaw(c->audio, out, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
       break;
     case(AF_FORMAT_A_LAW):
-      to_alaw(c->audio, l->audio, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
+      to_alaw(c->audio, out, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
       break;
     default:
-      float2int(c->audio, l->audio, len, l->bps);
+      float2int(c->audio, out, len, l->bps);
       if((l->format&AF_FORMAT_SIGN_MASK) == AF_FORMAT_US)
-	si2us(l->audio,len,l->bps);
+	si2us(out,len,l->bps);
       break;
     }
   } else {
@@ -281,30 +303,30 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
     // Convert to special formats
     switch(l->format&(AF_FORMAT_SPECIAL_MASK|AF_FORMAT_POINT_MASK)){
     case(AF_FORMAT_MU_LAW):
-      to_ulaw(c->audio, l->audio, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
+      to_ulaw(c->audio, out, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
       break;
     case(AF_FORMAT_A_LAW):
-      to_alaw(c->audio, l->audio, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
+      to_alaw(c->audio, out, len, c->bps, c->format&AF_FORMAT_POINT_MASK);
       break;
     case(AF_FORMAT_F):
-      int2float(c->audio, l->audio, len, c->bps);
+      int2float(c->audio, out, len, c->bps);
       break;
     default:
       // Change the number of bits
       if(c->bps != l->bps)
-	change_bps(c->audio,l->audio,len,c->bps,l->bps);
-      else
-	fast_memcpy(l->audio,c->audio,len*c->bps);
+	change_bps(c->audio,out,len,c->bps,l->bps);
+      else if(out != c->audio)
+	fast_memcpy(out,c->audio,len*c->bps);
       break;
     }
   }
 
   // Switch from cpu native endian to the correct endianness
   if((l->format&AF_FORMAT_END_MASK)!=AF_FORMAT_NE)
-    endian(l->audio,l->audio,len,l->bps);
+    endian(out,out,len,l->bps);
 
   // Set output data
-  c->audio  = l->audio;
+  c->audio  = out;
   c->len    = len*l->bps;
   c->bps    = l->bps;
   c->format = l->format;
@@ -460,8 +482,7 @@ static void change_bps(void* in, void* out, int len, int inbps, int outbps)
 	((uint8_t*)out)[i]=(uint8_t)((((uint32_t*)in)[i])>>24);
       break;
     case(2):
-      for(i=0;i<len;i++)
-	((uint16_t*)out)[i]=(uint16_t)((((uint32_t*)in)[i])>>16);
+      af_simd.s32_to_s16(out, in, len);
       break;
     case(3):
       for(i=0;i<len;i++)
@@ -481,8 +502,7 @@ static void float2int(float* in, void* out, int len, int bps)
       ((int8_t*)out)[i] = lrintf(127.0 * in[i]);
     break;
   case(2):
-    for(i=0;i<len;i++)
-      ((int16_t*)out)[i] = lrintf(32767.0 * in[i]);
+    af_simd.float_to_s16(out, in, len);
     break;
   case(3):
     for(i=0;i<len;i++)
@@ -504,8 +524,7 @@ static void int2float(void* in, float* out, int len, int bps)
       out[i]=(1.0/128.0)*((int8_t*)in)[i];
     break;
   case(2):
-    for(i=0;i<len;i++)
-      out[i]=(1.0/32768.0)*((int16_t*)in)[i];
+    af_simd.s16_to_float(out, in, len);
     break;
   case(3):
     for(i=0;i<len;i++)
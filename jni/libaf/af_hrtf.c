@@ -615,6 +615,7 @@ static int af_open(af_instance_t* af)
     af->uninit = uninit;
     af->play = play;
     af->mul = 1;
+    af->flags = AF_BUF_SCRATCH;
     af->data = calloc(1, sizeof(af_data_t));
     af->setup = calloc(1, sizeof(af_hrtf_t));
     if((af->data == NULL) || (af->setup == NULL))
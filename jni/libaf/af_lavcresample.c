@@ -194,6 +194,7 @@ static int af_open(af_instance_t* af){
   af->uninit=uninit;
   af->play=play;
   af->mul=1;
+  af->flags=AF_BUF_SCRATCH;
   af->data=calloc(1,sizeof(af_data_t));
   s->filter_length= 16;
   s->cutoff= max(1.0 - 6.5/(s->filter_length+8), 0.80);
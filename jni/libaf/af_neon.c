@@ -0,0 +1,271 @@
+/*
+ * NEON versions of the libaf sample kernels
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Built with -mfpu=neon whatever the rest of the player is built for,
+   af_simd_init() only calls in here after the CPU reported NEON. Builds
+   without NEON code generation (armeabi) get an empty stub. */
+
+#include <string.h>
+#include <limits.h>
+
+#include "config.h"
+#include "af.h"
+#include "af_simd.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+
+/* Rounds half away from zero where lrintf() rounds half to even, and
+   saturates where the C version wraps. */
+static void float_to_s16_neon(int16_t* out, const float* in, int len)
+{
+  const float32x4_t scale = vdupq_n_f32(32767.0f);
+  const float32x4_t half  = vdupq_n_f32(0.5f);
+  const uint32x4_t  sign  = vdupq_n_u32(0x80000000);
+  int i;
+
+  for(i=0;i+8<=len;i+=8){
+    float32x4_t x0 = vmulq_f32(vld1q_f32(in+i),   scale);
+    float32x4_t x1 = vmulq_f32(vld1q_f32(in+i+4), scale);
+    // +-0.5 with the sign of x, then truncate
+    x0 = vaddq_f32(x0, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(half),
+                       vandq_u32(vreinterpretq_u32_f32(x0), sign))));
+    x1 = vaddq_f32(x1, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(half),
+                       vandq_u32(vreinterpretq_u32_f32(x1), sign))));
+    vst1q_s16(out+i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(x0)),
+                                  vqmovn_s32(vcvtq_s32_f32(x1))));
+  }
+  af_simd_c.float_to_s16(out+i, in+i, len-i);
+}
+
+static void s16_to_float_neon(float* out, const int16_t* in, int len)
+{
+  const float32x4_t scale = vdupq_n_f32(1.0f/32768.0f);
+  int i;
+
+  for(i=0;i+8<=len;i+=8){
+    int16x8_t x = vld1q_s16(in+i);
+    vst1q_f32(out+i,   vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))),  scale));
+    vst1q_f32(out+i+4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+  }
+  af_simd_c.s16_to_float(out+i, in+i, len-i);
+}
+
+static void s32_to_s16_neon(int16_t* out, const int32_t* in, int len)
+{
+  int i;
+
+  for(i=0;i+8<=len;i+=8)
+    vst1q_s16(out+i, vcombine_s16(vshrn_n_s32(vld1q_s32(in+i),   16),
+                                  vshrn_n_s32(vld1q_s32(in+i+4), 16)));
+  af_simd_c.s32_to_s16(out+i, in+i, len-i);
+}
+
+static void volume_s16_neon(int16_t* a, int len, int nch, const int* vol)
+{
+  int16_t v[4];
+  int16x4_t vv;
+  int i;
+
+  // Lane pattern repeats every 4 samples only for 1, 2 and 4 channels
+  if(4 % nch){
+    af_simd_c.volume_s16(a, len, nch, vol);
+    return;
+  }
+  for(i=0;i<4;i++){
+    // beyond +42dB
+    if(vol[i % nch] > SHRT_MAX){
+      af_simd_c.volume_s16(a, len, nch, vol);
+      return;
+    }
+    v[i] = vol[i % nch];
+  }
+  vv = vld1_s16(v);
+  for(i=0;i+8<=len;i+=8){
+    int16x8_t x = vld1q_s16(a+i);
+    // the product needs 32 bits, vqshrn shifts and clamps like the C code
+    vst1q_s16(a+i, vcombine_s16(vqshrn_n_s32(vmull_s16(vget_low_s16(x),  vv), 8),
+                                vqshrn_n_s32(vmull_s16(vget_high_s16(x), vv), 8)));
+  }
+  // a multiple of 4 samples has been done, so the tail starts on channel 0
+  af_simd_c.volume_s16(a+i, len-i, nch, vol);
+}
+
+static void pan_float_neon(float* out, const float* in, int frames, int nchi,
+                           int ncho, const float (*level)[AF_NCH])
+{
+  // column k holds what input channel k adds to each output channel
+  float col[AF_NCH][AF_NCH];
+  float tmp[AF_NCH];
+  int f, j, k;
+
+  memset(col, 0, sizeof(col));
+  for(j=0;j<ncho;j++)
+    for(k=0;k<nchi;k++)
+      col[k][j] = level[j][k];
+
+  for(f=0;f<frames;f++){
+    float32x4_t lo = vdupq_n_f32(0.0f);
+    float32x4_t hi = vdupq_n_f32(0.0f);
+    for(k=0;k<nchi;k++){
+      lo = vmlaq_n_f32(lo, vld1q_f32(col[k]), in[k]);
+      if(ncho > 4)
+	hi = vmlaq_n_f32(hi, vld1q_f32(col[k]+4), in[k]);
+    }
+    switch(ncho){
+    case 2:
+      vst1_f32(out, vget_low_f32(lo));
+      break;
+    case 4:
+      vst1q_f32(out, lo);
+      break;
+    default:
+      vst1q_f32(tmp, lo);
+      vst1q_f32(tmp+4, hi);
+      memcpy(out, tmp, ncho*sizeof(float));
+      break;
+    }
+    out += ncho;
+    in += nchi;
+  }
+}
+
+/* Four channels at a time in the lanes; the bands of one channel depend
+   on each other and stay serial. */
+static void equalizer_float_neon(float* audio, int frames, int nch, int K,
+                                 const float* a, const float* b, const float* g,
+                                 float* w, float gain)
+{
+  int c, f, k;
+
+  for(c=0;c+4<=nch;c+=4){
+    float* p = audio + c;
+    for(f=0;f<frames;f++,p+=nch){
+      float32x4_t yt = vld1q_f32(p);
+      for(k=0;k<K;k++){
+	float*      wq = w + 2*k*AF_NCH + c;
+	float32x4_t w0 = vld1q_f32(wq);
+	float32x4_t w1 = vld1q_f32(wq + AF_NCH);
+	float32x4_t x  = vmulq_n_f32(yt, b[2*k]);
+	x  = vmlaq_n_f32(x, w0, a[2*k]);
+	x  = vmlaq_n_f32(x, w1, a[2*k+1]);
+	yt = vmlaq_f32(yt, vmlaq_n_f32(x, w1, b[2*k+1]), vld1q_f32(g + k*AF_NCH + c));
+	vst1q_f32(wq + AF_NCH, w0);
+	vst1q_f32(wq, x);
+      }
+      vst1q_f32(p, vmulq_n_f32(yt, gain));
+    }
+  }
+  for(;c+2<=nch;c+=2){
+    float* p = audio + c;
+    for(f=0;f<frames;f++,p+=nch){
+      float32x2_t yt = vld1_f32(p);
+      for(k=0;k<K;k++){
+	float*      wq = w + 2*k*AF_NCH + c;
+	float32x2_t w0 = vld1_f32(wq);
+	float32x2_t w1 = vld1_f32(wq + AF_NCH);
+	float32x2_t x  = vmul_n_f32(yt, b[2*k]);
+	x  = vmla_n_f32(x, w0, a[2*k]);
+	x  = vmla_n_f32(x, w1, a[2*k+1]);
+	yt = vmla_f32(yt, vmla_n_f32(x, w1, b[2*k+1]), vld1_f32(g + k*AF_NCH + c));
+	vst1_f32(wq + AF_NCH, w0);
+	vst1_f32(wq, x);
+      }
+      vst1_f32(p, vmul_n_f32(yt, gain));
+    }
+  }
+  // odd channel out
+  for(;c<nch;c++){
+    float* p = audio + c;
+    for(f=0;f<frames;f++,p+=nch){
+      float yt = *p;
+      for(k=0;k<K;k++){
+	float* wq = w + 2*k*AF_NCH + c;
+	float  x  = yt*b[2*k] + wq[0]*a[2*k] + wq[AF_NCH]*a[2*k+1];
+	yt += (x + wq[AF_NCH]*b[2*k+1]) * g[k*AF_NCH + c];
+	wq[AF_NCH] = wq[0];
+	wq[0] = x;
+      }
+      *p = yt*gain;
+    }
+  }
+}
+
+static int64_t dot_s16_neon(const int16_t* x, const int16_t* w, int n)
+{
+  int64x2_t sum = vdupq_n_s64(0);
+  int i;
+
+  // each product fits 32 bits, their sums are widened pairwise
+  for(i=0;i<n;i+=8){
+    int16x8_t xv = vld1q_s16(x+i);
+    int16x8_t wv = vld1q_s16(w+i);
+    sum = vpadalq_s32(sum, vmull_s16(vget_low_s16(xv),  vget_low_s16(wv)));
+    sum = vpadalq_s32(sum, vmull_s16(vget_high_s16(xv), vget_high_s16(wv)));
+  }
+  return vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+}
+
+static float dot_float_neon(const float* x, const float* w, int n)
+{
+  float32x4_t sum = vdupq_n_f32(0.0f);
+  float32x2_t s;
+  int i;
+
+  for(i=0;i<n;i+=4)
+    sum = vmlaq_f32(sum, vld1q_f32(x+i), vld1q_f32(w+i));
+  s = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+static int64_t dot_s16_s32_neon(const int16_t* x, const int32_t* w, int n)
+{
+  int64x2_t sum = vdupq_n_s64(0);
+  int i;
+
+  for(i=0;i<n;i+=8){
+    int16x8_t xv = vld1q_s16(x+i);
+    int32x4_t x0 = vmovl_s16(vget_low_s16(xv));
+    int32x4_t x1 = vmovl_s16(vget_high_s16(xv));
+    int32x4_t w0 = vld1q_s32(w+i);
+    int32x4_t w1 = vld1q_s32(w+i+4);
+    sum = vmlal_s32(sum, vget_low_s32(x0),  vget_low_s32(w0));
+    sum = vmlal_s32(sum, vget_high_s32(x0), vget_high_s32(w0));
+    sum = vmlal_s32(sum, vget_low_s32(x1),  vget_low_s32(w1));
+    sum = vmlal_s32(sum, vget_high_s32(x1), vget_high_s32(w1));
+  }
+  return vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+}
+#endif /* __ARM_NEON__ */
+
+void af_simd_init_neon(af_simd_t* simd)
+{
+#ifdef __ARM_NEON__
+  simd->float_to_s16    = float_to_s16_neon;
+  simd->s16_to_float    = s16_to_float_neon;
+  simd->s32_to_s16      = s32_to_s16_neon;
+  simd->volume_s16      = volume_s16_neon;
+  simd->pan_float       = pan_float_neon;
+  simd->equalizer_float = equalizer_float_neon;
+  simd->dot_s16         = dot_s16_neon;
+  simd->dot_float       = dot_float_neon;
+  simd->dot_s16_s32     = dot_s16_s32_neon;
+#endif
+}
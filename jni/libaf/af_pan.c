@@ -26,6 +26,7 @@
 #include <limits.h>
 
 #include "af.h"
+#include "af_simd.h"
 
 // Data for specific instances of this filter
 typedef struct af_pan_s
@@ -154,30 +155,15 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   af_data_t*    c    = data;		// Current working data
   af_data_t*	l    = af->data;	// Local data
   af_pan_t*  	s    = af->setup; 	// Setup for this instance
-  float*   	in   = c->audio;	// Input audio data
-  float*   	out  = NULL;		// Output audio data
-  float*	end  = in+c->len/4; 	// End of loop
   int		nchi = c->nch;		// Number of input channels
   int		ncho = l->nch;		// Number of output channels
-  register int  j,k;
 
   if(AF_OK != RESIZE_LOCAL_BUFFER(af,data))
     return NULL;
 
-  out = l->audio;
   // Execute panning
-  // FIXME: Too slow
-  while(in < end){
-    for(j=0;j<ncho;j++){
-      register float  x   = 0.0;
-      register float* tin = in;
-      for(k=0;k<nchi;k++)
-	x += tin[k] * s->level[j][k];
-      out[j] = x;
-    }
-    out+= ncho;
-    in+= nchi;
-  }
+  af_simd.pan_float(l->audio, c->audio, c->len/4/nchi, nchi, ncho,
+		    (const float (*)[AF_NCH])s->level);
 
   // Set output data
   c->audio = l->audio;
@@ -193,6 +179,7 @@ static int af_open(af_instance_t* af){
   af->uninit=uninit;
   af->play=play;
   af->mul=1;
+  af->flags=AF_BUF_SCRATCH;
   af->data=calloc(1,sizeof(af_data_t));
   af->setup=calloc(1,sizeof(af_pan_t));
   if(af->data == NULL || af->setup == NULL)
@@ -24,26 +24,31 @@
 #include <stdlib.h>
 #include <inttypes.h>
 
+#include "config.h"
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/common.h"
 #include "libavutil/mathematics.h"
 #include "af.h"
+#include "af_simd.h"
 #include "dsp.h"
 
-/* Below definition selects the length of each poly phase component.
-   Valid definitions are L8 and L16, where the number denotes the
-   length of the filter. This definition affects the computational
-   complexity (see play()), the performance (see filter.h) and the
-   memory usage. The filter length is chosen to 8 if the machine is
-   slow and to 16 if the machine is fast and has MMX.
+/* Default length of each poly phase component, the <length> parameter
+   can pick 8, 16 or 32. It affects the computational complexity (see
+   play()), the stop band attenuation and the memory usage. The filter
+   length is chosen to 8 if the machine is slow and to 16 if the machine
+   is fast and has MMX.
 */
-
 #if !HAVE_MMX // This machine is slow
-#define L8
+#define RSMP_TAPS	8
 #else
-#define L16
+#define RSMP_TAPS	16
 #endif
 
-#include "af_resample_template.c"
+// Filter banks no instance uses that are kept for the next one
+#define RSMP_CACHED	4
 
 // Filtering types
 #define RSMP_LIN   	(0<<0)	// Linear interpolation
@@ -59,9 +64,37 @@
 // Accuracy for linear interpolation
 #define STEPACCURACY 32
 
+/* Poly phase filter bank for one conversion ratio. The design only
+   depends on the ratio, the length and the sample type, so instances
+   share them and a new file at the same rates finds its bank ready. */
+typedef struct af_resample_bank_s
+{
+  struct af_resample_bank_s* next;
+  uint32_t	up;
+  uint32_t	dn;
+  int		taps;
+  int		type;	// RSMP_INT or RSMP_FLOAT
+  int		users;
+  void*		w;	// Filter weights [up][taps]
+} af_resample_bank_t;
+
+// Most recently used first
+static af_resample_bank_t* banks;
+#ifdef HAVE_PTHREADS
+// filter chains of the player, mencoder and libmplayer may run on other threads
+static pthread_mutex_t banks_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK()   pthread_mutex_lock(&banks_lock)
+#define UNLOCK() pthread_mutex_unlock(&banks_lock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
 // local data
 typedef struct af_resample_s
 {
+  af_resample_bank_t* bank;
+  int		taps;	// Length of each poly phase component
   void*  	w;	// Current filter weights
   void** 	xq; 	// Circular buffers
   uint32_t	xi; 	// Index for circular buffers
@@ -121,6 +154,89 @@ static int linint(af_data_t* c,af_data_t* l, af_resample_t* s)
   return len;
 }
 
+/* Find the bank for up:dn or design it. Kaiser window with beta = 10,
+   the caller holds banks_lock. \return NULL on error */
+static af_resample_bank_t* bank_get(uint32_t up, uint32_t dn, int taps, int type)
+{
+  af_resample_bank_t** p;
+  af_resample_bank_t* b;
+  float* w;
+  float* wt;
+  float fc;
+  int i,j;
+
+  for(p=&banks;*p;p=&(*p)->next){
+    b=*p;
+    if(b->up == up && b->dn == dn && b->taps == taps && b->type == type){
+      *p=b->next;
+      goto found;
+    }
+  }
+
+  // Calculate cutoff frequency for filter
+  fc = 1/(float)(max(up,dn));
+  // Allocate space for polyphase filter bank and prototype filter
+  b = calloc(1,sizeof(af_resample_bank_t));
+  w = malloc(sizeof(float) * up * taps);
+  if(b)
+    b->w = malloc(taps*up*(type == RSMP_INT ? 2 : 4));
+  if(NULL == b || NULL == w || NULL == b->w ||
+     -1 == af_filter_design_fir(up*taps, w, &fc, LP|KAISER , 10.0)){
+    mp_msg(MSGT_AFILTER, MSGL_ERR, "[resample] Unable to design prototype filter.\n");
+    if(b)
+      free(b->w);
+    free(b);
+    free(w);
+    return NULL;
+  }
+  // Copy data from prototype to polyphase filter
+  wt=w;
+  for(j=0;j<taps;j++){//Columns
+    for(i=0;i<up;i++){//Rows
+      if(type == RSMP_INT){
+	float t=(float)up*32767.0*(*wt);
+	((int16_t*)b->w)[i*taps+j] = (int16_t)((t>=0.0)?(t+0.5):(t-0.5));
+      }
+      else
+	((float*)b->w)[i*taps+j] = (float)up*(*wt);
+      wt++;
+    }
+  }
+  free(w);
+  b->up = up;
+  b->dn = dn;
+  b->taps = taps;
+  b->type = type;
+  mp_msg(MSGT_AFILTER, MSGL_V, "[resample] New filter designed up: %i "
+	 "down: %i length: %i\n", up, dn, taps);
+
+found:
+  b->next = banks;
+  banks = b;
+  b->users++;
+  return b;
+}
+
+// Drop a reference, banks beyond RSMP_CACHED unused ones are freed,
+// the caller holds banks_lock
+static void bank_put(af_resample_bank_t* bank)
+{
+  af_resample_bank_t** p = &banks;
+  int unused = 0;
+
+  bank->users--;
+  while(*p){
+    af_resample_bank_t* b = *p;
+    if(!b->users && ++unused > RSMP_CACHED){
+      *p = b->next;
+      free(b->w);
+      free(b);
+    }
+    else
+      p = &b->next;
+  }
+}
+
 /* Determine resampling type and format */
 static int set_types(struct af_instance_s* af, af_data_t* data)
 {
@@ -216,52 +332,29 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
 
     // Create space for circular buffers
     s->xq = malloc(n->nch*sizeof(void*));
-    s->xq[0] = calloc(n->nch, 2*L*af->data->bps);
+    s->xq[0] = calloc(n->nch, 2*s->taps*af->data->bps);
     for(i=1;i<n->nch;i++)
-      s->xq[i] = (uint8_t *)s->xq[i-1] + 2*L*af->data->bps;
+      s->xq[i] = (uint8_t *)s->xq[i-1] + 2*s->taps*af->data->bps;
     s->xi = 0;
 
-    // Check if the design needs to be redone
-    if(s->up != af->data->rate/d || s->dn != n->rate/d){
-      float* w;
-      float* wt;
-      float fc;
-      int j;
-      s->up = af->data->rate/d;
-      s->dn = n->rate/d;
+    // Check if another filter bank is needed
+    if(!s->bank || s->bank->up != af->data->rate/d ||
+       s->bank->dn != n->rate/d || s->bank->taps != s->taps ||
+       s->bank->type != (s->setup & RSMP_MASK)){
+      af_resample_bank_t* bank;
+      LOCK();
+      bank = bank_get(af->data->rate/d, n->rate/d, s->taps, s->setup & RSMP_MASK);
+      if(bank && s->bank)
+	bank_put(s->bank);
+      UNLOCK();
+      if(!bank)
+	return AF_ERROR;
+      s->bank = bank;
+      s->w = bank->w;
+      s->up = bank->up;
+      s->dn = bank->dn;
       s->wi = 0;
       s->i = 0;
-
-      // Calculate cutoff frequency for filter
-      fc = 1/(float)(max(s->up,s->dn));
-      // Allocate space for polyphase filter bank and prototype filter
-      w = malloc(sizeof(float) * s->up *L);
-      if(NULL != s->w)
-	free(s->w);
-      s->w = malloc(L*s->up*af->data->bps);
-
-      // Design prototype filter type using Kaiser window with beta = 10
-      if(NULL == w || NULL == s->w ||
-	 -1 == af_filter_design_fir(s->up*L, w, &fc, LP|KAISER , 10.0)){
-	mp_msg(MSGT_AFILTER, MSGL_ERR, "[resample] Unable to design prototype filter.\n");
-	return AF_ERROR;
-      }
-      // Copy data from prototype to polyphase filter
-      wt=w;
-      for(j=0;j<L;j++){//Columns
-	for(i=0;i<s->up;i++){//Rows
-	  if((s->setup & RSMP_MASK) == RSMP_INT){
-	    float t=(float)s->up*32767.0*(*wt);
-	    ((int16_t*)s->w)[i*L+j] = (int16_t)((t>=0.0)?(t+0.5):(t-0.5));
-	  }
-	  else
-	    ((float*)s->w)[i*L+j] = (float)s->up*(*wt);
-	  wt++;
-	}
-      }
-      free(w);
-      mp_msg(MSGT_AFILTER, MSGL_V, "[resample] New filter designed up: %i "
-	     "down: %i\n", s->up, s->dn);
     }
 
     // Set multiplier and delay
@@ -274,7 +367,14 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
     int rate=0;
     int type=RSMP_INT;
     int sloppy=1;
-    sscanf((char*)arg,"%i:%i:%i", &rate, &sloppy, &type);
+    int taps=s->taps;
+    sscanf((char*)arg,"%i:%i:%i:%i", &rate, &sloppy, &type, &taps);
+    if(taps != 8 && taps != 16 && taps != 32){
+      mp_msg(MSGT_AFILTER, MSGL_ERR, "[resample] The filter length must be "
+	     "8, 16 or 32. Current value is %i \n", taps);
+      return AF_ERROR;
+    }
+    s->taps = taps;
     s->setup = (sloppy?FREQ_SLOPPY:FREQ_EXACT) |
       (clamp(type,RSMP_LIN,RSMP_FLOAT));
     return af->control(af,AF_CONTROL_RESAMPLE_RATE | AF_CONTROL_SET, &rate);
@@ -309,7 +409,11 @@ static void uninit(struct af_instance_s* af)
   if (s) {
     if (s->xq) free(s->xq[0]);
     free(s->xq);
-    free(s->w);
+    if (s->bank) {
+      LOCK();
+      bank_put(s->bank);
+      UNLOCK();
+    }
     free(s);
   }
   if(af->data)
@@ -376,11 +480,13 @@ static int af_open(af_instance_t* af){
   af->uninit=uninit;
   af->play=play;
   af->mul=1;
+  af->flags=AF_BUF_SCRATCH;
   af->data=calloc(1,sizeof(af_data_t));
   af->setup=calloc(1,sizeof(af_resample_t));
   if(af->data == NULL || af->setup == NULL)
     return AF_ERROR;
   ((af_resample_t*)af->setup)->setup = RSMP_INT | FREQ_SLOPPY;
+  ((af_resample_t*)af->setup)->taps = RSMP_TAPS;
   return AF_OK;
 }
 
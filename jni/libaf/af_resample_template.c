@@ -19,22 +19,22 @@
  */
 
 /* This file contains the resampling engine, the sample format is
-   controlled by the FORMAT parameter, the filter length by the L
-   parameter and the resampling type by UP and DN. This file should
-   only be included by af_resample.c
+   controlled by the FORMAT parameter and the resampling type by UP and
+   DN. The filter length comes from the setup at runtime. This file
+   should only be included by af_resample.c
 */
 
 #undef L
-#undef SHIFT
 #undef FORMAT
 #undef FIR
 #undef ADDQUE
 
-/* The length Lxx definition selects the length of each poly phase
-   component. Valid definitions are L8 and L16 where the number
-   defines the nuber of taps. This definition affects the
-   computational complexity, the performance and the memory usage.
+/* The length L of each poly phase component is a power of two and a
+   multiple of 8, so the dot product kernels of af_simd can run it. It
+   affects the computational complexity, the performance and the
+   memory usage.
 */
+#define L taps
 
 /* The FORMAT_x parameter selects the sample format type currently
    float and int16 are supported. Thes two formats are selected by
@@ -44,36 +44,13 @@
 */
 
 #if defined(FORMAT_I)
-#define SHIFT >>16
 #define FORMAT int16_t
+#define FIR(x,w,y) y[0] = af_simd.dot_s16(x,w,L) >> 16
 #else
-#define SHIFT
 #define FORMAT float
+#define FIR(x,w,y) y[0] = af_simd.dot_float(x,w,L)
 #endif
 
-// Short filter
-#if defined(L8)
-
-#define L   	8	// Filter length
-// Unrolled loop to speed up execution
-#define FIR(x,w,y) \
-  (y[0])  = ( w[0]*x[0]+w[1]*x[1]+w[2]*x[2]+w[3]*x[3] \
-            + w[4]*x[4]+w[5]*x[5]+w[6]*x[6]+w[7]*x[7] ) SHIFT
-
-
-
-#else  /* L8/L16 */
-
-#define L   	16
-// Unrolled loop to speed up execution
-#define FIR(x,w,y) \
-  y[0] = ( w[0] *x[0] +w[1] *x[1] +w[2] *x[2] +w[3] *x[3] \
-         + w[4] *x[4] +w[5] *x[5] +w[6] *x[6] +w[7] *x[7] \
-         + w[8] *x[8] +w[9] *x[9] +w[10]*x[10]+w[11]*x[11] \
-         + w[12]*x[12]+w[13]*x[13]+w[14]*x[14]+w[15]*x[15] ) SHIFT
-
-#endif /* L8/L16 */
-
 // Macro to add data to circular que
 #define ADDQUE(xi,xq,in)\
   xq[xi]=xq[(xi)+L]=*(in);\
@@ -86,7 +63,8 @@
   uint32_t		inc   = s->up/s->dn;
   uint32_t		level = s->up%s->dn;
   uint32_t		up    = s->up;
-  uint32_t		dn    = s->dn;
+  uint32_t		step  = s->dn%s->up;	// wi increment
+  uint32_t		taps  = s->taps;
   uint32_t		ns    = c->len/l->bps;
   register FORMAT*	w     = s->w;
 
@@ -113,7 +91,8 @@
 	FIR((&x[xi]),(&w[wi*L]),out);
 	len++; out+=nch;
 	// Update wi to point at the correct polyphase component
-	wi=(wi+dn)%up;
+	wi+=step;
+	if(wi>=up) wi-=up;
       }
     }
 
@@ -129,7 +108,8 @@
   uint32_t		inc   = s->dn/s->up;
   uint32_t		level = s->dn%s->up;
   uint32_t		up    = s->up;
-  uint32_t		dn    = s->dn;
+  uint32_t		step  = s->dn%s->up;	// wi increment
+  uint32_t		taps  = s->taps;
   uint32_t		ns    = c->len/l->bps;
   FORMAT*		w     = s->w;
 
@@ -156,7 +136,8 @@
 	len++;	out+=nch;
 
 	// Update wi to point at the correct polyphase component
-	wi=(wi+dn)%up;
+	wi+=step;
+	if(wi>=up) wi-=up;
 
 	// Insert i number of new samples in queue
 	i = inc;
@@ -35,8 +35,13 @@
 #include <string.h>
 #include <limits.h>
 
+#include "config.h"
 #include "af.h"
+#include "af_simd.h"
 #include "libavutil/common.h"
+#ifdef CONFIG_LIBAVCODEC
+#include "libavcodec/avfft.h"
+#endif
 #include "subopt-helper.h"
 #include "help_mp.h"
 
@@ -68,7 +73,17 @@ typedef struct af_scaletempo_s
   int     num_channels;
   void*   buf_pre_corr;
   void*   table_window;
+  int     samples_corr;     // rounded up for the af_simd kernels
   int     (*best_overlap_offset)(struct af_scaletempo_s* s);
+  int     use_int;
+#ifdef CONFIG_LIBAVCODEC
+  // correlation through the frequency domain for long searches
+  int          fft_bits;
+  RDFTContext* rdft;
+  RDFTContext* irdft;
+  FFTSample*   fft_pre_corr;
+  FFTSample*   fft_search;
+#endif
   // command line
   float   scale_nominal;
   float   ms_stride;
@@ -115,7 +130,8 @@ static int fill_queue(struct af_instance_s* af, af_data_t* data, int offset)
   return offset - offset_unchanged;
 }
 
-#define UNROLL_PADDING (4*4)
+// the af_simd dot products take 8 samples at a time
+#define UNROLL_PADDING (8*4)
 
 static int best_overlap_offset_float(af_scaletempo_t* s)
 {
@@ -134,12 +150,7 @@ static int best_overlap_offset_float(af_scaletempo_t* s)
 
   search_start = (float*)s->buf_queue + s->num_channels;
   for (off=0; off<s->frames_search; off++) {
-    float corr = 0;
-    float* ps = search_start;
-    ppc = s->buf_pre_corr;
-    for (i=s->num_channels; i<s->samples_overlap; i++) {
-      corr += *ppc++ * *ps++;
-    }
+    float corr = af_simd.dot_float(s->buf_pre_corr, search_start, s->samples_corr);
     if (corr > best_corr) {
       best_corr = corr;
       best_off  = off;
@@ -156,8 +167,7 @@ static int best_overlap_offset_s16(af_scaletempo_t* s)
   int16_t *po, *search_start;
   int64_t best_corr = INT64_MIN;
   int best_off = 0;
-  int off;
-  long i;
+  int i, off;
 
   pw  = s->table_window;
   po  = s->buf_overlap;
@@ -169,19 +179,7 @@ static int best_overlap_offset_s16(af_scaletempo_t* s)
 
   search_start = (int16_t*)s->buf_queue + s->num_channels;
   for (off=0; off<s->frames_search; off++) {
-    int64_t corr = 0;
-    int16_t* ps = search_start;
-    ppc = s->buf_pre_corr;
-    ppc += s->samples_overlap - s->num_channels;
-    ps  += s->samples_overlap - s->num_channels;
-    i  = -(s->samples_overlap - s->num_channels);
-    do {
-      corr += ppc[i+0] * ps[i+0];
-      corr += ppc[i+1] * ps[i+1];
-      corr += ppc[i+2] * ps[i+2];
-      corr += ppc[i+3] * ps[i+3];
-      i += 4;
-    } while (i < 0);
+    int64_t corr = af_simd.dot_s16_s32(search_start, s->buf_pre_corr, s->samples_corr);
     if (corr > best_corr) {
       best_corr = corr;
       best_off  = off;
@@ -192,6 +190,111 @@ static int best_overlap_offset_s16(af_scaletempo_t* s)
   return best_off * 2 * s->num_channels;
 }
 
+#ifdef CONFIG_LIBAVCODEC
+/* The same correlation through the frequency domain: one real FFT of
+ * the windowed overlap, one of the search span and an inverse one of
+ * their product give every lag at once. The span is no longer than the
+ * transform, so no lag wraps around. Only every num_channels-th lag
+ * lines up with a frame and is a candidate.
+ */
+static int best_overlap_offset_fft(af_scaletempo_t* s)
+{
+  int n = 1 << s->fft_bits;
+  int nch = s->num_channels;
+  int samples_corr = s->samples_overlap - nch;
+  int samples_search = (s->frames_search - 1) * nch + samples_corr;
+  FFTSample* a = s->fft_pre_corr;
+  FFTSample* b = s->fft_search;
+  FFTSample best_corr;
+  int best_off = 0;
+  int i, off;
+
+  if (s->use_int) {
+    int32_t* pw = s->table_window;
+    int16_t* po = (int16_t*)s->buf_overlap + nch;
+    int16_t* ps = (int16_t*)s->buf_queue + nch;
+    for (i=0; i<samples_corr; i++)
+      a[i] = (FFTSample)pw[i] * po[i];
+    for (i=0; i<samples_search; i++)
+      b[i] = ps[i];
+  } else {
+    float* pw = s->table_window;
+    float* po = (float*)s->buf_overlap + nch;
+    float* ps = (float*)s->buf_queue + nch;
+    for (i=0; i<samples_corr; i++)
+      a[i] = pw[i] * po[i];
+    memcpy(b, ps, samples_search * sizeof(*b));
+  }
+  memset(a + samples_corr,   0, (n - samples_corr)   * sizeof(*a));
+  memset(b + samples_search, 0, (n - samples_search) * sizeof(*b));
+  av_rdft_calc(s->rdft, a);
+  av_rdft_calc(s->rdft, b);
+
+  // conj(A) * B, the real bins 0 and n/2 are packed into [0] and [1]
+  b[0] *= a[0];
+  b[1] *= a[1];
+  for (i=2; i<n; i+=2) {
+    FFTSample re = a[i] * b[i]   + a[i+1] * b[i+1];
+    FFTSample im = a[i] * b[i+1] - a[i+1] * b[i];
+    b[i]   = re;
+    b[i+1] = im;
+  }
+  av_rdft_calc(s->irdft, b);
+
+  best_corr = b[0];
+  for (off=1; off<s->frames_search; off++) {
+    if (b[off * nch] > best_corr) {
+      best_corr = b[off * nch];
+      best_off  = off;
+    }
+  }
+
+  return best_off * s->bytes_per_frame;
+}
+
+static void free_fft(af_scaletempo_t* s)
+{
+  if (s->rdft)
+    av_rdft_end(s->rdft);
+  if (s->irdft)
+    av_rdft_end(s->irdft);
+  av_freep(&s->fft_pre_corr);
+  av_freep(&s->fft_search);
+  s->rdft = s->irdft = NULL;
+  s->fft_bits = 0;
+}
+
+/* Switch to the FFT when three transforms cost less than the direct
+ * search, which takes frames_search dot products of samples_corr. A
+ * real transform of n samples is counted as n*log2(n) multiply-adds.
+ */
+static int init_fft(af_scaletempo_t* s, int nch)
+{
+  int samples_corr = s->samples_overlap - nch;
+  int samples_search = (s->frames_search - 1) * nch + samples_corr;
+  int bits = av_log2(samples_search - 1) + 1;
+
+  if (bits < 4 || bits > 16 ||
+      3LL * (1 << bits) * bits >= (int64_t)s->frames_search * samples_corr) {
+    free_fft(s);
+    return 0;
+  }
+  if (bits == s->fft_bits)
+    return 1;
+  free_fft(s);
+  s->rdft  = av_rdft_init(bits, DFT_R2C);
+  s->irdft = av_rdft_init(bits, IDFT_C2R);
+  s->fft_pre_corr = av_malloc((1 << bits) * sizeof(FFTSample));
+  s->fft_search   = av_malloc((1 << bits) * sizeof(FFTSample));
+  if (!s->rdft || !s->irdft || !s->fft_pre_corr || !s->fft_search) {
+    free_fft(s);
+    return 0;
+  }
+  s->fft_bits = bits;
+  return 1;
+}
+#endif
+
 static void output_overlap_float(af_scaletempo_t* s, void* buf_out,
 				  int bytes_off)
 {
@@ -366,10 +469,15 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
       }
     }
 
+    s->use_int = use_int;
     s->frames_search = (frames_overlap > 1) ? srate * s->ms_search : 0;
     if (s->frames_search <= 0) {
       s->best_overlap_offset = NULL;
+#ifdef CONFIG_LIBAVCODEC
+      free_fft(s);
+#endif
     } else {
+      s->samples_corr = (s->samples_overlap - nch + 7) & ~7;
       if (use_int) {
         int64_t t = frames_overlap;
         int32_t n = 8589934588LL / (t * t);  // 4 * (2^31 - 1) / t^2
@@ -380,7 +488,8 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
           mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
           return AF_ERROR;
         }
-        memset((char *)s->buf_pre_corr + s->bytes_overlap * 2, 0, UNROLL_PADDING);
+        memset((int32_t *)s->buf_pre_corr + s->samples_overlap - nch, 0,
+               (nch + 8) * 4);
         pw = s->table_window;
         for (i=1; i<frames_overlap; i++) {
           int32_t v = ( i * (t - i) * n ) >> 15;
@@ -391,12 +500,14 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
         s->best_overlap_offset = best_overlap_offset_s16;
       } else {
         float* pw;
-        s->buf_pre_corr = realloc(s->buf_pre_corr, s->bytes_overlap);
+        s->buf_pre_corr = realloc(s->buf_pre_corr, s->bytes_overlap + UNROLL_PADDING);
         s->table_window = realloc(s->table_window, s->bytes_overlap - nch * bps);
         if(!s->buf_pre_corr || !s->table_window) {
           mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
           return AF_ERROR;
         }
+        memset((float *)s->buf_pre_corr + s->samples_overlap - nch, 0,
+               (nch + 8) * 4);
         pw = s->table_window;
         for (i=1; i<frames_overlap; i++) {
           float v = i * (frames_overlap - i);
@@ -406,6 +517,13 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
         }
         s->best_overlap_offset = best_overlap_offset_float;
       }
+#ifdef CONFIG_LIBAVCODEC
+      if (init_fft(s, nch)) {
+        s->best_overlap_offset = best_overlap_offset_fft;
+        mp_msg(MSGT_AFILTER, MSGL_V, "[scaletempo] Overlap search with "
+               "%i point FFT\n", 1 << s->fft_bits);
+      }
+#endif
     }
 
     s->bytes_per_frame = bps * nch;
@@ -418,6 +536,7 @@ static int control(struct af_instance_s* af, int cmd, void* arg)
       mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
       return AF_ERROR;
     }
+    memset(s->buf_queue + s->bytes_queue, 0, UNROLL_PADDING);
 
     mp_msg (MSGT_AFILTER, MSGL_DBG2, "[scaletempo] "
             "%.2f stride_in, %i stride_out, %i standing, "
@@ -532,6 +651,9 @@ static void uninit(struct af_instance_s* af)
   free(s->buf_pre_corr);
   free(s->table_blend);
   free(s->table_window);
+#ifdef CONFIG_LIBAVCODEC
+  free_fft(s);
+#endif
   free(af->setup);
 }
 
@@ -0,0 +1,187 @@
+/*
+ * sample kernels shared by the libaf filters, picked for the CPU at runtime
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <limits.h>
+#include <math.h>
+
+#include "config.h"
+#include "af.h"
+#include "af_simd.h"
+
+static void float_to_s16_c(int16_t* out, const float* in, int len)
+{
+  register int i;
+  for(i=0;i<len;i++)
+    out[i] = lrintf(32767.0 * in[i]);
+}
+
+static void s16_to_float_c(float* out, const int16_t* in, int len)
+{
+  register int i;
+  for(i=0;i<len;i++)
+    out[i]=(1.0/32768.0)*in[i];
+}
+
+static void s32_to_s16_c(int16_t* out, const int32_t* in, int len)
+{
+  register int i;
+  for(i=0;i<len;i++)
+    out[i]=(uint16_t)(((uint32_t)in[i])>>16);
+}
+
+static void volume_s16_c(int16_t* a, int len, int nch, const int* vol)
+{
+  int ch, i;
+  for(ch = 0; ch < nch ; ch++){
+    register int v = vol[ch];
+    for(i=ch;i<len;i+=nch){
+      register int x = (a[i] * v) >> 8;
+      a[i]=clamp(x,SHRT_MIN,SHRT_MAX);
+    }
+  }
+}
+
+static void pan_float_c(float* out, const float* in, int frames, int nchi,
+                        int ncho, const float (*level)[AF_NCH])
+{
+  const float* end = in + frames*nchi;
+  register int j,k;
+  while(in < end){
+    for(j=0;j<ncho;j++){
+      register float x = 0.0;
+      for(k=0;k<nchi;k++)
+	x += in[k] * level[j][k];
+      out[j] = x;
+    }
+    out+= ncho;
+    in+= nchi;
+  }
+}
+
+static void equalizer_float_c(float* audio, int frames, int nch, int K,
+                              const float* a, const float* b, const float* g,
+                              float* w, float gain)
+{
+  int ci, k;
+  for(ci=0;ci<nch;ci++){
+    float* in  = audio + ci;
+    float* end = in + frames*nch;
+    while(in < end){
+      register float yt = *in; // Current input sample
+      for(k=0;k<K;k++){
+	float* wq = w + 2*k*AF_NCH + ci;
+	// Output from AR part of the filter
+	register float x = yt*b[2*k] + wq[0]*a[2*k] + wq[AF_NCH]*a[2*k+1];
+	// Output from MA part of the filter
+	yt += (x + wq[AF_NCH]*b[2*k+1]) * g[k*AF_NCH + ci];
+	wq[AF_NCH] = wq[0];
+	wq[0] = x;
+      }
+      *in = yt*gain;
+      in += nch;
+    }
+  }
+}
+
+static int64_t dot_s16_c(const int16_t* x, const int16_t* w, int n)
+{
+  register int64_t sum = 0;
+  register int i;
+  for(i=0;i<n;i++)
+    sum += w[i]*x[i];
+  return sum;
+}
+
+static float dot_float_c(const float* x, const float* w, int n)
+{
+  register float sum = 0;
+  register int i;
+  for(i=0;i<n;i++)
+    sum += w[i]*x[i];
+  return sum;
+}
+
+static int64_t dot_s16_s32_c(const int16_t* x, const int32_t* w, int n)
+{
+  register int64_t sum = 0;
+  register int i;
+  for(i=0;i<n;i++)
+    sum += (int64_t)w[i]*x[i];
+  return sum;
+}
+
+#if HAVE_ARMV6
+// SSAT does the shift and the clamp in one go
+static void volume_s16_armv6(int16_t* a, int len, int nch, const int* vol)
+{
+  int ch, i;
+  for(ch = 0; ch < nch ; ch++){
+    register int v = vol[ch];
+    for(i=ch;i<len;i+=nch){
+      int x = a[i] * v;
+      __asm__ ("ssat %0, #16, %1, asr #8" : "=r"(x) : "r"(x));
+      a[i] = x;
+    }
+  }
+}
+#endif
+
+const af_simd_t af_simd_c = {
+  float_to_s16_c,
+  s16_to_float_c,
+  s32_to_s16_c,
+  volume_s16_c,
+  pan_float_c,
+  equalizer_float_c,
+  dot_s16_c,
+  dot_float_c,
+  dot_s16_s32_c,
+};
+
+af_simd_t af_simd = {
+  float_to_s16_c,
+  s16_to_float_c,
+  s32_to_s16_c,
+  volume_s16_c,
+  pan_float_c,
+  equalizer_float_c,
+  dot_s16_c,
+  dot_float_c,
+  dot_s16_s32_c,
+};
+
+void af_simd_init(void)
+{
+  static int done;
+  if(done)
+    return;
+  done = 1;
+#if HAVE_ARMV6
+  if(gCpuCaps.hasARMv6)
+    af_simd.volume_s16 = volume_s16_armv6;
+#endif
+#if ARCH_ARM
+  if(gCpuCaps.hasNEON)
+    af_simd_init_neon(&af_simd);
+#endif
+  mp_msg(MSGT_AFILTER, MSGL_V, "[libaf] Using %s sample kernels\n",
+	 af_simd.pan_float != pan_float_c ? "NEON" :
+	 af_simd.volume_s16 != volume_s16_c ? "ARMv6" : "C");
+}
@@ -0,0 +1,65 @@
+/*
+ * sample kernels shared by the libaf filters, picked for the CPU at runtime
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_AF_SIMD_H
+#define MPLAYER_AF_SIMD_H
+
+#include <stdint.h>
+#include "af.h"
+
+/* Kernels that do not widen the samples may run with out == in. Lengths
+   are in samples unless they are called frames. */
+typedef struct af_simd_s {
+  // out[i] = lrintf(32767 * in[i])
+  void (*float_to_s16)(int16_t* out, const float* in, int len);
+  // out[i] = in[i] / 32768
+  void (*s16_to_float)(float* out, const int16_t* in, int len);
+  // out[i] = in[i] >> 16
+  void (*s32_to_s16)(int16_t* out, const int32_t* in, int len);
+  // a[i] = clamp((a[i] * vol[channel]) >> 8)
+  void (*volume_s16)(int16_t* a, int len, int nch, const int* vol);
+  // out[j] = sum of in[k] * level[j][k] for every frame
+  void (*pan_float)(float* out, const float* in, int frames, int nchi,
+                    int ncho, const float (*level)[AF_NCH]);
+  /* K cascaded band-pass stages on nch interleaved channels: a and b are
+     [K][2], g is [K][AF_NCH] and the filter state w is [K][2][AF_NCH] */
+  void (*equalizer_float)(float* audio, int frames, int nch, int K,
+                          const float* a, const float* b, const float* g,
+                          float* w, float gain);
+  // sum of x[i] * w[i], n is a multiple of 8; 32 full scale taps
+  // overflow 32 bits
+  int64_t (*dot_s16)(const int16_t* x, const int16_t* w, int n);
+  float (*dot_float)(const float* x, const float* w, int n);
+  // the same in 64 bits for weights wider than 16 bits
+  int64_t (*dot_s16_s32)(const int16_t* x, const int32_t* w, int n);
+} af_simd_t;
+
+/// in use by the filters, C until af_simd_init() finds something better
+extern af_simd_t af_simd;
+/// plain C versions, the reference for the others
+extern const af_simd_t af_simd_c;
+
+void af_simd_init(void);
+
+#if ARCH_ARM
+void af_simd_init_neon(af_simd_t* simd);
+#endif
+
+#endif /* MPLAYER_AF_SIMD_H */
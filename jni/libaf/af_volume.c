@@ -43,6 +43,7 @@
 #include <limits.h>
 
 #include "af.h"
+#include "af_simd.h"
 
 // Data for specific instances of this filter
 typedef struct af_volume_s
@@ -152,15 +153,11 @@ static af_data_t* play(struct af_instance_s* af, af_data_t* data)
   if(af->data->format == (AF_FORMAT_S16_NE)){
     int16_t*    a   = (int16_t*)c->audio;	// Audio data
     int         len = c->len/2;			// Number of samples
-    for(ch = 0; ch < nch ; ch++){
-      if(s->enable[ch]){
-	register int vol = (int)(255.0 * s->level[ch]);
-	for(i=ch;i<len;i+=nch){
-	  register int x = (a[i] * vol) >> 8;
-	  a[i]=clamp(x,SHRT_MIN,SHRT_MAX);
-	}
-      }
-    }
+    int         vol[AF_NCH];
+    // Disabled channels are scaled by 256/256
+    for(ch = 0; ch < nch ; ch++)
+      vol[ch] = s->enable[ch] ? (int)(255.0 * s->level[ch]) : 256;
+    af_simd.volume_s16(a, len, nch, vol);
   }
   // Machine is fast and data is floating point
   else if(af->data->format == (AF_FORMAT_FLOAT_NE)){
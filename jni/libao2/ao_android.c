@@ -41,6 +41,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
 #ifdef __MINGW32__
 // for GetFileType to detect pipes
 #include <windows.h>
@@ -288,14 +290,132 @@ static uint32_t bytesused;
 static uint32_t bytesinbuffer;
 static char * sndbuffer = 0;
 
+/* Queue depth tuning: of the config.buffer_count buffers of the device
+ * only depth are handed out by get_space(). An underrun adds one. A
+ * window without underruns in which the queue never got below two
+ * buffers when play() came back gives one back, the wakeup jitter and
+ * the decoding time both show up in that low-water mark.
+ */
+#define TUNE_WINDOW 5 // seconds of audio
+
+static int depth;          // buffers in use
+static int min_depth = 2;  // from the latency suboption or AOCONTROL_SET_LATENCY
+static int latency_ms;
+static int underruns;
+static int primed;         // data queued since the last reset
+static uint32_t low_water; // least bytes queued when play() came this window
+static uint32_t window;    // bytes played this window
+static int window_underruns;
+
+static int bytes_per_sec(void){
+	//only 16 bit seem supported by msm_pcm_out
+	return config.sample_rate*2*config.channel_count;
+}
+
+/* The driver has neither poll() nor a completion callback. For
+ * AOCONTROL_GET_POLL_FD a timerfd is armed by get_space() for the moment
+ * the queue will have drained by an outburst, so audio-only playback sleeps
+ * exactly that long. The NDK has no <sys/timerfd.h>, the kernel has the
+ * calls since 2.6.25.
+ */
+#if defined(__NR_timerfd_create) && defined(__NR_timerfd_settime)
+#define HAVE_TIMERFD 1
+#endif
+static int timer_fd = -1;
+
+static void arm_timer(int space){
+#ifdef HAVE_TIMERFD
+	struct itimerspec ts;
+	int64_t ns = 1; // 0 would disarm it
+	if(timer_fd < 0)
+		return;
+	if(space < ao_data.outburst)
+		ns = (int64_t)(ao_data.outburst - space) * 1000000000 / bytes_per_sec() + 1;
+	memset(&ts, 0, sizeof(ts));
+	ts.it_value.tv_sec  = ns / 1000000000;
+	ts.it_value.tv_nsec = ns % 1000000000;
+	// rearming also clears an expiry nobody read
+	syscall(__NR_timerfd_settime, timer_fd, 0, &ts, NULL);
+#endif
+}
+
+static void set_depth(int n){
+	n = FFMIN(FFMAX(n, min_depth), config.buffer_count);
+	if(n == depth)
+		return;
+	depth = n;
+	ao_data.buffersize = depth * config.buffer_size;
+	mp_msg(MSGT_AO, MSGL_V, "[android] Queue of %d/%d buffers, %d ms\n",
+	       depth, config.buffer_count,
+	       (int)(1000LL * ao_data.buffersize / bytes_per_sec()));
+}
+
+// the latency suboption is the floor for what callers ask for
+static void set_latency(float latency){
+	int n = 0;
+	latency = FFMAX(latency, latency_ms / 1000.0);
+	if(latency > 0)
+		n = (latency * bytes_per_sec() + config.buffer_size - 1) / config.buffer_size;
+	min_depth = FFMAX(n, 2);
+	if(depth)
+		set_depth(FFMAX(depth, min_depth));
+}
+
+// called by play() with the queue state before the new data
+static void tune(int len){
+	if(primed && bytesinbuffer == 0){
+		underruns++;
+		window_underruns++;
+		mp_msg(MSGT_AO, MSGL_V, "[android] Underrun %d\n", underruns);
+		set_depth(depth + 1);
+	}
+	if(primed && bytesinbuffer < low_water)
+		low_water = bytesinbuffer;
+	window += len;
+	if(window < TUNE_WINDOW * bytes_per_sec())
+		return;
+	if(!window_underruns && low_water >= 2 * config.buffer_size)
+		set_depth(depth - 1);
+	low_water = UINT32_MAX;
+	window = 0;
+	window_underruns = 0;
+}
+
 // to set/get/query special features/parameters
 static int control(int cmd,void *arg){
-    return -1;
+	switch(cmd){
+	case AOCONTROL_GET_LATENCY:
+		if(afd <= 0)
+			return CONTROL_ERROR;
+		*(float*)arg = (float)ao_data.buffersize / bytes_per_sec();
+		return CONTROL_OK;
+	case AOCONTROL_SET_LATENCY:
+		if(afd <= 0)
+			return CONTROL_ERROR;
+		set_latency(*(float*)arg);
+		return CONTROL_OK;
+	case AOCONTROL_GET_UNDERRUNS:
+		*(int*)arg = underruns;
+		return CONTROL_OK;
+	case AOCONTROL_GET_POLL_FD:
+		if(timer_fd < 0)
+			return CONTROL_ERROR;
+		*(int*)arg = timer_fd;
+		return CONTROL_OK;
+	}
+	return CONTROL_UNKNOWN;
 }
 
 
 static int init(int rate,int channels,int format,int flags){
+	const opt_t subopts[] = {
+		{"latency", OPT_ARG_INT, &latency_ms, (opt_test_f)int_non_neg},
+		{NULL}
+	};
 
+	latency_ms = 0;
+	if (subopt_parse(ao_subdevice, subopts) != 0)
+		return 0;
 	if(format != AFMT_S16_LE && 0)
 	{
 		printf("mauvais format :\\ ");
@@ -331,6 +451,24 @@ static int init(int rate,int channels,int format,int flags){
 	ioctl (afd, AUDIO_GET_STATS, &stats);
 	bytestobeused = bytesused = stats.byte_count;
 	bytesinbuffer = 0;
+
+	ao_data.samplerate = rate;
+	ao_data.channels = channels;
+	ao_data.format = AF_FORMAT_S16_LE;
+	ao_data.bps = bytes_per_sec();
+	ao_data.outburst = config.buffer_size;
+	// start with all of the device and tune down
+	underruns = primed = 0;
+	low_water = UINT32_MAX;
+	window = window_underruns = 0;
+	depth = 0;
+	set_latency(0);
+	set_depth(config.buffer_count);
+#ifdef HAVE_TIMERFD
+	timer_fd = syscall(__NR_timerfd_create, CLOCK_MONOTONIC, 0);
+	if(timer_fd >= 0)
+		fcntl(timer_fd, F_SETFL, O_NONBLOCK);
+#endif
 	//printf("initialisation ok %5d - %5d, type: %x\n",config.buffer_size,config.buffer_count,config.codec_type);
 	return 1;
 }
@@ -339,10 +477,15 @@ static int init(int rate,int channels,int format,int flags){
 static void uninit(int immed){
     if(afd)
     {
+    	mp_msg(MSGT_AO, MSGL_V, "[android] %d underruns, queue was %d/%d buffers\n",
+    	       underruns, depth, config.buffer_count);
     	ioctl (afd, AUDIO_STOP, 0);
     	close(afd);
     }
     afd = 0;
+    if(timer_fd >= 0)
+    	close(timer_fd);
+    timer_fd = -1;
 
     if(sndbuffer)
     {
@@ -362,6 +505,8 @@ static void reset(void){
 	ioctl (afd, AUDIO_START, 0);
 	ioctl (afd, AUDIO_GET_STATS, &stats);
 	bytestobeused = bytesused = stats.byte_count;
+	// running dry after this is not an underrun
+	primed = 0;
 }
 
 // stop playing, keep buffers (for pause)
@@ -388,17 +533,17 @@ static int internal_get_space(void){
 		bytesinbuffer = ( (0xffffffff - ( bytesused-1))+bytestobeused);
 	else
 		bytesinbuffer = (bytestobeused - bytesused);
-	if(bytesinbuffer <= (config.buffer_size * config.buffer_count))
-		return (config.buffer_size * config.buffer_count) - bytesinbuffer;
+	if(bytesinbuffer <= ao_data.buffersize)
+		return ao_data.buffersize - bytesinbuffer;
 	else
 		return 0;
 }
 // return: how many bytes can be played without blocking
 static int get_space(void){
-	//a minimum of a buffer is return else mplayer crash
-	int nbuff;
-	nbuff = internal_get_space();
-	return (nbuff?nbuff:config.buffer_size*config.buffer_count);
+	// ao_data.outburst is set, a full queue no longer needs faking space
+	int space = internal_get_space();
+	arm_timer(space);
+	return space;
 }
 
 // plays 'len' bytes of 'data'
@@ -410,6 +555,8 @@ static int play(void* data,int len,int flags){
     unsigned char *cdata;
 	//printf("PCM: Writing chunk! %5d\n",len);
 	internal_get_space();
+	tune(len);
+	primed = 1;
 	cdata = data;
 	bytestobeused += len;
 	for( int n=(len/config.buffer_size)+1;n>0;n--)
@@ -434,5 +581,5 @@ static float get_delay(void){
 	internal_get_space();
 	//printf("demande de delay %f\n",((float) (bytesinbuffer) ) / ( (float) (config.sample_rate*2*config.channel_count)));
 	//only 16 bit seem supported by msm_pcm_out
-    return ((float) (bytesinbuffer) ) / ( (float) (config.sample_rate*2*config.channel_count));
+    return ((float) (bytesinbuffer) ) / ( (float) bytes_per_sec());
 }
@@ -80,6 +80,15 @@ extern const ao_functions_t* const audio_out_drivers[];
 #define AOCONTROL_SET_VOLUME 5
 #define AOCONTROL_SET_PLUGIN_DRIVER 6
 #define AOCONTROL_SET_PLUGIN_LIST 7
+/* nonblocking fd that polls readable once at least outburst bytes can be
+   played; it is read until empty after each wait */
+#define AOCONTROL_GET_POLL_FD 8
+/* float, seconds between play() and the speaker with the queue full */
+#define AOCONTROL_GET_LATENCY 9
+/* float, shortest queue in seconds the ao may tune down to, 0 for auto */
+#define AOCONTROL_SET_LATENCY 10
+/* int, how often the device ran out of data since init */
+#define AOCONTROL_GET_UNDERRUNS 11
 
 #define AOPLAY_FINAL_CHUNK 1
 
@@ -963,7 +963,8 @@ static int mkv_write_packet_internal(AVFormatContext *s, AVPacket *pkt)
         end_ebml_master(pb, blockgroup);
     }
 
-    if (codec->codec_type == AVMEDIA_TYPE_VIDEO && keyframe) {
+    // cues are only written to seekable output, do not let them pile up
+    if (codec->codec_type == AVMEDIA_TYPE_VIDEO && keyframe && !url_is_streamed(s->pb)) {
         ret = mkv_add_cuepoint(mkv->cues, pkt->stream_index, ts, mkv->cluster_pos);
         if (ret < 0) return ret;
     }
@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
 
@@ -36,6 +37,7 @@
 #include "libaf/af_format.h"
 
 #include "libaf/af.h"
+#include "libavutil/common.h"
 
 #ifdef CONFIG_DYNAMIC_PLUGINS
 #include <dlfcn.h>
@@ -103,6 +105,7 @@ static int init_audio_codec(sh_audio_t *sh_audio)
 	return 0;
     }
     sh_audio->a_buffer_len = 0;
+    sh_audio->a_buffer_pos = 0;
 
     if (!sh_audio->ad_driver->init(sh_audio)) {
 	mp_msg(MSGT_DECAUDIO, MSGL_WARN, MSGTR_ADecoderInitFailed);
@@ -136,6 +139,7 @@ static int init_audio_codec(sh_audio_t *sh_audio)
     sh_audio->a_out_buffer_size = 0;
     sh_audio->a_out_buffer = NULL;
     sh_audio->a_out_buffer_len = 0;
+    sh_audio->a_out_buffer_pos = 0;
 
     return 1;
 }
@@ -317,6 +321,8 @@ void uninit_audio(sh_audio_t *sh_audio)
     free(sh_audio->a_out_buffer);
     sh_audio->a_out_buffer = NULL;
     sh_audio->a_out_buffer_size = 0;
+    sh_audio->a_out_buffer_len = 0;
+    sh_audio->a_out_buffer_pos = 0;
     av_freep(&sh_audio->a_buffer);
     av_freep(&sh_audio->a_in_buffer);
 }
@@ -362,18 +368,91 @@ int init_audio_filters(sh_audio_t *sh_audio, int in_samplerate,
     *out_format = afs->output.format;
 
     sh_audio->a_out_buffer_len = 0;
+    sh_audio->a_out_buffer_pos = 0;
 
     // ok!
     sh_audio->afilter = (void *) afs;
     return 1;
 }
 
+/* The ring holds a_out_buffer_size bytes and has MAX_OUTBURST bytes behind
+ * them where data wrapping to the start is copied for a contiguous read. */
+static int audio_out_grow(sh_audio_t *sh, int len)
+{
+    int size = 2 * (sh->a_out_buffer_len + len);
+    char *buf = malloc(size + MAX_OUTBURST);
+
+    if (!buf)
+	return 0;
+    mp_msg(MSGT_DECAUDIO, MSGL_V, "Increasing filtered audio buffer size "
+	   "from %d to %d\n", sh->a_out_buffer_size, size);
+    if (sh->a_out_buffer_len)
+	sh->a_out_buffer_len = mp_audio_out_read(sh, buf, sh->a_out_buffer_len);
+    free(sh->a_out_buffer);
+    sh->a_out_buffer = buf;
+    sh->a_out_buffer_size = size;
+    sh->a_out_buffer_pos = 0;
+    return 1;
+}
+
+int mp_audio_out_write(sh_audio_t *sh, const void *data, int len)
+{
+    int wpos, n;
+
+    if (sh->a_out_buffer_size - sh->a_out_buffer_len < len &&
+	!audio_out_grow(sh, len))
+	return 0;
+    wpos = sh->a_out_buffer_pos + sh->a_out_buffer_len;
+    if (wpos >= sh->a_out_buffer_size)
+	wpos -= sh->a_out_buffer_size;
+    n = FFMIN(len, sh->a_out_buffer_size - wpos);
+    memcpy(sh->a_out_buffer + wpos, data, n);
+    memcpy(sh->a_out_buffer, (const char *)data + n, len - n);
+    sh->a_out_buffer_len += len;
+    return len;
+}
+
+char *mp_audio_out_peek(sh_audio_t *sh, int len)
+{
+    char *p = sh->a_out_buffer + sh->a_out_buffer_pos;
+    int wrap = sh->a_out_buffer_pos + len - sh->a_out_buffer_size;
+
+    assert(len <= sh->a_out_buffer_len && len <= MAX_OUTBURST);
+    if (wrap > 0)
+	memcpy(sh->a_out_buffer + sh->a_out_buffer_size, sh->a_out_buffer,
+	       wrap);
+    return p;
+}
+
+void mp_audio_out_consume(sh_audio_t *sh, int len)
+{
+    sh->a_out_buffer_len -= len;
+    sh->a_out_buffer_pos += len;
+    if (sh->a_out_buffer_pos >= sh->a_out_buffer_size)
+	sh->a_out_buffer_pos -= sh->a_out_buffer_size;
+    if (!sh->a_out_buffer_len)
+	sh->a_out_buffer_pos = 0;
+}
+
+int mp_audio_out_read(sh_audio_t *sh, void *data, int len)
+{
+    int n;
+
+    len = FFMIN(len, sh->a_out_buffer_len);
+    if (len <= 0)
+	return 0;
+    n = FFMIN(len, sh->a_out_buffer_size - sh->a_out_buffer_pos);
+    memcpy(data, sh->a_out_buffer + sh->a_out_buffer_pos, n);
+    memcpy((char *)data + n, sh->a_out_buffer, len - n);
+    mp_audio_out_consume(sh, len);
+    return len;
+}
+
 static int filter_n_bytes(sh_audio_t *sh, int len)
 {
     int error = 0;
     // Filter
     af_data_t filter_input = {
-	.audio = sh->a_buffer,
 	.rate = sh->samplerate,
 	.nch = sh->channels,
 	.format = sh->sample_format
@@ -382,11 +461,20 @@ static int filter_n_bytes(sh_audio_t *sh, int len)
 
     assert(len-1 + sh->audio_out_minsize <= sh->a_buffer_size);
 
+    // Consumed decoder output is skipped, the rest is only moved down when
+    // the decoder might not have enough room behind it.
+    if (sh->a_buffer_pos + len-1 + sh->audio_out_minsize > sh->a_buffer_size) {
+	memmove(sh->a_buffer, sh->a_buffer + sh->a_buffer_pos,
+		sh->a_buffer_len);
+	sh->a_buffer_pos = 0;
+    }
+    filter_input.audio = sh->a_buffer + sh->a_buffer_pos;
+
     // Decode more bytes if needed
     while (sh->a_buffer_len < len) {
-	unsigned char *buf = sh->a_buffer + sh->a_buffer_len;
+	unsigned char *buf = sh->a_buffer + sh->a_buffer_pos + sh->a_buffer_len;
 	int minlen = len - sh->a_buffer_len;
-	int maxlen = sh->a_buffer_size - sh->a_buffer_len;
+	int maxlen = sh->a_buffer_size - sh->a_buffer_pos - sh->a_buffer_len;
 	int ret = sh->ad_driver->decode_audio(sh, buf, minlen, maxlen);
 	int format_change = sh->samplerate != filter_input.rate ||
 	                    sh->channels != filter_input.nch ||
@@ -404,20 +492,13 @@ static int filter_n_bytes(sh_audio_t *sh, int len)
     filter_output = af_play(sh->afilter, &filter_input);
     if (!filter_output)
 	return -1;
-    if (sh->a_out_buffer_size < sh->a_out_buffer_len + filter_output->len) {
-	int newlen = sh->a_out_buffer_len + filter_output->len;
-	mp_msg(MSGT_DECAUDIO, MSGL_V, "Increasing filtered audio buffer size "
-	       "from %d to %d\n", sh->a_out_buffer_size, newlen);
-	sh->a_out_buffer = realloc(sh->a_out_buffer, newlen);
-	sh->a_out_buffer_size = newlen;
-    }
-    memcpy(sh->a_out_buffer + sh->a_out_buffer_len, filter_output->audio,
-	   filter_output->len);
-    sh->a_out_buffer_len += filter_output->len;
+    if (mp_audio_out_write(sh, filter_output->audio, filter_output->len)
+	< filter_output->len)
+	return -1;
 
     // remove processed data from decoder buffer:
     sh->a_buffer_len -= len;
-    memmove(sh->a_buffer, sh->a_buffer + len, sh->a_buffer_len);
+    sh->a_buffer_pos = sh->a_buffer_len ? sh->a_buffer_pos + len : 0;
 
     return error;
 }
@@ -427,7 +508,8 @@ static int filter_n_bytes(sh_audio_t *sh, int len)
  * Return 0 on success, -1 on error/EOF (not distinguished).
  * In the former case sh_audio->a_out_buffer_len is always >= minlen
  * on return. In case of EOF/error it might or might not be.
- * Can reallocate sh_audio->a_out_buffer if needed to fit all filter output. */
+ * Can reallocate sh_audio->a_out_buffer if needed to fit all filter output,
+ * in the steady state it neither allocates nor moves data. */
 int mp_decode_audio(sh_audio_t *sh_audio, int minlen)
 {
     // Indicates that a filter seems to be buffering large amounts of data
@@ -479,7 +561,9 @@ int mp_decode_audio(sh_audio_t *sh_audio, int minlen)
 void resync_audio_stream(sh_audio_t *sh_audio)
 {
     sh_audio->a_buffer_len = 0;
+    sh_audio->a_buffer_pos = 0;
     sh_audio->a_out_buffer_len = 0;
+    sh_audio->a_out_buffer_pos = 0;
     sh_audio->a_in_buffer_len = 0;	// clear audio input buffer
     if (!sh_audio->initialized)
 	return;
@@ -31,6 +31,13 @@ extern int fakemono;
 void afm_help(void);
 int init_best_audio_codec(sh_audio_t *sh_audio, char** audio_codec_list, char** audio_fm_list);
 int mp_decode_audio(sh_audio_t *sh_audio, int minlen);
+/// append to the filtered audio, \return len or 0 if out of memory
+int mp_audio_out_write(sh_audio_t *sh_audio, const void *data, int len);
+/// \return len (at most MAX_OUTBURST) contiguous bytes of filtered audio
+char *mp_audio_out_peek(sh_audio_t *sh_audio, int len);
+void mp_audio_out_consume(sh_audio_t *sh_audio, int len);
+/// copy out and consume up to len bytes, \return the number of bytes
+int mp_audio_out_read(sh_audio_t *sh_audio, void *data, int len);
 void resync_audio_stream(sh_audio_t *sh_audio);
 void skip_audio_frame(sh_audio_t *sh_audio);
 void uninit_audio(sh_audio_t *sh_audio);
@@ -23,12 +23,16 @@
 #include <limits.h>
 #include <time.h>
 #include <assert.h>
+#include <unistd.h>
 
 #if !defined(INFINITY) && defined(HUGE_VAL)
 #define INFINITY HUGE_VAL
 #endif
 
 #include "config.h"
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "mp_msg.h"
 #include "help_mp.h"
@@ -49,6 +53,7 @@
 #include "vd_ffmpeg.h"
 
 extern char* passtmpfile;
+extern int encode_duplicates;
 
 //===========================================================================//
 
@@ -161,6 +166,7 @@ static int lavc_param_nssew= 8;
 static int lavc_param_closed_gop = 0;
 static int lavc_param_dc_precision = 8;
 static int lavc_param_threads= 1;
+static int lavc_param_pipeline= 0;
 static int lavc_param_turbo = 0;
 static int lavc_param_skip_threshold=0;
 static int lavc_param_skip_factor=0;
@@ -314,7 +320,10 @@ const m_option_t lavcopts_conf[]={
 	{"top", &lavc_param_top, CONF_TYPE_INT, CONF_RANGE, -1, 1, NULL},
         {"qns", &lavc_param_qns, CONF_TYPE_INT, CONF_RANGE, 0, 1000000, NULL},
         {"nssew", &lavc_param_nssew, CONF_TYPE_INT, CONF_RANGE, 0, 1000000, NULL},
-	{"threads", &lavc_param_threads, CONF_TYPE_INT, CONF_RANGE, 1, 8, NULL},
+	{"threads", &lavc_param_threads, CONF_TYPE_INT, CONF_RANGE, 0, 16, NULL},
+#ifdef HAVE_PTHREADS
+	{"pipeline", &lavc_param_pipeline, CONF_TYPE_INT, CONF_RANGE, 0, 16, NULL},
+#endif
 	{"turbo", &lavc_param_turbo, CONF_TYPE_FLAG, 0, 0, 1, NULL},
         {"skip_threshold", &lavc_param_skip_threshold, CONF_TYPE_INT, CONF_RANGE, 0, 1000000, NULL},
         {"skip_factor", &lavc_param_skip_factor, CONF_TYPE_INT, CONF_RANGE, 0, 1000000, NULL},
@@ -333,12 +342,38 @@ const m_option_t lavcopts_conf[]={
 	{NULL, NULL, 0, 0, 0, 0, NULL}
 };
 
+/* A frame on its way through the encoder. Without the pipeline there is
+   one on the stack and buf is the muxer's buffer, with it they wait in a
+   ring for the encoding thread and then for put_image() to mux them. */
+typedef struct {
+    mp_image_t *mpi;            ///< copy of the input, pipeline only
+    int dup;                    ///< empty chunk for a duplicated frame
+    double pts;
+    uint8_t *buf;
+    int out_size;
+    int key_frame;
+    double coded_pts;
+    char *stats;                ///< stats_out of this frame
+} enc_frame_t;
+
 struct vf_priv_s {
     muxer_stream_t* mux;
     AVCodecContext *context;
     AVFrame *pic;
     AVCodec *codec;
     FILE *stats_file;
+#ifdef HAVE_PTHREADS
+    int depth;                  ///< size of the ring, 0 without a pipeline
+    enc_frame_t *ring;
+    /* frames handed to the thread, encoded and muxed so far, the ring
+       slot of frame n is n % depth */
+    unsigned queued, encoded, written;
+    int quit;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        ///< a frame was queued
+    pthread_cond_t done;        ///< a frame was encoded
+#endif
 };
 
 #define stats_file (vf->priv->stats_file)
@@ -346,6 +381,31 @@ struct vf_priv_s {
 #define lavc_venc_context (vf->priv->context)
 
 static int encode_frame(struct vf_instance *vf, AVFrame *pic, double pts);
+static void pipeline_start(struct vf_instance *vf, int width, int height,
+                           unsigned int fmt);
+#ifdef HAVE_PTHREADS
+static void pipeline_drain(struct vf_instance *vf, unsigned keep);
+static enc_frame_t *pipeline_slot(struct vf_instance *vf);
+static void pipeline_queue(struct vf_instance *vf);
+static void pipeline_stop(struct vf_instance *vf);
+#endif
+
+/// encoders that split a frame into slices for their threads
+static int slice_threads(AVCodecContext *ctx)
+{
+    switch (ctx->codec_id) {
+    case CODEC_ID_MPEG1VIDEO:
+    case CODEC_ID_MPEG2VIDEO:
+    case CODEC_ID_MPEG4:
+    case CODEC_ID_DNXHD:
+    case CODEC_ID_H264:
+        return 1;
+    case CODEC_ID_H263P:
+        return !!(ctx->flags & CODEC_FLAG_H263P_SLICE_STRUCT);
+    default:
+        return 0;
+    }
+}
 
 static int config(struct vf_instance *vf,
         int width, int height, int d_width, int d_height,
@@ -688,7 +748,18 @@ static int config(struct vf_instance *vf,
 	vf->priv->pic->quality = (int)(FF_QP2LAMBDA * lavc_param_vqscale + 0.5);
     }
 
-    if(lavc_param_threads > 1)
+    if(lavc_param_threads == 0){
+        // one per CPU, for the encoders that can use them
+        int threads = 1;
+        if(slice_threads(lavc_venc_context)){
+            threads = sysconf(_SC_NPROCESSORS_ONLN);
+            // a slice is at least one macroblock row
+            threads = av_clip(threads, 1, FFMIN(16, (height + 15) >> 4));
+        }
+        mp_msg(MSGT_MENCODER, MSGL_V, "[VE_LAVC] Using %d threads\n", threads);
+        if(threads > 1)
+            avcodec_thread_init(lavc_venc_context, threads);
+    } else if(lavc_param_threads > 1)
 	avcodec_thread_init(lavc_venc_context, lavc_param_threads);
 
     if (avcodec_open(lavc_venc_context, vf->priv->codec) != 0) {
@@ -713,6 +784,7 @@ static int config(struct vf_instance *vf,
 
     mux_v->decoder_delay = lavc_venc_context->max_b_frames ? 1 : 0;
 
+    pipeline_start(vf, width, height, outfmt);
     return 1;
 }
 
@@ -720,9 +792,22 @@ static int control(struct vf_instance *vf, int request, void* data){
 
     switch(request){
         case VFCTRL_FLUSH_FRAMES:
+#ifdef HAVE_PTHREADS
+            if(vf->priv->depth)
+                pipeline_drain(vf, 0);
+#endif
             if(vf->priv->codec->capabilities & CODEC_CAP_DELAY)
                 while(encode_frame(vf, NULL, MP_NOPTS_VALUE) > 0);
             return CONTROL_TRUE;
+#ifdef HAVE_PTHREADS
+        case VFCTRL_DUPLICATE_FRAME:
+            // the empty chunk has to wait behind the frames in the pipeline
+            if(!vf->priv->depth)
+                return CONTROL_UNKNOWN;
+            pipeline_slot(vf)->dup= 1;
+            pipeline_queue(vf);
+            return CONTROL_TRUE;
+#endif
         default:
             return CONTROL_UNKNOWN;
     }
@@ -765,9 +850,7 @@ static double psnr(double d){
     return -10.0*log(d)/log(10);
 }
 
-static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
-    AVFrame *pic= vf->priv->pic;
-
+static void fill_pic(AVFrame *pic, mp_image_t *mpi){
     pic->data[0]=mpi->planes[0];
     pic->data[1]=mpi->planes[1];
     pic->data[2]=mpi->planes[2];
@@ -784,57 +867,69 @@ static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
         if(lavc_param_top!=-1)
             pic->top_field_first= lavc_param_top;
     }
+}
+
+static int put_image(struct vf_instance *vf, mp_image_t *mpi, double pts){
+    AVFrame *pic= vf->priv->pic;
 
+#ifdef HAVE_PTHREADS
+    if(vf->priv->depth){
+        // the decoder and the filters may reuse mpi as soon as we return
+        enc_frame_t *frame= pipeline_slot(vf);
+        copy_mpi(frame->mpi, mpi);
+        frame->mpi->fields= mpi->fields;
+        frame->pts= pts;
+        frame->dup= 0;
+        pipeline_queue(vf);
+        return 1;
+    }
+#endif
+    fill_pic(pic, mpi);
     return encode_frame(vf, pic, pts) >= 0;
 }
 
-static int encode_frame(struct vf_instance *vf, AVFrame *pic, double pts){
-    const char pict_type_char[5]= {'?', 'I', 'P', 'B', 'S'};
-    int out_size;
-    double dts;
-
-    if(pts == MP_NOPTS_VALUE)
-        pts= lavc_venc_context->frame_number * av_q2d(lavc_venc_context->time_base);
-
-    if(pic){
-#if 0
-        pic->opaque= malloc(sizeof(pts));
-        memcpy(pic->opaque, &pts, sizeof(pts));
-#else
-        if(pts != MP_NOPTS_VALUE)
-            pic->pts= floor(pts / av_q2d(lavc_venc_context->time_base) + 0.5);
-        else
-            pic->pts= MP_NOPTS_VALUE;
-#endif
-    }
-	out_size = avcodec_encode_video(lavc_venc_context, mux_v->buffer, mux_v->buffer_size,
-	    pic);
+/// encode pic into frame->buf, NULL flushes a delayed frame
+static void encode_pic(struct vf_instance *vf, AVFrame *pic, enc_frame_t *frame){
+    AVFrame *coded;
 
-    if(pts != MP_NOPTS_VALUE)
-        dts= pts - lavc_venc_context->delay * av_q2d(lavc_venc_context->time_base);
-    else
-        dts= MP_NOPTS_VALUE;
-#if 0
-    pts= lavc_venc_context->coded_frame->opaque ?
-           *(double*)lavc_venc_context->coded_frame->opaque
-         : MP_NOPTS_VALUE;
-#else
-    if(lavc_venc_context->coded_frame->pts != MP_NOPTS_VALUE)
-        pts= lavc_venc_context->coded_frame->pts * av_q2d(lavc_venc_context->time_base);
+    if(frame->pts == MP_NOPTS_VALUE)
+        frame->pts= lavc_venc_context->frame_number * av_q2d(lavc_venc_context->time_base);
+    if(pic)
+        pic->pts= floor(frame->pts / av_q2d(lavc_venc_context->time_base) + 0.5);
+
+    frame->out_size = avcodec_encode_video(lavc_venc_context, frame->buf,
+                                           mux_v->buffer_size, pic);
+
+    coded= lavc_venc_context->coded_frame;
+    frame->key_frame= coded->key_frame;
+    if(coded->pts != MP_NOPTS_VALUE)
+        frame->coded_pts= coded->pts * av_q2d(lavc_venc_context->time_base);
     else
-        pts= MP_NOPTS_VALUE;
+        frame->coded_pts= MP_NOPTS_VALUE;
     assert(MP_NOPTS_VALUE == AV_NOPTS_VALUE);
-#endif
-//fprintf(stderr, "ve_lavc %f/%f\n", dts, pts);
+    free(coded->opaque);
+    coded->opaque= NULL;
+    // overwritten by the next frame
+    frame->stats= lavc_venc_context->stats_out && stats_file ?
+                  strdup(lavc_venc_context->stats_out) : NULL;
+}
+
+/// mux an encoded frame, 0 if the encoder is holding it back
+static int write_frame(struct vf_instance *vf, enc_frame_t *frame){
+    const char pict_type_char[5]= {'?', 'I', 'P', 'B', 'S'};
+    int out_size= frame->out_size;
+    double dts= frame->pts - lavc_venc_context->delay * av_q2d(lavc_venc_context->time_base);
+
+//fprintf(stderr, "ve_lavc %f/%f\n", dts, frame->coded_pts);
     if(out_size == 0 && lavc_param_skip_threshold==0 && lavc_param_skip_factor==0){
         ++mux_v->encoder_delay;
         return 0;
     }
 
-    muxer_write_chunk(mux_v,out_size,lavc_venc_context->coded_frame->key_frame?0x10:0,
-                      dts, pts);
-    free(lavc_venc_context->coded_frame->opaque);
-    lavc_venc_context->coded_frame->opaque= NULL;
+    if(frame->buf != mux_v->buffer)
+        memcpy(mux_v->buffer, frame->buf, out_size);
+    muxer_write_chunk(mux_v,out_size,frame->key_frame?0x10:0,
+                      dts, frame->coded_pts);
 
     /* store psnr / pict size / type / qscale */
     if(lavc_param_psnr){
@@ -888,13 +983,175 @@ static int encode_frame(struct vf_instance *vf, AVFrame *pic, double pts){
             );
     }
     /* store stats if there are any */
-    if(lavc_venc_context->stats_out && stats_file)
-        fprintf(stats_file, "%s", lavc_venc_context->stats_out);
+    if(frame->stats)
+        fprintf(stats_file, "%s", frame->stats);
+    return out_size;
+}
+
+static int encode_frame(struct vf_instance *vf, AVFrame *pic, double pts){
+    enc_frame_t frame= { .pts= pts, .buf= mux_v->buffer };
+    int out_size;
+
+    encode_pic(vf, pic, &frame);
+    out_size= write_frame(vf, &frame);
+    free(frame.stats);
     return out_size;
 }
 
+#ifdef HAVE_PTHREADS
+/* The encoder runs in its own thread while the main loop decodes, filters
+   and encodes the audio of the frames behind. Only the thread touches the
+   codec context until the frames are muxed in order by the main loop. */
+static void *encode_thread(void *arg){
+    struct vf_instance *vf= arg;
+    struct vf_priv_s *p= vf->priv;
+
+    pthread_mutex_lock(&p->lock);
+    while(!p->quit){
+        enc_frame_t *frame;
+        if(p->encoded == p->queued){
+            pthread_cond_wait(&p->wake, &p->lock);
+            continue;
+        }
+        frame= &p->ring[p->encoded % p->depth];
+        pthread_mutex_unlock(&p->lock);
+        if(!frame->dup){
+            fill_pic(p->pic, frame->mpi);
+            encode_pic(vf, p->pic, frame);
+        }
+        pthread_mutex_lock(&p->lock);
+        p->encoded++;
+        pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/// mux what the thread has encoded, waiting until at most keep frames are left
+static void pipeline_drain(struct vf_instance *vf, unsigned keep){
+    struct vf_priv_s *p= vf->priv;
+
+    pthread_mutex_lock(&p->lock);
+    while(p->queued - p->written > keep || p->written != p->encoded){
+        enc_frame_t *frame;
+        if(p->written == p->encoded){
+            pthread_cond_wait(&p->done, &p->lock);
+            continue;
+        }
+        frame= &p->ring[p->written % p->depth];
+        pthread_mutex_unlock(&p->lock);
+        if(frame->dup)
+            muxer_write_chunk(mux_v, 0, 0, MP_NOPTS_VALUE, MP_NOPTS_VALUE);
+        else
+            write_frame(vf, frame);
+        free(frame->stats);
+        frame->stats= NULL;
+        pthread_mutex_lock(&p->lock);
+        p->written++;
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+/// the slot for the next frame, once there is one
+static enc_frame_t *pipeline_slot(struct vf_instance *vf){
+    pipeline_drain(vf, vf->priv->depth - 1);
+    return &vf->priv->ring[vf->priv->queued % vf->priv->depth];
+}
+
+/// hand the slot from pipeline_slot() to the thread
+static void pipeline_queue(struct vf_instance *vf){
+    pthread_mutex_lock(&vf->priv->lock);
+    vf->priv->queued++;
+    pthread_cond_signal(&vf->priv->wake);
+    pthread_mutex_unlock(&vf->priv->lock);
+}
+
+static void pipeline_free(struct vf_priv_s *p, int n){
+    int i;
+
+    for(i=0;i<n;i++){
+        if(p->ring[i].mpi)
+            free_mp_image(p->ring[i].mpi);
+        free(p->ring[i].buf);
+        free(p->ring[i].stats);
+    }
+    free(p->ring);
+    p->ring= NULL;
+    p->depth= 0;
+}
+
+static void pipeline_stop(struct vf_instance *vf){
+    struct vf_priv_s *p= vf->priv;
+
+    if(!p->depth)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->quit= 1;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    pipeline_free(p, p->depth);
+}
+#endif
+
+static void pipeline_start(struct vf_instance *vf, int width, int height,
+                           unsigned int fmt){
+#ifdef HAVE_PTHREADS
+    struct vf_priv_s *p= vf->priv;
+    int i;
+
+    if(p->depth){
+        pipeline_drain(vf, 0);
+        pipeline_stop(vf);
+    }
+    if(!lavc_param_pipeline)
+        return;
+    // both need the frame that was just encoded
+    if(lavc_param_psnr || !encode_duplicates){
+        mp_msg(MSGT_MENCODER, MSGL_WARN,
+               "[VE_LAVC] pipeline does not work with psnr or -noencodedups, ignored.\n");
+        return;
+    }
+    p->ring= calloc(lavc_param_pipeline, sizeof(*p->ring));
+    if(!p->ring)
+        return;
+    for(i=0;i<lavc_param_pipeline;i++){
+        p->ring[i].mpi= alloc_mpi(width, height, fmt);
+        p->ring[i].buf= malloc(mux_v->buffer_size);
+        if(!p->ring[i].buf){
+            pipeline_free(p, i + 1);
+            return;
+        }
+    }
+    p->depth= lavc_param_pipeline;
+    p->queued= p->encoded= p->written= 0;
+    p->quit= 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    if(pthread_create(&p->thread, NULL, encode_thread, vf)){
+        mp_msg(MSGT_MENCODER, MSGL_WARN,
+               "[VE_LAVC] Cannot start the encoding thread, encoding frame by frame.\n");
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->wake);
+        pthread_cond_destroy(&p->done);
+        pipeline_free(p, p->depth);
+        return;
+    }
+    mp_msg(MSGT_MENCODER, MSGL_V, "[VE_LAVC] Encoding in a thread, up to %d frames ahead\n",
+           p->depth);
+#endif
+}
+
 static void uninit(struct vf_instance *vf){
 
+#ifdef HAVE_PTHREADS
+    pipeline_stop(vf);
+#endif
+
     if(lavc_param_psnr){
         double f= lavc_venc_context->width*lavc_venc_context->height*255.0*255.0;
         f*= lavc_venc_context->coded_frame->coded_picture_number;
@@ -36,6 +36,7 @@
 struct vf_priv_s {
     double pts;
     const vo_functions_t *vo;
+    int no_frame_pts;   // the vo did not take VOCTRL_SET_FRAME_PTS
 };
 #define video_out (vf->priv->vo)
 
@@ -166,6 +167,10 @@ static int put_image(struct vf_instance *vf,
   if(!vo_config_count) return 0; // vo not configured?
   // record pts (potentially modified by filters) for main loop
   vf->priv->pts = pts;
+  // asked once, most VOs do not want it
+  if(!vf->priv->no_frame_pts &&
+     video_out->control(VOCTRL_SET_FRAME_PTS, &pts) != VO_TRUE)
+    vf->priv->no_frame_pts = 1;
   // first check, maybe the vo/vf plugin implements draw_image using mpi:
   if(video_out->control(VOCTRL_DRAW_IMAGE,mpi)==VO_TRUE) return 1; // done.
   // nope, fallback to old draw_frame/draw_slice:
@@ -30,6 +30,9 @@
 #include "stheader.h"
 #include "aac_hdr.h"
 #include "ms_hdr.h"
+#include "framemap.h"
+
+#define FRAME_MAP_INTERVAL 0.5
 
 typedef struct {
 	uint8_t *buf;
@@ -37,6 +40,8 @@ typedef struct {
 	float time;	/// amount of time elapsed based upon samples_per_frame/sample_rate (in milliseconds)
 	float last_pts; /// last pts seen
 	int bitrate;	/// bitrate computed as size/time
+	frame_map_t *map;	/// known frame positions, for seeking
+	int scanning;	/// the map is filled in the background, since the first seek
 } aac_priv_t;
 
 static int demux_aac_init(demuxer_t *demuxer)
@@ -68,6 +73,7 @@ static void demux_close_aac(demuxer_t *demuxer)
 	if(priv->buf)
 		free(priv->buf);
 
+	frame_map_free(priv->map);
 	free(demuxer->priv);
 
 	return;
@@ -123,8 +129,19 @@ fail:
 	return 0;
 }
 
+static int aac_frame_parse(unsigned char *hdr, double *duration)
+{
+	int srate, num, len = aac_parse_frame(hdr, &srate, &num);
+
+	if(len <= 0 || !srate)
+		return 0;
+	*duration = num * 1024.0 / srate;
+	return len;
+}
+
 static demuxer_t* demux_aac_open(demuxer_t *demuxer)
 {
+	aac_priv_t *priv = (aac_priv_t *) demuxer->priv;
 	sh_audio_t *sh;
 
 	sh = new_sh_audio(demuxer, 0, NULL);
@@ -135,6 +152,8 @@ static demuxer_t* demux_aac_open(demuxer_t *demuxer)
 
 	demuxer->filepos = stream_tell(demuxer->stream);
 
+	priv->map = frame_map_new(FRAME_MAP_INTERVAL);
+
 	return demuxer;
 }
 
@@ -179,6 +198,7 @@ static int demux_aac_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
 			}
 
 
+			frame_map_add(priv->map, priv->last_pts, stream_tell(demuxer->stream) - 8);
 			memcpy(dp->buffer, priv->buf, 8);
 			stream_read(demuxer->stream, &(dp->buffer[8]), len-8);
 			if(srate)
@@ -209,17 +229,36 @@ static void demux_aac_seek(demuxer_t *demuxer, float rel_seek_secs, float audio_
 	aac_priv_t *priv = (aac_priv_t *) demuxer->priv;
 	demux_stream_t *d_audio=demuxer->audio;
 	sh_audio_t *sh_audio=d_audio->sh;
-	float time;
+	frame_map_entry_t e;
+	float time, target;
 
 	ds_free_packs(d_audio);
 
-	time = (flags & SEEK_ABSOLUTE) ? rel_seek_secs - priv->last_pts : rel_seek_secs;
-	if(time < 0)
+	// files that are never seeked in are not read twice
+	if(!priv->scanning && (demuxer->stream->flags & MP_STREAM_SEEK))
+	{
+		priv->scanning = 1;
+		frame_map_scan(priv->map, demuxer->stream, demuxer->movi_start,
+		               demuxer->movi_end, 8, aac_frame_parse);
+	}
+
+	target = (flags & SEEK_ABSOLUTE) ? rel_seek_secs : priv->last_pts + rel_seek_secs;
+	if(target < 0)
+		target = 0;
+	// start counting frames from the closest known position before target
+	if(frame_map_find(priv->map, target, &e) ||
+	   (frame_map_last(priv->map, &e) && e.pts <= target &&
+	    (e.pts > priv->last_pts || target < priv->last_pts)))
+	{
+		stream_seek(demuxer->stream, e.pos);
+		priv->last_pts = e.pts;
+	}
+	else if(target < priv->last_pts)
 	{
 		stream_seek(demuxer->stream, demuxer->movi_start);
-		time = priv->last_pts + time;
 		priv->last_pts = 0;
 	}
+	time = target - priv->last_pts;
 
 	if(time > 0)
 	{
@@ -29,6 +29,8 @@
 #include "genres.h"
 #include "mp3_hdr.h"
 #include "demux_audio.h"
+#include "seekidx.h"
+#include "framemap.h"
 
 #include "libavutil/intreadwrite.h"
 
@@ -44,8 +46,18 @@
 typedef struct da_priv {
   int frmt;
   double next_pts;
+  int exact_pts; // next_pts was counted from a known position, not guessed
+  double duration; // from the Xing/VBRI header, 0 if unknown
+  frame_map_entry_t *toc; // Xing/VBRI seek table, positions are approximate
+  int toc_num;
+  frame_map_t *map; // exact frame positions seen while playing or scanning
 } da_priv_t;
 
+//! seconds between frame map entries
+#define FRAME_MAP_INTERVAL 0.5
+//! largest first frame we look for a Xing/VBRI header in
+#define MAX_TOC_FRAME 4096
+
 //! rather arbitrary value for maximum length of wav-format headers
 #define MAX_WAVHDR_LEN (1 * 1024 * 1024)
 
@@ -260,6 +272,104 @@ get_flac_metadata (demuxer_t* demuxer)
 }
 #endif
 
+/**
+ * \brief read the Xing/Info or VBRI header in the first MP3 frame
+ * Both give the number of frames and a table of byte positions at
+ * regular time intervals, which makes VBR seeking constant time.
+ */
+static void mp3_read_toc(demuxer_t *demuxer, da_priv_t *priv, sh_audio_t *sh_audio) {
+  stream_t *s = demuxer->stream;
+  uint8_t *buf;
+  int len, chans, freq, spf, layer, br, off, i;
+  unsigned int frames = 0, bytes = 0;
+
+  buf = malloc(MAX_TOC_FRAME);
+  if (!buf)
+    return;
+  stream_seek(s, demuxer->movi_start);
+  len = stream_read(s, buf, MAX_TOC_FRAME);
+  if (len < 4 || mp_get_mp3_header(buf, &chans, &freq, &spf, &layer, &br) <= 0 ||
+      layer != 3)
+    goto out;
+  // the tag follows the side info, whose size depends on version and channels
+  off = 4 + ((buf[1] & 8) ? (chans == 1 ? 17 : 32) : (chans == 1 ? 9 : 17));
+  if (off + 8 <= len && (!memcmp(buf + off, "Xing", 4) || !memcmp(buf + off, "Info", 4))) {
+    unsigned int flags = AV_RB32(buf + off + 4);
+    uint8_t *p = buf + off + 8;
+    if (flags & 1) {
+      frames = AV_RB32(p);
+      p += 4;
+    }
+    if (flags & 2) {
+      bytes = AV_RB32(p);
+      p += 4;
+    }
+    if (!bytes)
+      bytes = demuxer->movi_end - demuxer->movi_start;
+    if (!frames)
+      goto out;
+    priv->duration = frames * (double)spf / freq;
+    if ((flags & 4) && p + 100 <= buf + len && bytes) {
+      // entry i is the position at i percent of the duration
+      priv->toc = malloc(101 * sizeof(*priv->toc));
+      if (!priv->toc)
+        goto out;
+      for (i = 0; i < 100; i++) {
+        priv->toc[i].pts = priv->duration * i / 100;
+        priv->toc[i].pos = demuxer->movi_start + (off_t)p[i] * bytes / 256;
+      }
+      priv->toc[100].pts = priv->duration;
+      priv->toc[100].pos = demuxer->movi_start + bytes;
+      priv->toc_num = 101;
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V, "demux_audio: Xing header, %u frames%s\n",
+           frames, priv->toc ? ", TOC" : "");
+  } else if (4 + 32 + 26 <= len && !memcmp(buf + 36, "VBRI", 4)) {
+    uint8_t *p = buf + 36;
+    int entries = AV_RB16(p + 18), scale = AV_RB16(p + 20);
+    int size = AV_RB16(p + 22), per_entry = AV_RB16(p + 24);
+    off_t pos = demuxer->movi_start;
+    bytes = AV_RB32(p + 10);
+    frames = AV_RB32(p + 14);
+    if (!frames)
+      goto out;
+    priv->duration = frames * (double)spf / freq;
+    if (size >= 1 && size <= 4 && 36 + 26 + entries * size <= len) {
+      // entry i is the size of the stretch of per_entry frames before it
+      priv->toc = malloc((entries + 1) * sizeof(*priv->toc));
+      if (!priv->toc)
+        goto out;
+      p += 26;
+      for (i = 0; i <= entries; i++) {
+        priv->toc[i].pts = FFMIN((double)i * per_entry * spf / freq, priv->duration);
+        priv->toc[i].pos = pos;
+        if (i < entries) {
+          unsigned int v = 0;
+          int j;
+          for (j = 0; j < size; j++)
+            v = v << 8 | *p++;
+          pos += (off_t)v * scale;
+        }
+      }
+      priv->toc_num = entries + 1;
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V, "demux_audio: VBRI header, %u frames, %d TOC entries\n",
+           frames, priv->toc_num);
+  }
+  // the average bitrate is better for guessing than that of the first frame
+  if (priv->duration > 0 && demuxer->movi_end > demuxer->movi_start)
+    sh_audio->i_bps = (demuxer->movi_end - demuxer->movi_start) / priv->duration;
+out:
+  free(buf);
+}
+
+static int mp3_frame_parse(unsigned char *hdr, double *duration) {
+  int freq, spf, len = mp_get_mp3_header(hdr, NULL, &freq, &spf, NULL, NULL);
+  if (len > 0)
+    *duration = spf / (double)freq;
+  return len;
+}
+
 static int demux_audio_open(demuxer_t* demuxer) {
   stream_t *s;
   sh_audio_t* sh_audio;
@@ -499,10 +609,21 @@ static int demux_audio_open(demuxer_t* demuxer) {
 	    break;
   }
 
-  priv = malloc(sizeof(da_priv_t));
+  priv = calloc(1, sizeof(da_priv_t));
   priv->frmt = frmt;
   priv->next_pts = 0;
+  priv->exact_pts = 1;
   demuxer->priv = priv;
+  if (frmt == MP3) {
+    priv->map = frame_map_new(FRAME_MAP_INTERVAL);
+    if (demuxer->movi_end && (s->flags & MP_STREAM_SEEK) == MP_STREAM_SEEK)
+      mp3_read_toc(demuxer, priv, sh_audio);
+    // without a TOC exact seeking means counting frames, do it up front
+    if (!priv->toc && hr_mp3_seek &&
+        frame_map_scan(priv->map, s, demuxer->movi_start, demuxer->movi_end,
+                       HDR_SIZE, mp3_frame_parse))
+      mp_msg(MSGT_DEMUX, MSGL_V, "demux_audio: scanning MP3 frames in the background\n");
+  }
   demuxer->audio->id = 0;
   demuxer->audio->sh = sh_audio;
   sh_audio->ds = demuxer->audio;
@@ -526,6 +647,10 @@ static int demux_audio_open(demuxer_t* demuxer) {
 
   mp_msg(MSGT_DEMUX,MSGL_V,"demux_audio: audio data 0x%X - 0x%X  \n",(int)demuxer->movi_start,(int)demuxer->movi_end);
 
+  // frames are counted from the start, other formats guess from the bitrate
+  if (frmt == MP3)
+    seekidx_open(demuxer, 0);
+
   return DEMUXER_TYPE_AUDIO;
 }
 
@@ -554,6 +679,10 @@ static int demux_audio_fill_buffer(demuxer_t *demux, demux_stream_t *ds) {
 	  return 0; // might be ID3 tag, i.e. EOF
 	stream_skip(s,-3);
       } else {
+	if (priv->exact_pts) {
+	  seekidx_add(demux, this_pts, stream_tell(s) - 4);
+	  frame_map_add(priv->map, this_pts, stream_tell(s) - 4);
+	}
 	dp = new_demux_packet(l);
 	memcpy(dp->buffer,hdr,4);
 	if (stream_read(s,dp->buffer + 4,l-4) != l-4)
@@ -614,17 +743,84 @@ static void high_res_mp3_seek(demuxer_t *demuxer,float time) {
       stream_skip(demuxer->stream,-3);
       continue;
     }
+    if (priv->exact_pts)
+      frame_map_add(priv->map, priv->next_pts, stream_tell(demuxer->stream) - 4);
     stream_skip(demuxer->stream,len-4);
     priv->next_pts += sh->audio.dwScale/(double)sh->samplerate;
     nf--;
   }
 }
 
+/**
+ * \brief seek in MP3 using the frame map, the TOC or, with -hr-mp3-seek,
+ * by counting frames from the nearest known one
+ * \return 0 if none of these is possible
+ */
+static int mp3_seek(demuxer_t *demuxer, float rel_seek_secs, int flags) {
+  da_priv_t *priv = demuxer->priv;
+  stream_t *s = demuxer->stream;
+  frame_map_entry_t e;
+  double target;
+
+  if (flags & SEEK_FACTOR)
+    target = rel_seek_secs * priv->duration;
+  else
+    target = (flags & SEEK_ABSOLUTE) ? rel_seek_secs : priv->next_pts + rel_seek_secs;
+  if (priv->duration > 0 && target > priv->duration)
+    target = priv->duration;
+  if (target < 0)
+    target = 0;
+
+  // exact and cheap: a known frame is at most two intervals away
+  if (frame_map_find(priv->map, target, &e)) {
+    stream_seek(s, e.pos);
+    priv->next_pts = e.pts;
+    priv->exact_pts = 1;
+    high_res_mp3_seek(demuxer, target - e.pts);
+    return 1;
+  }
+
+  if (hr_mp3_seek) {
+    if (!frame_map_last(priv->map, &e) || e.pts > target) {
+      e.pts = 0;
+      e.pos = demuxer->movi_start;
+    }
+    // count from the current position only if it is known and closer
+    if (!priv->exact_pts || priv->next_pts < e.pts || target < priv->next_pts) {
+      stream_seek(s, e.pos);
+      priv->next_pts = e.pts;
+      priv->exact_pts = 1;
+    }
+    high_res_mp3_seek(demuxer, target - priv->next_pts);
+    return 1;
+  }
+
+  if (priv->toc_num) {
+    frame_map_entry_t *a, *b;
+    off_t pos;
+    int i;
+    for (i = 1; i < priv->toc_num - 1 && priv->toc[i].pts <= target; i++)
+      ;
+    a = &priv->toc[i - 1];
+    b = &priv->toc[i];
+    pos = a->pos;
+    if (b->pts > a->pts && target > a->pts)
+      pos += (b->pos - a->pos) * ((target - a->pts) / (b->pts - a->pts));
+    if (demuxer->movi_end && pos > demuxer->movi_end)
+      pos = demuxer->movi_end;
+    // fill_buffer() syncs to the next frame header
+    stream_seek(s, pos);
+    priv->next_pts = target;
+    priv->exact_pts = 0;
+    return 1;
+  }
+  return 0;
+}
+
 static void demux_audio_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_delay,int flags){
   sh_audio_t* sh_audio;
   stream_t* s;
   int64_t base,pos;
-  float len;
   da_priv_t* priv;
 
   if(!(sh_audio = demuxer->audio->sh))
@@ -632,17 +828,9 @@ static void demux_audio_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_
   s = demuxer->stream;
   priv = demuxer->priv;
 
-  if(priv->frmt == MP3 && hr_mp3_seek && !(flags & SEEK_FACTOR)) {
-    len = (flags & SEEK_ABSOLUTE) ? rel_seek_secs - priv->next_pts : rel_seek_secs;
-    if(len < 0) {
-      stream_seek(s,demuxer->movi_start);
-      len = priv->next_pts + len;
-      priv->next_pts = 0;
-    }
-    if(len > 0)
-      high_res_mp3_seek(demuxer,len);
+  if(priv->frmt == MP3 && (!(flags & SEEK_FACTOR) || priv->duration > 0) &&
+     mp3_seek(demuxer, rel_seek_secs, flags))
     return;
-  }
 
   base = flags&SEEK_ABSOLUTE ? demuxer->movi_start : stream_tell(s);
   if(flags&SEEK_FACTOR)
@@ -656,6 +844,7 @@ static void demux_audio_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_
     pos = demuxer->movi_start;
 
   priv->next_pts = (pos-demuxer->movi_start)/(double)sh_audio->i_bps;
+  priv->exact_pts = 0;
 
   switch(priv->frmt) {
   case WAV:
@@ -673,6 +862,8 @@ static void demux_close_audio(demuxer_t* demuxer) {
 
   if(!priv)
     return;
+  frame_map_free(priv->map);
+  free(priv->toc);
   free(priv);
 }
 
@@ -683,6 +874,10 @@ static int demux_audio_control(demuxer_t *demuxer,int cmd, void *arg){
 
     switch(cmd) {
 	case DEMUXER_CTRL_GET_TIME_LENGTH:
+	    if (priv->duration > 0) {
+		*((double *)arg) = priv->duration;
+		return DEMUXER_CTRL_OK;
+	    }
 	    if (audio_length<=0) return DEMUXER_CTRL_DONTKNOW;
 	    *((double *)arg)=(double)audio_length;
 	    return DEMUXER_CTRL_GUESS;
@@ -693,6 +888,18 @@ static int demux_audio_control(demuxer_t *demuxer,int cmd, void *arg){
     	    *((int *)arg)=(int)( (priv->next_pts*100)  / audio_length);
 	    return DEMUXER_CTRL_OK;
 
+	case DEMUXER_CTRL_SEEK_POS: {
+	    demux_seek_pos_t *sp = arg;
+	    if (priv->frmt != MP3)
+		return DEMUXER_CTRL_NOTIMPL;
+	    stream_seek(demuxer->stream, sp->pos);
+	    priv->next_pts = sp->pts;
+	    priv->exact_pts = 1;
+	    if (hr_mp3_seek && sp->target > sp->pts)
+		high_res_mp3_seek(demuxer, sp->target - sp->pts);
+	    return DEMUXER_CTRL_OK;
+	}
+
 	default:
 	    return DEMUXER_CTRL_NOTIMPL;
     }
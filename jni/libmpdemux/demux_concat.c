@@ -0,0 +1,472 @@
+/*
+ * plays the segments of a concat:// stream one after the other through a
+ * single set of stream headers, so that the decoders are not reopened
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mp_msg.h"
+#include "stream/stream.h"
+#include "demuxer.h"
+#include "stheader.h"
+#include "seekidx.h"
+
+typedef struct concat_seg {
+    demuxer_t *demuxer;     ///< NULL if the segment is not open
+    double start;           ///< position on the joined timeline
+    double length;          ///< 0 if unknown
+    double offset;          ///< added to timestamps, MP_NOPTS_VALUE if unknown
+    int played;             ///< start is exact, not estimated
+    int used;               ///< was read from since it was opened
+} concat_seg_t;
+
+typedef struct concat_priv {
+    stream_segments_t *seg;
+    concat_seg_t *segs;
+    int cur;                ///< the segment being read
+    int audio_id, video_id, dvdsub_id;
+    double end_pts;         ///< end of the last timestamped packet
+    double last_pts[2], dur[2];     ///< of the video and audio packets
+} concat_priv_t;
+
+extern const demuxer_desc_t demuxer_desc_concat;
+
+/// these resync at any packet boundary and are simply joined byte by byte
+static int byte_concat_format(int type)
+{
+    switch (type) {
+    case DEMUXER_TYPE_MPEG_TS:
+    case DEMUXER_TYPE_MPEG_PS:
+    case DEMUXER_TYPE_MPEG_PES:
+    case DEMUXER_TYPE_MPEG_ES:
+    case DEMUXER_TYPE_MPEG4_ES:
+    case DEMUXER_TYPE_H264_ES:
+    case DEMUXER_TYPE_MPEG_TY:
+    case DEMUXER_TYPE_PVA:
+    case DEMUXER_TYPE_LMLM4:
+    case DEMUXER_TYPE_AUDIO:
+    case DEMUXER_TYPE_AAC:
+    case DEMUXER_TYPE_RAWAUDIO:
+    case DEMUXER_TYPE_RAWVIDEO:
+        return 1;
+    }
+    return 0;
+}
+
+static demuxer_t *open_segment(concat_priv_t *p, int i, int type)
+{
+    int file_format = DEMUXER_TYPE_UNKNOWN;
+    stream_t *s = open_stream(p->seg->urls[i], NULL, &file_format);
+    demuxer_t *d;
+
+    if (!s)
+        return NULL;
+    d = demux_open_stream(s, type, 0, p->audio_id, p->video_id, p->dvdsub_id,
+                          p->seg->urls[i]);
+    if (!d) {
+        free_stream(s);
+        return NULL;
+    }
+    if (!p->segs[i].length)
+        p->segs[i].length = demuxer_get_time_length(d);
+    return d;
+}
+
+static void close_segment(concat_priv_t *p, int i)
+{
+    demuxer_t *d = p->segs[i].demuxer;
+    stream_t *s = d->stream;
+
+    free_demuxer(d);
+    free_stream(s);
+    p->segs[i].demuxer = NULL;
+    p->segs[i].used = 0;
+}
+
+/**
+ * Close the segments that are neither current nor the first one, which owns
+ * the stream headers.
+ */
+static void close_idle_segments(concat_priv_t *p)
+{
+    int i;
+
+    for (i = 1; i < p->seg->num; i++) {
+        demuxer_t *d = p->segs[i].demuxer;
+        if (d && i != p->cur)
+            close_segment(p, i);
+    }
+}
+
+/// estimate the starts of the segments that were not played yet
+static void update_starts(concat_priv_t *p)
+{
+    double rate = 0;
+    int i;
+
+    // seconds per byte of the first segment for those not opened yet
+    if (p->segs[0].length > 0)
+        rate = p->segs[0].length / (p->seg->start[1] - p->seg->start[0]);
+    for (i = 1; i < p->seg->num; i++) {
+        double len = p->segs[i - 1].length;
+        if (len <= 0)
+            len = rate * (p->seg->start[i] - p->seg->start[i - 1]);
+        if (!p->segs[i].played)
+            p->segs[i].start = p->segs[i - 1].start + len;
+    }
+}
+
+static int same_video(sh_video_t *a, sh_video_t *b)
+{
+    if (!a)
+        return 1;
+    if (!b || a->format != b->format || !a->bih != !b->bih)
+        return 0;
+    if (!a->bih)
+        return a->disp_w == b->disp_w && a->disp_h == b->disp_h;
+    return a->bih->biWidth == b->bih->biWidth &&
+           a->bih->biHeight == b->bih->biHeight &&
+           a->bih->biSize == b->bih->biSize &&
+           !memcmp(a->bih + 1, b->bih + 1,
+                   a->bih->biSize - sizeof(*a->bih));
+}
+
+static int same_audio(sh_audio_t *a, sh_audio_t *b)
+{
+    if (!a)
+        return 1;
+    if (!b || a->format != b->format || !a->wf != !b->wf ||
+        a->codecdata_len != b->codecdata_len ||
+        memcmp(a->codecdata, b->codecdata, a->codecdata_len))
+        return 0;
+    // the decoder overwrites samplerate and channels
+    return !a->wf || (a->wf->nSamplesPerSec == b->wf->nSamplesPerSec &&
+                      a->wf->nChannels == b->wf->nChannels &&
+                      a->wf->cbSize == b->wf->cbSize &&
+                      !memcmp(a->wf + 1, b->wf + 1, a->wf->cbSize));
+}
+
+static double first_pts(demuxer_t *d)
+{
+    if (d->video->first && d->video->first->pts != MP_NOPTS_VALUE)
+        return d->video->first->pts;
+    if (d->audio->first && d->audio->first->pts != MP_NOPTS_VALUE)
+        return d->audio->first->pts;
+    return 0;
+}
+
+/// seek within one segment, the caller resyncs the decoders
+static void seek_segment(demuxer_t *d, float rel_seek_secs, int flags)
+{
+    demux_flush(d);
+    d->stream->eof = 0;
+    d->video->eof = 0;
+    d->audio->eof = 0;
+    d->sub->eof = 0;
+    if (!seekidx_seek(d, rel_seek_secs, flags) && d->desc->seek)
+        d->desc->seek(d, rel_seek_secs, 0, flags);
+    demux_control(d, DEMUXER_CTRL_RESYNC, NULL);
+}
+
+/**
+ * Make segment i the current one.
+ * \param seeking the timestamps will not continue from the current ones
+ */
+static int switch_segment(demuxer_t *demuxer, int i, int seeking)
+{
+    concat_priv_t *p = demuxer->priv;
+    concat_seg_t *s = p->segs + i;
+    demuxer_t *d = s->demuxer;
+
+    if (!d)
+        d = s->demuxer = open_segment(p, i, demuxer->file_format);
+    if (!d || d->file_format != demuxer->file_format ||
+        !same_video(demuxer->video->sh, d->video->sh) ||
+        !same_audio(demuxer->audio->sh, d->audio->sh)) {
+        mp_msg(MSGT_DEMUX, MSGL_WARN,
+               "[concat] %s does not continue the previous segment, "
+               "stopping\n", p->seg->urls[i]);
+        if (d)
+            close_segment(p, i);
+        return 0;
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V, "[concat] segment %d: %s\n", i + 1,
+           p->seg->urls[i]);
+    p->cur = i;
+    if (!seeking) {
+        if (s->used)
+            seek_segment(d, 0, SEEK_ABSOLUTE);
+        s->start = p->end_pts;
+        s->played = 1;
+        s->offset = MP_NOPTS_VALUE;     // set by the first timestamp
+    } else if (s->offset == MP_NOPTS_VALUE)
+        s->offset = s->start - first_pts(d);
+    s->used = 1;
+    close_idle_segments(p);
+    return 1;
+}
+
+/// move the packets the current segment demuxed to the joined stream
+static void move_packets(concat_priv_t *p, demux_stream_t *dst,
+                         demux_stream_t *src, int track)
+{
+    concat_seg_t *s = p->segs + p->cur;
+    demux_packet_t *dp;
+
+    while ((dp = src->first)) {
+        src->first = dp->next;
+        src->packs--;
+        src->bytes -= dp->len;
+        dp->next = NULL;
+        if (dp->pts != MP_NOPTS_VALUE) {
+            if (s->offset == MP_NOPTS_VALUE)
+                s->offset = s->start - dp->pts;
+            dp->pts += s->offset;
+            if (dp->endpts != MP_NOPTS_VALUE)
+                dp->endpts += s->offset;
+            if (track < 2) {
+                if (dp->pts > p->last_pts[track])
+                    p->dur[track] = dp->pts - p->last_pts[track];
+                p->last_pts[track] = dp->pts;
+                if (dp->pts + p->dur[track] > p->end_pts)
+                    p->end_pts = dp->pts + p->dur[track];
+            }
+        }
+        ds_add_packet(dst, dp);
+    }
+    src->last = NULL;
+}
+
+static int demux_concat_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
+{
+    concat_priv_t *p = demuxer->priv;
+
+    while (1) {
+        demuxer_t *d = p->segs[p->cur].demuxer;
+        demux_stream_t *sds = ds == demuxer->video ? d->video :
+                              ds == demuxer->audio ? d->audio : d->sub;
+        int ret = demux_fill_buffer(d, sds);
+        move_packets(p, demuxer->video, d->video, 0);
+        move_packets(p, demuxer->audio, d->audio, 1);
+        move_packets(p, demuxer->sub, d->sub, 2);
+        if (ret)
+            return 1;
+        if (p->cur + 1 >= p->seg->num || !switch_segment(demuxer, p->cur + 1, 0))
+            return 0;
+    }
+}
+
+static void demux_concat_seek(demuxer_t *demuxer, float rel_seek_secs,
+                              float audio_delay, int flags)
+{
+    concat_priv_t *p = demuxer->priv;
+    double target;
+    int i;
+
+    if (flags & SEEK_FACTOR) {
+        off_t pos = rel_seek_secs * p->seg->start[p->seg->num];
+        for (i = p->seg->num - 1; i > 0 && p->seg->start[i] > pos; i--)
+            ;
+        target = (double)(pos - p->seg->start[i]) /
+                 (p->seg->start[i + 1] - p->seg->start[i]);
+        flags = SEEK_ABSOLUTE | SEEK_FACTOR;
+    } else {
+        update_starts(p);
+        target = rel_seek_secs;
+        if (!(flags & SEEK_ABSOLUTE))
+            target += demuxer->video->sh ? demuxer->video->pts :
+                                           demuxer->audio->pts;
+        for (i = p->seg->num - 1; i > 0 && p->segs[i].start > target; i--)
+            ;
+        target -= p->segs[i].start;
+        if (target < 0)
+            target = 0;
+        flags = SEEK_ABSOLUTE;
+    }
+    if (i != p->cur && !switch_segment(demuxer, i, 1))
+        return;
+    seek_segment(p->segs[i].demuxer, target, flags);
+    p->end_pts = 0;
+    p->last_pts[0] = p->last_pts[1] = 0;
+}
+
+static int demux_concat_control(demuxer_t *demuxer, int cmd, void *arg)
+{
+    concat_priv_t *p = demuxer->priv;
+    double len;
+
+    switch (cmd) {
+    case DEMUXER_CTRL_GET_TIME_LENGTH:
+        update_starts(p);
+        len = p->segs[p->seg->num - 1].length;
+        if (len <= 0)
+            return DEMUXER_CTRL_DONTKNOW;
+        *(double *)arg = p->segs[p->seg->num - 1].start + len;
+        return p->segs[p->seg->num - 1].played ? DEMUXER_CTRL_OK
+                                                : DEMUXER_CTRL_GUESS;
+    case DEMUXER_CTRL_GET_PERCENT_POS: {
+        demuxer_t *d = p->segs[p->cur].demuxer;
+        off_t pos = p->seg->start[p->cur] + stream_tell(d->stream);
+        *(int *)arg = 100 * (double)pos / p->seg->start[p->seg->num];
+        return DEMUXER_CTRL_OK;
+    }
+    case DEMUXER_CTRL_CORRECT_PTS:
+        return demux_control(p->segs[0].demuxer, cmd, arg);
+    }
+    // switching streams would leave the later segments behind
+    return DEMUXER_CTRL_NOTIMPL;
+}
+
+static void demux_close_concat(demuxer_t *demuxer)
+{
+    concat_priv_t *p = demuxer->priv;
+    int i;
+
+    for (i = p->seg->num - 1; i >= 0; i--)
+        if (p->segs[i].demuxer)
+            close_segment(p, i);
+    // the stream headers were the first segment's
+    memset(demuxer->a_streams, 0, sizeof(demuxer->a_streams));
+    memset(demuxer->v_streams, 0, sizeof(demuxer->v_streams));
+    memset(demuxer->s_streams, 0, sizeof(demuxer->s_streams));
+    free(p->segs);
+    free(p);
+}
+
+static void set_ds(sh_common_t *sh, demux_stream_t *ds)
+{
+    if (sh)
+        sh->ds = ds;
+}
+
+/**
+ * \brief play the segments of vd's stream as one file if they are
+ * complete files of the same format
+ * \return the new demuxer, or vd if its stream is to be read byte by byte
+ */
+demuxer_t *new_concat_demuxer(demuxer_t *vd, int audio_id, int video_id,
+                              int dvdsub_id)
+{
+    stream_segments_t *seg;
+    concat_priv_t *p;
+    demuxer_t *ret, *first, *second;
+    int i;
+
+    if (stream_control(vd->stream, STREAM_CTRL_GET_SEGMENTS, &seg) != STREAM_OK ||
+        seg->num < 2 || vd->type == DEMUXER_TYPE_PLAYLIST ||
+        byte_concat_format(vd->file_format))
+        return vd;
+    p = calloc(1, sizeof(*p));
+    if (!p)
+        return vd;
+    p->segs = calloc(seg->num, sizeof(*p->segs));
+    if (!p->segs) {
+        free(p);
+        return vd;
+    }
+    p->seg = seg;
+    p->audio_id = audio_id;
+    p->video_id = video_id;
+    p->dvdsub_id = dvdsub_id;
+    for (i = 0; i < seg->num; i++)
+        p->segs[i].offset = MP_NOPTS_VALUE;
+
+    // the parts of a split file are not files of their own
+    second = open_segment(p, 1, DEMUXER_TYPE_UNKNOWN);
+    first = second && second->file_format == vd->file_format ?
+            open_segment(p, 0, vd->file_format) : NULL;
+    if (!first) {
+        if (second) {
+            stream_t *s = second->stream;
+            free_demuxer(second);
+            free_stream(s);
+        }
+        free(p->segs);
+        free(p);
+        return vd;
+    }
+    mp_msg(MSGT_DEMUX, MSGL_INFO,
+           "[concat] joining %d segments without reopening the codecs\n",
+           seg->num);
+    p->segs[0].demuxer = first;
+    p->segs[0].offset = 0;
+    p->segs[0].played = 1;
+    p->segs[0].used = 1;
+    p->segs[1].demuxer = second;
+
+    ret = calloc(1, sizeof(*ret));
+    if (!ret) {
+        close_segment(p, 0);
+        close_segment(p, 1);
+        free(p->segs);
+        free(p);
+        return vd;
+    }
+    ret->type = DEMUXER_TYPE_CONCAT;
+    ret->file_format = first->file_format;
+    ret->desc = &demuxer_desc_concat;
+    ret->stream = vd->stream;
+    ret->stream_pts = MP_NOPTS_VALUE;
+    ret->reference_clock = MP_NOPTS_VALUE;
+    ret->movi_start = vd->stream->start_pos;
+    ret->movi_end = vd->stream->end_pos;
+    ret->seekable = first->seekable;
+    ret->filepos = -1;
+    ret->audio = new_demuxer_stream(ret, first->audio->id);
+    ret->video = new_demuxer_stream(ret, first->video->id);
+    ret->sub = new_demuxer_stream(ret, first->sub->id);
+    ret->audio->sh = first->audio->sh;
+    ret->video->sh = first->video->sh;
+    ret->sub->sh = first->sub->sh;
+    // the decoders read the joined streams
+    memcpy(ret->a_streams, first->a_streams, sizeof(ret->a_streams));
+    memcpy(ret->v_streams, first->v_streams, sizeof(ret->v_streams));
+    memcpy(ret->s_streams, first->s_streams, sizeof(ret->s_streams));
+    for (i = 0; i < MAX_A_STREAMS; i++)
+        set_ds(ret->a_streams[i], ret->audio);
+    for (i = 0; i < MAX_V_STREAMS; i++)
+        set_ds(ret->v_streams[i], ret->video);
+    for (i = 0; i < MAX_S_STREAMS; i++)
+        set_ds(ret->s_streams[i], ret->sub);
+    ret->info = first->info;
+    first->info = NULL;
+    if (vd->filename)
+        ret->filename = strdup(vd->filename);
+    ret->priv = p;
+
+    free_demuxer(vd);
+    return ret;
+}
+
+const demuxer_desc_t demuxer_desc_concat = {
+    "Concat demuxer",
+    "", // Not selectable
+    "",
+    "?",
+    "internal use only",
+    DEMUXER_TYPE_CONCAT,
+    0, // no autodetect
+    NULL,
+    demux_concat_fill_buffer,
+    NULL,
+    demux_close_concat,
+    demux_concat_seek,
+    demux_concat_control
+};
@@ -27,6 +27,10 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "stream/stream.h"
 #include "demuxer.h"
@@ -34,6 +38,7 @@
 #include "ebml.h"
 #include "matroska.h"
 #include "demux_real.h"
+#include "seekidx.h"
 
 #include "mp_msg.h"
 #include "help_mp.h"
@@ -169,18 +174,35 @@ typedef struct mkv_demuxer {
 
     uint64_t cluster_size;
     uint64_t blockgroup_size;
+    uint64_t cluster_start;
 
+    /* sorted by track number, then timecode */
     mkv_index_t *indexes;
     int num_indexes;
+    uint64_t indexed_tc;        ///< indexes are complete up to this timecode
 
     off_t *parsed_cues;
     int parsed_cues_num;
     off_t *parsed_seekhead;
     int parsed_seekhead_num;
 
+    /* sorted, may have gaps when seeking skipped over clusters */
     uint64_t *cluster_positions;
     int num_cluster_pos;
 
+    /* Cues behind the clusters are read by a thread from a second stream,
+     * new entries are merged into indexes before each seek. */
+    off_t cues_pos;
+#ifdef HAVE_PTHREADS
+    stream_t *cues_stream;
+    pthread_t cues_thread;
+    pthread_mutex_t cues_lock;
+    mkv_index_t *cues_new;
+    int num_cues_new;
+    int cues_done;
+    volatile int cues_abort;
+#endif
+
     int64_t skip_to_timecode;
     int v_skip_to_keyframe, a_skip_to_keyframe;
 
@@ -190,6 +212,9 @@ typedef struct mkv_demuxer {
     int audio_tracks[MAX_A_STREAMS];
 } mkv_demuxer_t;
 
+/* how far to scan for a cluster after jumping to an estimated position */
+#define MKV_RESYNC_RANGE   (16 * 1024 * 1024)
+
 #define REALHEADER_SIZE    16
 #define RVPROPERTIES_SIZE  34
 #define RAPROPERTIES4_SIZE 56
@@ -228,13 +253,36 @@ static mkv_track_t *demux_mkv_find_track_by_num(mkv_demuxer_t *d, int n,
     return NULL;
 }
 
+/**
+ * \brief find the first known cluster at or after position
+ * \return index into cluster_positions, num_cluster_pos if there is none
+ */
+static int find_cluster_position(mkv_demuxer_t *mkv_d, uint64_t position)
+{
+    int lo = 0, hi = mkv_d->num_cluster_pos;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (mkv_d->cluster_positions[mid] < position)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
 static void add_cluster_position(mkv_demuxer_t *mkv_d, uint64_t position)
 {
     int i = mkv_d->num_cluster_pos;
 
-    while (i--)
+    // clusters are usually found in file order, so check the end first
+    if (!i || mkv_d->cluster_positions[i - 1] < position)
+        ;
+    else {
+        i = find_cluster_position(mkv_d, position);
         if (mkv_d->cluster_positions[i] == position)
             return;
+    }
 
     grow_array(&mkv_d->cluster_positions, mkv_d->num_cluster_pos,
                sizeof(uint64_t));
@@ -242,7 +290,93 @@ static void add_cluster_position(mkv_demuxer_t *mkv_d, uint64_t position)
         mkv_d->num_cluster_pos = 0;
         return;
     }
-    mkv_d->cluster_positions[mkv_d->num_cluster_pos++] = position;
+    memmove(mkv_d->cluster_positions + i + 1, mkv_d->cluster_positions + i,
+            (mkv_d->num_cluster_pos - i) * sizeof(uint64_t));
+    mkv_d->cluster_positions[i] = position;
+    mkv_d->num_cluster_pos++;
+}
+
+static int add_index(mkv_index_t **indexes, int *num_indexes,
+                     const mkv_index_t *entry)
+{
+    grow_array(indexes, *num_indexes, sizeof(mkv_index_t));
+    if (!*indexes) {
+        *num_indexes = 0;
+        return 0;
+    }
+    (*indexes)[(*num_indexes)++] = *entry;
+    return 1;
+}
+
+static int cmp_index(const void *a, const void *b)
+{
+    const mkv_index_t *x = a, *y = b;
+
+    if (x->tnum != y->tnum)
+        return x->tnum < y->tnum ? -1 : 1;
+    if (x->timecode != y->timecode)
+        return x->timecode < y->timecode ? -1 : 1;
+    if (x->filepos != y->filepos)
+        return x->filepos < y->filepos ? -1 : 1;
+    return 0;
+}
+
+/// sort indexes and drop duplicates, e.g. from Cues that were read twice
+static void sort_indexes(mkv_demuxer_t *mkv_d)
+{
+    int i, n = 0;
+
+    if (!mkv_d->num_indexes)
+        return;
+    qsort(mkv_d->indexes, mkv_d->num_indexes, sizeof(mkv_index_t), cmp_index);
+    for (i = 1; i < mkv_d->num_indexes; i++)
+        if (cmp_index(mkv_d->indexes + n, mkv_d->indexes + i))
+            mkv_d->indexes[++n] = mkv_d->indexes[i];
+    mkv_d->num_indexes = n + 1;
+}
+
+/**
+ * \brief find the cue points of one track
+ * \param end set to one past the last entry of the track
+ * \return index of the first entry of the track
+ */
+static int find_track_indexes(mkv_demuxer_t *mkv_d, int tnum, int *end)
+{
+    int lo = 0, hi = mkv_d->num_indexes, start;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (mkv_d->indexes[mid].tnum < tnum)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    start = lo;
+    hi = mkv_d->num_indexes;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (mkv_d->indexes[mid].tnum <= tnum)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *end = lo;
+    return start;
+}
+
+/// \return the first entry in [start, end) at or after ms, end if none
+static int find_index_time(mkv_demuxer_t *mkv_d, int start, int end,
+                           int64_t ms)
+{
+    while (start < end) {
+        int mid = (start + end) >> 1;
+        if ((int64_t) (mkv_d->indexes[mid].timecode * mkv_d->tc_scale /
+                       1000000.0) < ms)
+            start = mid + 1;
+        else
+            end = mid;
+    }
+    return start;
 }
 
 
@@ -929,116 +1063,259 @@ static int demux_mkv_read_tracks(demuxer_t *demuxer)
     return 0;
 }
 
-static int demux_mkv_read_cues(demuxer_t *demuxer)
+/**
+ * \brief read one element of a Cues list
+ * \param length bytes left in the list, the element size is subtracted
+ * \param entry set if the element was a complete cue point, the file
+ *        position is relative to the segment start
+ * \return 1 if entry was set, 0 otherwise
+ */
+static int demux_mkv_read_cuepoint(stream_t *s, uint64_t *length,
+                                   mkv_index_t *entry)
 {
-    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
-    stream_t *s = demuxer->stream;
-    uint64_t length, l, time, track, pos;
-    off_t off;
+    uint64_t l, time, track, pos;
     int i, il;
 
-    if (index_mode == 0) {
-        ebml_read_skip(s, NULL);
-        return 0;
-    }
-    off = stream_tell(s);
-    for (i = 0; i < mkv_d->parsed_cues_num; i++)
-        if (mkv_d->parsed_cues[i] == off) {
-            ebml_read_skip(s, NULL);
-            return 0;
-        }
-    mkv_d->parsed_cues = realloc(mkv_d->parsed_cues,
-                                 (mkv_d->parsed_cues_num + 1) * sizeof(off_t));
-    mkv_d->parsed_cues[mkv_d->parsed_cues_num++] = off;
-
-    mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] /---- [ parsing cues ] -----------\n");
-    length = ebml_read_length(s, NULL);
+    time = track = pos = EBML_UINT_INVALID;
 
-    while (length > 0) {
-        time = track = pos = EBML_UINT_INVALID;
+    switch (ebml_read_id(s, &il)) {
+    case MATROSKA_ID_POINTENTRY:
+    {
+        uint64_t len;
 
-        switch (ebml_read_id(s, &il)) {
-        case MATROSKA_ID_POINTENTRY:
-        {
-            uint64_t len;
+        len = ebml_read_length(s, &i);
+        l = len + i;
 
-            len = ebml_read_length(s, &i);
-            l = len + i;
+        while (len > 0) {
+            uint64_t l;
+            int il;
 
-            while (len > 0) {
-                uint64_t l;
-                int il;
-
-                switch (ebml_read_id(s, &il)) {
-                case MATROSKA_ID_CUETIME:
-                    time = ebml_read_uint(s, &l);
-                    break;
+            switch (ebml_read_id(s, &il)) {
+            case MATROSKA_ID_CUETIME:
+                time = ebml_read_uint(s, &l);
+                break;
 
-                case MATROSKA_ID_CUETRACKPOSITION:
-                {
-                    uint64_t le;
+            case MATROSKA_ID_CUETRACKPOSITION:
+            {
+                uint64_t le;
 
-                    le = ebml_read_length(s, &i);
-                    l = le + i;
+                le = ebml_read_length(s, &i);
+                l = le + i;
 
-                    while (le > 0) {
-                        uint64_t l;
-                        int il;
+                while (le > 0) {
+                    uint64_t l;
+                    int il;
 
-                        switch (ebml_read_id(s, &il)) {
-                        case MATROSKA_ID_CUETRACK:
-                            track = ebml_read_uint(s, &l);
-                            break;
+                    switch (ebml_read_id(s, &il)) {
+                    case MATROSKA_ID_CUETRACK:
+                        track = ebml_read_uint(s, &l);
+                        break;
 
-                        case MATROSKA_ID_CUECLUSTERPOSITION:
-                            pos = ebml_read_uint(s, &l);
-                            break;
+                    case MATROSKA_ID_CUECLUSTERPOSITION:
+                        pos = ebml_read_uint(s, &l);
+                        break;
 
-                        default:
-                            ebml_read_skip(s, &l);
-                            break;
-                        }
-                        le -= l + il;
+                    default:
+                        ebml_read_skip(s, &l);
+                        break;
                     }
-                    break;
+                    le -= l + il;
                 }
+                break;
+            }
 
-                default:
-                    ebml_read_skip(s, &l);
-                    break;
-                }
-                len -= l + il;
+            default:
+                ebml_read_skip(s, &l);
+                break;
             }
-            break;
+            len -= l + il;
         }
+        break;
+    }
 
-        default:
-            ebml_read_skip(s, &l);
-            break;
+    default:
+        ebml_read_skip(s, &l);
+        break;
+    }
+
+    *length -= l + il;
+
+    if (time == EBML_UINT_INVALID || track == EBML_UINT_INVALID
+        || pos == EBML_UINT_INVALID)
+        return 0;
+    entry->tnum = track;
+    entry->timecode = time;
+    entry->filepos = pos;
+    mp_msg(MSGT_DEMUX, MSGL_DBG2,
+           "[mkv] |+ found cue point " "for track %" PRIu64
+           ": timecode %" PRIu64 ", filepos: %" PRIu64 "\n", track,
+           time, pos);
+    return 1;
+}
+
+#ifdef HAVE_PTHREADS
+static void *demux_mkv_cues_thread(void *arg)
+{
+    mkv_demuxer_t *mkv_d = arg;
+    stream_t *s = mkv_d->cues_stream;
+    mkv_index_t entry;
+    uint64_t length;
+
+    if (stream_seek(s, mkv_d->cues_pos)) {
+        length = ebml_read_length(s, NULL);
+        while (length > 0 && !s->eof && !mkv_d->cues_abort) {
+            if (!demux_mkv_read_cuepoint(s, &length, &entry))
+                continue;
+            entry.filepos += mkv_d->segment_start;
+            pthread_mutex_lock(&mkv_d->cues_lock);
+            add_index(&mkv_d->cues_new, &mkv_d->num_cues_new, &entry);
+            pthread_mutex_unlock(&mkv_d->cues_lock);
         }
+    }
+    pthread_mutex_lock(&mkv_d->cues_lock);
+    mkv_d->cues_done = 1;
+    pthread_mutex_unlock(&mkv_d->cues_lock);
+    return NULL;
+}
+#endif
 
-        length -= l + il;
+/**
+ * \brief read the Cues at off in the background
+ *
+ * Cues are usually written at the end of the file, and reading them while
+ * opening means a long seek and a few MB of reading before playback can
+ * start. Only done for local files: a thread blocked in a network read
+ * could not be joined when the file is closed.
+ * \return 1 if the thread was started
+ */
+static int demux_mkv_start_cues_thread(demuxer_t *demuxer, off_t off)
+{
+#ifdef HAVE_PTHREADS
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    stream_t *s = demuxer->stream;
+    int file_format = DEMUXER_TYPE_UNKNOWN;
 
-        if (time != EBML_UINT_INVALID && track != EBML_UINT_INVALID
-            && pos != EBML_UINT_INVALID) {
-            grow_array(&mkv_d->indexes, mkv_d->num_indexes,
-                       sizeof(mkv_index_t));
-            if (!mkv_d->indexes) {
-                mkv_d->num_indexes = 0;
-                break;
-            }
-            mkv_d->indexes[mkv_d->num_indexes].tnum = track;
-            mkv_d->indexes[mkv_d->num_indexes].timecode = time;
-            mkv_d->indexes[mkv_d->num_indexes].filepos = mkv_d->segment_start
-                                                         + pos;
-            mp_msg(MSGT_DEMUX, MSGL_DBG2,
-                   "[mkv] |+ found cue point " "for track %" PRIu64
-                   ": timecode %" PRIu64 ", filepos: %" PRIu64 "\n", track,
-                   time, mkv_d->segment_start + pos);
-            mkv_d->num_indexes++;
+    if (mkv_d->cues_pos || !s->url || !strcmp(s->url, "-")
+        || (s->flags & MP_STREAM_SEEK) != MP_STREAM_SEEK
+        || s->type != STREAMTYPE_FILE)
+        return 0;
+    mkv_d->cues_stream = open_stream(s->url, NULL, &file_format);
+    if (!mkv_d->cues_stream)
+        return 0;
+    mkv_d->cues_pos = off;
+    pthread_mutex_init(&mkv_d->cues_lock, NULL);
+    if (pthread_create(&mkv_d->cues_thread, NULL, demux_mkv_cues_thread,
+                       mkv_d)) {
+        pthread_mutex_destroy(&mkv_d->cues_lock);
+        free_stream(mkv_d->cues_stream);
+        mkv_d->cues_stream = NULL;
+        mkv_d->cues_pos = 0;
+        return 0;
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] reading cues in the background\n");
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/// \brief merge the cue points read by the thread so far
+static void demux_mkv_merge_cues(demuxer_t *demuxer)
+{
+#ifdef HAVE_PTHREADS
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    int i, done;
+
+    if (!mkv_d->cues_stream)
+        return;
+    pthread_mutex_lock(&mkv_d->cues_lock);
+    for (i = 0; i < mkv_d->num_cues_new; i++) {
+        mkv_index_t *e = mkv_d->cues_new + i;
+        // Cues are stored in time order, so everything before is known
+        if (e->timecode > mkv_d->indexed_tc)
+            mkv_d->indexed_tc = e->timecode;
+        add_cluster_position(mkv_d, e->filepos);
+        if (!add_index(&mkv_d->indexes, &mkv_d->num_indexes, e))
+            break;
+    }
+    mkv_d->num_cues_new = 0;
+    done = mkv_d->cues_done;
+    pthread_mutex_unlock(&mkv_d->cues_lock);
+    sort_indexes(mkv_d);
+    if (done) {
+        pthread_join(mkv_d->cues_thread, NULL);
+        pthread_mutex_destroy(&mkv_d->cues_lock);
+        free_stream(mkv_d->cues_stream);
+        free(mkv_d->cues_new);
+        mkv_d->cues_stream = NULL;
+        mkv_d->cues_new = NULL;
+        mkv_d->indexed_tc = UINT64_MAX;
+        mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] %d cue points read\n",
+               mkv_d->num_indexes);
+    }
+#endif
+}
+
+static void demux_mkv_stop_cues_thread(mkv_demuxer_t *mkv_d)
+{
+#ifdef HAVE_PTHREADS
+    if (!mkv_d->cues_stream)
+        return;
+    mkv_d->cues_abort = 1;
+    pthread_join(mkv_d->cues_thread, NULL);
+    pthread_mutex_destroy(&mkv_d->cues_lock);
+    free_stream(mkv_d->cues_stream);
+    free(mkv_d->cues_new);
+    mkv_d->cues_stream = NULL;
+#endif
+}
+
+/**
+ * \param background read the Cues in a thread if possible, for Cues that
+ *        are behind the clusters
+ */
+static int demux_mkv_read_cues(demuxer_t *demuxer, int background)
+{
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    stream_t *s = demuxer->stream;
+    mkv_index_t entry;
+    uint64_t length;
+    off_t off;
+    int i;
+
+    if (index_mode == 0) {
+        ebml_read_skip(s, NULL);
+        return 0;
+    }
+    off = stream_tell(s);
+    for (i = 0; i < mkv_d->parsed_cues_num; i++)
+        if (mkv_d->parsed_cues[i] == off) {
+            ebml_read_skip(s, NULL);
+            return 0;
         }
+    mkv_d->parsed_cues = realloc(mkv_d->parsed_cues,
+                                 (mkv_d->parsed_cues_num + 1) * sizeof(off_t));
+    mkv_d->parsed_cues[mkv_d->parsed_cues_num++] = off;
+
+    if (background && demux_mkv_start_cues_thread(demuxer, off)) {
+        ebml_read_skip(s, NULL);
+        return 0;
     }
 
+    mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] /---- [ parsing cues ] -----------\n");
+    length = ebml_read_length(s, NULL);
+
+    while (length > 0 && !s->eof) {
+        if (!demux_mkv_read_cuepoint(s, &length, &entry))
+            continue;
+        entry.filepos += mkv_d->segment_start;
+        if (!add_index(&mkv_d->indexes, &mkv_d->num_indexes, &entry))
+            break;
+    }
+    sort_indexes(mkv_d);
+    if (!mkv_d->cues_pos)
+        mkv_d->indexed_tc = UINT64_MAX;
+
     mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] \\---- [ parsing cues ] -----------\n");
     return 0;
 }
@@ -1350,7 +1627,8 @@ static int demux_mkv_read_seekhead(demuxer_t *demuxer)
             else
                 switch (seek_id) {
                 case MATROSKA_ID_CUES:
-                    if (demux_mkv_read_cues(demuxer))
+                    if (demux_mkv_read_cues(demuxer, mkv_d->segment_start
+                                            + seek_pos > saved_pos))
                         res = 1;
                     break;
 
@@ -1968,7 +2246,7 @@ static int demux_mkv_open(demuxer_t *demuxer)
             break;
 
         case MATROSKA_ID_CUES:
-            cont = demux_mkv_read_cues(demuxer);
+            cont = demux_mkv_read_cues(demuxer, 0);
             break;
 
         case MATROSKA_ID_TAGS:
@@ -2111,7 +2389,9 @@ static int demux_mkv_open(demuxer_t *demuxer)
         }
     }
 
-    if (s->end_pos == 0 || (mkv_d->indexes == NULL && index_mode < 0))
+    if (s->end_pos == 0
+        || (mkv_d->indexes == NULL && !mkv_d->cues_pos && index_mode < 0
+            && !index_cache))
         demuxer->seekable = 0;
     else {
         demuxer->movi_start = s->start_pos;
@@ -2119,6 +2399,10 @@ static int demux_mkv_open(demuxer_t *demuxer)
         demuxer->seekable = 1;
     }
 
+    /* without cues, remember where the clusters are for the next time */
+    if (mkv_d->indexes == NULL && !mkv_d->cues_pos)
+        seekidx_open(demuxer, 0);
+
     return DEMUXER_TYPE_MATROSKA;
 }
 
@@ -2134,6 +2418,7 @@ static void demux_close_mkv(demuxer_t *demuxer)
                 demux_mkv_free_trackentry(mkv_d->tracks[i]);
             free(mkv_d->tracks);
         }
+        demux_mkv_stop_cues_thread(mkv_d);
         free(mkv_d->indexes);
         free(mkv_d->cluster_positions);
         free(mkv_d->parsed_cues);
@@ -2428,7 +2713,8 @@ static void flush_cached_dps(demuxer_t *demuxer, mkv_track_t *track)
  *
  * \param demuxer The Matroska demuxer struct for this instance.
  * \param track The packet is meant for this track.
- * \param buffer The actual frame contents.
+ * \param bp The packet holding the whole block.
+ * \param buffer The actual frame contents, inside \a bp.
  * \param size The frame size in bytes.
  * \param block_bref A relative timecode (backward reference). If it is \c 0
  *   then the frame is an I frame.
@@ -2437,14 +2723,13 @@ static void flush_cached_dps(demuxer_t *demuxer, mkv_track_t *track)
  *   of \a block_bref. Otherwise it's a B frame.
  */
 static void handle_video_bframes(demuxer_t *demuxer, mkv_track_t *track,
-                                 uint8_t *buffer, uint32_t size,
-                                 int block_bref, int block_fref)
+                                 demux_packet_t *bp, uint8_t *buffer,
+                                 uint32_t size, int block_bref, int block_fref)
 {
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
     demux_packet_t *dp;
 
-    dp = new_demux_packet(size);
-    memcpy(dp->buffer, buffer, size);
+    dp = new_demux_packet_ref(bp, buffer, size);
     dp->pos = demuxer->filepos;
     dp->pts = mkv_d->last_pts;
     if ((track->num_cached_dps > 0) && (dp->pts < track->max_pts))
@@ -2465,11 +2750,13 @@ static void handle_video_bframes(demuxer_t *demuxer, mkv_track_t *track,
         track->max_pts = dp->pts;
 }
 
-static int handle_block(demuxer_t *demuxer, uint8_t *block, uint64_t length,
+static int handle_block(demuxer_t *demuxer, demux_packet_t *bp,
                         uint64_t block_duration, int64_t block_bref,
                         int64_t block_fref, uint8_t simpleblock)
 {
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    uint8_t *block = bp->buffer;
+    uint64_t length = bp->len;
     mkv_track_t *track = NULL;
     demux_stream_t *ds = NULL;
     uint64_t old_length;
@@ -2571,7 +2858,7 @@ static int handle_block(demuxer_t *demuxer, uint8_t *block, uint64_t length,
                 handle_realaudio(demuxer, track, block, lace_size[i],
                                  block_bref);
             else if (ds == demuxer->video && track->reorder_timecodes)
-                handle_video_bframes(demuxer, track, block, lace_size[i],
+                handle_video_bframes(demuxer, track, bp, block, lace_size[i],
                                      block_bref, block_fref);
             else {
                 int modified, size = lace_size[i];
@@ -2579,10 +2866,14 @@ static int handle_block(demuxer_t *demuxer, uint8_t *block, uint64_t length,
                 uint8_t *buffer;
                 modified = demux_mkv_decode(track, block, &buffer, &size, 1);
                 if (buffer) {
-                    dp = new_demux_packet(size);
-                    memcpy(dp->buffer, buffer, size);
-                    if (modified)
+                    // laces of the block are referenced, not copied, where
+                    // the zeroed padding of the block follows them
+                    if (modified) {
+                        dp = new_demux_packet(size);
+                        memcpy(dp->buffer, buffer, size);
                         free(buffer);
+                    } else
+                        dp = new_demux_packet_ref(bp, buffer, size);
                     dp->flags = (block_bref == 0
                                  && block_fref == 0) ? 0x10 : 0;
                     /* If default_duration is 0, assume no pts value is known
@@ -2622,14 +2913,15 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
         while (mkv_d->cluster_size > 0) {
             uint64_t block_duration = 0, block_length = 0;
             int64_t block_bref = 0, block_fref = 0;
-            uint8_t *block = NULL;
+            demux_packet_t *block = NULL;
 
             while (mkv_d->blockgroup_size > 0) {
                 switch (ebml_read_id(s, &il)) {
                 case MATROSKA_ID_BLOCKDURATION:
                     block_duration = ebml_read_uint(s, &l);
                     if (block_duration == EBML_UINT_INVALID) {
-                        free(block);
+                        if (block)
+                            free_demux_packet(block);
                         return 0;
                     }
                     block_duration *= mkv_d->tc_scale / 1000000.0;
@@ -2637,24 +2929,32 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
 
                 case MATROSKA_ID_BLOCK:
                     block_length = ebml_read_length(s, &tmp);
-                    free(block);
-                    if (block_length > SIZE_MAX - AV_LZO_INPUT_PADDING)
+                    if (block)
+                        free_demux_packet(block);
+                    block = NULL;
+                    // the packet padding covers AV_LZO_INPUT_PADDING
+                    if (block_length > INT_MAX - MP_INPUT_BUFFER_PADDING_SIZE)
                         return 0;
-                    block = malloc(block_length + AV_LZO_INPUT_PADDING);
+                    l = tmp + block_length;
+                    // no room for track number, timecode and flags
+                    if (block_length < 4) {
+                        stream_skip(s, block_length);
+                        break;
+                    }
                     demuxer->filepos = stream_tell(s);
-                    if (stream_read(s, block, block_length) !=
-                        (int) block_length) {
-                        free(block);
+                    block = demux_read_packet(demuxer, s, block_length);
+                    if (block->len != (int) block_length) {
+                        free_demux_packet(block);
                         return 0;
                     }
-                    l = tmp + block_length;
                     break;
 
                 case MATROSKA_ID_REFERENCEBLOCK:
                 {
                     int64_t num = ebml_read_int(s, &l);
                     if (num == EBML_INT_INVALID) {
-                        free(block);
+                        if (block)
+                            free_demux_packet(block);
                         return 0;
                     }
                     if (num <= 0)
@@ -2665,7 +2965,8 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
                 }
 
                 case EBML_ID_INVALID:
-                    free(block);
+                    if (block)
+                        free_demux_packet(block);
                     return 0;
 
                 default:
@@ -2677,10 +2978,9 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
             }
 
             if (block) {
-                int res = handle_block(demuxer, block, block_length,
-                                       block_duration, block_bref, block_fref,
-                                       0);
-                free(block);
+                int res = handle_block(demuxer, block, block_duration,
+                                       block_bref, block_fref, 0);
+                free_demux_packet(block);
                 if (res < 0)
                     return 0;
                 if (res)
@@ -2699,6 +2999,9 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
                         mkv_d->has_first_tc = 1;
                     }
                     mkv_d->cluster_tc = num * mkv_d->tc_scale;
+                    seekidx_add(demuxer, (mkv_d->cluster_tc / 1000000.0 -
+                                          mkv_d->first_tc) / 1000.0,
+                                mkv_d->cluster_start);
                     break;
                 }
 
@@ -2711,18 +3014,22 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
                 {
                     int res;
                     block_length = ebml_read_length(s, &tmp);
-                    block = malloc(block_length);
+                    if (block_length > INT_MAX - MP_INPUT_BUFFER_PADDING_SIZE)
+                        return 0;
+                    l = tmp + block_length;
+                    if (block_length < 4) {
+                        stream_skip(s, block_length);
+                        break;
+                    }
                     demuxer->filepos = stream_tell(s);
-                    if (stream_read(s, block, block_length) !=
-                        (int) block_length) {
-                        free(block);
+                    block = demux_read_packet(demuxer, s, block_length);
+                    if (block->len != (int) block_length) {
+                        free_demux_packet(block);
                         return 0;
                     }
-                    l = tmp + block_length;
-                    res = handle_block(demuxer, block, block_length,
-                                       block_duration, block_bref,
-                                       block_fref, 1);
-                    free(block);
+                    res = handle_block(demuxer, block, block_duration,
+                                       block_bref, block_fref, 1);
+                    free_demux_packet(block);
                     mkv_d->cluster_size -= l + il;
                     if (res < 0)
                         return 0;
@@ -2745,22 +3052,72 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer, demux_stream_t *ds)
 
         if (ebml_read_id(s, &il) != MATROSKA_ID_CLUSTER)
             return 0;
-        add_cluster_position(mkv_d, stream_tell(s) - il);
+        mkv_d->cluster_start = stream_tell(s) - il;
+        add_cluster_position(mkv_d, mkv_d->cluster_start);
         mkv_d->cluster_size = ebml_read_length(s, NULL);
     }
 
     return 0;
 }
 
+/**
+ * \brief find the next cluster at or after pos by scanning for its id
+ * \return position of the cluster, -1 if there is none before limit
+ */
+static off_t demux_mkv_find_cluster(demuxer_t *demuxer, off_t pos,
+                                    off_t limit)
+{
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    stream_t *s = demuxer->stream;
+    uint32_t id = 0;
+
+    if (!stream_seek(s, pos))
+        return -1;
+    while (!s->eof && stream_tell(s) < limit) {
+        id = id << 8 | stream_read_char(s);
+        if (id == MATROSKA_ID_CLUSTER) {
+            off_t cluster = stream_tell(s) - 4;
+            uint32_t child;
+
+            // a cluster starts with its timecode, which rules out most
+            // false matches in the middle of frame data
+            if (ebml_read_length(s, NULL) != EBML_UINT_INVALID) {
+                child = ebml_read_id(s, NULL);
+                if (child == MATROSKA_ID_CLUSTERTIMECODE
+                    || child == EBML_ID_VOID) {
+                    add_cluster_position(mkv_d, cluster);
+                    return cluster;
+                }
+            }
+            stream_seek(s, cluster + 4);
+            id = 0;
+        }
+    }
+    return -1;
+}
+
+/// \return 1 if the cues can be used to seek to target_timecode
+static int demux_mkv_index_usable(mkv_demuxer_t *mkv_d,
+                                  int64_t target_timecode)
+{
+    if (!mkv_d->indexes)
+        return 0;
+    if (mkv_d->indexed_tc == UINT64_MAX)
+        return 1;
+    return target_timecode + (int64_t) mkv_d->first_tc <=
+           (int64_t) (mkv_d->indexed_tc * mkv_d->tc_scale / 1000000.0);
+}
+
 static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
                            float audio_delay, int flags)
 {
     free_cached_dps(demuxer);
+    demux_mkv_merge_cues(demuxer);
     if (!(flags & SEEK_FACTOR)) {       /* time in secs */
         mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
         stream_t *s = demuxer->stream;
-        int64_t target_timecode = 0, diff, min_diff = 0xFFFFFFFFFFFFFFFLL;
-        int i;
+        int64_t target_timecode = 0;
+        int i, use_index;
 
         if (!(flags & SEEK_ABSOLUTE))   /* relative seek */
             target_timecode = (int64_t) (mkv_d->last_pts * 1000.0);
@@ -2768,7 +3125,8 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         if (target_timecode < 0)
             target_timecode = 0;
 
-        if (mkv_d->indexes == NULL) {   /* no index was found */
+        use_index = demux_mkv_index_usable(mkv_d, target_timecode);
+        if (!use_index) {               /* no index was found */
             uint64_t target_filepos, cluster_pos, max_pos;
 
             target_filepos =
@@ -2778,12 +3136,23 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
             max_pos = mkv_d->num_cluster_pos ?
                 mkv_d->cluster_positions[mkv_d->num_cluster_pos - 1] : 0;
             if (target_filepos > max_pos) {
-                if ((off_t) max_pos > stream_tell(s))
-                    stream_seek(s, max_pos);
-                else
-                    stream_seek(s, stream_tell(s) + mkv_d->cluster_size);
+                off_t pos = stream_tell(s), found = -1;
+
+                /* far away: jump there instead of parsing every cluster */
+                if (target_filepos - max_pos > MKV_RESYNC_RANGE)
+                    found = demux_mkv_find_cluster(demuxer, target_filepos,
+                                                   target_filepos +
+                                                   MKV_RESYNC_RANGE);
+                if (found < 0) {
+                    stream_seek(s, pos);
+                    if ((off_t) max_pos > stream_tell(s))
+                        stream_seek(s, max_pos);
+                    else
+                        stream_seek(s, stream_tell(s) + mkv_d->cluster_size);
+                }
                 /* parse all the clusters upto target_filepos */
-                while (!s->eof && stream_tell(s) < (off_t) target_filepos) {
+                while (found < 0 && !s->eof
+                       && stream_tell(s) < (off_t) target_filepos) {
                     switch (ebml_read_id(s, &i)) {
                     case MATROSKA_ID_CLUSTER:
                         add_cluster_position(mkv_d,
@@ -2791,67 +3160,69 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
                         break;
 
                     case MATROSKA_ID_CUES:
-                        demux_mkv_read_cues(demuxer);
+                        demux_mkv_read_cues(demuxer, 0);
                         break;
                     }
                     ebml_read_skip(s, NULL);
                 }
                 if (s->eof)
                     stream_reset(s);
+                use_index = demux_mkv_index_usable(mkv_d, target_timecode);
             }
 
-            if (mkv_d->indexes == NULL) {
-                cluster_pos = mkv_d->cluster_positions[0];
+            if (!use_index && mkv_d->num_cluster_pos) {
                 /* Let's find the nearest cluster */
-                for (i = 0; i < mkv_d->num_cluster_pos; i++) {
-                    diff = mkv_d->cluster_positions[i] - target_filepos;
-                    if (rel_seek_secs < 0 && diff < 0 && -diff < min_diff) {
-                        cluster_pos = mkv_d->cluster_positions[i];
-                        min_diff = -diff;
-                    } else if (rel_seek_secs > 0
-                               && (diff < 0 ? -1 * diff : diff) < min_diff) {
-                        cluster_pos = mkv_d->cluster_positions[i];
-                        min_diff = diff < 0 ? -1 * diff : diff;
-                    }
+                int n = find_cluster_position(mkv_d, target_filepos);
+                uint64_t *pos = mkv_d->cluster_positions;
+
+                cluster_pos = pos[0];
+                if (rel_seek_secs < 0) {
+                    if (n > 0)
+                        cluster_pos = pos[n - 1];
+                } else if (rel_seek_secs > 0) {
+                    if (n == mkv_d->num_cluster_pos
+                        || (n > 0 && target_filepos - pos[n - 1] <=
+                                     pos[n] - target_filepos))
+                        cluster_pos = pos[n - 1];
+                    else
+                        cluster_pos = pos[n];
                 }
                 mkv_d->cluster_size = mkv_d->blockgroup_size = 0;
                 stream_seek(s, cluster_pos);
             }
-        } else {
+        }
+        if (use_index) {
             mkv_index_t *index = NULL;
             int seek_id = (demuxer->video->id < 0) ?
                 demuxer->audio->id : demuxer->video->id;
+            int64_t target = target_timecode + mkv_d->first_tc;
+            int start, end, n;
 
             /* let's find the entry in the indexes with the smallest */
             /* difference to the wanted timecode. */
-            for (i = 0; i < mkv_d->num_indexes; i++)
-                if (mkv_d->indexes[i].tnum == seek_id) {
-                    diff =
-                        target_timecode + mkv_d->first_tc -
-                        (int64_t) mkv_d->indexes[i].timecode *
-                        mkv_d->tc_scale / 1000000.0;
-
-                    if ((flags & SEEK_ABSOLUTE
-                         || target_timecode <= mkv_d->last_pts * 1000)) {
-                        // Absolute seek or seek backward: find the last index
-                        // position before target time
-                        if (diff < 0 || diff >= min_diff)
-                            continue;
-                    } else {
-                        // Relative seek forward: find the first index position
-                        // after target time. If no such index exists, find last
-                        // position between current position and target time.
-                        if (diff <= 0) {
-                            if (min_diff <= 0 && diff <= min_diff)
-                                continue;
-                        } else if (diff >=
-                                   FFMIN(target_timecode - mkv_d->last_pts,
-                                         min_diff))
-                            continue;
-                    }
-                    min_diff = diff;
-                    index = mkv_d->indexes + i;
+            start = find_track_indexes(mkv_d, seek_id, &end);
+            if (flags & SEEK_ABSOLUTE
+                || target_timecode <= mkv_d->last_pts * 1000) {
+                // Absolute seek or seek backward: find the last index
+                // position before target time
+                n = find_index_time(mkv_d, start, end, target + 1);
+                if (n > start)
+                    index = mkv_d->indexes + n - 1;
+            } else {
+                // Relative seek forward: find the first index position
+                // after target time. If no such index exists, find last
+                // position between current position and target time.
+                n = find_index_time(mkv_d, start, end, target);
+                if (n < end)
+                    index = mkv_d->indexes + n;
+                else if (n > start) {
+                    int64_t diff = target -
+                        (int64_t) (mkv_d->indexes[n - 1].timecode *
+                                   mkv_d->tc_scale / 1000000.0);
+                    if (diff < target_timecode - mkv_d->last_pts)
+                        index = mkv_d->indexes + n - 1;
                 }
+            }
 
             if (index) {        /* We've found an entry. */
                 mkv_d->cluster_size = mkv_d->blockgroup_size = 0;
@@ -2872,8 +3243,8 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
         stream_t *s = demuxer->stream;
         uint64_t target_filepos;
-        mkv_index_t *index = NULL;
-        int i;
+        mkv_index_t *index;
+        int start, end, lo, hi;
 
         if (mkv_d->indexes == NULL) {   /* no index was found *//* I'm lazy... */
             mp_msg(MSGT_DEMUX, MSGL_V, "[mkv] seek unsupported flags\n");
@@ -2881,16 +3252,20 @@ static void demux_mkv_seek(demuxer_t *demuxer, float rel_seek_secs,
         }
 
         target_filepos = (uint64_t) (demuxer->movi_end * rel_seek_secs);
-        for (i = 0; i < mkv_d->num_indexes; i++)
-            if (mkv_d->indexes[i].tnum == demuxer->video->id)
-                if ((index == NULL)
-                    || ((mkv_d->indexes[i].filepos >= target_filepos)
-                        && ((index->filepos < target_filepos)
-                            || (mkv_d->indexes[i].filepos < index->filepos))))
-                    index = &mkv_d->indexes[i];
-
-        if (!index)
+        start = find_track_indexes(mkv_d, demuxer->video->id, &end);
+        if (start == end)
             return;
+        /* clusters are stored in time order, so filepos is sorted too */
+        lo = start;
+        hi = end;
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+            if (mkv_d->indexes[mid].filepos < target_filepos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        index = mkv_d->indexes + (lo < end ? lo : end - 1);
 
         mkv_d->cluster_size = mkv_d->blockgroup_size = 0;
         stream_seek(s, index->filepos);
@@ -2926,6 +3301,20 @@ static int demux_mkv_control(demuxer_t *demuxer, int cmd, void *arg)
         *((int *) arg) = (int) (100 * mkv_d->last_pts / mkv_d->duration);
         return DEMUXER_CTRL_OK;
 
+    case DEMUXER_CTRL_SEEK_POS:
+    {
+        demux_seek_pos_t *sp = arg;
+
+        free_cached_dps(demuxer);
+        mkv_d->cluster_size = mkv_d->blockgroup_size = 0;
+        stream_seek(demuxer->stream, sp->pos);
+        if (demuxer->video->id >= 0)
+            mkv_d->v_skip_to_keyframe = 1;
+        mkv_d->a_skip_to_keyframe = 1;
+        demux_mkv_fill_buffer(demuxer, NULL);
+        return DEMUXER_CTRL_OK;
+    }
+
     case DEMUXER_CTRL_SWITCH_AUDIO:
         if (demuxer->audio && demuxer->audio->sh) {
             sh_audio_t *sh = demuxer->a_streams[demuxer->audio->id];
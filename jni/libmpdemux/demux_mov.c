@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <math.h>
 
 #include "config.h"
 
@@ -82,12 +83,6 @@
 #define char2short(x,y)	AV_RB16(&(x)[(y)])
 #define char2int(x,y) 	AV_RB32(&(x)[(y)])
 
-typedef struct {
-    unsigned int pts; // duration
-    unsigned int size;
-    off_t pos;
-} mov_sample_t;
-
 typedef struct {
     unsigned int sample; // number of the first sample in the chunk
     unsigned int size;   // number of samples in the chunk
@@ -104,6 +99,8 @@ typedef struct {
 typedef struct {
     unsigned int num;
     unsigned int dur;
+    unsigned int sample; // number of the first sample in the run
+    unsigned int pts;    // pts of that sample
 } mov_durmap_t;
 
 typedef struct {
@@ -149,8 +146,18 @@ typedef struct {
     unsigned char* stream_header;
     int stream_header_len; // if >0, this header should be sent before the 1st frame
     //
-    int samples_size;
-    mov_sample_t* samples;
+    // Sample index: positions and pts are derived on demand from the
+    // chunk and duration tables instead of being stored per sample.
+    int samples_size;      // number of samples
+    int sizes_size;        // entries in the sample size table
+    off_t sizes_pos;       // where to load it from, -1 once loaded
+    uint16_t* sizes16;     // sample sizes if they all fit 16 bits
+    uint32_t* sizes32;     // otherwise
+    unsigned int fixed_size; // size of every sample if there is no table
+    int indexed;           // mov_index_track() has been run
+    int cur_sample;        // last sample located by mov_sample_pos()
+    int cur_chunk;
+    off_t cur_pos;
     int chunks_size;
     mov_chunk_t* chunks;
     int chunkmap_size;
@@ -166,60 +173,174 @@ typedef struct {
     void* desc; // image/sound/etc description (pointer to ImageDescription etc)
 } mov_track_t;
 
-static void mov_build_index(mov_track_t* trak,int timescale){
-    int i,j,s;
-    int last=trak->chunks_size;
-    unsigned int pts=0;
+#define MOV_MAX_TRACKS 256
+#define MOV_MAX_SUBLEN 1024
 
-#if 0
-    if (trak->chunks_size <= 0)
-    {
-	mp_msg(MSGT_DEMUX, MSGL_WARN, "No chunk offset table, trying to build one!\n");
+typedef struct {
+    off_t moov_start;
+    off_t moov_end;
+    off_t mdat_start;
+    off_t mdat_end;
+    int track_db;
+    mov_track_t* tracks[MOV_MAX_TRACKS];
+    int timescale; // movie timescale
+    int duration;  // movie duration (in movie timescale units)
+    subtitle subs;
+    char subtext[MOV_MAX_SUBLEN + 1];
+    int current_sub;
+} mov_priv_t;
 
-	trak->chunks_size = trak->samples_size; /* XXX: FIXME ! */
-	// audit: this code will be vulnerable if it is reenabled (currently #if 0)
-	trak->chunks = realloc(trak->chunks, sizeof(mov_chunk_t)*trak->chunks_size);
+static unsigned int mov_sample_size(mov_track_t* trak, int sample){
+    if (sample < 0 || sample >= trak->sizes_size)
+        return trak->fixed_size;
+    return trak->sizes16 ? trak->sizes16[sample] : trak->sizes32[sample];
+}
 
-	for (i=0; i < trak->chunks_size; i++)
-	    trak->chunks[i].pos = -1;
+/// Read the stsz entries, narrowed to 16 bits unless a sample is bigger.
+static void mov_read_sizes(stream_t* s, mov_track_t* trak){
+    int i, j;
+    trak->sizes16 = realloc_struct(NULL, trak->sizes_size, sizeof(uint16_t));
+    if (!trak->sizes16) {
+        trak->sizes_size = 0;
+        return;
     }
-#endif
+    for (i = 0; i < trak->sizes_size; i++) {
+        unsigned int size = stream_read_dword(s);
+        if (size > 0xffff && !trak->sizes32) {
+            trak->sizes32 = realloc_struct(NULL, trak->sizes_size, sizeof(uint32_t));
+            if (!trak->sizes32) {
+                trak->sizes_size = i;
+                return;
+            }
+            for (j = 0; j < i; j++)
+                trak->sizes32[j] = trak->sizes16[j];
+            free(trak->sizes16);
+            trak->sizes16 = NULL;
+        }
+        if (trak->sizes32)
+            trak->sizes32[i] = size;
+        else
+            trak->sizes16[i] = size;
+    }
+}
 
-    mp_msg(MSGT_DEMUX, MSGL_V, "MOV track #%d: %d chunks, %d samples\n",trak->id,trak->chunks_size,trak->samples_size);
-    mp_msg(MSGT_DEMUX, MSGL_V, "pts=%d  scale=%d  time=%5.3f\n",trak->length,trak->timescale,(float)trak->length/(float)trak->timescale);
+/// \return the pts of a sample, extrapolated past the end of the stts table
+static unsigned int mov_sample_pts(mov_track_t* trak, int sample){
+    int lo = 0, hi = trak->durmap_size - 1;
+    mov_durmap_t* run;
+    if (hi < 0 || sample < 0)
+        return 0;
+    // last run starting at or before sample
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (trak->durmap[mid].sample <= sample)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    run = &trak->durmap[lo];
+    return run->pts + (sample - run->sample) * run->dur;
+}
 
-    // process chunkmap:
-    i=trak->chunkmap_size;
-    while(i>0){
-	--i;
-	j=trak->chunkmap[i].first;
-	for(;j>=0 && j<last;j++){
-	    trak->chunks[j].desc=trak->chunkmap[i].sdid;
-	    trak->chunks[j].size=trak->chunkmap[i].spc;
-	}
-	last=FFMIN(trak->chunkmap[i].first, trak->chunks_size);
+/// \return the first sample with pts >= ipts, samples_size if there is none
+static int mov_pts_to_sample(mov_track_t* trak, unsigned int ipts){
+    int lo = 0, hi = trak->durmap_size;
+    mov_durmap_t* run;
+    int sample;
+    // first run whose last sample is at or after ipts
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        run = &trak->durmap[mid];
+        if (run->pts + (run->num - 1) * run->dur >= ipts)
+            hi = mid;
+        else
+            lo = mid + 1;
     }
+    if (lo == trak->durmap_size)
+        return trak->samples_size;
+    run = &trak->durmap[lo];
+    sample = run->sample;
+    if (ipts > run->pts)
+        sample += (ipts - run->pts + run->dur - 1) / run->dur;
+    return FFMIN(sample, trak->samples_size);
+}
 
-#if 0
-    for (i=0; i < trak->chunks_size; i++)
-    {
-	/* fixup position */
-	if (trak->chunks[i].pos == -1)
-	    if (i > 0)
-		trak->chunks[i].pos = trak->chunks[i-1].pos + trak->chunks[i-1].size;
-	    else
-		trak->chunks[i].pos = 0; /* FIXME: set initial pos */
-#endif
+/// \return the first chunk with a sample number >= sample
+static int mov_sample_to_chunk(mov_track_t* trak, unsigned int sample){
+    int lo = 0, hi = trak->chunks_size;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (trak->chunks[mid].sample >= sample)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
 
-    // calc pts of chunks:
+/**
+ * \return file position of a sample, -1 if no chunk contains it
+ * Sequential access is O(1), random access a binary search over the
+ * chunks plus a walk over the preceding samples of the same chunk.
+ */
+static off_t mov_sample_pos(mov_track_t* trak, int sample){
+    mov_chunk_t* c = trak->cur_chunk >= 0 ? &trak->chunks[trak->cur_chunk] : NULL;
+    off_t pos;
+    int s;
+    if (c && sample == trak->cur_sample + 1 && sample < c->sample + c->size) {
+        pos = trak->cur_pos + mov_sample_size(trak, trak->cur_sample);
+    } else {
+        // last chunk starting at or before sample, skipping empty chunks
+        int i = mov_sample_to_chunk(trak, sample + 1) - 1;
+        if (i < 0 || sample >= trak->chunks[i].sample + trak->chunks[i].size)
+            return -1;
+        c = &trak->chunks[i];
+        pos = c->pos;
+        for (s = c->sample; s < sample; s++)
+            pos += mov_sample_size(trak, s);
+        trak->cur_chunk = i;
+    }
+    trak->cur_sample = sample;
+    trak->cur_pos = pos;
+    return pos;
+}
+
+/**
+ * Cheap per-track setup done while parsing the header: sample count,
+ * cumulative stts runs and the constant sample size cases. Everything
+ * that grows with the number of chunks or samples is left to
+ * mov_index_track(), which runs only for tracks that get played.
+ */
+static void mov_build_index(mov_track_t* trak){
+    int i,j,s;
+    unsigned int pts=0;
+
+    mp_msg(MSGT_DEMUX, MSGL_V, "MOV track #%d: %d chunks, %d samples\n",trak->id,trak->chunks_size,trak->sizes_size);
+    mp_msg(MSGT_DEMUX, MSGL_V, "pts=%d  scale=%d  time=%5.3f\n",trak->length,trak->timescale,(float)trak->length/(float)trak->timescale);
+
+    trak->cur_chunk = -1;
+    // count samples in the chunkmap:
     s=0;
-    for(j=0;j<trak->chunks_size;j++){
-        trak->chunks[j].sample=s;
-        s+=trak->chunks[j].size;
+    for(i=0;i<trak->chunkmap_size;i++){
+	int first=trak->chunkmap[i].first;
+	int last=i+1<trak->chunkmap_size ? trak->chunkmap[i+1].first : trak->chunks_size;
+	first=FFMAX(first,0);
+	last=FFMIN(last,trak->chunks_size);
+	if(last>first) s+=(last-first)*trak->chunkmap[i].spc;
     }
-    i = 0;
-    for (j = 0; j < trak->durmap_size; j++)
-      i += trak->durmap[j].num;
+
+    // cumulative duration runs, empty runs dropped so they stay sorted:
+    j=0;
+    for(i=0;i<trak->durmap_size;i++){
+	if(!trak->durmap[i].num) continue;
+	trak->durmap[j]=trak->durmap[i];
+	trak->durmap[j].sample=j ? trak->durmap[j-1].sample+trak->durmap[j-1].num : 0;
+	trak->durmap[j].pts=pts;
+	pts+=trak->durmap[j].num*trak->durmap[j].dur;
+	j++;
+    }
+    trak->durmap_size=j;
+    i = j ? trak->durmap[j-1].sample+trak->durmap[j-1].num : 0;
     if (i != s) {
       mp_msg(MSGT_DEMUX, MSGL_WARN,
              "MOV: durmap and chunkmap sample count differ (%i vs %i)\n", i, s);
@@ -227,66 +348,72 @@ static void mov_build_index(mov_track_t* trak,int timescale){
     }
 
     // workaround for fixed-size video frames (dv and uncompressed)
-    if(!trak->samples_size && trak->type!=MOV_TRAK_AUDIO){
-	trak->samples=calloc(s, sizeof(mov_sample_t));
-	trak->samples_size=trak->samples ? s : 0;
-	for(i=0;i<trak->samples_size;i++)
-	    trak->samples[i].size=trak->samplesize;
+    if(!trak->sizes_size && trak->type!=MOV_TRAK_AUDIO){
+	trak->fixed_size=trak->samplesize;
+	trak->samples_size=s;
 	trak->samplesize=0;
     }
 
-    if(!trak->samples_size){
+    if(!trak->sizes_size && !trak->fixed_size){
 	// constant sampesize
+	trak->samples_size=0;
 	if(trak->durmap_size==1 || (trak->durmap_size==2 && trak->durmap[1].num==1)){
 	    trak->duration=trak->durmap[0].dur;
 	} else mp_msg(MSGT_DEMUX, MSGL_ERR, "*** constant samplesize & variable duration not yet supported! ***\nContact the author if you have such sample file!\n");
 	return;
     }
 
-    if (trak->samples_size < s) {
+    if (trak->sizes_size && trak->sizes_size < s)
       mp_msg(MSGT_DEMUX, MSGL_WARN,
              "MOV: durmap or chunkmap bigger than sample count (%i vs %i)\n",
-             s, trak->samples_size);
-      trak->samples = realloc_struct(trak->samples, s, sizeof(mov_sample_t));
-      trak->samples_size = trak->samples ? s : 0;
+             s, trak->sizes_size);
+    trak->samples_size = FFMAX(s, trak->sizes_size);
+}
+
+/**
+ * Finish the index of a track the first time it is read or seeked:
+ * load deferred sample sizes, number the chunks and resolve edit lists.
+ */
+static void mov_index_track(demuxer_t* demuxer, mov_track_t* trak){
+    mov_priv_t* priv=demuxer->priv;
+    int i,j,s;
+    int last=trak->chunks_size;
+
+    if(trak->indexed) return;
+    trak->indexed=1;
+
+    if(trak->sizes_pos>=0 && trak->sizes_size){
+	stream_seek(demuxer->stream,trak->sizes_pos);
+	mov_read_sizes(demuxer->stream,trak);
     }
+    trak->sizes_pos=-1;
 
-    // calc pts:
-    s=0;
-    for(j=0;j<trak->durmap_size;j++){
-	for(i=0;i<trak->durmap[j].num;i++){
-	    if (s >= trak->samples_size)
-		break;
-	    trak->samples[s].pts=pts;
-	    ++s;
-	    pts+=trak->durmap[j].dur;
+    // process chunkmap:
+    i=trak->chunkmap_size;
+    while(i>0){
+	--i;
+	j=trak->chunkmap[i].first;
+	for(;j>=0 && j<last;j++){
+	    trak->chunks[j].desc=trak->chunkmap[i].sdid;
+	    trak->chunks[j].size=trak->chunkmap[i].spc;
 	}
+	last=FFMIN(trak->chunkmap[i].first, trak->chunks_size);
     }
 
-    // calc sample offsets
+    // calc pts of chunks:
     s=0;
     for(j=0;j<trak->chunks_size;j++){
-	off_t pos=trak->chunks[j].pos;
-	for(i=0;i<trak->chunks[j].size;i++){
-	    if (s >= trak->samples_size)
-		break;
-	    trak->samples[s].pos=pos;
-	    mp_msg(MSGT_DEMUX, MSGL_DBG3, "Sample %5d: pts=%8d  off=0x%08X  size=%d\n",s,
-		trak->samples[s].pts,
-		(int)trak->samples[s].pos,
-		trak->samples[s].size);
-	    pos+=trak->samples[s].size;
-	    ++s;
-	}
+        trak->chunks[j].sample=s;
+        s+=trak->chunks[j].size;
     }
 
     // precalc editlist entries
-    if(trak->editlist_size>0){
+    if(trak->editlist_size>0 && trak->samples_size){
 	int frame=0;
 	int e_pts=0;
 	for(i=0;i<trak->editlist_size;i++){
 	    mov_editlist_t* el=&trak->editlist[i];
-	    int sample=0;
+	    int sample;
 	    int pts=el->pos;
 	    el->start_frame=frame;
 	    if(pts<0){
@@ -294,43 +421,22 @@ static void mov_build_index(mov_track_t* trak,int timescale){
 		el->frames=0; continue;
 	    }
 	    // find start sample
-	    for(;sample<trak->samples_size;sample++){
-		if(pts<=trak->samples[sample].pts) break;
-	    }
+	    sample=mov_pts_to_sample(trak,pts);
 	    el->start_sample=sample;
-	    el->pts_offset=((long long)e_pts*(long long)trak->timescale)/(long long)timescale-trak->samples[sample].pts;
-	    pts+=((long long)el->dur*(long long)trak->timescale)/(long long)timescale;
+	    el->pts_offset=((long long)e_pts*(long long)trak->timescale)/(long long)priv->timescale-mov_sample_pts(trak,sample);
+	    pts+=((long long)el->dur*(long long)trak->timescale)/(long long)priv->timescale;
 	    e_pts+=el->dur;
 	    // find end sample
-	    for(;sample<trak->samples_size;sample++){
-		if(pts<trak->samples[sample].pts) break;
-	    }
+	    sample=FFMAX(sample,mov_pts_to_sample(trak,pts+1));
 	    el->frames=sample-el->start_sample;
 	    frame+=el->frames;
 	    mp_msg(MSGT_DEMUX,MSGL_V,"EL#%d: pts=%d  1st_sample=%d  frames=%d (%5.3fs)  pts_offs=%d\n",i,
 		el->pos,el->start_sample, el->frames,
-		(float)(el->dur)/(float)timescale, el->pts_offset);
+		(float)(el->dur)/(float)priv->timescale, el->pts_offset);
 	}
     }
-
 }
 
-#define MOV_MAX_TRACKS 256
-#define MOV_MAX_SUBLEN 1024
-
-typedef struct {
-    off_t moov_start;
-    off_t moov_end;
-    off_t mdat_start;
-    off_t mdat_end;
-    int track_db;
-    mov_track_t* tracks[MOV_MAX_TRACKS];
-    int timescale; // movie timescale
-    int duration;  // movie duration (in movie timescale units)
-    subtitle subs;
-    char subtext[MOV_MAX_SUBLEN + 1];
-    int current_sub;
-} mov_priv_t;
 
 #define MOV_FOURCC(a,b,c,d) ((a<<24)|(b<<16)|(c<<8)|(d))
 
@@ -558,7 +664,8 @@ static void demux_close_mov(demuxer_t *demuxer) {
       free(track->tkdata);
       free(track->stdata);
       free(track->stream_header);
-      free(track->samples);
+      free(track->sizes16);
+      free(track->sizes32);
       free(track->chunks);
       free(track->chunkmap);
       free(track->durmap);
@@ -1335,7 +1442,7 @@ static void lschunks(demuxer_t* demuxer,int level,off_t endpos,mov_track_t* trak
 	    trak->id=priv->track_db;
 	    priv->tracks[priv->track_db]=trak;
 	    lschunks(demuxer,level+1,pos+len,trak);
-	    mov_build_index(trak,priv->timescale);
+	    mov_build_index(trak);
 	    switch(trak->type){
 	    case MOV_TRAK_AUDIO: {
 		sh_audio_t* sh=new_sh_audio(demuxer,priv->track_db, NULL);
@@ -1375,12 +1482,12 @@ static void lschunks(demuxer_t* demuxer,int level,off_t endpos,mov_track_t* trak
 
 		for (i=0; i<trak->samples_size; i++)
 		{
-		    char buf[trak->samples[i].size];
-		    stream_seek(demuxer->stream, trak->samples[i].pos);
+		    char buf[mov_sample_size(trak, i)];
+		    stream_seek(demuxer->stream, mov_sample_pos(trak, i));
 		    snprintf((char *)&name[0], 20, "samp%d", i);
 		    fd = open((char *)&name[0], O_CREAT|O_WRONLY);
-		    stream_read(demuxer->stream, &buf[0], trak->samples[i].size);
-		    write(fd, &buf[0], trak->samples[i].size);
+		    stream_read(demuxer->stream, &buf[0], mov_sample_size(trak, i));
+		    write(fd, &buf[0], mov_sample_size(trak, i));
 		    close(fd);
 		 }
 		for (i=0; i<trak->chunks_size; i++)
@@ -1810,17 +1917,21 @@ static int lschunks_intrak(demuxer_t* demuxer, int level, unsigned int id,
       int ver = (temp << 24);
       int flags = (temp << 16) | (temp << 8) | temp;
       int entries = stream_read_dword(demuxer->stream);
-      int i;
       mp_msg(MSGT_DEMUX, MSGL_V,
              "MOV: %*sSample size table! (entries=%d ss=%d) (ver:%d,flags:%d)\n", level, "",
              entries, ss, ver, flags);
       trak->samplesize = ss;
-      if (!ss) {
-        // variable samplesize
-        trak->samples = realloc_struct(trak->samples, entries, sizeof(mov_sample_t));
-        trak->samples_size = entries;
-        for (i = 0; i < trak->samples_size; i++)
-          trak->samples[i].size = stream_read_dword(demuxer->stream);
+      if (!ss && entries > 0) {
+        // variable samplesize, loaded when the track is first used if
+        // seeking back to it is cheap: only local files, not a decompressed
+        // header that will be gone by then, nor network or linear streams
+        trak->sizes_size = entries;
+        trak->sizes_pos = stream_tell(demuxer->stream);
+        if (demuxer->stream->type != STREAMTYPE_FILE ||
+            !(demuxer->stream->flags & MP_STREAM_SEEK_BW)) {
+          mov_read_sizes(demuxer->stream, trak);
+          trak->sizes_pos = -1;
+        }
       }
       break;
     }
@@ -2033,9 +2144,9 @@ static demuxer_t* mov_read_header(demuxer_t* demuxer){
 		mp_msg(MSGT_DEMUX, MSGL_INFO, "MOV: Track #%d: Extracting %d data chunks to files\n",t_no,trak->samples_size);
 		for (i=0; i<trak->samples_size; i++)
 		{
-		    int len=trak->samples[i].size;
+		    int len=mov_sample_size(trak, i);
 		    char buf[len];
-		    stream_seek(demuxer->stream, trak->samples[i].pos);
+		    stream_seek(demuxer->stream, mov_sample_pos(trak, i));
 		    snprintf(name, 20, "t%02d-s%03d.%s", t_no,i,
 			(trak->media_handler==MOV_FOURCC('f','l','s','h')) ?
 			    "swf":"dump");
@@ -2118,6 +2229,7 @@ static int demux_mov_fill_buffer(demuxer_t *demuxer,demux_stream_t* ds){
     if (ds->eof) return 0;
     trak = stream_track(priv, ds);
     if (!trak) return 0;
+    mov_index_track(demuxer, trak);
 
 if(trak->samplesize){
     // read chunk:
@@ -2172,16 +2284,17 @@ if(trak->samplesize){
 	frame-=trak->editlist[trak->editlist_pos].start_frame;
 	frame+=trak->editlist[trak->editlist_pos].start_sample;
 	// calc pts:
-	pts=(float)(trak->samples[frame].pts+
+	pts=(float)(mov_sample_pts(trak,frame)+
 	    trak->editlist[trak->editlist_pos].pts_offset)/(float)trak->timescale;
     } else {
 	if(frame>=trak->samples_size) return 0; // EOF
-	pts=(float)trak->samples[frame].pts/(float)trak->timescale;
+	pts=(float)mov_sample_pts(trak,frame)/(float)trak->timescale;
     }
     // read sample:
-    stream_seek(demuxer->stream,trak->samples[frame].pos);
-    x=trak->samples[frame].size;
-    pos=trak->samples[frame].pos;
+    pos=mov_sample_pos(trak,frame);
+    if(pos<0) return 0; // not covered by any chunk
+    stream_seek(demuxer->stream,pos);
+    x=mov_sample_size(trak,frame);
 }
 if(trak->pos==0 && trak->stream_header_len>0){
     // we have to append the stream header...
@@ -2204,21 +2317,21 @@ if(trak->pos==0 && trak->stream_header_len>0){
     if (demuxer->sub->id >= 0 && demuxer->sub->id < priv->track_db)
       trak = priv->tracks[demuxer->sub->id];
     if (trak) {
-      int samplenr = 0;
-      while (samplenr < trak->samples_size) {
-        double subpts = (double)trak->samples[samplenr].pts / (double)trak->timescale;
-        if (subpts >= pts) break;
-        samplenr++;
-      }
+      // last subtitle sample starting before pts
+      int samplenr;
+      mov_index_track(demuxer, trak);
+      samplenr = mov_pts_to_sample(trak, pts > 0 ? ceil(pts * trak->timescale) : 0);
       samplenr--;
       if (samplenr < 0)
         vo_sub = NULL;
       else if (samplenr != priv->current_sub) {
-        off_t pos = trak->samples[samplenr].pos;
-        int len = trak->samples[samplenr].size;
-        double subpts = (double)trak->samples[samplenr].pts / (double)trak->timescale;
-        stream_seek(demuxer->stream, pos);
-        ds_read_packet(demuxer->sub, demuxer->stream, len, subpts, pos, 0);
+        off_t pos = mov_sample_pos(trak, samplenr);
+        int len = mov_sample_size(trak, samplenr);
+        double subpts = (double)mov_sample_pts(trak, samplenr) / (double)trak->timescale;
+        if (pos >= 0) {
+          stream_seek(demuxer->stream, pos);
+          ds_read_packet(demuxer->sub, demuxer->stream, len, subpts, pos, 0);
+        }
         priv->current_sub = samplenr;
       }
     }
@@ -2235,26 +2348,25 @@ static float mov_seek_track(mov_track_t* trak,float pts,int flags){
 if(trak->samplesize){
     int sample=pts/trak->duration;
 //    printf("MOV track seek - chunk: %d  (pts: %5.3f  dur=%d)  \n",sample,pts,trak->duration);
-    if(!(flags&SEEK_ABSOLUTE)) sample+=trak->chunks[trak->pos].sample; // relative
-    trak->pos=0;
-    while(trak->pos<trak->chunks_size && trak->chunks[trak->pos].sample<sample) ++trak->pos;
+    if(!(flags&SEEK_ABSOLUTE) && trak->pos<trak->chunks_size)
+	sample+=trak->chunks[trak->pos].sample; // relative
+    trak->pos=mov_sample_to_chunk(trak,FFMAX(sample,0));
     if (trak->pos == trak->chunks_size) return -1;
     pts=(float)(trak->chunks[trak->pos].sample*trak->duration)/(float)trak->timescale;
 } else {
     unsigned int ipts;
-    if(!(flags&SEEK_ABSOLUTE)) pts+=trak->samples[trak->pos].pts;
+    if(!(flags&SEEK_ABSOLUTE)) pts+=mov_sample_pts(trak,trak->pos);
     if(pts<0) pts=0;
     ipts=pts;
     //printf("MOV track seek - sample: %d  \n",ipts);
-    for(trak->pos=0;trak->pos<trak->samples_size;++trak->pos){
-	if(trak->samples[trak->pos].pts>=ipts) break; // found it!
-    }
+    trak->pos=mov_pts_to_sample(trak,ipts);
     if (trak->pos == trak->samples_size) return -1;
     if(trak->keyframes_size){
-	// find nearest keyframe
-	int i;
-	for(i=0;i<trak->keyframes_size;i++){
-	    if(trak->keyframes[i]>=trak->pos) break;
+	// find nearest keyframe, stss is sorted
+	int i=0, hi=trak->keyframes_size;
+	while(i<hi){
+	    int mid=(i+hi)>>1;
+	    if(trak->keyframes[mid]>=trak->pos) hi=mid; else i=mid+1;
 	}
 	if (i == trak->keyframes_size) return -1;
 	if(i>0 && (trak->keyframes[i]-trak->pos) > (trak->pos-trak->keyframes[i-1]))
@@ -2262,7 +2374,7 @@ if(trak->samplesize){
 	trak->pos=trak->keyframes[i];
 //	printf("nearest keyframe: %d  \n",trak->pos);
     }
-    pts=(float)trak->samples[trak->pos].pts/(float)trak->timescale;
+    pts=(float)mov_sample_pts(trak,trak->pos)/(float)trak->timescale;
 }
 
 //    printf("MOV track seek done:  %5.3f  \n",pts);
@@ -2280,6 +2392,7 @@ static void demux_seek_mov(demuxer_t *demuxer,float pts,float audio_delay,int fl
     ds=demuxer->video;
     trak = stream_track(priv, ds);
     if (trak) {
+	mov_index_track(demuxer, trak);
 	//if(flags&2) pts*=(float)trak->length/(float)trak->timescale;
 	//if(!(flags&1)) pts+=ds->pts;
 	ds->pts=mov_seek_track(trak,pts,flags);
@@ -2291,6 +2404,7 @@ static void demux_seek_mov(demuxer_t *demuxer,float pts,float audio_delay,int fl
     ds=demuxer->audio;
     trak = stream_track(priv, ds);
     if (trak) {
+	mov_index_track(demuxer, trak);
 	//if(flags&2) pts*=(float)trak->length/(float)trak->timescale;
 	//if(!(flags&1)) pts+=ds->pts;
 	ds->pts=mov_seek_track(trak,pts,flags);
@@ -34,6 +34,7 @@
 #include "stheader.h"
 #include "mp3_hdr.h"
 #include "demux_mpg.h"
+#include "seekidx.h"
 
 //#define MAX_PS_PACKETSIZE 2048
 #define MAX_PS_PACKETSIZE (224*1024)
@@ -293,7 +294,6 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
   unsigned char c=0;
   unsigned long long pts=0;
   unsigned long long dts=0;
-  int l;
   int pes_ext2_subid=-1;
   double stream_pts = MP_NOPTS_VALUE;
   demux_stream_t *ds=NULL;
@@ -584,19 +584,18 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
     mp_dbg(MSGT_DEMUX,MSGL_DBG2,"DEMUX_MPG: Read %d data bytes from packet %04X\n",len,id);
 //    printf("packet start = 0x%X  \n",stream_tell(demux->stream)-packet_start_pos);
 
-    dp=new_demux_packet(len);
+    dp=demux_read_packet(demux,demux->stream,len);
     if(!dp) {
       mp_dbg(MSGT_DEMUX,MSGL_ERR,"DEMUX_MPG ERROR: couldn't create demux_packet(%d bytes)\n",len);
       stream_skip(demux->stream,len);
       return 0;
     }
-    l = stream_read(demux->stream,dp->buffer,len);
-    if(l<len)
-      resize_demux_packet(dp, l);
-    len = l;
+    len = dp->len;
     if(set_pts)
       dp->pts=pts/90000.0f;
     dp->pos=demux->filepos;
+    if(ds == demux->video && set_pts)
+      seekidx_add_video(demux, dp, demux->filepos);
     /*
       workaround:
       set dp->stream_pts only when feeding the video stream, or strangely interleaved files
@@ -901,51 +900,14 @@ do{
 
 void skip_audio_frame(sh_audio_t *sh_audio);
 
-static void demux_seek_mpg(demuxer_t *demuxer, float rel_seek_secs,
-                           float audio_delay, int flags)
+/// seek to newpos and resync to the next keyframe
+static void demux_seek_mpg_pos(demuxer_t *demuxer, off_t newpos)
 {
     demux_stream_t *d_audio=demuxer->audio;
     demux_stream_t *d_video=demuxer->video;
     sh_audio_t *sh_audio=d_audio->sh;
     sh_video_t *sh_video=d_video->sh;
-    mpg_demuxer_t *mpg_d=(mpg_demuxer_t*)demuxer->priv;
-    int precision = 1;
-    float oldpts = 0;
-    off_t oldpos = demuxer->filepos;
-    float newpts = 0;
-    off_t newpos = (flags & SEEK_ABSOLUTE) ? demuxer->movi_start : oldpos;
-
-    if(mpg_d)
-      oldpts = mpg_d->last_pts;
-    newpts = (flags & SEEK_ABSOLUTE) ? 0.0 : oldpts;
-  //================= seek in MPEG ==========================
-  //calculate the pts to seek to
-    if(flags & SEEK_FACTOR) {
-      if (mpg_d && mpg_d->first_to_final_pts_len > 0.0)
-        newpts += mpg_d->first_to_final_pts_len * rel_seek_secs;
-      else
-        newpts += rel_seek_secs * (demuxer->movi_end - demuxer->movi_start) * oldpts / oldpos;
-    } else
-      newpts += rel_seek_secs;
-    if (newpts < 0) newpts = 0;
 
-    if(flags&SEEK_FACTOR){
-	// float seek 0..1
-	newpos+=(demuxer->movi_end-demuxer->movi_start)*rel_seek_secs;
-    } else {
-	// time seek (secs)
-        if (mpg_d && mpg_d->has_valid_timestamps) {
-          if (mpg_d->first_to_final_pts_len > 0.0)
-            newpos += rel_seek_secs * (demuxer->movi_end - demuxer->movi_start) / mpg_d->first_to_final_pts_len;
-          else if (oldpts > 0.0)
-            newpos += rel_seek_secs * (oldpos - demuxer->movi_start) / oldpts;
-        } else if(!sh_video || !sh_video->i_bps) // unspecified or VBR
-          newpos+=2324*75*rel_seek_secs; // 174.3 kbyte/sec
-        else
-          newpos+=sh_video->i_bps*rel_seek_secs;
-    }
-
-    while (1) {
         if(newpos<demuxer->movi_start){
 	    if(demuxer->stream->type!=STREAMTYPE_VCD) demuxer->movi_start=0; // for VCD
 	    if(newpos<demuxer->movi_start) newpos=demuxer->movi_start;
@@ -990,6 +952,53 @@ static void demux_seek_mpg(demuxer_t *demuxer, float rel_seek_secs,
 	  }
           if(!i || !skip_video_packet(d_video)) break; // EOF?
         }
+}
+
+static void demux_seek_mpg(demuxer_t *demuxer, float rel_seek_secs,
+                           float audio_delay, int flags)
+{
+    demux_stream_t *d_audio=demuxer->audio;
+    demux_stream_t *d_video=demuxer->video;
+    sh_video_t *sh_video=d_video->sh;
+    mpg_demuxer_t *mpg_d=(mpg_demuxer_t*)demuxer->priv;
+    int precision = 1;
+    float oldpts = 0;
+    off_t oldpos = demuxer->filepos;
+    float newpts = 0;
+    off_t newpos = (flags & SEEK_ABSOLUTE) ? demuxer->movi_start : oldpos;
+
+    if(mpg_d)
+      oldpts = mpg_d->last_pts;
+    newpts = (flags & SEEK_ABSOLUTE) ? 0.0 : oldpts;
+  //================= seek in MPEG ==========================
+  //calculate the pts to seek to
+    if(flags & SEEK_FACTOR) {
+      if (mpg_d && mpg_d->first_to_final_pts_len > 0.0)
+        newpts += mpg_d->first_to_final_pts_len * rel_seek_secs;
+      else
+        newpts += rel_seek_secs * (demuxer->movi_end - demuxer->movi_start) * oldpts / oldpos;
+    } else
+      newpts += rel_seek_secs;
+    if (newpts < 0) newpts = 0;
+
+    if(flags&SEEK_FACTOR){
+	// float seek 0..1
+	newpos+=(demuxer->movi_end-demuxer->movi_start)*rel_seek_secs;
+    } else {
+	// time seek (secs)
+        if (mpg_d && mpg_d->has_valid_timestamps) {
+          if (mpg_d->first_to_final_pts_len > 0.0)
+            newpos += rel_seek_secs * (demuxer->movi_end - demuxer->movi_start) / mpg_d->first_to_final_pts_len;
+          else if (oldpts > 0.0)
+            newpos += rel_seek_secs * (oldpos - demuxer->movi_start) / oldpts;
+        } else if(!sh_video || !sh_video->i_bps) // unspecified or VBR
+          newpos+=2324*75*rel_seek_secs; // 174.3 kbyte/sec
+        else
+          newpos+=sh_video->i_bps*rel_seek_secs;
+    }
+
+    while (1) {
+        demux_seek_mpg_pos(demuxer, newpos);
 	if(!mpg_d)
           break;
         if (!precision || abs(newpts - mpg_d->last_pts) < 0.5 || (mpg_d->last_pts == oldpts)) break;
@@ -1065,6 +1074,11 @@ static int demux_mpg_control(demuxer_t *demuxer, int cmd, void *arg)
             *((int*)arg) = demuxer->audio->id;
             return DEMUXER_CTRL_OK;
 
+	case DEMUXER_CTRL_SEEK_POS:
+	    // the position comes from the keyframe index, no need to correct it
+	    demux_seek_mpg_pos(demuxer, ((demux_seek_pos_t *)arg)->pos);
+	    return DEMUXER_CTRL_OK;
+
 	default:
 	    return DEMUXER_CTRL_NOTIMPL;
     }
@@ -1143,6 +1157,7 @@ static demuxer_t* demux_mpg_ps_open(demuxer_t* demuxer)
         else sh_video->format = 0x10000002;
     }
 
+    seekidx_open(demuxer, MP_NOPTS_VALUE);
     return demuxer;
 }
 
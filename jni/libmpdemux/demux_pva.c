@@ -145,7 +145,8 @@ static demuxer_t * demux_open_pva (demuxer_t * demuxer)
 
 	priv=malloc(sizeof(pva_priv_t));
 
-	if(demuxer->stream->type!=STREAMTYPE_FILE) demuxer->seekable=0;
+	if(demuxer->stream->type!=STREAMTYPE_FILE &&
+	   demuxer->stream->type!=STREAMTYPE_CONCAT) demuxer->seekable=0;
 	else demuxer->seekable=1;
 
 	demuxer->priv=priv;
@@ -37,6 +37,7 @@
 #include "ms_hdr.h"
 #include "mpeg_hdr.h"
 #include "demux_ts.h"
+#include "seekidx.h"
 
 #define TS_PH_PACKET_SIZE 192
 #define TS_FEC_PACKET_SIZE 204
@@ -56,6 +57,14 @@
 #define TYPE_AUDIO 1
 #define TYPE_VIDEO 2
 
+#define TS_SEEKPOINT_SPACING (64*1024)		/* min distance of entries in the seek map */
+#define TS_MAX_SEEKPOINTS 65536
+#define TS_SEEK_READAHEAD (1024*1024)		/* bytes read per seek probe */
+#define TS_SEEK_MAX_PROBES 16
+#define TS_SEEK_TOLERANCE 0.1
+#define TS_SEEK_MAX_SCAN (32*1024*1024)		/* how far to look for a keyframe */
+#define TS_PTS_WRAP ((double)(1LL << 33) / 90000.0)
+
 int ts_prog;
 int ts_keep_broken=0;
 off_t ts_probe = 0;
@@ -225,6 +234,11 @@ typedef struct {
 	double last_pts;
 } TS_stream_info;
 
+typedef struct {
+	double pts;	//as in the PES header, not unwrapped
+	off_t pos;	//of the TS packet starting the PES
+} ts_seekpoint_t;
+
 typedef struct {
 	MpegTSContext ts;
 	int last_pid;
@@ -240,6 +254,13 @@ typedef struct {
 	int last_sid;
 	char packet[TS_FEC_PACKET_SIZE];
 	TS_stream_info vstr, astr;
+	ts_seekpoint_t *seekpoints;	//PES starts of the main stream, sorted by pos
+	int seekpoints_cnt, seekpoints_max;
+	int seek_probed;
+	double start_pts;
+	uint32_t pid_skip[NB_PID_MAX / 32];	//PIDs ts_parse() drops unparsed
+	int pid_skip_key[5];	//selection and tables the bitmap was built for
+	int tables_version;	//bumped when PAT, PMT or the stream list change
 } ts_priv_t;
 
 
@@ -339,6 +360,7 @@ static void ts_add_stream(demuxer_t * demuxer, ES_stream_t *es)
 
 	if(priv->ts.streams[es->pid].sh)
 		return;
+	priv->tables_version++;
 
 	if((IS_AUDIO(es->type) || IS_AUDIO(es->subtype)) && priv->last_aid+1 < MAX_A_STREAMS)
 	{
@@ -1088,6 +1110,7 @@ static demuxer_t *demux_open_ts(demuxer_t * demuxer)
 		priv->pmt[i].section.buffer_len = 0;
 
 	demuxer->filepos = stream_tell(demuxer->stream);
+	seekidx_open(demuxer, MP_NOPTS_VALUE);
 	return demuxer;
 }
 
@@ -1114,6 +1137,7 @@ static void demux_close_ts(demuxer_t * demuxer)
 			}
 			free(priv->pmt);
 		}
+		free(priv->seekpoints);
 		free(priv);
 	}
 	demuxer->priv=NULL;
@@ -1614,16 +1638,63 @@ static int pes_parse2(unsigned char *buf, uint16_t packet_len, ES_stream_t *es,
 
 static int ts_sync(stream_t *stream)
 {
+	unsigned char *buf, *sync;
+	int len;
+
 	mp_msg(MSGT_DEMUX, MSGL_DBG3, "TS_SYNC \n");
 
-	while (!stream->eof)
-		if (stream_read_char(stream) == 0x47)
+	//memchr() checks a word or a vector at a time
+	while((len = stream_peek_buffer(stream, &buf)) > 0)
+	{
+		sync = memchr(buf, 0x47, len);
+		if(sync)
+		{
+			stream_skip(stream, sync - buf + 1);
 			return 1;
+		}
+		stream_skip(stream, len);
+	}
 
 	return 0;
 }
 
 
+/// remember where a timestamp of the main stream starts, for seeking
+static void ts_add_seekpoint(ts_priv_t *priv, double pts, off_t pos)
+{
+	ts_seekpoint_t *sp = priv->seekpoints;
+	int lo = 0, hi = priv->seekpoints_cnt, mid;
+
+	while(lo < hi)	//first entry at or after pos
+	{
+		mid = (lo + hi) / 2;
+		if(sp[mid].pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if((lo > 0 && pos - sp[lo-1].pos < TS_SEEKPOINT_SPACING) ||
+	   (lo < priv->seekpoints_cnt && sp[lo].pos - pos < TS_SEEKPOINT_SPACING))
+		return;
+
+	if(priv->seekpoints_cnt == priv->seekpoints_max)
+	{
+		int max = priv->seekpoints_max ? 2 * priv->seekpoints_max : 256;
+		if(max > TS_MAX_SEEKPOINTS)
+			return;
+		sp = realloc(priv->seekpoints, max * sizeof(ts_seekpoint_t));
+		if(sp == NULL)
+			return;
+		priv->seekpoints = sp;
+		priv->seekpoints_max = max;
+	}
+	memmove(&sp[lo+1], &sp[lo], (priv->seekpoints_cnt - lo) * sizeof(ts_seekpoint_t));
+	sp[lo].pts = pts;
+	sp[lo].pos = pos;
+	priv->seekpoints_cnt++;
+}
+
+
 static void ts_dump_streams(ts_priv_t *priv)
 {
 	int i;
@@ -1775,9 +1846,12 @@ static int parse_pat(ts_priv_t * priv, int is_start, unsigned char *buff, int si
 			priv->pat.progs = tmp;
 			idx = priv->pat.progs_cnt;
 			priv->pat.progs_cnt++;
+			priv->tables_version++;
 		}
 
 		priv->pat.progs[idx].id = progid;
+		if(priv->pat.progs[idx].pmt_pid != (((base[2]  & 0x1F) << 8) | base[3]))
+			priv->tables_version++;
 		priv->pat.progs[idx].pmt_pid = ((base[2]  & 0x1F) << 8) | base[3];
 		mp_msg(MSGT_DEMUX, MSGL_V, "PROG: %d (%d-th of %d), PMT: %d\n", priv->pat.progs[idx].id, i+1, entries, priv->pat.progs[idx].pmt_pid);
 		mp_msg(MSGT_IDENTIFY, MSGL_V, "PROGRAM_ID=%d (0x%02X), PMT_PID: %d(0x%02X)\n",
@@ -2440,6 +2514,8 @@ static int parse_pmt(ts_priv_t * priv, uint16_t progid, uint16_t pid, int is_sta
 	pmt->curr_next = (base[5] & 1);
 	pmt->section_number = base[6];
 	pmt->last_section_number = base[7];
+	if(pmt->PCR_PID != (((base[8] & 0x1f) << 8 ) | base[9]))
+		priv->tables_version++;
 	pmt->PCR_PID = ((base[8] & 0x1f) << 8 ) | base[9];
 	pmt->prog_descr_length = ((base[10] & 0xf) << 8 ) | base[11];
 	if(pmt->prog_descr_length > pmt->section_length - 9)
@@ -2561,6 +2637,7 @@ static int parse_pmt(ts_priv_t * priv, uint16_t progid, uint16_t pid, int is_sta
 			tss = new_pid(priv, es_pid);
 			if(tss)
 				tss->type = pmt->es[idx].type;
+			priv->tables_version++;
 		}
 
 		section_bytes -= 5 + pmt->es[idx].descr_length;
@@ -2677,6 +2754,12 @@ static int fill_packet(demuxer_t *demuxer, demux_stream_t *ds, demux_packet_t **
 	{
 		ret = *dp_offset;
 		resize_demux_packet(*dp, ret);	//shrinked to the right size
+		if(ds == demuxer->video && demuxer->seekidx)
+		{
+			ts_priv_t *priv = demuxer->priv;
+			// pos was taken after the first TS packet of the PES
+			seekidx_add_video(demuxer, *dp, (*dp)->pos - priv->ts.packet_size);
+		}
 		ds_add_packet(ds, *dp);
 		mp_msg(MSGT_DEMUX, MSGL_DBG2, "ADDED %d  bytes to %s fifo, PTS=%.3f\n", ret, (ds == demuxer->audio ? "audio" : (ds == demuxer->video ? "video" : "sub")), (*dp)->pts);
 		if(si)
@@ -2732,6 +2815,79 @@ static int fill_extradata(mp4_decoder_config_t * mp4_dec, ES_stream_t *tss)
 	return tss->extradata_len;
 }
 
+/// rebuild the bitmap of PIDs to drop if the selection or the tables changed
+static void ts_update_pid_filter(demuxer_t *demuxer)
+{
+	ts_priv_t *priv = (ts_priv_t*) demuxer->priv;
+	sh_sub_t *sh_sub = demuxer->sub->sh;
+	int key[5], pid, pcr_pid;
+
+	key[0] = demuxer->video->id;
+	key[1] = demuxer->audio->id;
+	key[2] = sh_sub ? sh_sub->sid : -1;
+	key[3] = priv->prog;
+	key[4] = priv->tables_version;
+	if(!memcmp(key, priv->pid_skip_key, sizeof(key)))
+		return;
+	memcpy(priv->pid_skip_key, key, sizeof(key));
+
+	memset(priv->pid_skip, 0, sizeof(priv->pid_skip));
+	pcr_pid = prog_pcr_pid(priv, priv->prog);
+	for(pid = 0; pid < NB_PID_MAX; pid++)
+	{
+		ES_stream_t *tss = priv->ts.pids[pid];
+		int is_video, is_audio, is_sub;
+
+		//same conditions as in ts_parse(), for streams that are known
+		if(pid == 0 || pid == pcr_pid || !tss || !priv->ts.streams[pid].sh ||
+		   tss->type == SL_SECTION || tss->type == SL_PES_STREAM ||
+		   prog_id_in_pat(priv, pid) != -1)
+		{
+			if((pid > 1 && pid < 16) || pid == 8191)
+				priv->pid_skip[pid >> 5] |= 1U << (pid & 31);
+			continue;
+		}
+		is_video = IS_VIDEO(tss->type);
+		is_audio = IS_AUDIO(tss->type) || (tss->type == PES_PRIVATE1);
+		is_sub = IS_SUB(tss->type);
+		if((is_video && demuxer->video->id == priv->ts.streams[pid].id) ||
+		   (is_audio && demuxer->audio->id == priv->ts.streams[pid].id) ||
+		   (is_sub && sh_sub && sh_sub->sid == pid))
+			continue;
+		priv->pid_skip[pid >> 5] |= 1U << (pid & 31);
+	}
+}
+
+/**
+ * \brief sync to the next packet whose PID is not dropped
+ *
+ * Packets of unselected streams and other programs are skipped right in the
+ * stream buffer, before their header is parsed.
+ */
+static int ts_sync_filtered(demuxer_t *demuxer)
+{
+	ts_priv_t *priv = (ts_priv_t*) demuxer->priv;
+	stream_t *stream = demuxer->stream;
+	unsigned char *buf;
+	int pid;
+
+	ts_update_pid_filter(demuxer);
+	while(ts_sync(stream))
+	{
+		if(stream_peek_buffer(stream, &buf) < 2)
+			return 1;
+		pid = ((buf[0] & 0x1f) << 8) | buf[1];
+		if(!(priv->pid_skip[pid >> 5] & (1U << (pid & 31))))
+			return 1;
+		//its PES has to start over once the stream is selected
+		if(priv->ts.pids[pid])
+			priv->ts.pids[pid]->is_synced = 0;
+		stream_skip(stream, priv->ts.packet_size - 1);
+	}
+
+	return 0;
+}
+
 // 0 = EOF or no stream found
 // else = [-] number of bytes written to the packet
 static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, unsigned char *packet, int probe)
@@ -2747,6 +2903,7 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, unsigned char *packet,
 	int *dp_offset = 0, *buffer_size = 0;
 	int32_t progid, pid_type, bad, ts_error;
 	int junk = 0, rap_flag = 0;
+	off_t pkt_pos;
 	pmt_t *pmt;
 	mp4_decoder_config_t *mp4_dec;
 	TS_stream_info *si;
@@ -2779,11 +2936,12 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, unsigned char *packet,
 		}
 
 
-		if(! ts_sync(stream))
+		if(! (probe ? ts_sync(stream) : ts_sync_filtered(demuxer)))
 		{
 			mp_msg(MSGT_DEMUX, MSGL_INFO, "TS_PARSE: COULDN'T SYNC\n");
 			return 0;
 		}
+		pkt_pos = stream_tell(stream) - 1;
 
 		len = stream_read(stream, &packet[1], 3);
 		if (len != 3)
@@ -3082,6 +3240,9 @@ static int ts_parse(demuxer_t *demuxer , ES_stream_t *es, unsigned char *packet,
 			}
 			else
 			{
+				if(es->pts != 0.0 && ds->sh == (demuxer->video->sh ? demuxer->video->sh : demuxer->audio->sh))
+					ts_add_seekpoint(priv, es->pts, pkt_pos);
+
 				if(es->pts == 0.0)
 					es->pts = tss->pts = tss->last_pts;
 				else
@@ -3205,24 +3366,237 @@ static void reset_fifos(demuxer_t *demuxer, int a, int v, int s)
 }
 
 
+static void demux_seek_ts_pos(demuxer_t *demuxer, off_t newpos);
+
+/// seconds since the start of the main stream, across PTS wraparounds
+static double ts_seek_time(ts_priv_t *priv, double pts)
+{
+	pts -= priv->start_pts;
+	if(pts < -TS_PTS_WRAP / 2)
+		pts += TS_PTS_WRAP;
+	return pts;
+}
+
+static int ts_main_pid(ts_priv_t *priv, void *sh)
+{
+	int pid;
+
+	for(pid = 0; pid < NB_PID_MAX; pid++)
+		if(priv->ts.streams[pid].sh == sh)
+			return pid;
+	return -1;
+}
+
+/**
+ * Read the raw packets of pid in [pos, pos+range) without touching the
+ * parser state. Finds the first PES header with a timestamp later than
+ * "after" or, if "before" is set, the last one not later than it.
+ * With key set only random access points count: packets with the
+ * random_access_indicator or, for video in format fmt, a keyframe start.
+ * \return 1 if sp was set
+ */
+static int ts_scan_pts(demuxer_t *demuxer, int pid, unsigned int fmt, off_t pos, off_t range,
+		       int key, double after, double before, ts_seekpoint_t *sp)
+{
+	ts_priv_t *priv = (ts_priv_t*) demuxer->priv;
+	stream_t *stream = demuxer->stream;
+	unsigned char pkt[TS_FEC_PACKET_SIZE], *p;
+	int size = priv->ts.packet_size, found = 0, rai, afc, len;
+	off_t end = pos + range, ppos;
+	uint64_t v;
+	double pts;
+
+	if(!stream_seek(stream, pos))
+		return 0;
+	while(stream_tell(stream) < end && ts_sync(stream))
+	{
+		ppos = stream_tell(stream) - 1;
+		pkt[0] = 0x47;
+		if(stream_read(stream, &pkt[1], size - 1) != size - 1)
+			break;
+		if((pkt[1] & 0xc0) != 0x40 || (((pkt[1] & 0x1f) << 8) | pkt[2]) != pid)
+			continue;	//transport error, no PES start or other pid
+		afc = (pkt[3] >> 4) & 3;
+		if(!(afc & 1))
+			continue;
+		p = &pkt[4];
+		rai = 0;
+		if(afc == 3)
+		{
+			if(p[0] > 182)
+				continue;
+			if(p[0])
+				rai = p[1] & 0x40;
+			p += p[0] + 1;
+		}
+		len = &pkt[TS_PACKET_SIZE] - p;
+		if(len < 14 || p[0] || p[1] || p[2] != 1 || !(p[7] & 0x80) || 9 + p[8] > len)
+			continue;
+
+		v = (uint64_t) ((p[9] >> 1) & 7) << 30 | p[10] << 22 | (p[11] >> 1) << 15 | p[12] << 7 | p[13] >> 1;
+		pts = v / 90000.0;
+		if(key && !rai && fmt && !mp_es_keyframe_start(fmt, p + 9 + p[8], len - 9 - p[8]))
+			continue;
+
+		if(before != MP_NOPTS_VALUE)
+		{
+			if(ts_seek_time(priv, pts) > before)
+				break;
+		}
+		else if(ts_seek_time(priv, pts) <= after)
+			continue;
+		sp->pts = pts;
+		sp->pos = ppos;
+		found = 1;
+		if(before == MP_NOPTS_VALUE)
+			break;
+	}
+	return found;
+}
+
+/**
+ * Seek by timestamp: interpolate and bisect on the seek map, probing the
+ * file where it has no entries yet, then snap to the random access point
+ * at or before the target.
+ * \return 0 if timestamps cannot be used, the caller falls back to bitrate
+ */
+static int demux_seek_ts_pts(demuxer_t *demuxer, float rel_seek_secs, int flags)
+{
+	ts_priv_t *priv = (ts_priv_t*) demuxer->priv;
+	demux_stream_t *ds = demuxer->video->sh ? demuxer->video : demuxer->audio;
+	ts_seekpoint_t lo, hi, sp;
+	off_t start, end, pos, w;
+	double target, cur = 0, t, tlo, thi;
+	int pid, i, have_lo = 0, have_hi = 0, probes = 0;
+	unsigned int fmt;
+
+	if(!ds->sh || (demuxer->stream->flags & MP_STREAM_SEEK) != MP_STREAM_SEEK ||
+	   demuxer->movi_end <= demuxer->movi_start)
+		return 0;
+	pid = ts_main_pid(priv, ds->sh);
+	if(pid < 0)
+		return 0;
+	fmt = ds == demuxer->video ? ((sh_video_t *)ds->sh)->format : 0;
+
+	if(!priv->seek_probed)
+	{
+		// first and last timestamps, the outer bounds for interpolation
+		priv->seek_probed = 1;
+		if(ts_scan_pts(demuxer, pid, fmt, demuxer->movi_start, TS_SEEK_READAHEAD, 0, MP_NOPTS_VALUE, MP_NOPTS_VALUE, &sp))
+		{
+			priv->start_pts = sp.pts;
+			ts_add_seekpoint(priv, sp.pts, sp.pos);
+			start = FFMAX(demuxer->movi_start, demuxer->movi_end - 2 * TS_SEEK_READAHEAD);
+			if(ts_scan_pts(demuxer, pid, fmt, start, demuxer->movi_end - start, 0, MP_NOPTS_VALUE, MP_NOPTS_VALUE, &sp))
+				ts_add_seekpoint(priv, sp.pts, sp.pos);
+			mp_msg(MSGT_DEMUX, MSGL_V, "TS seek map: %d points, start pts %.3f\n", priv->seekpoints_cnt, priv->start_pts);
+		}
+	}
+	if(priv->seekpoints_cnt < 2)
+		return 0;
+
+	if(!(flags & SEEK_ABSOLUTE))
+	{
+		if(ds->pts == 0.0)
+			return 0;
+		cur = ts_seek_time(priv, ds->pts);
+	}
+	target = FFMAX(cur + rel_seek_secs, 0);
+
+	// last map entry at or before the target and the next one after it
+	for(i = 0; i < priv->seekpoints_cnt; i++)
+	{
+		if(ts_seek_time(priv, priv->seekpoints[i].pts) <= target)
+		{
+			lo = priv->seekpoints[i];
+			have_lo = 1;
+			have_hi = 0;
+		}
+		else if(!have_hi)
+		{
+			hi = priv->seekpoints[i];
+			have_hi = 1;
+		}
+	}
+	if(!have_lo)
+		return 0;
+	if(!have_hi)
+		hi.pos = demuxer->movi_end;
+
+	while(probes < TS_SEEK_MAX_PROBES && hi.pos - lo.pos > TS_SEEK_READAHEAD)
+	{
+		tlo = ts_seek_time(priv, lo.pts);
+		if(target - tlo <= TS_SEEK_TOLERANCE)
+			break;
+		// alternate interpolation with bisection, to bound the probe count
+		// when the bitrate is very uneven
+		pos = lo.pos + (hi.pos - lo.pos) / 2;
+		if(have_hi && !(probes & 1))
+		{
+			thi = ts_seek_time(priv, hi.pts);
+			if(thi > tlo)
+				pos = lo.pos + (off_t) ((hi.pos - lo.pos) * ((target - tlo) / (thi - tlo)));
+		}
+		pos = FFMIN(FFMAX(pos, lo.pos + priv->ts.packet_size), hi.pos - TS_SEEK_READAHEAD / 2);
+		probes++;
+		if(!ts_scan_pts(demuxer, pid, fmt, pos, FFMIN(TS_SEEK_READAHEAD, hi.pos - pos), 0, MP_NOPTS_VALUE, MP_NOPTS_VALUE, &sp))
+		{
+			hi.pos = pos;	//nothing in between, keep the old timestamp
+			continue;
+		}
+		ts_add_seekpoint(priv, sp.pts, sp.pos);
+		t = ts_seek_time(priv, sp.pts);
+		if(t <= target)
+			lo = sp;
+		else
+		{
+			hi = sp;
+			have_hi = 1;
+		}
+	}
+
+	// snap to the last random access point not after the target,
+	// looking further back each time none is found
+	start = lo.pos;
+	end = FFMIN(hi.pos, lo.pos + 4 * TS_SEEK_READAHEAD);
+	for(w = TS_SEEK_READAHEAD; ; w *= 2)
+	{
+		if(ts_scan_pts(demuxer, pid, fmt, start, end - start, 1, MP_NOPTS_VALUE, target, &sp))
+			break;
+		if(start <= demuxer->movi_start || w > TS_SEEK_MAX_SCAN)
+		{
+			sp = lo;	//demux_seek_ts_pos() resyncs to a keyframe
+			break;
+		}
+		end = start + priv->ts.packet_size;
+		start = FFMAX(demuxer->movi_start, start - w);
+	}
+
+	if(!(flags & SEEK_ABSOLUTE) && rel_seek_secs > 0 && ts_seek_time(priv, sp.pts) <= cur)
+	{
+		// that one is behind the current position, take the next one instead
+		if(!ts_scan_pts(demuxer, pid, fmt, sp.pos + priv->ts.packet_size, TS_SEEK_MAX_SCAN, 1, cur, MP_NOPTS_VALUE, &sp))
+			return 0;
+	}
+
+	t = ts_seek_time(priv, sp.pts);
+	demux_seek_ts_pos(demuxer, sp.pos);
+	mp_msg(MSGT_DEMUX, MSGL_V, "TS seek to %.3f: keyframe at %.3f (%+.3f), landed at %.3f, %d probes\n",
+		target, t, t - target, ds->pts != 0.0 ? ts_seek_time(priv, ds->pts) : t, probes);
+	return 1;
+}
+
 static void demux_seek_ts(demuxer_t *demuxer, float rel_seek_secs, float audio_delay, int flags)
 {
-	demux_stream_t *d_audio=demuxer->audio;
-	demux_stream_t *d_video=demuxer->video;
-	sh_audio_t *sh_audio=d_audio->sh;
-	sh_video_t *sh_video=d_video->sh;
+	sh_video_t *sh_video=demuxer->video->sh;
 	ts_priv_t * priv = (ts_priv_t*) demuxer->priv;
-	int i, video_stats;
+	int video_stats;
 	off_t newpos;
 
 	//================= seek in MPEG-TS ==========================
 
-	ts_dump_streams(demuxer->priv);
-	reset_fifos(demuxer, sh_audio != NULL, sh_video != NULL, demuxer->sub->id > 0);
-
-	demux_flush(demuxer);
-
-
+	if(!(flags & SEEK_FACTOR) && demux_seek_ts_pts(demuxer, rel_seek_secs, flags))
+		return;
 
 	video_stats = (sh_video != NULL);
 	if(video_stats)
@@ -3247,6 +3621,24 @@ static void demux_seek_ts(demuxer_t *demuxer, float rel_seek_secs, float audio_d
 	}
 
 
+	demux_seek_ts_pos(demuxer, newpos);
+}
+
+/// seek to newpos and resync to the next keyframe
+static void demux_seek_ts_pos(demuxer_t *demuxer, off_t newpos)
+{
+	demux_stream_t *d_audio=demuxer->audio;
+	demux_stream_t *d_video=demuxer->video;
+	sh_audio_t *sh_audio=d_audio->sh;
+	sh_video_t *sh_video=d_video->sh;
+	ts_priv_t * priv = (ts_priv_t*) demuxer->priv;
+	int i;
+
+	ts_dump_streams(demuxer->priv);
+	reset_fifos(demuxer, sh_audio != NULL, sh_video != NULL, demuxer->sub->id > 0);
+
+	demux_flush(demuxer);
+
 	if(newpos < demuxer->movi_start)
   		newpos = demuxer->movi_start;	//begininng of stream
 
@@ -3474,6 +3866,10 @@ static int demux_ts_control(demuxer_t *demuxer, int cmd, void *arg)
 			return DEMUXER_CTRL_OK;
 		}
 
+		case DEMUXER_CTRL_SEEK_POS:
+			demux_seek_ts_pos(demuxer, ((demux_seek_pos_t *)arg)->pos);
+			return DEMUXER_CTRL_OK;
+
 		default:
 			return DEMUXER_CTRL_NOTIMPL;
 	}
@@ -39,6 +39,7 @@
 #include "stheader.h"
 #include "mf.h"
 #include "demux_audio.h"
+#include "seekidx.h"
 
 #include "libaf/af_format.h"
 #include "libmpcodecs/dec_teletext.h"
@@ -392,6 +393,7 @@ void free_demuxer(demuxer_t *demuxer)
     int i;
     mp_msg(MSGT_DEMUXER, MSGL_DBG2, "DEMUXER: freeing %s demuxer at %p\n",
            demuxer->desc->shortdesc, demuxer);
+    seekidx_close(demuxer);
     if (demuxer->desc->close)
         demuxer->desc->close(demuxer);
     // Very ugly hack to make it behave like old implementation
@@ -577,12 +579,19 @@ void ds_add_packet(demux_stream_t *ds, demux_packet_t *dp)
 #endif
 }
 
-void ds_read_packet(demux_stream_t *ds, stream_t *stream, int len,
-                    double pts, off_t pos, int flags)
+/// read the next len bytes of stream into a new packet
+demux_packet_t *demux_read_packet(demuxer_t *demuxer, stream_t *stream, int len)
 {
     demux_packet_t *dp = new_demux_packet(len);
     len = stream_read(stream, dp->buffer, len);
     resize_demux_packet(dp, len);
+    return dp;
+}
+
+void ds_read_packet(demux_stream_t *ds, stream_t *stream, int len,
+                    double pts, off_t pos, int flags)
+{
+    demux_packet_t *dp = demux_read_packet(ds->demuxer, stream, len);
     dp->pts = pts;
     dp->pos = pos;
     dp->flags = flags;
@@ -965,17 +974,137 @@ int user_correct_pts = -1;
   (ex: tv,mf).
 */
 
-static demuxer_t *demux_open_stream(stream_t *stream, int file_format,
-                                    int force, int audio_id, int video_id,
-                                    int dvdsub_id, char *filename)
+/// magic bytes at the start of a file, one or two per entry
+typedef struct demux_signature {
+    int type;
+    int offset, len;
+    const char *magic;
+    int offset2, len2;
+    const char *magic2;
+} demux_signature_t;
+
+#define SIG(type, off, magic) { type, off, sizeof(magic) - 1, magic }
+#define SIG2(type, off, magic, off2, magic2) \
+    { type, off, sizeof(magic) - 1, magic, off2, sizeof(magic2) - 1, magic2 }
+
+/* Only decides the order in which demuxers are checked, so a match must be
+ * likely but need not be certain. Formats that libavformat is preferred for
+ * (see demux_lavf.c) list DEMUXER_TYPE_LAVF_PREFERRED too. */
+static const demux_signature_t demux_signatures[] = {
+    SIG2(DEMUXER_TYPE_AVI,        0, "RIFF", 8, "AVI "),
+    SIG2(DEMUXER_TYPE_AVI,        0, "ON2 ", 8, "ON2f"),
+    SIG2(DEMUXER_TYPE_AUDIO,      0, "RIFF", 8, "WAVE"),
+    SIG(DEMUXER_TYPE_ASF,         0, "\x30\x26\xb2\x75\x8e\x66\xcf\x11"),
+    SIG(DEMUXER_TYPE_NSV,         0, "NSVf"),
+    SIG(DEMUXER_TYPE_NSV,         0, "NSVs"),
+    SIG(DEMUXER_TYPE_REAL,        0, ".RMF"),
+    SIG(DEMUXER_TYPE_REALAUDIO,   0, ".ra\xfd"),
+    SIG(DEMUXER_TYPE_SMJPEG,      0, "\0\nSMJPEG"),
+    SIG(DEMUXER_TYPE_MATROSKA,    0, "\x1a\x45\xdf\xa3"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 0, "\x1a\x45\xdf\xa3"),
+    SIG(DEMUXER_TYPE_VQF,         0, "TWIN"),
+    SIG(DEMUXER_TYPE_MOV,         4, "ftyp"),
+    SIG(DEMUXER_TYPE_MOV,         4, "moov"),
+    SIG(DEMUXER_TYPE_MOV,         4, "mdat"),
+    SIG(DEMUXER_TYPE_MOV,         4, "free"),
+    SIG(DEMUXER_TYPE_MOV,         4, "wide"),
+    SIG(DEMUXER_TYPE_MOV,         4, "skip"),
+    SIG(DEMUXER_TYPE_MOV,         4, "pnot"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 4, "ftyp"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 4, "moov"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 4, "mdat"),
+    SIG(DEMUXER_TYPE_Y4M,         0, "YUV4MPEG2"),
+    SIG(DEMUXER_TYPE_OGG,         0, "OggS"),
+    SIG(DEMUXER_TYPE_FILM,        0, "FILM"),
+    SIG(DEMUXER_TYPE_GIF,         0, "GIF8"),
+    SIG2(DEMUXER_TYPE_MPEG_TS,    0, "\x47", 188, "\x47"),
+    SIG2(DEMUXER_TYPE_MPEG_TS,    4, "\x47", 196, "\x47"),
+    SIG2(DEMUXER_TYPE_MPEG_TS,    0, "\x47", 204, "\x47"),
+    SIG(DEMUXER_TYPE_MPEG_PS,     0, "\x00\x00\x01\xba"),
+    SIG(DEMUXER_TYPE_MPEG_PS,     0, "\x00\x00\x01\xb3"),
+    SIG(DEMUXER_TYPE_AUDIO,       0, "ID3"),
+    SIG(DEMUXER_TYPE_AUDIO,       0, "fLaC"),
+    SIG(DEMUXER_TYPE_MPC,         0, "MP+"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 0, "MP+"),
+    SIG(DEMUXER_TYPE_NUT,         0, "nut/multimedia container"),
+    SIG(DEMUXER_TYPE_LAVF_PREFERRED, 0, "nut/multimedia container"),
+    SIG(DEMUXER_TYPE_MNG,         0, "\x8aMNG\r\n\x1a\n"),
+    SIG(DEMUXER_TYPE_AAC,         0, "ADIF"),
+    { 0 }
+};
+
+#define DEMUX_SIGNATURE_SIZE 256
+
+/* enough for the largest reads of the checks (lavf, TS) */
+#define DEMUX_PROBE_SIZE (2 * 1024 * 1024 + 64 * 1024)
+
+#define DEMUXER_LIST_LEN (sizeof(demuxer_list) / sizeof(demuxer_list[0]))
+
+/**
+ * Mark the entries of demuxer_list whose signature matches the start of
+ * the stream.
+ */
+static void demux_match_signatures(stream_t *stream, char *matched)
+{
+    unsigned char buf[DEMUX_SIGNATURE_SIZE];
+    const demux_signature_t *sig;
+    int len, i;
+
+    memset(matched, 0, DEMUXER_LIST_LEN);
+    if (!stream_seek(stream, stream->start_pos))
+        return;
+    len = stream_read(stream, buf, sizeof(buf));
+    for (sig = demux_signatures; sig->type; sig++) {
+        if (sig->offset + sig->len > len
+            || memcmp(buf + sig->offset, sig->magic, sig->len))
+            continue;
+        if (sig->len2 && (sig->offset2 + sig->len2 > len
+                          || memcmp(buf + sig->offset2, sig->magic2, sig->len2)))
+            continue;
+        for (i = 0; demuxer_list[i]; i++)
+            if (demuxer_list[i]->type == sig->type) {
+                mp_msg(MSGT_DEMUXER, MSGL_DBG2, "demuxer: signature of %s\n",
+                       demuxer_list[i]->name);
+                matched[i] = 1;
+            }
+    }
+}
+
+static demuxer_t *demux_detect_stream(stream_t *stream, int file_format,
+                                      int force, int audio_id, int video_id,
+                                      int dvdsub_id, char *filename);
+
+/**
+ * Detect the format of stream and open a demuxer for it. While detecting,
+ * the start of the stream is kept in memory so that every check after the
+ * first one reads from there instead of the source.
+ */
+demuxer_t *demux_open_stream(stream_t *stream, int file_format,
+                             int force, int audio_id, int video_id,
+                             int dvdsub_id, char *filename)
+{
+    demuxer_t *demuxer;
+    int probing = stream_probe_begin(stream, DEMUX_PROBE_SIZE);
+
+    demuxer = demux_detect_stream(stream, file_format, force, audio_id,
+                                  video_id, dvdsub_id, filename);
+    if (probing)
+        stream_probe_end(stream);
+    return demuxer;
+}
+
+static demuxer_t *demux_detect_stream(stream_t *stream, int file_format,
+                                      int force, int audio_id, int video_id,
+                                      int dvdsub_id, char *filename)
 {
     demuxer_t *demuxer = NULL;
 
     sh_video_t *sh_video = NULL;
 
     const demuxer_desc_t *demuxer_desc;
+    char matched[DEMUXER_LIST_LEN];
     int fformat = 0;
-    int i;
+    int i, pass;
 
     // If somebody requested a demuxer check it
     if (file_format) {
@@ -1011,62 +1140,35 @@ static demuxer_t *demux_open_stream(stream_t *stream, int file_format,
             return NULL;
         }
     }
-    // Test demuxers with safe file checks
-    for (i = 0; (demuxer_desc = demuxer_list[i]); i++) {
-        if (demuxer_desc->safe_check) {
-            demuxer = new_demuxer(stream, demuxer_desc->type, audio_id,
-                                  video_id, dvdsub_id, filename);
-            if ((fformat = demuxer_desc->check_file(demuxer)) != 0) {
-                if (fformat == demuxer_desc->type) {
-                    demuxer_t *demux2 = demuxer;
-                    mp_msg(MSGT_DEMUXER, MSGL_INFO,
-                           MSGTR_Detected_XXX_FileFormat,
-                           demuxer_desc->shortdesc);
-                    file_format = fformat;
-                    if (!demuxer->desc->open
-                        || (demux2 = demuxer->desc->open(demuxer))) {
-                        demuxer = demux2;
-                        goto dmx_open;
-                    }
-                } else {
-                    if (fformat == DEMUXER_TYPE_PLAYLIST)
-                        return demuxer; // handled in mplayer.c
-                    // Format changed after check, recurse
-                    free_demuxer(demuxer);
-                    demuxer = demux_open_stream(stream, fformat, force,
-                                                audio_id, video_id,
-                                                dvdsub_id, filename);
-                    if (demuxer)
-                        return demuxer; // done!
-                    file_format = DEMUXER_TYPE_UNKNOWN;
-                }
+    demux_match_signatures(stream, matched);
+
+    // Test demuxers with safe file checks first, then the fuzzy ones.
+    // Within each group the ones whose signature matched go first.
+    for (pass = 0; pass < 4; pass++) {
+        int safe = pass < 2, sig = !(pass & 1);
+
+        // If no forced demuxer perform file extension based detection
+        // Ok. We're over the stable detectable fileformats, the next ones are
+        // a bit fuzzy. So by default (extension_parsing==1) try extension-based
+        // detection first:
+        if (pass == 2 && file_format == DEMUXER_TYPE_UNKNOWN && filename
+            && extension_parsing == 1) {
+            file_format = demuxer_type_by_filename(filename);
+            if (file_format != DEMUXER_TYPE_UNKNOWN) {
+                // we like recursion :)
+                demuxer = demux_open_stream(stream, file_format, force, audio_id,
+                                            video_id, dvdsub_id, filename);
+                if (demuxer)
+                    return demuxer; // done!
+                file_format = DEMUXER_TYPE_UNKNOWN; // continue fuzzy guessing...
+                mp_msg(MSGT_DEMUXER, MSGL_V,
+                       "demuxer: continue fuzzy content-based format guessing...\n");
             }
-            free_demuxer(demuxer);
-            demuxer = NULL;
         }
-    }
-
-    // If no forced demuxer perform file extension based detection
-    // Ok. We're over the stable detectable fileformats, the next ones are
-    // a bit fuzzy. So by default (extension_parsing==1) try extension-based
-    // detection first:
-    if (file_format == DEMUXER_TYPE_UNKNOWN && filename
-        && extension_parsing == 1) {
-        file_format = demuxer_type_by_filename(filename);
-        if (file_format != DEMUXER_TYPE_UNKNOWN) {
-            // we like recursion :)
-            demuxer = demux_open_stream(stream, file_format, force, audio_id,
-                                        video_id, dvdsub_id, filename);
-            if (demuxer)
-                return demuxer; // done!
-            file_format = DEMUXER_TYPE_UNKNOWN; // continue fuzzy guessing...
-            mp_msg(MSGT_DEMUXER, MSGL_V,
-                   "demuxer: continue fuzzy content-based format guessing...\n");
-        }
-    }
-    // Try detection for all other demuxers
-    for (i = 0; (demuxer_desc = demuxer_list[i]); i++) {
-        if (!demuxer_desc->safe_check && demuxer_desc->check_file) {
+        for (i = 0; (demuxer_desc = demuxer_list[i]); i++) {
+            if (!demuxer_desc->check_file || demuxer_desc->safe_check != safe
+                || matched[i] != sig)
+                continue;
             demuxer = new_demuxer(stream, demuxer_desc->type, audio_id,
                                   video_id, dvdsub_id, filename);
             if ((fformat = demuxer_desc->check_file(demuxer)) != 0) {
@@ -1242,7 +1344,8 @@ demuxer_t *demux_open(stream_t *vs, int file_format, int audio_id,
     else if (sd)
         res = new_demuxers_demuxer(vd, vd, sd);
     else
-        res = vd;
+        res = new_concat_demuxer(vd, audio_stream ? -2 : audio_id, video_id,
+                                 sub_stream ? -2 : dvdsub_id);
 
     correct_pts = user_correct_pts;
     if (correct_pts < 0)
@@ -1306,6 +1409,11 @@ int demux_seek(demuxer_t *demuxer, float rel_seek_secs, float audio_delay,
     demuxer->audio->eof = 0;
     demuxer->sub->eof = 0;
 
+    if (seekidx_seek(demuxer, rel_seek_secs, flags)) {
+        demux_resync(demuxer);
+        return 1;
+    }
+
     if (flags & SEEK_ABSOLUTE)
         pts = 0.0f;
     else {
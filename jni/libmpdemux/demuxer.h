@@ -95,6 +95,8 @@
 #define DEMUXER_TYPE_DEMUXERS (1<<16)
 // A virtual demuxer type for the network code
 #define DEMUXER_TYPE_PLAYLIST (2<<16)
+// Segments of a concat:// stream played through one set of stream headers
+#define DEMUXER_TYPE_CONCAT (3<<16)
 
 
 #define MP_NOPTS_VALUE (-1LL<<63) //both int64_t and double should be able to represent this exactly
@@ -112,6 +114,7 @@
 #define DEMUXER_CTRL_SWITCH_VIDEO 14
 #define DEMUXER_CTRL_IDENTIFY_PROGRAM 15
 #define DEMUXER_CTRL_CORRECT_PTS 16
+#define DEMUXER_CTRL_SEEK_POS 17 /* demux_seek_pos_t, see seekidx.h */
 
 #define SEEK_ABSOLUTE (1 << 0)
 #define SEEK_FACTOR   (1 << 1)
@@ -273,6 +276,8 @@ typedef struct demuxer {
 
   void* priv;  // fileformat-dependent data
   char** info;
+
+  struct seek_index *seekidx; ///< cached keyframe positions, see seekidx.h
 } demuxer_t;
 
 typedef struct {
@@ -328,6 +333,31 @@ static inline demux_packet_t* clone_demux_packet(demux_packet_t* pack){
   return dp;
 }
 
+/**
+ * packet of len bytes at buf, which stay valid as long as pack does.
+ * MP_INPUT_BUFFER_PADDING_SIZE readable bytes must follow, decoders expect
+ * them to be zero: unless they are the packet holds a copy instead.
+ */
+static inline demux_packet_t* new_demux_packet_ref(demux_packet_t* pack,
+                                                   unsigned char* buf, int len){
+  static const unsigned char zero[MP_INPUT_BUFFER_PADDING_SIZE];
+  demux_packet_t* dp;
+  if(memcmp(buf+len, zero, MP_INPUT_BUFFER_PADDING_SIZE)){
+    dp=new_demux_packet(len);
+    memcpy(dp->buffer, buf, len);
+    return dp;
+  }
+  dp=clone_demux_packet(pack);
+  dp->len=len;
+  dp->buffer=buf;
+  dp->pts=MP_NOPTS_VALUE;
+  dp->endpts=MP_NOPTS_VALUE;
+  dp->stream_pts=MP_NOPTS_VALUE;
+  dp->pos=0;
+  dp->flags=0;
+  return dp;
+}
+
 static inline void free_demux_packet(demux_packet_t* dp){
   if (dp->master==NULL){  //dp is a master packet
     dp->refcount--;
@@ -360,6 +390,7 @@ void free_demuxer_stream(demux_stream_t *ds);
 void free_demuxer(demuxer_t *demuxer);
 
 void ds_add_packet(demux_stream_t *ds,demux_packet_t* dp);
+demux_packet_t *demux_read_packet(demuxer_t *demuxer, stream_t *stream, int len);
 void ds_read_packet(demux_stream_t *ds, stream_t *stream, int len, double pts, off_t pos, int flags);
 
 int demux_fill_buffer(demuxer_t *demux,demux_stream_t *ds);
@@ -421,6 +452,9 @@ demuxer_t* demux_open(stream_t *stream,int file_format,int aid,int vid,int sid,c
 void demux_flush(demuxer_t *demuxer);
 int demux_seek(demuxer_t *demuxer,float rel_seek_secs,float audio_delay,int flags);
 demuxer_t*  new_demuxers_demuxer(demuxer_t* vd, demuxer_t* ad, demuxer_t* sd);
+demuxer_t *new_concat_demuxer(demuxer_t *vd, int aid, int vid, int sid);
+demuxer_t *demux_open_stream(stream_t *stream, int file_format, int force,
+                             int aid, int vid, int sid, char *filename);
 
 // AVI demuxer params:
 extern int index_mode;  // -1=untouched  0=don't use index  1=use (geneate) index
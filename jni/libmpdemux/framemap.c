@@ -0,0 +1,228 @@
+/*
+ * sampled frame position table for seeking in headerless audio streams
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "config.h"
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "mp_msg.h"
+#include "stream/stream.h"
+#include "demuxer.h"
+#include "framemap.h"
+
+#define FRAME_MAP_MAX_ENTRIES (1 << 18)
+#define FRAME_MAP_MAX_HDR     16
+
+struct frame_map {
+    double interval;
+    frame_map_entry_t *entries;
+    int num, max;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_t lock;
+    pthread_t thread;
+    stream_t *stream;           ///< of the scan, NULL if none is running
+    off_t start, end;
+    int hdr_size;
+    frame_map_parse_t parse;
+    volatile int abort;
+#endif
+};
+
+#ifdef HAVE_PTHREADS
+#define LOCK(map)   pthread_mutex_lock(&(map)->lock)
+#define UNLOCK(map) pthread_mutex_unlock(&(map)->lock)
+#else
+#define LOCK(map)
+#define UNLOCK(map)
+#endif
+
+frame_map_t *frame_map_new(double interval)
+{
+    frame_map_t *map = calloc(1, sizeof(*map));
+
+    if (!map)
+        return NULL;
+    map->interval = interval;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&map->lock, NULL);
+#endif
+    return map;
+}
+
+/// \return index of the first entry after pts
+static int find_after(frame_map_t *map, double pts)
+{
+    int lo = 0, hi = map->num;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (map->entries[mid].pts <= pts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void frame_map_add(frame_map_t *map, double pts, off_t pos)
+{
+    frame_map_entry_t *e;
+    int i;
+
+    if (!map)
+        return;
+    LOCK(map);
+    i = find_after(map, pts);
+    // the scan and playback may both add the same stretch
+    if ((i > 0 && pts - map->entries[i - 1].pts < map->interval / 2) ||
+        (i < map->num && map->entries[i].pts - pts < map->interval / 2))
+        goto out;
+    if (map->num == map->max) {
+        int max = map->max ? 2 * map->max : 256;
+        if (max > FRAME_MAP_MAX_ENTRIES)
+            goto out;
+        e = realloc(map->entries, max * sizeof(*e));
+        if (!e)
+            goto out;
+        map->entries = e;
+        map->max = max;
+    }
+    e = map->entries + i;
+    memmove(e + 1, e, (map->num - i) * sizeof(*e));
+    e->pts = pts;
+    e->pos = pos;
+    map->num++;
+out:
+    UNLOCK(map);
+}
+
+int frame_map_find(frame_map_t *map, double pts, frame_map_entry_t *e)
+{
+    int i, found = 0;
+
+    if (!map)
+        return 0;
+    LOCK(map);
+    i = find_after(map, pts);
+    if (i > 0 && pts - map->entries[i - 1].pts < 2 * map->interval) {
+        *e = map->entries[i - 1];
+        found = 1;
+    }
+    UNLOCK(map);
+    return found;
+}
+
+int frame_map_last(frame_map_t *map, frame_map_entry_t *e)
+{
+    int found = 0;
+
+    if (!map)
+        return 0;
+    LOCK(map);
+    if (map->num) {
+        *e = map->entries[map->num - 1];
+        found = 1;
+    }
+    UNLOCK(map);
+    return found;
+}
+
+#ifdef HAVE_PTHREADS
+static void *scan_thread(void *arg)
+{
+    frame_map_t *map = arg;
+    stream_t *s = map->stream;
+    unsigned char hdr[FRAME_MAP_MAX_HDR];
+    double pts = 0, last = -map->interval, duration;
+    off_t pos;
+    int len;
+
+    if (!stream_seek(s, map->start))
+        return NULL;
+    while (!map->abort) {
+        pos = stream_tell(s);
+        if (pos + map->hdr_size > map->end ||
+            stream_read(s, hdr, map->hdr_size) != map->hdr_size)
+            break;
+        len = map->parse(hdr, &duration);
+        if (len < map->hdr_size) {
+            stream_skip(s, 1 - map->hdr_size);
+            continue;
+        }
+        if (pts - last >= map->interval) {
+            frame_map_add(map, pts, pos);
+            last = pts;
+        }
+        pts += duration;
+        stream_skip(s, len - map->hdr_size);
+    }
+    mp_msg(MSGT_DEMUX, MSGL_V, "frame map: scanned %.1f s%s\n", pts,
+           map->abort ? " (aborted)" : "");
+    return NULL;
+}
+#endif
+
+int frame_map_scan(frame_map_t *map, stream_t *s, off_t start, off_t end,
+                   int hdr_size, frame_map_parse_t parse)
+{
+#ifdef HAVE_PTHREADS
+    int file_format = DEMUXER_TYPE_UNKNOWN;
+
+    // only worth it where reading the whole file is cheap
+    if (!map || map->stream || s->type != STREAMTYPE_FILE || !s->url ||
+        !strcmp(s->url, "-") || hdr_size > FRAME_MAP_MAX_HDR)
+        return 0;
+    map->stream = open_stream(s->url, NULL, &file_format);
+    if (!map->stream)
+        return 0;
+    map->start = start;
+    map->end = end ? end : s->end_pos;
+    map->hdr_size = hdr_size;
+    map->parse = parse;
+    if (pthread_create(&map->thread, NULL, scan_thread, map)) {
+        free_stream(map->stream);
+        map->stream = NULL;
+        return 0;
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void frame_map_free(frame_map_t *map)
+{
+    if (!map)
+        return;
+#ifdef HAVE_PTHREADS
+    if (map->stream) {
+        map->abort = 1;
+        pthread_join(map->thread, NULL);
+        free_stream(map->stream);
+    }
+    pthread_mutex_destroy(&map->lock);
+#endif
+    free(map->entries);
+    free(map);
+}
@@ -0,0 +1,63 @@
+/*
+ * sampled frame position table for seeking in headerless audio streams
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_FRAMEMAP_H
+#define MPLAYER_FRAMEMAP_H
+
+#include <sys/types.h>
+#include "stream/stream.h"
+
+typedef struct frame_map_entry {
+    double pts;
+    off_t pos;
+} frame_map_entry_t;
+
+typedef struct frame_map frame_map_t;
+
+/**
+ * Parser for the background scan.
+ * \return the length of the frame starting at hdr, <= 0 if there is none
+ */
+typedef int (*frame_map_parse_t)(unsigned char *hdr, double *duration);
+
+/**
+ * Frame positions are stored at most once per interval seconds. All entries
+ * must be exact: the demuxer only adds frames whose timestamp was counted
+ * from the start or from another entry.
+ */
+frame_map_t *frame_map_new(double interval);
+void frame_map_add(frame_map_t *map, double pts, off_t pos);
+/**
+ * \brief find the last entry at or before pts
+ * \return 1 if found and pts is less than two intervals after it
+ */
+int frame_map_find(frame_map_t *map, double pts, frame_map_entry_t *e);
+/// \return the last entry, 0 if the map is empty
+int frame_map_last(frame_map_t *map, frame_map_entry_t *e);
+/**
+ * \brief scan the frames in [start, end) of the file s is reading, in a
+ * background thread with a stream of its own
+ * \return 1 if the scan was started
+ */
+int frame_map_scan(frame_map_t *map, stream_t *s, off_t start, off_t end,
+                   int hdr_size, frame_map_parse_t parse);
+void frame_map_free(frame_map_t *map);
+
+#endif /* MPLAYER_FRAMEMAP_H */
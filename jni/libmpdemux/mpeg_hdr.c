@@ -542,3 +542,42 @@ int mp_vc1_decode_sequence_header(mp_mpeg_header_t * picture, unsigned char * bu
   //free(dest);
   return 1;
 }
+
+/// \return 1 if buf starts a keyframe or the headers in front of one
+int mp_es_keyframe_start(unsigned int format, const unsigned char *buf, int len)
+{
+    uint32_t state = -1;
+    int i;
+
+    // keyframes start within the first bytes of a PES payload
+    if (len > 256)
+        len = 256;
+    for (i = 0; i < len - 1; i++) {
+        state = state << 8 | buf[i];
+        if ((state & 0xffffff00) != 0x100)
+            continue;
+        switch (format) {
+        case 0x10000001:        // MPEG-1
+        case 0x10000002:        // MPEG-2
+            if (state == 0x1b3 || state == 0x1b8)
+                return 1;
+            break;
+        case 0x10000004:        // MPEG-4
+            if (state == 0x1b0 || (state & ~0xf) == 0x120
+                || (state == 0x1b6 && !(buf[i + 1] & 0xc0)))
+                return 1;
+            break;
+        case 0x10000005:        // H.264
+            if ((state & 0x1f) == 5 || (state & 0x1f) == 7)
+                return 1;
+            break;
+        case 0x31435657:         // WVC1
+            if (state == 0x10e || state == 0x10f)
+                return 1;
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
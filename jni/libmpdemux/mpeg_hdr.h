@@ -49,6 +49,7 @@ int mp4_header_process_vol(mp_mpeg_header_t * picture, unsigned char * buffer);
 void mp4_header_process_vop(mp_mpeg_header_t * picture, unsigned char * buffer);
 int h264_parse_sps(mp_mpeg_header_t * picture, unsigned char * buf, int len);
 int mp_vc1_decode_sequence_header(mp_mpeg_header_t * picture, unsigned char * buf, int len);
+int mp_es_keyframe_start(unsigned int format, const unsigned char *buf, int len);
 
 unsigned char mp_getbits(unsigned char *buffer, unsigned int from, unsigned char len);
 
@@ -47,9 +47,13 @@ extern char *info_comment;
 #define ODML_CHUNKLEN    0x40000000
 #define ODML_NOTKEYFRAME 0x80000000U
 #define MOVIALIGN        0x00001000
+/* superindex entries reserved per stream with -odmlflush, a day's worth */
+#define ODML_FLUSH_SPAN  (24*60*60)
+#define ODML_MAX_SUPERIDX 16384
 
 float avi_aspect_override = -1.0;
 int write_odml = 1;
+float odml_flush = 0;
 
 struct avi_odmlidx_entry {
 	uint64_t ofs;
@@ -73,8 +77,15 @@ struct avi_stream_info {
 	off_t *riffofs;
 	struct avi_odmlidx_entry *idx;
 	struct avi_odmlsuperidx_entry *superidx;
+	double next_flush;  ///< timer of the def_v stream at the next -odmlflush
 };
 
+/// -odmlflush: the file is OpenDML from the start and its index is written as it goes
+static int odml_streaming(void)
+{
+    return odml_flush > 0 && write_odml == 1;
+}
+
 static unsigned int avi_aspect(muxer_stream_t *vstream)
 {
     int x,y;
@@ -128,6 +139,13 @@ static muxer_stream_t* avifile_new_stream(muxer_t *muxer,int type){
     si->riffofssize=16;
     si->riffofs=calloc((si->riffofssize+1), sizeof(off_t));
     memset(si->riffofs, 0, sizeof(off_t)*si->riffofssize);
+    if (odml_streaming()) {
+        // the header must not grow later, so its superindex is sized up front
+        float n = ODML_FLUSH_SPAN / odml_flush + 256;
+        si->superidxsize = n > ODML_MAX_SUPERIDX ? ODML_MAX_SUPERIDX : n;
+        si->superidx = calloc(si->superidxsize, sizeof(*si->superidx));
+        si->next_flush = odml_flush;
+    }
 
     switch(type){
     case MUXER_TYPE_VIDEO:
@@ -204,6 +222,8 @@ static void avifile_odml_new_riff(muxer_t *muxer)
 }
 
 static void avifile_write_header(muxer_t *muxer);
+static void avifile_odml_flush_index(muxer_t *muxer);
+static void avifile_odml_update_header(muxer_t *muxer);
 
 static void avifile_write_chunk(muxer_stream_t *s,size_t len,unsigned int flags, double dts, double pts){
     off_t rifflen;
@@ -224,10 +244,18 @@ static void avifile_write_chunk(muxer_stream_t *s,size_t len,unsigned int flags,
 	rifflen += 8+muxer->idx_pos*sizeof(AVIINDEXENTRY);
     }
     if (rifflen + paddedlen > ODML_CHUNKLEN && write_odml == 1) {
+	// the ix## offsets of a flush are 32 bit, so they must not span RIFFs
+	if (odml_streaming())
+	    avifile_odml_flush_index(muxer);
 	if (vsi->riffofspos == 0) {
             avifile_write_standard_index(muxer);
 	}
 	avifile_odml_new_riff(muxer);
+	if (odml_streaming())
+	    avifile_odml_update_header(muxer);
+    } else if (odml_streaming() && muxer->def_v->timer >= vsi->next_flush) {
+	avifile_odml_flush_index(muxer);
+	avifile_odml_update_header(muxer);
     }
 
     if (vsi->riffofspos == 0) {
@@ -279,7 +307,7 @@ static void write_avi_list(stream_t *stream,unsigned int id,int len){
 
 #define WFSIZE(wf) (sizeof(WAVEFORMATEX)+(wf)->cbSize)
 
-static void avifile_write_header(muxer_t *muxer){
+static void avifile_put_header(muxer_t *muxer, int msgl){
   uint32_t riff[3];
   unsigned int dmlh[1];
   unsigned int i;
@@ -288,13 +316,14 @@ static void avifile_write_header(muxer_t *muxer){
   VideoPropHeader vprp;
   uint32_t aspect = avi_aspect(muxer->def_v);
   struct avi_stream_info *vsi = muxer->def_v->priv;
-  int isodml = vsi->riffofspos > 0;
+  int isodml = vsi->riffofspos > 0 || odml_streaming();
+  int junk;
 
-  mp_msg(MSGT_MUXER, MSGL_INFO, MSGTR_WritingHeader);
+  mp_msg(MSGT_MUXER, msgl, MSGTR_WritingHeader);
   if (aspect == 0) {
-    mp_msg(MSGT_MUXER, MSGL_INFO, "ODML: Aspect information not (yet?) available or unspecified, not writing vprp header.\n");
+    mp_msg(MSGT_MUXER, msgl, "ODML: Aspect information not (yet?) available or unspecified, not writing vprp header.\n");
   } else {
-    mp_msg(MSGT_MUXER, MSGL_INFO, "ODML: vprp aspect is %d:%d.\n", aspect >> 16, aspect & 0xffff);
+    mp_msg(MSGT_MUXER, msgl, "ODML: vprp aspect is %d:%d.\n", aspect >> 16, aspect & 0xffff);
   }
 
   /* deal with stream delays */
@@ -302,15 +331,15 @@ static void avifile_write_header(muxer_t *muxer){
       muxer_stream_t *s = muxer->streams[i];
       if (s->type == MUXER_TYPE_AUDIO && muxer->audio_delay_fix > 0.0) {
           s->h.dwStart = muxer->audio_delay_fix * s->h.dwRate/s->h.dwScale + 0.5;
-          mp_msg(MSGT_MUXER, MSGL_INFO, MSGTR_SettingAudioDelay, (float)s->h.dwStart * s->h.dwScale/s->h.dwRate);
+          mp_msg(MSGT_MUXER, msgl, MSGTR_SettingAudioDelay, (float)s->h.dwStart * s->h.dwScale/s->h.dwRate);
       }
       if (s->type == MUXER_TYPE_VIDEO && muxer->audio_delay_fix < 0.0) {
           s->h.dwStart = -muxer->audio_delay_fix * s->h.dwRate/s->h.dwScale + 0.5;
-          mp_msg(MSGT_MUXER, MSGL_INFO, MSGTR_SettingVideoDelay, (float)s->h.dwStart * s->h.dwScale/s->h.dwRate);
+          mp_msg(MSGT_MUXER, msgl, MSGTR_SettingVideoDelay, (float)s->h.dwStart * s->h.dwScale/s->h.dwRate);
       }
   }
 
-  if (isodml) {
+  if (vsi->riffofspos > 0) {
       unsigned int rifflen, movilen;
       int i;
 
@@ -549,14 +578,18 @@ info[i].id=0;
   }
 
   // JUNK:
-  write_avi_chunk(muxer->stream,ckidAVIPADDING,MOVIALIGN-(stream_tell(muxer->stream)%MOVIALIGN)-8,NULL); /* junk */
+  junk = MOVIALIGN-(stream_tell(muxer->stream)%MOVIALIGN)-8;
+  if (junk < 0) junk += MOVIALIGN;
+  write_avi_chunk(muxer->stream,ckidAVIPADDING,junk,NULL); /* junk */
   if (!isodml) {
     // 'movi' header:
     write_avi_list(muxer->stream,listtypeAVIMOVIE,muxer->movi_end-stream_tell(muxer->stream)-12);
   } else {
-    if (stream_tell(muxer->stream) != MOVIALIGN) {
+    // with -odmlflush the reserved superindex may need more than MOVIALIGN
+    off_t expected = muxer->movi_start ? muxer->movi_start-12 : stream_tell(muxer->stream);
+    if (stream_tell(muxer->stream) != expected) {
 	mp_msg(MSGT_MUXER, MSGL_ERR, "Opendml superindex is too big for reserved space!\n");
-	mp_msg(MSGT_MUXER, MSGL_ERR, "Expected filepos %d, real filepos %ld, missing space %ld\n", MOVIALIGN, stream_tell(muxer->stream), stream_tell(muxer->stream)-MOVIALIGN);
+	mp_msg(MSGT_MUXER, MSGL_ERR, "Expected filepos %ld, real filepos %ld, missing space %ld\n", (long)expected, (long)stream_tell(muxer->stream), (long)(stream_tell(muxer->stream)-expected));
 	mp_msg(MSGT_MUXER, MSGL_ERR, "Try increasing MOVIALIGN in libmpdemux/muxer_avi.c\n");
     }
     write_avi_list(muxer->stream,listtypeAVIMOVIE,muxer->movi_end-stream_tell(muxer->stream)-12);
@@ -565,6 +598,79 @@ info[i].id=0;
   if (muxer->file_end == 0) muxer->file_end = stream_tell(muxer->stream);
 }
 
+static void avifile_write_header(muxer_t *muxer){
+  avifile_put_header(muxer, MSGL_INFO);
+}
+
+/*
+ * -odmlflush: write the entries gathered since the last flush as one ix##
+ * chunk per stream into the current movi list and drop them. The index
+ * then takes constant memory and the superindex can point at it at once.
+ */
+static void avifile_odml_flush_index(muxer_t *muxer){
+  struct avi_stream_info *vsi = muxer->def_v->priv;
+  int i, j;
+
+  for (i=0; i<muxer->avih.dwStreams; i++) {
+    muxer_stream_t *s = muxer->streams[i];
+    struct avi_stream_info *si = s->priv;
+    struct avi_odmlsuperidx_entry *entry;
+    unsigned int idxhdr[8];
+    off_t start;
+
+    if (si->idxpos == 0)
+      continue;
+    if (si->superidxpos >= si->superidxsize) {
+      // only found by scanning the file
+      si->idxpos = 0;
+      continue;
+    }
+    start = si->idx[0].ofs;
+
+    entry = &si->superidx[si->superidxpos++];
+    entry->ofs = stream_tell(muxer->stream);
+    entry->len = 32 + 8*si->idxpos;
+    entry->duration = 0;
+    for (j=0; j<si->idxpos; j++)
+      entry->duration += s->h.dwSampleSize ? si->idx[j].len/s->h.dwSampleSize : 1;
+
+    idxhdr[0] = le2me_32((s->ckid << 16) | mmioFOURCC('i', 'x', 0, 0));
+    idxhdr[1] = le2me_32(24 + 8*si->idxpos);
+    idxhdr[2] = le2me_32(0x01000002);
+    idxhdr[3] = le2me_32(si->idxpos);
+    idxhdr[4] = le2me_32(s->ckid);
+    idxhdr[5] = le2me_32(start + 8);
+    idxhdr[6] = le2me_32((start + 8)>> 32);
+    idxhdr[7] = 0; /* unused */
+    stream_write_buffer(muxer->stream, idxhdr, sizeof(idxhdr));
+    for (j=0; j<si->idxpos; j++) {
+      unsigned int data[2];
+      data[0] = le2me_32(si->idx[j].ofs - start);
+      data[1] = le2me_32(si->idx[j].len | si->idx[j].flags);
+      stream_write_buffer(muxer->stream, data, sizeof(data));
+    }
+    si->idxpos = 0;
+
+    if (si->superidxpos == si->superidxsize)
+      mp_msg(MSGT_MUXER, MSGL_WARN, "ODML: Superindex of stream %d is full, the rest of it will not be indexed.\n", i);
+  }
+  muxer->file_end = stream_tell(muxer->stream);
+  vsi->next_flush = muxer->def_v->timer + odml_flush;
+}
+
+/// rewrite the header in place so that the file is playable as it is now
+static void avifile_odml_update_header(muxer_t *muxer){
+  struct avi_stream_info *vsi = muxer->def_v->priv;
+  off_t pos = stream_tell(muxer->stream);
+
+  // the first RIFF has no idx1 yet, its movi list ends with the file
+  if (vsi->riffofspos == 0)
+    muxer->movi_end = muxer->file_end;
+  stream_seek(muxer->stream, 0);
+  avifile_put_header(muxer, MSGL_V);
+  stream_seek(muxer->stream, pos);
+}
+
 static void avifile_odml_write_index(muxer_t *muxer){
   muxer_stream_t* s;
   struct avi_stream_info *si;
@@ -670,7 +776,11 @@ static void avifile_write_index(muxer_t *muxer){
   struct avi_stream_info *vsi = muxer->def_v->priv;
 
   mp_msg(MSGT_MUXER, MSGL_INFO, MSGTR_WritingTrailer);
-  if (vsi->riffofspos > 0){
+  if (odml_streaming()){
+    avifile_odml_flush_index(muxer);
+    if (vsi->riffofspos == 0)
+      avifile_write_standard_index(muxer);
+  } else if (vsi->riffofspos > 0){
     avifile_odml_write_index(muxer);
   } else {
     avifile_write_standard_index(muxer);
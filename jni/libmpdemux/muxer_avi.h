@@ -21,5 +21,6 @@
 
 extern float avi_aspect_override;
 extern int write_odml;
+extern float odml_flush;
 
 #endif /* MPLAYER_MUXER_AVI_H */
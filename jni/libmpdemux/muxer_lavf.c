@@ -73,6 +73,7 @@ static int mux_packet_size= 0;
 static float mux_preload= 0.5;
 static float mux_max_delay= 0.7;
 static char *mux_avopt = NULL;
+static int mux_stream = 0;
 
 const m_option_t lavfopts_conf[] = {
 	{"format", &(conf_format), CONF_TYPE_STRING, 0, 0, 0, NULL},
@@ -81,6 +82,7 @@ const m_option_t lavfopts_conf[] = {
 	{"preload", &mux_preload, CONF_TYPE_FLOAT, CONF_RANGE, 0, INT_MAX, NULL},
 	{"delay", &mux_max_delay, CONF_TYPE_FLOAT, CONF_RANGE, 0, INT_MAX, NULL},
         {"o", &mux_avopt, CONF_TYPE_STRING, 0, 0, 0, NULL},
+	{"stream", &mux_stream, CONF_TYPE_FLAG, 0, 0, 1, NULL},
 
 	{NULL, NULL, 0, 0, 0, 0, NULL}
 };
@@ -291,7 +293,9 @@ static void write_header(muxer_t *muxer)
 	muxer_priv_t *priv = (muxer_priv_t *) muxer->priv;
 
 	mp_msg(MSGT_MUXER, MSGL_INFO, MSGTR_WritingHeader);
-	av_write_header(priv->oc);
+	if(av_write_header(priv->oc) < 0)
+		mp_msg(MSGT_MUXER, MSGL_ERR, "Could not write header%s.\n",
+		       mux_stream ? ", the format may not support stream=1" : "");
 	muxer->cont_write_header = NULL;
 }
 
@@ -391,7 +395,10 @@ int muxer_init_muxer_lavf(muxer_t *muxer)
         }
 
 	priv->oc->pb = av_alloc_put_byte(priv->buffer, BIO_BUFFER_SIZE, 1, muxer, NULL, mp_write, mp_seek);
-	if ((muxer->stream->flags & MP_STREAM_SEEK) != MP_STREAM_SEEK)
+	// stream=1: written front to back and never revisited, so a file
+	// that is cut off is still playable (Matroska then writes small
+	// clusters and no cues)
+	if (mux_stream || (muxer->stream->flags & MP_STREAM_SEEK) != MP_STREAM_SEEK)
             priv->oc->pb->is_streamed = 1;
 
 	muxer->priv = (void *) priv;
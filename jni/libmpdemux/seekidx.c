@@ -0,0 +1,366 @@
+/*
+ * persistent keyframe index, cached between runs
+ *
+ * Formats without an index (or with one that is expensive to build) learn
+ * where their keyframes are while playing. The positions are saved in a
+ * cache directory under a fingerprint of the file and used by demux_seek
+ * when the same file is played again.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "path.h"
+#include "stream/stream.h"
+#include "demuxer.h"
+#include "stheader.h"
+#include "mpeg_hdr.h"
+#include "seekidx.h"
+
+#if defined(__MINGW32__)
+#define mkdir(a, b) mkdir(a)
+#endif
+
+int index_cache = 0;
+char *index_cache_dir = NULL;
+
+#define SEEKIDX_MAGIC       "MPSEEKIX"
+#define SEEKIDX_VERSION     1
+/// bytes at the start of the file that make up the fingerprint
+#define SEEKIDX_HASH_SIZE   (64 * 1024)
+#define SEEKIDX_MAX_ENTRIES (1 << 20)
+/// minimum distance between entries added while playing
+#define SEEKIDX_INTERVAL    1.0
+
+struct seekidx_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;    ///< DEMUXER_TYPE_*
+    int64_t size;       ///< stream size
+    uint32_t hash;      ///< FNV-1a of the first SEEKIDX_HASH_SIZE bytes
+    uint32_t count;
+};
+
+struct seekidx_entry {
+    double pts;
+    int64_t pos;
+    /// nonzero if everything between the previous entry and this one was
+    /// played, i.e. there is no unknown keyframe in between
+    uint32_t cont;
+    uint32_t reserved;
+};
+
+typedef struct seek_index {
+    char *path;
+    struct seekidx_header hdr;
+    struct seekidx_entry *entries;
+    int num, alloc;
+    int last;           ///< entry added last, -1 after a seek
+    int dirty;
+    double start_pts;
+} seek_index_t;
+
+static uint32_t fnv1a(uint32_t h, const unsigned char *buf, int len)
+{
+    while (len-- > 0)
+        h = (h ^ *buf++) * 16777619;
+    return h;
+}
+
+/// \return index of the first entry with a pts greater than pts
+static int find_entry(seek_index_t *idx, double pts)
+{
+    int lo = 0, hi = idx->num;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (idx->entries[mid].pts <= pts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void load_index(seek_index_t *idx)
+{
+    struct seekidx_header hdr;
+    FILE *f = fopen(idx->path, "rb");
+    int i;
+
+    if (!f)
+        return;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1
+        || memcmp(hdr.magic, idx->hdr.magic, sizeof(hdr.magic))
+        || hdr.version != idx->hdr.version || hdr.format != idx->hdr.format
+        || hdr.size != idx->hdr.size || hdr.hash != idx->hdr.hash
+        || hdr.count > SEEKIDX_MAX_ENTRIES)
+        goto fail;
+    idx->entries = malloc(hdr.count * sizeof(*idx->entries));
+    if (!idx->entries
+        || fread(idx->entries, sizeof(*idx->entries), hdr.count, f) != hdr.count)
+        goto fail;
+    for (i = 0; i < hdr.count; i++) {
+        struct seekidx_entry *e = idx->entries + i;
+        if (e->pos < 0 || e->pos > hdr.size
+            || (i && (e->pts <= e[-1].pts || e->pos <= e[-1].pos)))
+            goto fail;
+    }
+    idx->num = idx->alloc = hdr.count;
+    fclose(f);
+    mp_msg(MSGT_DEMUX, MSGL_V, "[seekidx] %d entries loaded from %s\n",
+           idx->num, idx->path);
+    return;
+
+fail:
+    mp_msg(MSGT_DEMUX, MSGL_V, "[seekidx] ignoring invalid %s\n", idx->path);
+    free(idx->entries);
+    idx->entries = NULL;
+    fclose(f);
+}
+
+static void save_index(seek_index_t *idx)
+{
+    char *tmp = malloc(strlen(idx->path) + 5);
+    FILE *f;
+
+    if (!tmp)
+        return;
+    sprintf(tmp, "%s.tmp", idx->path);
+    f = fopen(tmp, "wb");
+    if (!f) {
+        mp_msg(MSGT_DEMUX, MSGL_V, "[seekidx] cannot write %s: %s\n",
+               tmp, strerror(errno));
+        free(tmp);
+        return;
+    }
+    idx->hdr.count = idx->num;
+    if (fwrite(&idx->hdr, sizeof(idx->hdr), 1, f) != 1
+        || fwrite(idx->entries, sizeof(*idx->entries), idx->num, f) != idx->num
+        || fclose(f)) {
+        remove(tmp);
+    } else if (rename(tmp, idx->path)) {
+        remove(tmp);
+    } else
+        mp_msg(MSGT_DEMUX, MSGL_V, "[seekidx] %d entries saved to %s\n",
+               idx->num, idx->path);
+    free(tmp);
+}
+
+void seekidx_open(demuxer_t *demuxer, double start_pts)
+{
+    stream_t *s = demuxer->stream;
+    seek_index_t *idx;
+    unsigned char *buf;
+    char *dir, name[64];
+    off_t pos;
+    int len;
+
+    // the hash reads the start again, cheap only for local files
+    if (!index_cache || demuxer->seekidx || !demuxer->seekable
+        || s->end_pos <= 0 || (s->flags & MP_STREAM_SEEK) != MP_STREAM_SEEK
+        || s->type != STREAMTYPE_FILE)
+        return;
+
+    idx = calloc(1, sizeof(*idx));
+    buf = malloc(SEEKIDX_HASH_SIZE);
+    if (!idx || !buf) {
+        free(idx);
+        free(buf);
+        return;
+    }
+    pos = stream_tell(s);
+    stream_seek(s, s->start_pos);
+    len = stream_read(s, buf, SEEKIDX_HASH_SIZE);
+    stream_seek(s, pos);
+    s->eof = 0;
+
+    memcpy(idx->hdr.magic, SEEKIDX_MAGIC, sizeof(idx->hdr.magic));
+    idx->hdr.version = SEEKIDX_VERSION;
+    idx->hdr.format = demuxer->file_format;
+    idx->hdr.size = s->end_pos;
+    idx->hdr.hash = fnv1a(2166136261U, buf, len);
+    idx->start_pts = start_pts;
+    idx->last = -1;
+    free(buf);
+
+    dir = index_cache_dir ? strdup(index_cache_dir) : get_path("seekidx");
+    if (!dir) {
+        free(idx);
+        return;
+    }
+    mkdir(dir, 0755);
+    snprintf(name, sizeof(name), "/%08x-%"PRIx64".idx", idx->hdr.hash,
+             (uint64_t)idx->hdr.size);
+    idx->path = malloc(strlen(dir) + strlen(name) + 1);
+    if (idx->path) {
+        strcpy(idx->path, dir);
+        strcat(idx->path, name);
+        load_index(idx);
+        demuxer->seekidx = idx;
+    } else
+        free(idx);
+    free(dir);
+}
+
+void seekidx_add(demuxer_t *demuxer, double pts, off_t pos)
+{
+    seek_index_t *idx = demuxer->seekidx;
+    struct seekidx_entry *e;
+    int i, cont;
+
+    if (!idx || pts == MP_NOPTS_VALUE || pos < 0 || pos > idx->hdr.size)
+        return;
+
+    i = find_entry(idx, pts);
+    // a keyframe we already know, just note that playback got here
+    if (i > 0 && idx->entries[i - 1].pos == pos
+        && idx->entries[i - 1].pts == pts) {
+        i--;
+        if (idx->last >= 0 && i == idx->last + 1 && !idx->entries[i].cont) {
+            idx->entries[i].cont = 1;
+            idx->dirty = 1;
+        }
+        idx->last = i;
+        return;
+    }
+    if (idx->last >= 0) {
+        e = idx->entries + idx->last;
+        if (pts < e->pts + SEEKIDX_INTERVAL || pos <= e->pos)
+            return;
+        // the next known keyframe is close, it will be linked instead
+        if (i < idx->num && i == idx->last + 1
+            && idx->entries[i].pts < pts + SEEKIDX_INTERVAL)
+            return;
+    }
+    // timestamps that do not grow with the file position (discontinuities,
+    // wraps) cannot be used for seeking
+    if ((i > 0 && (idx->entries[i - 1].pos >= pos
+                   || idx->entries[i - 1].pts == pts))
+        || (i < idx->num && idx->entries[i].pos <= pos)) {
+        idx->last = -1;
+        return;
+    }
+    if (idx->num >= SEEKIDX_MAX_ENTRIES)
+        return;
+    if (idx->num == idx->alloc) {
+        int n = idx->alloc ? 2 * idx->alloc : 256;
+        e = realloc(idx->entries, n * sizeof(*e));
+        if (!e)
+            return;
+        idx->entries = e;
+        idx->alloc = n;
+    }
+    // inside a stretch that was played through before, or continuing one
+    cont = (idx->last >= 0 && idx->last == i - 1)
+           || (i < idx->num && idx->entries[i].cont);
+    e = idx->entries + i;
+    memmove(e + 1, e, (idx->num - i) * sizeof(*e));
+    e->pts = pts;
+    e->pos = pos;
+    e->cont = cont;
+    e->reserved = 0;
+    idx->num++;
+    idx->last = i;
+    idx->dirty = 1;
+}
+
+void seekidx_add_video(demuxer_t *demuxer, demux_packet_t *dp, off_t pos)
+{
+    sh_video_t *sh = demuxer->video->sh;
+
+    if (!demuxer->seekidx || !sh || dp->pts == MP_NOPTS_VALUE)
+        return;
+    if (mp_es_keyframe_start(sh->format, dp->buffer, dp->len))
+        seekidx_add(demuxer, dp->pts, pos);
+}
+
+int seekidx_seek(demuxer_t *demuxer, float rel_seek_secs, int flags)
+{
+    seek_index_t *idx = demuxer->seekidx;
+    demux_stream_t *ds;
+    demux_seek_pos_t sp;
+    double cur = MP_NOPTS_VALUE, target;
+    int i;
+
+    if (!idx)
+        return 0;
+    // whatever is played next is not continuous with the previous entry
+    idx->last = -1;
+    if ((flags & SEEK_FACTOR) || idx->num < 2)
+        return 0;
+
+    if (flags & SEEK_ABSOLUTE) {
+        if (idx->start_pts == MP_NOPTS_VALUE)
+            return 0;
+        target = idx->start_pts + rel_seek_secs;
+    } else {
+        ds = demuxer->video->sh ? demuxer->video : demuxer->audio;
+        if (!ds->sh || ds->pts == MP_NOPTS_VALUE)
+            return 0;
+        cur = ds->pts;
+        target = cur + rel_seek_secs;
+    }
+
+    // the last keyframe at or before target, which we only know to be the
+    // closest one if playback went on from there
+    i = find_entry(idx, target) - 1;
+    if (i < 0)
+        return 0;
+    if (idx->entries[i].pts != target
+        && (i + 1 >= idx->num || !idx->entries[i + 1].cont))
+        return 0;
+    // a forward seek must not end up behind the current position
+    if (cur != MP_NOPTS_VALUE && rel_seek_secs > 0
+        && idx->entries[i].pts <= cur) {
+        if (i + 1 >= idx->num || !idx->entries[i + 1].cont)
+            return 0;
+        i++;
+    }
+
+    sp.pts = idx->entries[i].pts;
+    sp.pos = idx->entries[i].pos;
+    sp.target = target;
+    if (demux_control(demuxer, DEMUXER_CTRL_SEEK_POS, &sp) != DEMUXER_CTRL_OK)
+        return 0;
+    mp_msg(MSGT_DEMUX, MSGL_DBG2, "[seekidx] seek to %.3f: %.3f at 0x%"PRIx64"\n",
+           target, sp.pts, (uint64_t)sp.pos);
+    return 1;
+}
+
+void seekidx_close(demuxer_t *demuxer)
+{
+    seek_index_t *idx = demuxer->seekidx;
+
+    if (!idx)
+        return;
+    if (idx->dirty && idx->num >= 2)
+        save_index(idx);
+    free(idx->entries);
+    free(idx->path);
+    free(idx);
+    demuxer->seekidx = NULL;
+}
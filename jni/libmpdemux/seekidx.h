@@ -0,0 +1,51 @@
+/*
+ * persistent keyframe index, cached between runs
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_SEEKIDX_H
+#define MPLAYER_SEEKIDX_H
+
+#include <sys/types.h>
+#include "demuxer.h"
+
+extern int index_cache;
+extern char *index_cache_dir;
+
+/// argument of DEMUXER_CTRL_SEEK_POS
+typedef struct demux_seek_pos {
+    double pts;     ///< timestamp of the keyframe at pos
+    off_t pos;      ///< where the demuxer can resume reading
+    double target;  ///< requested time, the demuxer may skip ahead to it
+} demux_seek_pos_t;
+
+/**
+ * Demuxers that implement DEMUXER_CTRL_SEEK_POS call seekidx_open() when
+ * they are done opening and then report resume points while playing.
+ * start_pts is the timestamp of the first frame, MP_NOPTS_VALUE if it is
+ * unknown, which disables the index for absolute seeks.
+ */
+void seekidx_open(demuxer_t *demuxer, double start_pts);
+void seekidx_add(demuxer_t *demuxer, double pts, off_t pos);
+/// add pos if dp is the start of a video keyframe (MPEG-ES style formats)
+void seekidx_add_video(demuxer_t *demuxer, demux_packet_t *dp, off_t pos);
+/// \return 1 if the seek was done with the index
+int seekidx_seek(demuxer_t *demuxer, float rel_seek_secs, int flags);
+void seekidx_close(demuxer_t *demuxer);
+
+#endif /* MPLAYER_SEEKIDX_H */
@@ -67,10 +67,12 @@ typedef struct sh_audio {
   char* a_buffer;
   int a_buffer_len;
   int a_buffer_size;
-  // output buffers:
+  int a_buffer_pos;      // decoded data starts here, only moved down when needed
+  // output buffers: ring buffer, see mp_audio_out_peek()
   char* a_out_buffer;
   int a_out_buffer_len;
   int a_out_buffer_size;
+  int a_out_buffer_pos;  // read position
 //  void* audio_out;        // the audio_out handle, used for this audio stream
   struct af_stream *afilter;          // the audio filter stream
   const struct ad_functions *ad_driver;
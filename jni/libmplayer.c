@@ -0,0 +1,321 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "mp_msg.h"
+#include "mp_core.h"
+#include "m_property.h"
+#include "input/input.h"
+#include "mp_fifo.h"
+#include "libavutil/avstring.h"
+#include "libmplayer.h"
+
+int libmplayer_embedded = 0;
+
+#ifdef HAVE_PTHREADS
+
+static const char * const default_args[] = {
+    "-noconsolecontrols", "-idle", "-vo", "embed,"
+};
+#define NUM_DEFAULT_ARGS (sizeof(default_args) / sizeof(default_args[0]))
+
+/// a request executed on the player thread
+struct embed_call {
+    void (*func)(MPContext *mpctx, struct embed_call *call);
+    const char *name;
+    char *buf;
+    int len;
+    int ret;
+    int done;
+};
+
+static pthread_t player_thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t frame_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct libmplayer_frame frame;
+
+static libmplayer_callbacks_t callbacks;
+static void *cb_opaque;
+static int player_argc;
+static char **player_argv;
+static int ready;    ///< commands can be queued
+static int running;  ///< player thread is not shutting down
+static int thread_started;
+static int started_once; ///< main() has run, its globals are stale now
+
+int main(int argc, char *argv[]);
+
+static void *player_thread_func(void *arg)
+{
+    main(player_argc, player_argv);
+    // main() always leaves through exit_player_with_rc()
+    return NULL;
+}
+
+int libmplayer_create(int argc, char **argv,
+                      const libmplayer_callbacks_t *cb, void *opaque)
+{
+    int i;
+    if (libmplayer_embedded)
+        return -1;
+    if (started_once) {
+        mp_msg(MSGT_CPLAYER, MSGL_ERR,
+               "[libmplayer] The player can only be started once per process.\n");
+        return -1;
+    }
+    player_argv = calloc(argc + NUM_DEFAULT_ARGS + 1, sizeof(char *));
+    if (!player_argv)
+        return -1;
+    // keep argv[0] in front, user arguments override the defaults
+    player_argc = 0;
+    player_argv[player_argc++] = strdup(argc > 0 ? argv[0] : "mplayer");
+    for (i = 0; i < NUM_DEFAULT_ARGS; i++)
+        player_argv[player_argc++] = strdup(default_args[i]);
+    for (i = 1; i < argc; i++)
+        player_argv[player_argc++] = strdup(argv[i]);
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    if (cb)
+        callbacks = *cb;
+    cb_opaque = opaque;
+    ready = 0;
+    running = 1;
+    libmplayer_embedded = 1;
+    if (pthread_create(&player_thread, NULL, player_thread_func, NULL)) {
+        running = 0;
+        libmplayer_destroy();
+        return -1;
+    }
+    thread_started = 1;
+    started_once = 1;
+
+    pthread_mutex_lock(&lock);
+    while (!ready && running)
+        pthread_cond_wait(&cond, &lock);
+    i = ready;
+    pthread_mutex_unlock(&lock);
+    if (!i) {
+        libmplayer_destroy();
+        return -1;
+    }
+    return 0;
+}
+
+void libmplayer_destroy(void)
+{
+    int i;
+    if (!libmplayer_embedded)
+        return;
+    pthread_mutex_lock(&lock);
+    i = running;
+    pthread_mutex_unlock(&lock);
+    if (i)
+        libmplayer_command("quit");
+    if (thread_started)
+        pthread_join(player_thread, NULL);
+    thread_started = 0;
+
+    for (i = 0; i < player_argc; i++)
+        free(player_argv[i]);
+    free(player_argv);
+    player_argv = NULL;
+    player_argc = 0;
+    libmplayer_set_frame_buffer(NULL, 0, 0, 0, 0);
+    libmplayer_embedded = 0;
+}
+
+static int post_cmd(mp_cmd_t *cmd)
+{
+    int r = 0;
+    pthread_mutex_lock(&lock);
+    // the queue is torn down by the player thread before it exits
+    if (ready && running)
+        r = mp_cmd_fifo_put(cmd);
+    else
+        mp_cmd_free(cmd);
+    pthread_mutex_unlock(&lock);
+    return r ? 0 : -1;
+}
+
+int libmplayer_command(const char *str)
+{
+    mp_cmd_t *cmd;
+    char *tmp = strdup(str);
+    if (!tmp)
+        return -1;
+    cmd = mp_input_parse_cmd(tmp);
+    free(tmp);
+    if (!cmd)
+        return -1;
+    return post_cmd(cmd);
+}
+
+static void get_property(MPContext *mpctx, struct embed_call *call)
+{
+    char *tmp;
+    int r = mp_property_do(call->name, M_PROPERTY_TO_STRING, &tmp, mpctx);
+    if (r <= 0) {
+        call->ret = -1;
+        return;
+    }
+    av_strlcpy(call->buf, tmp, call->len);
+    free(tmp);
+    call->ret = 0;
+}
+
+/**
+ * Run func on the player thread and wait for it.
+ * Commands posted this way run during pause without unpausing.
+ */
+static int player_call(struct embed_call *call)
+{
+    mp_cmd_t *cmd = calloc(1, sizeof(*cmd));
+    if (!cmd)
+        return -1;
+    cmd->id = MP_CMD_EMBED_CALL;
+    cmd->name = strdup("embed_call");
+    cmd->nargs = 1;
+    cmd->args[0].type = MP_CMD_ARG_VOID;
+    cmd->args[0].v.v = call;
+    cmd->args[1].type = -1;
+    cmd->pausing = 4;
+    call->ret = -1;
+    call->done = 0;
+    if (post_cmd(cmd) < 0)
+        return -1;
+
+    pthread_mutex_lock(&lock);
+    while (!call->done && running)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+    return call->done ? call->ret : -1;
+}
+
+int libmplayer_get_property(const char *name, char *buf, int len)
+{
+    struct embed_call call;
+    if (!buf || len <= 0)
+        return -1;
+    memset(&call, 0, sizeof(call));
+    call.func = get_property;
+    call.name = name;
+    call.buf = buf;
+    call.len = len;
+    return player_call(&call);
+}
+
+void libmplayer_set_frame_buffer(void *buf, int stride, int width, int height,
+                                 unsigned int fmt)
+{
+    pthread_mutex_lock(&frame_lock);
+    frame.buf = buf;
+    frame.stride = stride;
+    frame.width = width;
+    frame.height = height;
+    frame.fmt = fmt;
+    pthread_mutex_unlock(&frame_lock);
+}
+
+void libmplayer_run_call(MPContext *mpctx, void *arg)
+{
+    struct embed_call *call = arg;
+    call->func(mpctx, call);
+    pthread_mutex_lock(&lock);
+    call->done = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void libmplayer_event(int event, int arg, const char *str)
+{
+    if (!libmplayer_embedded)
+        return;
+    if (event == LIBMPLAYER_EVENT_READY) {
+        pthread_mutex_lock(&lock);
+        ready = 1;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+    if (callbacks.event)
+        callbacks.event(cb_opaque, event, arg, str);
+}
+
+void libmplayer_shutdown(void)
+{
+    // queued calls are freed with the command queue, fail their callers
+    pthread_mutex_lock(&lock);
+    running = 0;
+    ready = 0;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void libmplayer_exit(int rc)
+{
+    libmplayer_shutdown();
+    libmplayer_event(LIBMPLAYER_EVENT_EXIT, rc, NULL);
+    pthread_exit(NULL);
+}
+
+struct libmplayer_frame *libmplayer_lock_frame(void)
+{
+    pthread_mutex_lock(&frame_lock);
+    return &frame;
+}
+
+void libmplayer_unlock_frame(void)
+{
+    pthread_mutex_unlock(&frame_lock);
+}
+
+void libmplayer_frame_done(int width, int height)
+{
+    if (callbacks.frame)
+        callbacks.frame(cb_opaque, width, height);
+}
+
+#else /* HAVE_PTHREADS */
+
+int libmplayer_create(int argc, char **argv,
+                      const libmplayer_callbacks_t *cb, void *opaque)
+{
+    mp_msg(MSGT_CPLAYER, MSGL_ERR, "Embedding needs pthreads.\n");
+    return -1;
+}
+
+void libmplayer_destroy(void) {}
+int libmplayer_command(const char *cmd) { return -1; }
+int libmplayer_get_property(const char *name, char *buf, int len) { return -1; }
+void libmplayer_set_frame_buffer(void *buf, int stride, int width, int height,
+                                 unsigned int fmt) {}
+void libmplayer_event(int event, int arg, const char *str) {}
+void libmplayer_shutdown(void) {}
+void libmplayer_exit(int rc) {}
+void libmplayer_run_call(MPContext *mpctx, void *call) {}
+struct libmplayer_frame *libmplayer_lock_frame(void) { return NULL; }
+void libmplayer_unlock_frame(void) {}
+void libmplayer_frame_done(int width, int height) {}
+
+#endif /* HAVE_PTHREADS */
@@ -0,0 +1,111 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_LIBMPLAYER_H
+#define MPLAYER_LIBMPLAYER_H
+
+/*
+ * In-process embedding interface.
+ *
+ * The player keeps its state in globals, so only one instance can exist.
+ * It runs main() on its own thread; commands use the same syntax as slave
+ * mode and are handed to the main loop through the thread-safe command
+ * queue. Those globals are never reset, so the player can be started only
+ * once per process: after libmplayer_destroy() keep the process for
+ * something else or let it exit.
+ */
+
+enum libmplayer_event {
+    LIBMPLAYER_EVENT_READY,          ///< input is up, commands are accepted
+    LIBMPLAYER_EVENT_START_FILE,     ///< str: file name
+    LIBMPLAYER_EVENT_PLAYBACK_START,
+    LIBMPLAYER_EVENT_PAUSE,
+    LIBMPLAYER_EVENT_UNPAUSE,
+    LIBMPLAYER_EVENT_END_FILE,       ///< arg: value of mpctx->eof
+    LIBMPLAYER_EVENT_EXIT,           ///< arg: exit code
+};
+
+typedef struct libmplayer_callbacks {
+    /// Called on the player thread, must not block.
+    void (*event)(void *opaque, int event, int arg, const char *str);
+    /// A new frame is in the frame buffer (or was dropped if none is set).
+    void (*frame)(void *opaque, int width, int height);
+} libmplayer_callbacks_t;
+
+/**
+ * Start the player thread. argv is parsed like the command line, after
+ * the defaults "-noconsolecontrols -idle -vo embed,".
+ * \return 0 on success, -1 if an instance is already running, one has
+ *         run before in this process or the player exited during startup
+ */
+int libmplayer_create(int argc, char **argv,
+                      const libmplayer_callbacks_t *cb, void *opaque);
+/// Stop playback, wait for the player thread and release the instance.
+void libmplayer_destroy(void);
+/**
+ * Queue a slave mode command, e.g. "loadfile foo.mkv" or "seek 10".
+ * \return 0 if queued, -1 if it could not be parsed or queued
+ */
+int libmplayer_command(const char *cmd);
+/**
+ * Read a property as a string. Blocks until the player thread handles
+ * the request, which may take until a blocking open returns.
+ * \return 0 on success, -1 on error
+ */
+int libmplayer_get_property(const char *name, char *buf, int len);
+/**
+ * Set the buffer decoded frames are copied into. fmt is an IMGFMT_*
+ * packed RGB/BGR format; frames are converted to it and cropped to
+ * width x height (add -vf scale to fit). A new format takes effect
+ * when the video output is configured again. Pass buf == NULL to stop
+ * copying frames.
+ */
+void libmplayer_set_frame_buffer(void *buf, int stride, int width, int height,
+                                 unsigned int fmt);
+
+/* player side */
+
+extern int libmplayer_embedded;
+
+struct MPContext;
+
+void libmplayer_event(int event, int arg, const char *str);
+
+/// Stop accepting commands, called before the command queue goes away.
+void libmplayer_shutdown(void);
+/// Terminate the player thread instead of the process.
+void libmplayer_exit(int rc);
+/// Run a call posted with MP_CMD_EMBED_CALL on the player thread.
+void libmplayer_run_call(struct MPContext *mpctx, void *call);
+
+struct libmplayer_frame {
+    unsigned char *buf;
+    int stride, width, height;
+    unsigned int fmt;
+};
+
+/**
+ * Get exclusive access to the frame buffer, buf is NULL if none is set.
+ * Must be paired with libmplayer_unlock_frame().
+ */
+struct libmplayer_frame *libmplayer_lock_frame(void);
+void libmplayer_unlock_frame(void);
+/// Tell the application that a frame of the given size was output.
+void libmplayer_frame_done(int width, int height);
+
+#endif /* MPLAYER_LIBMPLAYER_H */
@@ -0,0 +1,186 @@
+/*
+ * JNI binding of the embedding interface for com.example.hellojni.MPlayer
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <jni.h>
+
+#include "config.h"
+#include "libmpcodecs/img_format.h"
+#include "libmplayer.h"
+
+/* keep in sync with MPlayer.java */
+#define FORMAT_RGB565   0
+#define FORMAT_RGBA8888 1
+
+static JavaVM *jvm;
+static jobject player_obj;
+static jobject frame_buf;    ///< global ref keeping the direct buffer alive
+static jmethodID on_event, on_frame;
+
+jint JNI_OnLoad(JavaVM *vm, void *reserved);
+
+jint JNI_OnLoad(JavaVM *vm, void *reserved)
+{
+    jvm = vm;
+    return JNI_VERSION_1_4;
+}
+
+/// The player thread stays attached from its first callback until EXIT.
+static JNIEnv *player_env(void)
+{
+    JNIEnv *env;
+    if ((*jvm)->GetEnv(jvm, (void **)&env, JNI_VERSION_1_4) == JNI_OK)
+        return env;
+    if ((*jvm)->AttachCurrentThread(jvm, &env, NULL) != JNI_OK)
+        return NULL;
+    return env;
+}
+
+static void event_cb(void *opaque, int event, int arg, const char *str)
+{
+    JNIEnv *env = player_env();
+    jstring jstr = NULL;
+    if (!env)
+        return;
+    if (str)
+        jstr = (*env)->NewStringUTF(env, str);
+    (*env)->CallVoidMethod(env, player_obj, on_event, event, arg, jstr);
+    if ((*env)->ExceptionCheck(env))
+        (*env)->ExceptionClear(env);
+    if (jstr)
+        (*env)->DeleteLocalRef(env, jstr);
+    if (event == LIBMPLAYER_EVENT_EXIT)
+        (*jvm)->DetachCurrentThread(jvm);
+}
+
+static void frame_cb(void *opaque, int width, int height)
+{
+    JNIEnv *env = player_env();
+    if (!env)
+        return;
+    (*env)->CallVoidMethod(env, player_obj, on_frame, width, height);
+    if ((*env)->ExceptionCheck(env))
+        (*env)->ExceptionClear(env);
+}
+
+static void release_refs(JNIEnv *env)
+{
+    if (frame_buf)
+        (*env)->DeleteGlobalRef(env, frame_buf);
+    if (player_obj)
+        (*env)->DeleteGlobalRef(env, player_obj);
+    frame_buf = player_obj = NULL;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_hellojni_MPlayer_nativeCreate(JNIEnv *env, jobject thiz,
+                                               jobjectArray args)
+{
+    static const libmplayer_callbacks_t cb = { event_cb, frame_cb };
+    jclass cls = (*env)->GetObjectClass(env, thiz);
+    int argc = args ? (*env)->GetArrayLength(env, args) : 0;
+    char **argv = calloc(argc + 2, sizeof(char *));
+    int i, r;
+
+    on_event = (*env)->GetMethodID(env, cls, "onEvent", "(IILjava/lang/String;)V");
+    on_frame = (*env)->GetMethodID(env, cls, "onFrame", "(II)V");
+    if (!argv || !on_event || !on_frame) {
+        free(argv);
+        return -1;
+    }
+    argv[0] = strdup("mplayer");
+    for (i = 0; i < argc; i++) {
+        jstring s = (*env)->GetObjectArrayElement(env, args, i);
+        const char *c = (*env)->GetStringUTFChars(env, s, NULL);
+        argv[i + 1] = strdup(c);
+        (*env)->ReleaseStringUTFChars(env, s, c);
+        (*env)->DeleteLocalRef(env, s);
+    }
+    player_obj = (*env)->NewGlobalRef(env, thiz);
+    r = libmplayer_create(argc + 1, argv, &cb, NULL);
+    // libmplayer keeps its own copy of the arguments
+    for (i = 0; i < argc + 1; i++)
+        free(argv[i]);
+    free(argv);
+    if (r < 0)
+        release_refs(env);
+    return r;
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_hellojni_MPlayer_nativeDestroy(JNIEnv *env, jobject thiz)
+{
+    libmplayer_destroy();
+    release_refs(env);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_hellojni_MPlayer_nativeCommand(JNIEnv *env, jobject thiz,
+                                                jstring cmd)
+{
+    const char *c = (*env)->GetStringUTFChars(env, cmd, NULL);
+    int r;
+    if (!c)
+        return -1;
+    r = libmplayer_command(c);
+    (*env)->ReleaseStringUTFChars(env, cmd, c);
+    return r;
+}
+
+JNIEXPORT jstring JNICALL
+Java_com_example_hellojni_MPlayer_nativeGetProperty(JNIEnv *env, jobject thiz,
+                                                    jstring name)
+{
+    const char *c = (*env)->GetStringUTFChars(env, name, NULL);
+    char buf[1024];
+    int r;
+    if (!c)
+        return NULL;
+    r = libmplayer_get_property(c, buf, sizeof(buf));
+    (*env)->ReleaseStringUTFChars(env, name, c);
+    return r < 0 ? NULL : (*env)->NewStringUTF(env, buf);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_hellojni_MPlayer_nativeSetFrameBuffer(JNIEnv *env, jobject thiz,
+                                                       jobject buf, jint stride,
+                                                       jint width, jint height,
+                                                       jint format)
+{
+    void *data = NULL;
+    jobject old = frame_buf;
+    unsigned int fmt = format == FORMAT_RGBA8888 ? IMGFMT_RGBA : IMGFMT_BGR16;
+    int bpp = format == FORMAT_RGBA8888 ? 4 : 2;
+
+    if (buf) {
+        data = (*env)->GetDirectBufferAddress(env, buf);
+        if (!data || stride < width * bpp ||
+            (*env)->GetDirectBufferCapacity(env, buf) < (jlong)stride * height)
+            return -1;
+        frame_buf = (*env)->NewGlobalRef(env, buf);
+    } else
+        frame_buf = NULL;
+    // once this returns the player no longer touches the old buffer
+    libmplayer_set_frame_buffer(data, stride, width, height, data ? fmt : 0);
+    if (old)
+        (*env)->DeleteGlobalRef(env, old);
+    return 0;
+}
@@ -108,6 +108,8 @@ extern const vo_functions_t video_out_tdfxfb;
 extern const vo_functions_t video_out_s3fb;
 extern const vo_functions_t video_out_wii;
 extern const vo_functions_t video_out_null;
+extern const vo_functions_t video_out_embed;
+extern const vo_functions_t video_out_shm;
 extern const vo_functions_t video_out_zr;
 extern const vo_functions_t video_out_zr2;
 extern const vo_functions_t video_out_bl;
@@ -262,6 +264,9 @@ const vo_functions_t* const video_out_drivers[] =
         &video_out_winvidix,
 #endif
         &video_out_cvidix,
+#endif
+#ifdef CONFIG_EMBED_VO
+        &video_out_embed,
 #endif
         &video_out_null,
         // should not be auto-selected
@@ -269,6 +274,9 @@ const vo_functions_t* const video_out_drivers[] =
         &video_out_xvmc,
 #endif
         &video_out_mpegpes,
+#ifdef CONFIG_SHM_VO
+        &video_out_shm,
+#endif
 #ifdef CONFIG_YUV4MPEG
         &video_out_yuv4mpeg,
 #endif
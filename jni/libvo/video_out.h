@@ -83,6 +83,19 @@ typedef struct {
 #define VOCTRL_GET_DEINTERLACE 31
 
 #define VOCTRL_UPDATE_SCREENINFO 32
+/* VO_FALSE if check_events() need not be polled while idle (no window
+   events, or they arrive through an fd registered with the input layer) */
+#define VOCTRL_NEEDS_EVENT_POLL 33
+/* pts (double *) of the image about to be drawn, for VOs that export it */
+#define VOCTRL_SET_FRAME_PTS 34
+/* frame queue statistics of VOs that hand frames to another process */
+#define VOCTRL_GET_QUEUE_STATS 35
+typedef struct {
+  unsigned frames;   // frames published
+  unsigned dropped;  // frames dropped because the queue was full
+  unsigned queued;   // frames not yet released by the reader
+  unsigned capacity; // queue length
+} mp_queue_stats_t;
 
 // Vo can be used by xover
 #define VOCTRL_XOVERLAY_SUPPORT 22
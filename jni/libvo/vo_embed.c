@@ -0,0 +1,185 @@
+/*
+ * video output into a buffer owned by an embedding application
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "libavutil/common.h"
+#include "video_out.h"
+#include "video_out_internal.h"
+#include "fastmemcpy.h"
+#include "sub.h"
+#include "osd.h"
+#include "libmplayer.h"
+
+static const vo_info_t info =
+{
+    "Embedding application buffer",
+    "embed",
+    "",
+    ""
+};
+
+const LIBVO_EXTERN(embed)
+
+static uint32_t image_width, image_height, image_format;
+static int image_bpp;
+/// size of the last frame copied out, 0 if it was dropped
+static int out_width, out_height;
+/// target of draw_alpha while the frame buffer is locked in draw_osd
+static struct libmplayer_frame *osd_frame;
+
+static int fmt_bpp(uint32_t format)
+{
+    switch (format) {
+    case IMGFMT_RGB15: case IMGFMT_BGR15:
+    case IMGFMT_RGB16: case IMGFMT_BGR16:
+        return 2;
+    case IMGFMT_RGB24: case IMGFMT_BGR24:
+        return 3;
+    case IMGFMT_RGB32: case IMGFMT_BGR32:
+        return 4;
+    }
+    return 0;
+}
+
+static void draw_alpha(int x0, int y0, int w, int h, unsigned char *src,
+                       unsigned char *srca, int stride)
+{
+    unsigned char *dst;
+    if (x0 + w > out_width || y0 + h > out_height)
+        return;
+    dst = osd_frame->buf + y0 * osd_frame->stride + x0 * image_bpp;
+    switch (image_format) {
+    case IMGFMT_RGB15: case IMGFMT_BGR15:
+        vo_draw_alpha_rgb15(w, h, src, srca, stride, dst, osd_frame->stride);
+        break;
+    case IMGFMT_RGB16: case IMGFMT_BGR16:
+        vo_draw_alpha_rgb16(w, h, src, srca, stride, dst, osd_frame->stride);
+        break;
+    case IMGFMT_RGB24: case IMGFMT_BGR24:
+        vo_draw_alpha_rgb24(w, h, src, srca, stride, dst, osd_frame->stride);
+        break;
+    case IMGFMT_RGB32: case IMGFMT_BGR32:
+        vo_draw_alpha_rgb32(w, h, src, srca, stride, dst, osd_frame->stride);
+        break;
+    }
+}
+
+static int draw_slice(uint8_t *image[], int stride[], int w, int h, int x, int y)
+{
+    return 0;
+}
+
+static int draw_image(mp_image_t *mpi)
+{
+    struct libmplayer_frame *f = libmplayer_lock_frame();
+    out_width = out_height = 0;
+    if (f->buf && f->fmt == image_format) {
+        out_width  = FFMIN(mpi->w, f->width);
+        out_height = FFMIN(mpi->h, f->height);
+        memcpy_pic(f->buf, mpi->planes[0], out_width * image_bpp, out_height,
+                   f->stride, mpi->stride[0]);
+    }
+    libmplayer_unlock_frame();
+    return VO_TRUE;
+}
+
+static void draw_osd(void)
+{
+    osd_frame = libmplayer_lock_frame();
+    if (osd_frame->buf && out_width && out_height)
+        vo_draw_text(out_width, out_height, draw_alpha);
+    libmplayer_unlock_frame();
+}
+
+static void flip_page(void)
+{
+    libmplayer_frame_done(out_width, out_height);
+}
+
+static int draw_frame(uint8_t *src[])
+{
+    return 0;
+}
+
+static int query_format(uint32_t format)
+{
+    int fmt;
+    struct libmplayer_frame *f = libmplayer_lock_frame();
+    fmt = f->fmt;
+    libmplayer_unlock_frame();
+    // without a buffer any format will do, frames are only counted
+    if (fmt && format != fmt)
+        return 0;
+    if (!fmt_bpp(format))
+        return 0;
+    return VFCAP_CSP_SUPPORTED | VFCAP_CSP_SUPPORTED_BY_HW | VFCAP_OSD |
+           VFCAP_ACCEPT_STRIDE;
+}
+
+static int config(uint32_t width, uint32_t height, uint32_t d_width,
+                  uint32_t d_height, uint32_t flags, char *title,
+                  uint32_t format)
+{
+    image_width  = width;
+    image_height = height;
+    image_format = format;
+    image_bpp    = fmt_bpp(format);
+    out_width = out_height = 0;
+    return 0;
+}
+
+static void uninit(void)
+{
+}
+
+static void check_events(void)
+{
+}
+
+static int preinit(const char *arg)
+{
+    if (arg) {
+        mp_msg(MSGT_VO, MSGL_WARN, "[VO_EMBED] Unknown subdevice: %s.\n", arg);
+        return ENOSYS;
+    }
+    // only usable from inside an embedding application
+    if (!libmplayer_embedded)
+        return -1;
+    return 0;
+}
+
+static int control(uint32_t request, void *data, ...)
+{
+    switch (request) {
+    case VOCTRL_QUERY_FORMAT:
+        return query_format(*((uint32_t *)data));
+    case VOCTRL_DRAW_IMAGE:
+        return draw_image(data);
+    case VOCTRL_NEEDS_EVENT_POLL:
+        return VO_FALSE;
+    }
+    return VO_NOTIMPL;
+}
@@ -1161,6 +1161,8 @@ static int control(uint32_t request, void *data, ...)
         return get_image(data);
     case VOCTRL_QUERY_FORMAT:
         return query_format(*(uint32_t*)data);
+    case VOCTRL_NEEDS_EVENT_POLL:
+        return VO_FALSE;
     }
 
 #ifdef CONFIG_VIDIX
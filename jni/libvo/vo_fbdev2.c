@@ -430,6 +430,8 @@ static int control(uint32_t request, void *data, ...)
   switch (request) {
   case VOCTRL_QUERY_FORMAT:
     return query_format(*((uint32_t*)data));
+  case VOCTRL_NEEDS_EVENT_POLL:
+    return VO_FALSE;
   }
   return VO_NOTIMPL;
 }
@@ -0,0 +1,434 @@
+/*
+ * video output into a ring of shared memory buffers
+ *
+ * Frames are published for a separate process (compositor, test
+ * harness) that maps the same file; see vo_shm.h for the layout.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "config.h"
+#include "mp_msg.h"
+#include "subopt-helper.h"
+#include "video_out.h"
+#include "video_out_internal.h"
+#include "fastmemcpy.h"
+#include "sub.h"
+#include "osd.h"
+#include "libmpcodecs/vf.h"
+#include "vo_shm.h"
+
+static const vo_info_t info =
+{
+    "Shared memory frame ring",
+    "shm",
+    "",
+    ""
+};
+
+const LIBVO_EXTERN(shm)
+
+#ifdef CONFIG_ANDROID
+#define DEFAULT_PATH "/data/local/tmp/mplayer-vo.shm"
+#else
+#define DEFAULT_PATH "/dev/shm/mplayer-vo"
+#endif
+
+static char *shm_path;
+static int notify_fd;
+static int num_buffers;
+
+static int shm_fd = -1;
+static uint8_t *shm_base;
+static size_t shm_size;
+static struct vo_shm_header *hdr;
+
+static uint32_t image_width, image_height, image_format;
+static int planar, image_bpp;
+
+/// the slot of the frame being drawn, NULL while nothing is drawn or
+/// when the ring is full and the frame gets dropped
+static struct vo_shm_slot *cur_slot;
+static int frame_started, frame_dropped;
+static double frame_pts = MP_NOPTS_VALUE;
+static unsigned frames_out, frames_dropped;
+
+static int fmt_bpp(uint32_t format)
+{
+    switch (format) {
+    case IMGFMT_YV12: case IMGFMT_I420: case IMGFMT_IYUV:
+        return 1;
+    case IMGFMT_RGB15: case IMGFMT_BGR15:
+    case IMGFMT_RGB16: case IMGFMT_BGR16:
+        return 2;
+    case IMGFMT_RGB24: case IMGFMT_BGR24:
+        return 3;
+    case IMGFMT_RGB32: case IMGFMT_BGR32:
+        return 4;
+    }
+    return 0;
+}
+
+static void wake_reader(void)
+{
+#ifdef __linux__
+    syscall(SYS_futex, &hdr->write_seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+    if (notify_fd >= 0) {
+        uint64_t one = 1;
+        if (write(notify_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            mp_msg(MSGT_VO, MSGL_DBG2, "[vo_shm] notify: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * Claim the slot for the next frame, unless the reader still holds all
+ * of them. Only called once per frame.
+ */
+static void start_frame(void)
+{
+    uint32_t seq;
+    if (frame_started)
+        return;
+    frame_started = 1;
+    seq = hdr->write_seq;
+    __sync_synchronize();
+    if (seq - hdr->read_seq >= hdr->num_buffers) {
+        frame_dropped = 1;
+        return;
+    }
+    cur_slot = &hdr->slot[seq % hdr->num_buffers];
+}
+
+static void end_frame(void)
+{
+    frame_started = frame_dropped = 0;
+    cur_slot = NULL;
+}
+
+static uint8_t *slot_plane(struct vo_shm_slot *s, int i)
+{
+    return shm_base + s->offset[i];
+}
+
+static void draw_alpha(int x0, int y0, int w, int h, unsigned char *src,
+                       unsigned char *srca, int stride)
+{
+    int dstride = cur_slot->stride[0];
+    uint8_t *dst = slot_plane(cur_slot, 0) + y0 * dstride + x0 * image_bpp;
+    switch (image_format) {
+    case IMGFMT_YV12: case IMGFMT_I420: case IMGFMT_IYUV:
+        vo_draw_alpha_yv12(w, h, src, srca, stride, dst, dstride);
+        break;
+    case IMGFMT_RGB15: case IMGFMT_BGR15:
+        vo_draw_alpha_rgb15(w, h, src, srca, stride, dst, dstride);
+        break;
+    case IMGFMT_RGB16: case IMGFMT_BGR16:
+        vo_draw_alpha_rgb16(w, h, src, srca, stride, dst, dstride);
+        break;
+    case IMGFMT_RGB24: case IMGFMT_BGR24:
+        vo_draw_alpha_rgb24(w, h, src, srca, stride, dst, dstride);
+        break;
+    case IMGFMT_RGB32: case IMGFMT_BGR32:
+        vo_draw_alpha_rgb32(w, h, src, srca, stride, dst, dstride);
+        break;
+    }
+}
+
+static int draw_slice(uint8_t *image[], int stride[], int w, int h, int x, int y)
+{
+    int i;
+    start_frame();
+    if (!cur_slot)
+        return 0;
+    for (i = 0; i < (planar ? 3 : 1); i++) {
+        int shift = planar && i ? 1 : 0;
+        int bpp = planar ? 1 : image_bpp;
+        uint8_t *dst = slot_plane(cur_slot, i) +
+                       (y >> shift) * cur_slot->stride[i] + (x >> shift) * bpp;
+        memcpy_pic(dst, image[i], (w >> shift) * bpp, h >> shift,
+                   cur_slot->stride[i], stride[i]);
+    }
+    return 0;
+}
+
+static int draw_frame(uint8_t *src[])
+{
+    return VO_ERROR;
+}
+
+/// Let the previous filter render straight into the next free slot.
+static int get_image(mp_image_t *mpi)
+{
+    int i;
+    // the slot is handed to the reader on flip, reference frames would
+    // still be needed by the decoder afterwards
+    if (mpi->type != MP_IMGTYPE_TEMP || mpi->imgfmt != image_format)
+        return VO_FALSE;
+    if (mpi->width > image_width || mpi->height > image_height)
+        return VO_FALSE;
+    start_frame();
+    if (!cur_slot)
+        return VO_FALSE;
+    if (!(mpi->flags & (MP_IMGFLAG_ACCEPT_STRIDE | MP_IMGFLAG_ACCEPT_WIDTH)) &&
+        cur_slot->stride[0] != mpi->width * (mpi->bpp / 8))
+        return VO_FALSE;
+    for (i = 0; i < (planar ? 3 : 1); i++) {
+        mpi->planes[i] = slot_plane(cur_slot, i);
+        mpi->stride[i] = cur_slot->stride[i];
+    }
+    mpi->flags |= MP_IMGFLAG_DIRECT;
+    return VO_TRUE;
+}
+
+static int draw_image(mp_image_t *mpi)
+{
+    start_frame();
+    // already in place (DR) or copied slice by slice
+    if (!cur_slot || mpi->flags & (MP_IMGFLAG_DIRECT | MP_IMGFLAG_DRAW_CALLBACK))
+        return VO_TRUE;
+    draw_slice(mpi->planes, mpi->stride, mpi->w, mpi->h, 0, 0);
+    return VO_TRUE;
+}
+
+static void draw_osd(void)
+{
+    if (cur_slot)
+        vo_draw_text(image_width, image_height, draw_alpha);
+}
+
+static void flip_page(void)
+{
+    struct vo_shm_slot *s;
+    // nothing new was drawn (e.g. OSD redraw while paused)
+    if (!frame_started)
+        return;
+    if (frame_dropped || !cur_slot) {
+        hdr->dropped = ++frames_dropped;
+        end_frame();
+        return;
+    }
+    s = cur_slot;
+    s->seq    = hdr->write_seq;
+    s->width  = image_width;
+    s->height = image_height;
+    s->pts    = frame_pts;
+    // slot contents must be visible before the frame is
+    __sync_synchronize();
+    hdr->write_seq = s->seq + 1;
+    frames_out++;
+    wake_reader();
+    end_frame();
+}
+
+static int query_format(uint32_t format)
+{
+    if (!fmt_bpp(format))
+        return 0;
+    return VFCAP_CSP_SUPPORTED | VFCAP_CSP_SUPPORTED_BY_HW | VFCAP_OSD |
+           VFCAP_ACCEPT_STRIDE;
+}
+
+static void unmap_shm(void)
+{
+    if (shm_base)
+        munmap(shm_base, shm_size);
+    shm_base = NULL;
+    hdr = NULL;
+    shm_size = 0;
+}
+
+static int config(uint32_t width, uint32_t height, uint32_t d_width,
+                  uint32_t d_height, uint32_t flags, char *title,
+                  uint32_t format)
+{
+    uint32_t stride[3], size[3], buffer_size, generation = 0;
+    int plane_w[3], plane_h[3];
+    size_t need;
+    int i, p;
+
+    image_width  = width;
+    image_height = height;
+    image_format = format;
+    image_bpp    = fmt_bpp(format);
+    planar       = format == IMGFMT_YV12 || format == IMGFMT_I420 ||
+                   format == IMGFMT_IYUV;
+    for (i = 0; i < 3; i++) {
+        int shift = planar && i ? 1 : 0;
+        plane_w[i] = (width  + shift) >> shift;
+        plane_h[i] = (height + shift) >> shift;
+        // rows start on 16 byte boundaries for SIMD readers
+        stride[i] = (plane_w[i] * (planar ? 1 : image_bpp) + 15) & ~15;
+        size[i]   = planar || !i ? stride[i] * plane_h[i] : 0;
+    }
+    buffer_size = (size[0] + size[1] + size[2] + 63) & ~63;
+    need = VO_SHM_HEADER_SIZE + (size_t)buffer_size * num_buffers;
+
+    if (hdr)
+        generation = hdr->generation + 1;
+    end_frame();
+    if (need > shm_size) {
+        unmap_shm();
+        if (ftruncate(shm_fd, need) < 0) {
+            mp_msg(MSGT_VO, MSGL_ERR, "[vo_shm] Cannot resize %s: %s\n",
+                   shm_path, strerror(errno));
+            return -1;
+        }
+        shm_base = mmap(NULL, need, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        shm_fd, 0);
+        if (shm_base == MAP_FAILED) {
+            shm_base = NULL;
+            mp_msg(MSGT_VO, MSGL_ERR, "[vo_shm] Cannot map %s: %s\n",
+                   shm_path, strerror(errno));
+            return -1;
+        }
+        shm_size = need;
+        hdr = (struct vo_shm_header *)shm_base;
+    }
+
+    // invalidate the old geometry before it changes under the reader
+    hdr->magic        = 0;
+    __sync_synchronize();
+    hdr->version      = VO_SHM_VERSION;
+    hdr->format       = format;
+    hdr->num_buffers  = num_buffers;
+    hdr->buffer_size  = buffer_size;
+    hdr->write_seq    = 0;
+    hdr->read_seq     = 0;
+    hdr->dropped      = 0;
+    for (i = 0; i < num_buffers; i++) {
+        struct vo_shm_slot *s = &hdr->slot[i];
+        uint32_t off = VO_SHM_HEADER_SIZE + i * buffer_size;
+        memset(s, 0, sizeof(*s));
+        for (p = 0; p < (planar ? 3 : 1); p++) {
+            s->offset[p] = off;
+            s->stride[p] = stride[p];
+            off += size[p];
+        }
+    }
+    hdr->generation = generation;
+    __sync_synchronize();
+    hdr->magic = VO_SHM_MAGIC;
+    frames_out = frames_dropped = 0;
+    mp_msg(MSGT_VO, MSGL_V, "[vo_shm] %dx%d %s, %d buffers of %u bytes in %s\n",
+           width, height, vo_format_name(format), num_buffers, buffer_size,
+           shm_path);
+    return 0;
+}
+
+static void uninit(void)
+{
+    if (hdr) {
+        mp_msg(MSGT_VO, MSGL_V, "[vo_shm] %u frames, %u dropped\n",
+               frames_out, frames_dropped);
+        hdr->magic = 0;
+    }
+    unmap_shm();
+    if (shm_fd >= 0)
+        close(shm_fd);
+    shm_fd = -1;
+    free(shm_path);
+    shm_path = NULL;
+}
+
+static void check_events(void)
+{
+}
+
+static int preinit(const char *arg)
+{
+    const opt_t subopts[] = {
+        {"path",    OPT_ARG_MSTRZ, &shm_path,    NULL},
+        {"buffers", OPT_ARG_INT,   &num_buffers, int_pos},
+        {"fd",      OPT_ARG_INT,   &notify_fd,   NULL},
+        {NULL, 0, NULL, NULL}
+    };
+
+    shm_path    = NULL;
+    num_buffers = 3;
+    notify_fd   = -1;
+    if (subopt_parse(arg, subopts) != 0) {
+        mp_msg(MSGT_VO, MSGL_FATAL,
+               "\n-vo shm command line help:\n"
+               "Example: mplayer -vo shm:path=/dev/shm/video:buffers=4\n"
+               "\nOptions:\n"
+               "  path=<file>\n"
+               "    File to share frames through (default " DEFAULT_PATH ").\n"
+               "  buffers=<1-%d>\n"
+               "    Number of frames the reader may hold (default 3).\n"
+               "  fd=<n>\n"
+               "    Inherited eventfd (or pipe) to signal for each frame.\n"
+               "\n", VO_SHM_MAX_BUFFERS);
+        return -1;
+    }
+    if (num_buffers > VO_SHM_MAX_BUFFERS)
+        num_buffers = VO_SHM_MAX_BUFFERS;
+    if (!shm_path)
+        shm_path = strdup(DEFAULT_PATH);
+
+    shm_fd = open(shm_path, O_RDWR | O_CREAT, 0644);
+    if (shm_fd < 0) {
+        mp_msg(MSGT_VO, MSGL_ERR, "[vo_shm] Cannot open %s: %s\n",
+               shm_path, strerror(errno));
+        free(shm_path);
+        shm_path = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int control(uint32_t request, void *data, ...)
+{
+    switch (request) {
+    case VOCTRL_QUERY_FORMAT:
+        return query_format(*((uint32_t *)data));
+    case VOCTRL_GET_IMAGE:
+        return get_image(data);
+    case VOCTRL_DRAW_IMAGE:
+        return draw_image(data);
+    case VOCTRL_SET_FRAME_PTS:
+        frame_pts = *(double *)data;
+        return VO_TRUE;
+    case VOCTRL_GET_QUEUE_STATS: {
+        mp_queue_stats_t *st = data;
+        if (!hdr)
+            return VO_FALSE;
+        st->frames   = frames_out;
+        st->dropped  = frames_dropped;
+        st->queued   = hdr->write_seq - hdr->read_seq;
+        st->capacity = hdr->num_buffers;
+        return VO_TRUE;
+    }
+    case VOCTRL_NEEDS_EVENT_POLL:
+        return VO_FALSE;
+    }
+    return VO_NOTIMPL;
+}
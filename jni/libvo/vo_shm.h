@@ -0,0 +1,66 @@
+/*
+ * shared memory layout of -vo shm, for use by reader processes
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_VO_SHM_H
+#define MPLAYER_VO_SHM_H
+
+#include <stdint.h>
+
+/*
+ * Frame n is stored in slot[n % num_buffers] and is complete once
+ * write_seq > n. The reader handles frames read_seq .. write_seq-1 and
+ * then stores the new read_seq; the player never overwrites a frame
+ * before it is released, it drops new frames instead.
+ *
+ * write_seq is a futex word: wait on it with FUTEX_WAIT (not the
+ * private variant). If the player was given an eventfd with fd=<n>, it
+ * is also signalled for every frame.
+ *
+ * generation changes whenever the video is reconfigured; the reader
+ * must then reread the geometry and remap if buffer_size grew.
+ */
+
+#define VO_SHM_MAGIC        0x4853504d /* "MPSH" */
+#define VO_SHM_VERSION      1
+#define VO_SHM_MAX_BUFFERS  16
+#define VO_SHM_HEADER_SIZE  4096
+
+struct vo_shm_slot {
+    uint32_t seq;          ///< frame number in this slot
+    uint32_t width, height;
+    uint32_t offset[3];    ///< Y/U/V or packed plane, from mapping start
+    uint32_t stride[3];
+    double   pts;          ///< MP_NOPTS_VALUE if unknown
+};
+
+struct vo_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    volatile uint32_t generation;
+    uint32_t format;       ///< IMGFMT_*; planar formats are always Y,U,V
+    uint32_t num_buffers;
+    uint32_t buffer_size;  ///< bytes per slot, slots follow the header
+    volatile uint32_t write_seq;
+    volatile uint32_t read_seq;
+    volatile uint32_t dropped;
+    struct vo_shm_slot slot[VO_SHM_MAX_BUFFERS];
+};
+
+#endif /* MPLAYER_VO_SHM_H */
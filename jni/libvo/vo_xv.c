@@ -741,6 +741,8 @@ static int control(uint32_t request, void *data, ...)
             return int_pause = 0;
         case VOCTRL_QUERY_FORMAT:
             return query_format(*((uint32_t *) data));
+        case VOCTRL_NEEDS_EVENT_POLL:
+            return VO_FALSE; // X events wake up the input layer
         case VOCTRL_GET_IMAGE:
             return get_image(data);
         case VOCTRL_DRAW_IMAGE:
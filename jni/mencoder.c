@@ -84,6 +84,7 @@
 #include "stream/stream_dvd.h"
 #endif
 #include "stream/stream_dvdnav.h"
+#include "batch.h"
 #include "codec-cfg.h"
 #include "edl.h"
 #include "help_mp.h"
@@ -242,6 +243,9 @@ static m_time_size_t end_at = { .type = END_AT_NONE, .pos = 0 };
 
 static char * frameno_filename=NULL;
 
+static char *batch_filename=NULL;
+static int batch_jobs=0;
+
 typedef struct {
     unsigned char* start;
     int in_size;
@@ -299,11 +303,7 @@ static int dec_audio(sh_audio_t *sh_audio,unsigned char* buffer,int total){
 		if(len>MAX_OUTBURST) len=MAX_OUTBURST;
 		if (mp_decode_audio(sh_audio, len) < 0)
                     at_eof = 1;
-		if(len>sh_audio->a_out_buffer_len) len=sh_audio->a_out_buffer_len;
-		fast_memcpy(buffer+size,sh_audio->a_out_buffer,len);
-		sh_audio->a_out_buffer_len-=len; size+=len;
-		if(sh_audio->a_out_buffer_len>0)
-		    fast_memcpy(sh_audio->a_out_buffer,&sh_audio->a_out_buffer[len],sh_audio->a_out_buffer_len);
+		size+=mp_audio_out_read(sh_audio,buffer+size,len);
     }
     return size;
 }
@@ -609,6 +609,12 @@ if(!codecs_file || !parse_codec_cfg(codecs_file)){
 }
 
  parse_cfgfiles(mconfig);
+ // the workers come back with the command line of their job
+ if (batch_filename) {
+     int ret = batch_run(batch_filename, batch_jobs, &argc, &argv);
+     if (ret >= 0)
+         exit(ret);
+ }
  filelist = m_config_parse_me_command_line(mconfig, argc, argv);
  if(!filelist) mencoder_exit(1, MSGTR_ErrorParsingCommandLine);
 
@@ -776,12 +782,14 @@ d_dvdsub=demuxer->sub;
 sh_audio=d_audio->sh;
 sh_video=d_video->sh;
 
-  if(!sh_video)
+  // without video the audio is encoded alone, but some stream is needed
+  if(!sh_video && !sh_audio)
   {
-	mp_msg(MSGT_CPLAYER,MSGL_FATAL,MSGTR_VideoStreamRequired);
+	mp_msg(MSGT_CPLAYER,MSGL_FATAL,"No audio or video stream to encode.\n");
 	mencoder_exit(1,NULL);
   }
 
+  if(sh_video){
   if(!video_read_properties(sh_video)){
       mp_msg(MSGT_CPLAYER, MSGL_FATAL, MSGTR_CannotReadVideoProperties);
       mencoder_exit(1,NULL);
@@ -797,6 +805,11 @@ sh_video=d_video->sh;
     sh_video->frametime=1.0f/sh_video->fps;
     mp_msg(MSGT_MENCODER,MSGL_INFO,MSGTR_ForcingInputFPS, sh_video->fps);
   }
+  } else if(out_file_format != MUXER_TYPE_LAVF && out_file_format != MUXER_TYPE_RAWAUDIO){
+    // the AVI, MPEG and raw video muxers are built around a video stream
+    mp_msg(MSGT_MENCODER,MSGL_FATAL,"No video stream, audio only output needs -of lavf or -of rawaudio.\n");
+    mencoder_exit(1,NULL);
+  }
 
   if(sh_audio && out_audio_codec<0){
     if(audio_id==-2)
@@ -816,6 +829,8 @@ if(sh_audio && (out_audio_codec || seek_to_sec || !sh_audio->wf || playback_spee
     sh_audio=d_audio->sh=NULL; // failed to init :(
   }
   mp_msg(MSGT_CPLAYER,MSGL_INFO,"==========================================================================\n");
+  if(!sh_audio && !sh_video)
+    mencoder_exit(1,NULL);
 }
 
   if (sh_audio) {
@@ -832,7 +847,7 @@ if(sh_audio && (out_audio_codec || seek_to_sec || !sh_audio->wf || playback_spee
 // set up video encoder:
 
 if (!curfile) { // curfile is non zero when a second file is opened
-if (vobsub_out) {
+if (vobsub_out && sh_video) {
     unsigned int palette[16], width, height;
     unsigned char tmp[3] = { 0, 0, 0 };
     if (spudec_ifo && vobsub_parse_ifo(NULL,spudec_ifo, palette, &width, &height, 1, dvdsub_id, tmp) >= 0)
@@ -858,7 +873,7 @@ if (vobsub_out) {
     }
 #endif
 }
-else {
+else if (sh_video) {
 if (spudec_ifo) {
   unsigned int palette[16], width, height;
   if (vobsub_parse_ifo(NULL,spudec_ifo, palette, &width, &height, 1, -1, NULL) >= 0)
@@ -893,6 +908,7 @@ if(out_file_format == MUXER_TYPE_MPEG) audio_preload = 0;
 muxer->audio_delay_fix = audio_delay_fix;
 
 // ============= VIDEO ===============
+if (sh_video) {
 
 mux_v=muxer_new_stream(muxer,MUXER_TYPE_VIDEO);
 
@@ -917,7 +933,13 @@ mux_v->h.dwRate=mux_v->h.dwScale*(force_ofps?force_ofps:sh_video->fps*playback_s
 mux_v->codec=out_video_codec;
 
 mux_v->bih=NULL;
+} // if (sh_video)
+}
+if (!mux_v != !sh_video) {
+	mp_msg(MSGT_MENCODER,MSGL_FATAL,"Either all files or none must have video.\n");
+	mencoder_exit(1,NULL);
 }
+if (sh_video) {
 sh_video->codec=NULL;
 sh_video->vfilter=NULL; // fixme!
 
@@ -1084,10 +1106,11 @@ default: {
     if(!sh_video->initialized) mencoder_exit(1,NULL);
  }
 }
+} // if (sh_video)
 
 if (!curfile) {
 /* force output fourcc to .. */
-if ((force_fourcc != NULL) && (strlen(force_fourcc) >= 4))
+if (mux_v && (force_fourcc != NULL) && (strlen(force_fourcc) >= 4))
 {
     mux_v->bih->biCompression = mmioFOURCC(force_fourcc[0], force_fourcc[1],
 					    force_fourcc[2], force_fourcc[3]);
@@ -1095,7 +1118,7 @@ if ((force_fourcc != NULL) && (strlen(force_fourcc) >= 4))
 	mux_v->bih->biCompression, (char *)&mux_v->bih->biCompression);
 }
 
-if (! ignore_start)
+if (sh_video && ! ignore_start)
     muxer->audio_delay_fix -= sh_video->stream_delay;
 
 //if(demuxer->file_format!=DEMUXER_TYPE_AVI) pts_from_bps=0; // it must be 0 for mpeg/asf!
@@ -1281,7 +1304,7 @@ if(file_format == DEMUXER_TYPE_TV)
 	}
 
 play_n_frames=play_n_frames_mf;
-if (curfile && end_at.type == END_AT_TIME) end_at.pos += mux_v->timer;
+if (curfile && end_at.type == END_AT_TIME) end_at.pos += mux_v ? mux_v->timer : mux_a->timer;
 
 if (edl_records) free_edl(edl_records);
 next_edl_record = edl_records = NULL;
@@ -1291,7 +1314,7 @@ if (edl_filename) {
     next_edl_record = edl_records = edl_parse_file();
 }
 
-if (sh_audio && audio_delay != 0.) fixdelay(d_video, d_audio, mux_a, &frame_data, mux_v->codec==VCODEC_COPY);
+if (sh_audio && sh_video && audio_delay != 0.) fixdelay(d_video, d_audio, mux_a, &frame_data, mux_v->codec==VCODEC_COPY);
 
 while(!at_eof){
 
@@ -1301,10 +1324,10 @@ while(!at_eof){
     int skip_flag=0; // 1=skip  -1=duplicate
 
     if((end_at.type == END_AT_SIZE && end_at.pos <= stream_tell(muxer->stream))  ||
-       (end_at.type == END_AT_TIME && end_at.pos < mux_v->timer))
+       (end_at.type == END_AT_TIME && end_at.pos < (mux_v ? mux_v->timer : mux_a->timer)))
         break;
 
-    if(play_n_frames>=0){
+    if(sh_video && play_n_frames>=0){
       --play_n_frames;
       if(play_n_frames<0) break;
     }
@@ -1354,15 +1377,15 @@ goto_redo_edl:
 
 
 if(sh_audio){
-    // get audio:
-    while(mux_a->timer-audio_preload<mux_v->timer){
+    // get audio, one chunk per round without video:
+    while(!mux_v || mux_a->timer-audio_preload<mux_v->timer){
         float tottime;
 	int len=0;
 
 	ptimer_start = GetTimerMS();
 	// CBR - copy 0.5 sec of audio
 	// or until the end of video:
-	tottime = stop_time(demuxer, mux_v);
+	tottime = mux_v ? stop_time(demuxer, mux_v) : -1;
 	if (tottime != -1) {
 		tottime -= mux_a->timer;
 		if (tottime > 1./audio_density) tottime = 1./audio_density;
@@ -1415,7 +1438,7 @@ if(sh_audio){
 				mux_a->buffer_len += len;
 			}
 	    }
-	    if (mux_v->timer == 0) mux_a->h.dwInitialFrames++;
+	    if (mux_v && mux_v->timer == 0) mux_a->h.dwInitialFrames++;
 	}
 	else {
 	if(mux_a->h.dwSampleSize){
@@ -1436,7 +1459,10 @@ if(sh_audio){
 		}
 	    }
 	}
-	if(len<=0) break; // EOF?
+	if(len<=0){ // EOF?
+	    if(!mux_v) at_eof=1;
+	    break;
+	}
 	muxer_write_chunk(mux_a,len,AVIIF_KEYFRAME, MP_NOPTS_VALUE, MP_NOPTS_VALUE);
 	if(!mux_a->h.dwSampleSize && mux_a->timer>0)
 	    mux_a->wf->nAvgBytesPerSec=0.5f+(double)mux_a->size/mux_a->timer; // avg bps (VBR)
@@ -1449,7 +1475,23 @@ if(sh_audio){
 	audiosamples++;
 	audiorate+= (GetTimerMS() - ptimer_start);
 
+	if(!mux_v) break;
+    }
+}
+
+if(!mux_v){
+    // audio only, the chunk above was all the work of this round
+    if(!quiet){
+	float t=(GetTimerMS()-timer_start)*0.001f;
+	float p=demuxer_get_percent_pos(demuxer) / 100.0;
+	mp_msg(MSGT_STATUSLINE,MSGL_STATUS,"Pos:%6.1fs (%2d%%) %5.2fx Trem:%4dmin %3dmb [%d]\r",
+	    mux_a->timer, (int)(p*100),
+	    (t>1) ? mux_a->timer/t : 0,
+	    (p>0.001) ? (int)((t/p-t)/60) : 0,
+	    (p>0.001) ? (int)(stream_tell(muxer->stream)/p/1024/1024) : 0,
+	    (mux_a->timer>1) ? (int)(mux_a->size/mux_a->timer/125) : 0);
     }
+    continue;
 }
 
     // get video frame!
@@ -1734,7 +1776,7 @@ if(ferror(muxer_f) || fclose(muxer_f) != 0) {
 if(vobsub_writer)
     vobsub_out_close(vobsub_writer);
 
-if(out_video_codec==VCODEC_FRAMENO && mux_v->timer>100){
+if(out_video_codec==VCODEC_FRAMENO && mux_v && mux_v->timer>100){
     mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_RecommendedVideoBitrate,"650MB",(int)((650*1024*1024-muxer_f_size)/mux_v->timer/125));
     mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_RecommendedVideoBitrate,"700MB",(int)((700*1024*1024-muxer_f_size)/mux_v->timer/125));
     mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_RecommendedVideoBitrate,"800MB",(int)((800*1024*1024-muxer_f_size)/mux_v->timer/125));
@@ -1743,11 +1785,13 @@ if(out_video_codec==VCODEC_FRAMENO && mux_v->timer>100){
     mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_RecommendedVideoBitrate,"2 x 800MB",(int)((2*800*1024*1024-muxer_f_size)/mux_v->timer/125));
 }
 
+if(mux_v)
 mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_VideoStreamResult,
     (float)(mux_v->size/mux_v->timer*8.0f/1000.0f), (int)(mux_v->size/mux_v->timer), (uint64_t)mux_v->size, (float)mux_v->timer, decoded_frameno);
 if(sh_audio)
 mp_msg(MSGT_MENCODER, MSGL_INFO, MSGTR_AudioStreamResult,
     (float)(mux_a->size/mux_a->timer*8.0f/1000.0f), (int)(mux_a->size/mux_a->timer), (uint64_t)mux_a->size, (float)mux_a->timer);
+batch_report(!mux_v || (mux_a && mux_a->timer > mux_v->timer) ? mux_a->timer : mux_v->timer);
 
 if(sh_audio){ uninit_audio(sh_audio);sh_audio=NULL; }
 if(sh_video){ uninit_video(sh_video);sh_video=NULL; }
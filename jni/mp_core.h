@@ -129,6 +129,15 @@ typedef struct MPContext {
 
     int was_paused;
 
+    // -gapless: set when the audio ended and the next file is open already
+    int gapless_eof;
+    // kept from one file to the next: the filter chain with the decoder
+    // format it was built for and filtered audio not yet given to the ao
+    af_stream_t *gapless_afilter;
+    int gapless_rate, gapless_nch, gapless_format;
+    unsigned char *gapless_buf;
+    int gapless_len;
+
 #ifdef CONFIG_DVDNAV
     struct mp_image *nav_smpi;   ///< last decoded dvdnav video image
     unsigned char *nav_buffer;   ///< last read dvdnav video frame
@@ -146,6 +155,8 @@ extern int file_filter;
 // These appear in options list
 extern float playback_speed;
 extern int fixed_vo;
+extern int gapless_audio;
+extern int use_audio_thread;
 extern int forced_subs_only;
 
 
@@ -17,6 +17,11 @@
  */
 
 #include <stdlib.h>
+#include "config.h"
+#ifdef HAVE_POSIX_SELECT
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 #include "osdep/timer.h"
 #include "input/input.h"
 #include "input/mouse.h"
@@ -86,3 +91,223 @@ void mplayer_put_key(int code) {
       now - last_key_time[1] < doubleclick_time)
     put_double(code);
 }
+
+
+#ifdef HAVE_POSIX_SELECT
+/*
+ * Command queue for frontends running on other threads.
+ *
+ * Producers push into a bounded ring using the sequence number scheme of
+ * Dmitry Vyukov's bounded queue, the main thread is the only consumer.
+ * A pipe wakes up the main loop, it is registered as input event fd.
+ * seek and volume commands are coalesced: they are parked in a per-command
+ * slot that producers merge into, the ring only carries a token for it.
+ */
+
+#define CMD_RING_SIZE 64 // must be a power of two
+
+typedef struct {
+  volatile unsigned seq;
+  mp_cmd_t *cmd;
+  int slot; // index into coalesce_slots or -1 for a plain command
+} cmd_cell_t;
+
+static struct {
+  int id;
+  mp_cmd_t * volatile pending;
+} coalesce_slots[] = {
+  { MP_CMD_SEEK, NULL },
+  { MP_CMD_VOLUME, NULL },
+};
+
+#define NUM_COALESCE_SLOTS (sizeof(coalesce_slots) / sizeof(coalesce_slots[0]))
+
+static cmd_cell_t cmd_ring[CMD_RING_SIZE];
+static volatile unsigned cmd_ring_head; // next cell to be claimed by a producer
+static unsigned cmd_ring_tail;          // next cell to be read by the consumer
+static int wakeup_pipe[2] = { -1, -1 };
+
+static int ring_push(mp_cmd_t *cmd, int slot) {
+  unsigned pos = cmd_ring_head;
+  cmd_cell_t *cell;
+  for (;;) {
+    int dif;
+    cell = &cmd_ring[pos & (CMD_RING_SIZE - 1)];
+    dif = (int)(cell->seq - pos);
+    if (dif == 0) {
+      if (__sync_bool_compare_and_swap(&cmd_ring_head, pos, pos + 1))
+        break;
+      pos = cmd_ring_head;
+    } else if (dif < 0)
+      return 0; // full
+    else
+      pos = cmd_ring_head;
+  }
+  cell->cmd = cmd;
+  cell->slot = slot;
+  __sync_synchronize();
+  cell->seq = pos + 1;
+  return 1;
+}
+
+static int ring_pop(mp_cmd_t **cmd, int *slot) {
+  cmd_cell_t *cell = &cmd_ring[cmd_ring_tail & (CMD_RING_SIZE - 1)];
+  if ((int)(cell->seq - (cmd_ring_tail + 1)) < 0)
+    return 0; // empty
+  __sync_synchronize();
+  *cmd = cell->cmd;
+  *slot = cell->slot;
+  __sync_synchronize();
+  cell->seq = cmd_ring_tail + CMD_RING_SIZE;
+  cmd_ring_tail++;
+  return 1;
+}
+
+static int cmd_mode(mp_cmd_t *cmd) {
+  return cmd->nargs > 1 ? cmd->args[1].v.i : 0;
+}
+
+/**
+ * \brief fold an older command into a newer one of the same kind
+ * \return 1 if old was merged into cmd and can be freed
+ */
+static int merge_cmd(mp_cmd_t *cmd, mp_cmd_t *old) {
+  if (cmd->pausing != old->pausing)
+    return 0;
+  // a new absolute value always supersedes the old one
+  if (cmd_mode(cmd))
+    return 1;
+  if (cmd->id == MP_CMD_SEEK) {
+    switch (cmd_mode(old)) {
+    case 0: // relative + relative
+      cmd->args[0].v.f += old->args[0].v.f;
+      return 1;
+    case 2: // absolute seconds + relative
+      cmd->args[0].v.f += old->args[0].v.f;
+      cmd->args[1].v.i = 2;
+      cmd->args[1].type = MP_CMD_ARG_INT;
+      if (cmd->nargs < 2)
+        cmd->nargs = 2;
+      return 1;
+    }
+  }
+  // relative volume changes are steps, not amounts; keep each of them
+  return 0;
+}
+
+static int slot_for_cmd(mp_cmd_t *cmd) {
+  int i;
+  for (i = 0; i < NUM_COALESCE_SLOTS; i++)
+    if (coalesce_slots[i].id == cmd->id)
+      return i;
+  return -1;
+}
+
+static void cmd_fifo_wakeup(void) {
+  char c = 0;
+  // a full pipe already guarantees a wakeup
+  if (write(wakeup_pipe[1], &c, 1) < 0) {}
+}
+
+int mp_cmd_fifo_put(mp_cmd_t *cmd) {
+  int slot;
+  if (!cmd)
+    return 0;
+  if (wakeup_pipe[1] < 0) {
+    mp_cmd_free(cmd);
+    return 0;
+  }
+  slot = slot_for_cmd(cmd);
+  if (slot >= 0) {
+    mp_cmd_t * volatile *pending = &coalesce_slots[slot].pending;
+    for (;;) {
+      // take ownership of whatever is parked and fold it in
+      mp_cmd_t *old = __sync_lock_test_and_set(pending, NULL);
+      if (old) {
+        if (merge_cmd(cmd, old))
+          mp_cmd_free(old);
+        else if (!ring_push(old, -1))
+          mp_cmd_free(old);
+      }
+      if (__sync_bool_compare_and_swap(pending, NULL, cmd))
+        break;
+    }
+    // an extra token for an already consumed slot is harmless
+    ring_push(NULL, slot);
+  } else if (!ring_push(cmd, -1)) {
+    mp_cmd_free(cmd);
+    return 0;
+  }
+  cmd_fifo_wakeup();
+  return 1;
+}
+
+/// Event fd callback, moves the commands into the input queue.
+static void cmd_fifo_drain(void) {
+  char buf[64];
+  mp_cmd_t *cmd;
+  int slot;
+  while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0) {}
+  while (ring_pop(&cmd, &slot)) {
+    if (slot >= 0)
+      cmd = __sync_lock_test_and_set(&coalesce_slots[slot].pending, NULL);
+    if (cmd && !mp_input_queue_cmd(cmd))
+      mp_cmd_free(cmd);
+  }
+  // the token of a parked command is lost if the ring was full
+  for (slot = 0; slot < NUM_COALESCE_SLOTS; slot++) {
+    cmd = __sync_lock_test_and_set(&coalesce_slots[slot].pending, NULL);
+    if (cmd && !mp_input_queue_cmd(cmd))
+      mp_cmd_free(cmd);
+  }
+}
+
+int mp_cmd_fifo_init(void) {
+  unsigned i;
+  if (wakeup_pipe[0] >= 0)
+    return 1;
+  for (i = 0; i < CMD_RING_SIZE; i++)
+    cmd_ring[i].seq = i;
+  cmd_ring_head = cmd_ring_tail = 0;
+  if (pipe(wakeup_pipe))
+    goto err_out;
+  for (i = 0; i < 2; i++)
+    fcntl(wakeup_pipe[i], F_SETFL, fcntl(wakeup_pipe[i], F_GETFL) | O_NONBLOCK);
+  if (!mp_input_add_event_fd(wakeup_pipe[0], cmd_fifo_drain))
+    goto err_out;
+  return 1;
+
+err_out:
+  mp_cmd_fifo_uninit();
+  return 0;
+}
+
+void mp_cmd_fifo_uninit(void) {
+  mp_cmd_t *cmd;
+  int slot, i;
+  if (wakeup_pipe[0] < 0)
+    return;
+  mp_input_rm_event_fd(wakeup_pipe[0]);
+  close(wakeup_pipe[0]);
+  close(wakeup_pipe[1]);
+  wakeup_pipe[0] = wakeup_pipe[1] = -1;
+  while (ring_pop(&cmd, &slot))
+    mp_cmd_free(cmd);
+  for (i = 0; i < NUM_COALESCE_SLOTS; i++) {
+    mp_cmd_free(coalesce_slots[i].pending);
+    coalesce_slots[i].pending = NULL;
+  }
+}
+#else
+int mp_cmd_fifo_put(mp_cmd_t *cmd) {
+  mp_cmd_free(cmd);
+  return 0;
+}
+
+int mp_cmd_fifo_init(void) {
+  return 0;
+}
+
+void mp_cmd_fifo_uninit(void) {
+}
+#endif /* HAVE_POSIX_SELECT */
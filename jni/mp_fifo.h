@@ -26,4 +26,17 @@ extern unsigned doubleclick_time;
 int mplayer_get_key(int fd);
 void mplayer_put_key(int code);
 
+struct mp_cmd;
+
+/// Set up the thread-safe command queue and hook it into the input layer.
+int mp_cmd_fifo_init(void);
+void mp_cmd_fifo_uninit(void);
+/**
+ * Queue a command from any thread and wake up the main loop.
+ * Successive seek and volume commands are merged while still queued.
+ * Takes ownership of cmd, also on failure.
+ * \return 1 if queued, 0 if the queue is full or not initialized
+ */
+int mp_cmd_fifo_put(struct mp_cmd *cmd);
+
 #endif /* MPLAYER_MP_FIFO_H */
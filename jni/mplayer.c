@@ -39,6 +39,10 @@
 #include <windows.h>
 #endif
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #ifndef __MINGW32__
 #include <sys/ioctl.h>
 #include <sys/wait.h>
@@ -108,6 +112,7 @@
 #include "m_struct.h"
 #include "metadata.h"
 #include "mixer.h"
+#include "libmplayer.h"
 #include "mp_core.h"
 #include "mp_fifo.h"
 #include "mp_msg.h"
@@ -121,6 +126,7 @@
 #include "path.h"
 #include "playtree.h"
 #include "playtreeparser.h"
+#include "prefetch.h"
 #include "spudec.h"
 #include "subreader.h"
 #include "vobsub.h"
@@ -186,6 +192,8 @@ static MPContext mpctx_s = {
 static MPContext *mpctx = &mpctx_s;
 
 int fixed_vo=0;
+int gapless_audio=0;
+int use_audio_thread=0;
 
 // benchmark:
 double video_time_usage=0;
@@ -196,6 +204,9 @@ static int total_frame_cnt=0;
 static int drop_frame_cnt=0; // total number of dropped frames
 int benchmark=0;
 
+// seconds of sound the ao may queue when there is no video to keep in sync
+#define AUDIO_ONLY_LATENCY 0.5
+
 // options:
 #define DEFAULT_STARTUP_DECODE_RETRY 8
        int auto_quality=0;
@@ -611,6 +622,96 @@ static void mp_dvdnav_context_free(MPContext *ctx){
 }
 #endif
 
+/// keep the filter chain and the undelivered end of the audio for the next file
+static void gapless_keep_audio(void)
+{
+    sh_audio_t *sh = mpctx->sh_audio;
+
+    if (!sh)
+        return;
+    if (mpctx->gapless_afilter) {
+        af_uninit(mpctx->gapless_afilter);
+        free(mpctx->gapless_afilter);
+    }
+    mpctx->gapless_afilter = sh->afilter;
+    mpctx->gapless_rate    = sh->samplerate;
+    mpctx->gapless_nch     = sh->channels;
+    mpctx->gapless_format  = sh->sample_format;
+    sh->afilter = NULL;
+    free(mpctx->gapless_buf);
+    // already filtered for the ao that stays open
+    mpctx->gapless_len = 0;
+    mpctx->gapless_buf = malloc(sh->a_out_buffer_len);
+    if (mpctx->gapless_buf)
+        mpctx->gapless_len = mp_audio_out_read(sh, mpctx->gapless_buf,
+                                               sh->a_out_buffer_len);
+}
+
+/// play the end of the audio after all, the next file has none
+static void gapless_flush_audio(void)
+{
+    sh_audio_t *sh = mpctx->sh_audio;
+
+    while (sh && sh->a_out_buffer_len > 0) {
+        int len = mpctx->audio_out->get_space();
+        int flags = 0;
+        if (len > MAX_OUTBURST)
+            len = MAX_OUTBURST;
+        if (len >= sh->a_out_buffer_len) {
+            len = sh->a_out_buffer_len;
+            flags = AOPLAY_FINAL_CHUNK;
+        } else if (ao_data.outburst > 0)
+            len -= len % ao_data.outburst;
+        if (len <= 0) {
+            usec_sleep(10000);
+            continue;
+        }
+        len = mpctx->audio_out->play(mp_audio_out_peek(sh, len), len, flags);
+        if (len > 0)
+            mp_audio_out_consume(sh, len);
+        else if (mpctx->audio_out->get_delay() < .04)
+            break; // the ao takes no partial chunk, as in fill_audio_out_buffers
+        else
+            usec_sleep(10000);
+    }
+}
+
+static void gapless_discard(void)
+{
+    if (mpctx->gapless_afilter) {
+        af_uninit(mpctx->gapless_afilter);
+        free(mpctx->gapless_afilter);
+        mpctx->gapless_afilter = NULL;
+    }
+    free(mpctx->gapless_buf);
+    mpctx->gapless_buf = NULL;
+    mpctx->gapless_len = 0;
+}
+
+/// \return 1 if the kept filter chain fits the decoder output of sh
+static int gapless_reuse_afilter(sh_audio_t *sh)
+{
+    af_stream_t *afs = mpctx->gapless_afilter;
+
+    if (!afs)
+        return 0;
+    mpctx->gapless_afilter = NULL;
+    if (sh->samplerate != mpctx->gapless_rate ||
+        sh->channels != mpctx->gapless_nch ||
+        sh->sample_format != mpctx->gapless_format) {
+        af_uninit(afs);
+        free(afs);
+        return 0;
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Reusing the audio filter chain.\n");
+    sh->afilter = afs;
+    mpctx->mixer.afilter = afs;
+#ifdef CONFIG_GUI
+    if (use_gui) guiGetEvent(guiSetAfilter, (char *)afs);
+#endif
+    return 1;
+}
+
 void uninit_player(unsigned int mask){
   mask &= initialized_flags;
 
@@ -692,6 +793,7 @@ void uninit_player(unsigned int mask){
     if (mpctx->edl_muted) mixer_mute(&mpctx->mixer);
     if (mpctx->audio_out) mpctx->audio_out->uninit(mpctx->eof?0:1);
     mpctx->audio_out=NULL;
+    gapless_discard();
   }
 
 #ifdef CONFIG_GUI
@@ -705,6 +807,7 @@ void uninit_player(unsigned int mask){
   if(mask&INITIALIZED_INPUT){
     initialized_flags&=~INITIALIZED_INPUT;
     current_module="uninit_input";
+    mp_cmd_fifo_uninit();
     mp_input_uninit();
 #ifdef CONFIG_MENU
     if (use_menu)
@@ -715,8 +818,79 @@ void uninit_player(unsigned int mask){
   current_module=NULL;
 }
 
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t audio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t audio_thread;
+static int audio_thread_running;
+static int audio_thread_quit;
+static int audio_lock_held;    ///< by the main thread
+static int audio_thread_error; ///< the audio chain failed on the audio thread
+#endif
+
+/**
+ * While the audio thread runs, the main thread holds audio_lock and lets go
+ * of it only around work that touches neither the demuxer nor the audio
+ * chain: video decoding, filtering, flipping and sleeping.
+ */
+static void yield_audio_lock(void)
+{
+#ifdef HAVE_PTHREADS
+    if (audio_thread_running) {
+        audio_lock_held = 0;
+        pthread_mutex_unlock(&audio_lock);
+    }
+#endif
+}
+
+static void take_audio_lock(void)
+{
+#ifdef HAVE_PTHREADS
+    if (audio_thread_running) {
+        pthread_mutex_lock(&audio_lock);
+        audio_lock_held = 1;
+    }
+#endif
+}
+
+/// \return 1 if the caller is the audio thread
+static int on_audio_thread(void)
+{
+#ifdef HAVE_PTHREADS
+    return audio_thread_running && pthread_equal(pthread_self(), audio_thread);
+#else
+    return 0;
+#endif
+}
+
+/// \return 1 if the audio thread feeds the ao, it only does so with video
+static int audio_in_thread(void)
+{
+#ifdef HAVE_PTHREADS
+    return audio_thread_running && mpctx->sh_video;
+#else
+    return 0;
+#endif
+}
+
+static void stop_audio_thread(void)
+{
+#ifdef HAVE_PTHREADS
+    if (!audio_thread_running)
+        return;
+    if (!audio_lock_held)
+        pthread_mutex_lock(&audio_lock);
+    audio_thread_quit = 1;
+    audio_thread_running = 0;
+    audio_lock_held = 0;
+    pthread_mutex_unlock(&audio_lock);
+    pthread_join(audio_thread, NULL);
+#endif
+}
+
 void exit_player_with_rc(enum exit_reason how, int rc)
 {
+  if (libmplayer_embedded)
+    libmplayer_shutdown();
 
 #ifdef CONFIG_NETWORKING
   if (udp_master)
@@ -724,6 +898,8 @@ void exit_player_with_rc(enum exit_reason how, int rc)
 #endif /* CONFIG_NETWORKING */
 
   if (mpctx->user_muted && !mpctx->edl_muted) mixer_mute(&mpctx->mixer);
+  stop_audio_thread();
+  prefetch_cancel();
   uninit_player(INITIALIZED_ALL);
 #if defined(__MINGW32__) || defined(__CYGWIN__)
   timeEndPeriod(1);
@@ -785,6 +961,9 @@ void exit_player_with_rc(enum exit_reason how, int rc)
   }
   mp_msg(MSGT_CPLAYER,MSGL_DBG2,"max framesize was %d bytes\n",max_framesize);
 
+  // an embedding application only loses the player thread
+  if (libmplayer_embedded)
+    libmplayer_exit(rc);
   exit(rc);
 }
 
@@ -1045,6 +1224,9 @@ static int libmpdemux_was_interrupted(int eof) {
        case MP_CMD_PLAY_ALT_SRC_STEP: {
 	 eof = (cmd->args[0].v.i > 0) ?  PT_NEXT_SRC : PT_PREV_SRC;
        } break;
+       case MP_CMD_EMBED_CALL: // the caller is waiting for an answer
+	 run_command(mpctx, cmd);
+	 break;
        }
        mp_cmd_free(cmd);
   }
@@ -1653,6 +1835,7 @@ static void update_osd_msg(void) {
 
 
 void reinit_audio_chain(void) {
+    float latency;
     if (!mpctx->sh_audio)
         return;
     if (!(initialized_flags & INITIALIZED_ACODEC)) {
@@ -1678,6 +1861,13 @@ void reinit_audio_chain(void) {
                                // output:
                                &ao_data.samplerate, &ao_data.channels, &ao_data.format)){
             mp_msg(MSGT_CPLAYER,MSGL_ERR,MSGTR_AudioFilterChainPreinitError);
+            // the main thread owns the teardown, it exits when it sees this
+            if (on_audio_thread()) {
+#ifdef HAVE_PTHREADS
+                audio_thread_error = 1;
+#endif
+                goto init_error;
+            }
             exit_player(EXIT_ERROR);
         }
         current_module="ao2_init";
@@ -1704,10 +1894,22 @@ void reinit_audio_chain(void) {
 
     // init audio filters:
     current_module="af_init";
-    if(!build_afilter_chain(mpctx->sh_audio, &ao_data)) {
+    if(!gapless_reuse_afilter(mpctx->sh_audio) &&
+       !build_afilter_chain(mpctx->sh_audio, &ao_data)) {
         mp_msg(MSGT_CPLAYER,MSGL_ERR,MSGTR_NoMatchingFilter);
         goto init_error;
     }
+    if (mpctx->gapless_len) {
+        // the end of the previous file goes out first
+        mp_audio_out_write(mpctx->sh_audio, mpctx->gapless_buf, mpctx->gapless_len);
+        free(mpctx->gapless_buf);
+        mpctx->gapless_buf = NULL;
+        mpctx->gapless_len = 0;
+    }
+    // nothing waits for the sound without video, a deep queue rides out
+    // stalls; with video the ao keeps it as short as it can
+    latency = mpctx->sh_video ? 0 : AUDIO_ONLY_LATENCY;
+    mpctx->audio_out->control(AOCONTROL_SET_LATENCY, &latency);
     mpctx->mixer.audio_out = mpctx->audio_out;
     mpctx->mixer.volstep = volstep;
     return;
@@ -1829,13 +2031,19 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
 	if (in_size > max_framesize)
 	    max_framesize = in_size;
 	current_module = "decode video";
+	yield_audio_lock();
 	decoded_frame = decode_video(sh_video, start, in_size, drop_frame, pts, NULL);
+	take_audio_lock();
 	if (decoded_frame) {
+	    int res;
 	    update_subtitles(sh_video, sh_video->pts, mpctx->d_sub, 0);
 	    update_teletext(sh_video, mpctx->demuxer, 0);
 	    update_osd_msg();
 	    current_module = "filter video";
-	    if (filter_video(sh_video, decoded_frame, sh_video->pts))
+	    yield_audio_lock();
+	    res = filter_video(sh_video, decoded_frame, sh_video->pts);
+	    take_audio_lock();
+	    if (res)
 		break;
 	} else if (drop_frame)
 	    return -1;
@@ -1849,7 +2057,12 @@ static int generate_video_frame(sh_video_t *sh_video, demux_stream_t *d_video)
     int rtc_fd = -1;
 #endif
 
-static float timing_sleep(float time_frame)
+/**
+ * \brief sleep until the next frame is due
+ * \param cmd_pending set when the sleep was cut short by user input
+ * \return remaining time until the frame is due
+ */
+static float timing_sleep(float time_frame, int *cmd_pending)
 {
 #ifdef HAVE_RTC
     if (rtc_fd >= 0){
@@ -1869,7 +2082,16 @@ static float timing_sleep(float time_frame)
 	float margin = softsleep ? 0.011 : 0;
 	current_module = "sleep_timer";
 	while (time_frame > margin) {
-	    usec_sleep(1000000 * (time_frame - margin));
+	    int ms = 1000 * (time_frame - margin);
+	    // wait on the input fds rather than sleeping blindly so that
+	    // commands are handled right away, not after the frame is shown
+	    if (ms > 0) {
+		if (mp_input_wait(ms, 0, -1)) {
+		    *cmd_pending = 1;
+		    return time_frame - GetRelativeTime();
+		}
+	    } else
+		usec_sleep(1000000 * (time_frame - margin));
 	    time_frame -= GetRelativeTime();
 	}
 	if (softsleep){
@@ -2129,10 +2351,15 @@ static int fill_audio_out_buffers(void)
     int audio_eof=0;
     int bytes_to_write;
     int format_change = 0;
+    int out_fd = -1;
     sh_audio_t * const sh_audio = mpctx->sh_audio;
 
     current_module="play_audio";
 
+    if (!mpctx->sh_video &&
+        mpctx->audio_out->control(AOCONTROL_GET_POLL_FD, &out_fd) != CONTROL_OK)
+	out_fd = -1;
+
     while (1) {
 	int sleep_time;
 	// all the current uses of ao_data.pts seem to be in aos that handle
@@ -2148,7 +2375,12 @@ static int fill_audio_out_buffers(void)
 	// to avoid 100% CPU use
 	sleep_time = (ao_data.outburst - bytes_to_write) * 1000 / ao_data.bps;
 	if (sleep_time < 10) sleep_time = 10; // limit to 100 wakeups per second
-	usec_sleep(sleep_time * 1000);
+	// wake up for the audio device or for user input, whichever is first;
+	// a pending command goes to the main loop right away
+	if (mp_input_wait(sleep_time, 0, out_fd))
+	    return 1;
+	// do not spin on a device that claims to have room too early
+	out_fd = -1;
     }
 
     while (bytes_to_write) {
@@ -2168,6 +2400,12 @@ static int fill_audio_out_buffers(void)
 	if (!format_change && res < 0) // EOF or error
 	    if (mpctx->d_audio->eof) {
 		audio_eof = 1;
+		// with the next file open already, the rest is played in
+		// front of its first samples without closing the ao
+		if (gapless_audio && prefetch_ready()) {
+		    mpctx->gapless_eof = 1;
+		    return 0;
+		}
 		if (sh_audio->a_out_buffer_len == 0)
 		    return 0;
 	    }
@@ -2188,12 +2426,11 @@ static int fill_audio_out_buffers(void)
 	// They're obviously badly broken in the way they handle av sync;
 	// would not having access to this make them more broken?
 	ao_data.pts = ((mpctx->sh_video?mpctx->sh_video->timer:0)+mpctx->delay)*90000.0;
-	playsize = mpctx->audio_out->play(sh_audio->a_out_buffer, playsize, playflags);
+	playsize = mpctx->audio_out->play(mp_audio_out_peek(sh_audio, playsize),
+	                                  playsize, playflags);
 
 	if (playsize > 0) {
-	    sh_audio->a_out_buffer_len -= playsize;
-	    memmove(sh_audio->a_out_buffer, &sh_audio->a_out_buffer[playsize],
-		    sh_audio->a_out_buffer_len);
+	    mp_audio_out_consume(sh_audio, playsize);
 	    mpctx->delay += playback_speed*playsize/(double)ao_data.bps;
 	}
 	else if ((format_change || audio_eof) && mpctx->audio_out->get_delay() < .04) {
@@ -2210,6 +2447,53 @@ static int fill_audio_out_buffers(void)
     return 1;
 }
 
+#ifdef HAVE_PTHREADS
+static void *audio_thread_loop(void *arg)
+{
+    while (1) {
+        int sleep_time = 10;
+        pthread_mutex_lock(&audio_lock);
+        if (audio_thread_quit) {
+            pthread_mutex_unlock(&audio_lock);
+            break;
+        }
+        if (audio_in_thread() && mpctx->sh_audio) {
+            int space;
+            fill_audio_out_buffers();
+            // wake up when the ao takes the next outburst
+            if (mpctx->sh_audio && ao_data.bps > 0) {
+                space = mpctx->audio_out->get_space();
+                if (space < ao_data.outburst)
+                    sleep_time = (ao_data.outburst - space) * 1000 / ao_data.bps;
+                sleep_time = av_clip(sleep_time, 1, 50);
+            }
+        }
+        pthread_mutex_unlock(&audio_lock);
+        usec_sleep(sleep_time * 1000);
+    }
+    return NULL;
+}
+#endif
+
+/// start feeding the ao from its own thread, the caller holds audio_lock after
+static void start_audio_thread(void)
+{
+#ifdef HAVE_PTHREADS
+    if (audio_thread_running)
+        return;
+    pthread_mutex_lock(&audio_lock);
+    audio_thread_quit = 0;
+    audio_thread_error = 0;
+    if (pthread_create(&audio_thread, NULL, audio_thread_loop, NULL)) {
+        pthread_mutex_unlock(&audio_lock);
+        return;
+    }
+    audio_thread_running = 1;
+    audio_lock_held = 1;
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Audio output runs in its own thread.\n");
+#endif
+}
+
 static int sleep_until_update(float *time_frame, float *aq_sleep_time)
 {
     int frame_time_remaining = 0;
@@ -2272,8 +2556,15 @@ static int sleep_until_update(float *time_frame, float *aq_sleep_time)
     //============================== SLEEP: ===================================
 
     // flag 256 means: libvo driver does its timing (dvb card)
-    if (*time_frame > 0.001 && !(vo_flags&256))
-	*time_frame = timing_sleep(*time_frame);
+    if (*time_frame > 0.001 && !(vo_flags&256)) {
+	int cmd_pending = 0;
+	yield_audio_lock();
+	*time_frame = timing_sleep(*time_frame, &cmd_pending);
+	take_audio_lock();
+	// handle the command first, the frame is shown on the next iteration
+	if (cmd_pending)
+	    frame_time_remaining = 1;
+    }
 
 #ifdef CONFIG_NETWORKING
     if (udp_master) {
@@ -2428,6 +2719,7 @@ static double update_video(int *blit_frame)
 	    max_framesize = in_size; // stats
 	drop_frame = check_framedrop(frame_time);
 	current_module = "decode_video";
+	yield_audio_lock();
 #ifdef CONFIG_DVDNAV
 	full_frame = 1;
 	decoded_frame = mp_dvdnav_restore_smpi(&in_size,&start,decoded_frame);
@@ -2436,6 +2728,7 @@ static double update_video(int *blit_frame)
 #endif
 	decoded_frame = decode_video(sh_video, start, in_size, drop_frame,
 				     sh_video->pts, &full_frame);
+	take_audio_lock();
 
     if (full_frame) {
 	sh_video->timer += frame_time;
@@ -2477,8 +2770,10 @@ static double update_video(int *blit_frame)
     } while (!full_frame);
 
 	current_module = "filter_video";
+	yield_audio_lock();
 	*blit_frame = (decoded_frame && filter_video(sh_video, decoded_frame,
 						    sh_video->pts));
+	take_audio_lock();
     }
     else {
 	int res = generate_video_frame(sh_video, mpctx->d_video);
@@ -2512,9 +2807,30 @@ static double update_video(int *blit_frame)
     return frame_time;
 }
 
+/**
+ * \return how long pause_loop() may block waiting for input, in ms
+ */
+static int pause_wait_time(void)
+{
+#ifdef CONFIG_GUI
+    if (use_gui)
+        return 20;
+#endif
+#ifdef CONFIG_MENU
+    if (vf_menu)
+        return 20;
+#endif
+    if (mpctx->sh_video && mpctx->video_out && vo_config_count &&
+        mpctx->video_out->control(VOCTRL_NEEDS_EVENT_POLL, NULL) != VO_FALSE)
+        return 20;
+    // nothing to poll, only input can end the pause
+    return 1000;
+}
+
 static void pause_loop(void)
 {
     mp_cmd_t* cmd;
+    int wait_time;
     if (!quiet) {
         // Small hack to display the pause message on the OSD line.
         // The pause string is: "\n == PAUSE == \r" so we need to
@@ -2538,8 +2854,10 @@ static void pause_loop(void)
 
     if (mpctx->audio_out && mpctx->sh_audio)
         mpctx->audio_out->pause(); // pause audio, keep data if possible
+    libmplayer_event(LIBMPLAYER_EVENT_PAUSE, 0, NULL);
 
-    while ( (cmd = mp_input_get_cmd(20, 1, 1)) == NULL || cmd->pausing == 4) {
+    wait_time = pause_wait_time();
+    while ( (cmd = mp_input_get_cmd(wait_time, 1, 1)) == NULL || cmd->pausing == 4) {
         if (cmd) {
           cmd = mp_input_get_cmd(0,1,0);
           run_command(mpctx, cmd);
@@ -2560,7 +2878,6 @@ static void pause_loop(void)
         if (vf_menu)
             vf_menu_pause_update(vf_menu);
 #endif
-        usec_sleep(20000);
     }
     if (cmd && cmd->id == MP_CMD_PAUSE) {
         cmd = mp_input_get_cmd(0,1,0);
@@ -2576,6 +2893,7 @@ static void pause_loop(void)
     if (mpctx->video_out && mpctx->sh_video && vo_config_count)
         mpctx->video_out->control(VOCTRL_RESUME, NULL); // resume video
     (void)GetRelativeTime(); // ignore time that passed during pause
+    libmplayer_event(LIBMPLAYER_EVENT_UNPAUSE, 0, NULL);
 #ifdef CONFIG_GUI
     if (use_gui) {
         if (guiIntfStruct.Playing == guiSetStop)
@@ -2705,6 +3023,7 @@ static int seek(MPContext *mpctx, double amount, int style)
     if (mpctx->sh_audio) {
 	current_module = "seek_audio_reset";
 	mpctx->audio_out->reset(); // stop audio, throwing away buffered data
+	mpctx->gapless_eof = 0;
 	if (!mpctx->sh_video)
 	    update_subtitles(NULL, mpctx->sh_audio->pts, mpctx->d_sub, 1);
     }
@@ -2736,6 +3055,32 @@ static int seek(MPContext *mpctx, double amount, int style)
 /* This preprocessor directive is a hack to generate a mplayer-nomain.o object
  * file for some tools to link against. */
 #ifndef DISABLE_MAIN
+/// open the file the playtree moves to at the end of this one in the background
+static void prefetch_next_file(void)
+{
+    play_tree_iter_t *iter;
+    char *next = NULL;
+    int loop;
+
+    // skip what needs the file opened in a special way or exactly once
+    if (!mpctx->playtree_iter || mpctx->loop_times >= 0 || stream_dump_type ||
+        seek_to_byte || audio_stream || sub_stream ||
+        mp_msg_test(MSGT_IDENTIFY, MSGL_INFO))
+        return;
+    iter = play_tree_iter_new_copy(mpctx->playtree_iter);
+    if (!iter)
+        return;
+    // stepping past the end counts down the loops of the shared root
+    loop = iter->root->loop;
+    if (play_tree_iter_step(iter, 1, 0) == PLAY_TREE_ITER_ENTRY &&
+        !iter->tree->params) // entry options may change how it is opened
+        next = play_tree_iter_get_file(iter, 1);
+    iter->root->loop = loop;
+    if (next)
+        prefetch_start(next, audio_id, video_id, dvdsub_id);
+    play_tree_iter_free(iter);
+}
+
 int main(int argc,char* argv[]){
 
 
@@ -2752,6 +3097,8 @@ int i;
 
 int gui_no_filename=0;
 
+int keep_ao;
+
   InitTimer();
   srand(GetTimerMS());
 
@@ -3069,6 +3416,8 @@ if(!codecs_file || !parse_codec_cfg(codecs_file)){
 current_module = "init_input";
 mp_input_init();
   mp_input_add_key_fd(-1,0,mplayer_get_key,NULL);
+  mp_cmd_fifo_init();
+  libmplayer_event(LIBMPLAYER_EVENT_READY, 0, NULL);
 if(slave_mode)
   mp_input_add_cmd_fd(0,USE_SELECT,MP_INPUT_SLAVE_CMD_FUNC,NULL);
 else if(!noconsolecontrols)
@@ -3099,14 +3448,16 @@ stream_set_interrupt_callback(mp_input_check_interrupt);
 initialized_flags|=INITIALIZED_INPUT;
 current_module = NULL;
 
+#ifdef CONFIG_CRASH_DEBUG
+  prog_path = argv[0];
+#endif
+  // signal handling belongs to the embedding application
+  if (!libmplayer_embedded) {
   /// Catch signals
 #ifndef __MINGW32__
   signal(SIGCHLD,child_sighandler);
 #endif
 
-#ifdef CONFIG_CRASH_DEBUG
-  prog_path = argv[0];
-#endif
   //========= Catch terminate signals: ================
   // terminate requests:
   signal(SIGTERM,exit_sighandler); // kill
@@ -3128,6 +3479,7 @@ current_module = NULL;
     signal(SIGTRAP,exit_sighandler);
 #endif
 #endif
+  }
 
 #ifdef CONFIG_GUI
   if(use_gui){
@@ -3235,6 +3587,7 @@ while (player_idle_mode && !filename) {
         case MP_CMD_GET_PROPERTY:
         case MP_CMD_SET_PROPERTY:
         case MP_CMD_STEP_PROPERTY:
+        case MP_CMD_EMBED_CALL:
             run_command(mpctx, cmd);
             break;
     }
@@ -3272,6 +3625,7 @@ while (player_idle_mode && !filename) {
     if(filename) {
 	mp_msg(MSGT_CPLAYER,MSGL_INFO,MSGTR_Playing,
 		filename_recode(filename));
+        libmplayer_event(LIBMPLAYER_EVENT_START_FILE, 0, filename);
         if(use_filename_title && vo_wintitle == NULL)
             vo_wintitle = strdup ( mp_basename2 (filename));
     }
@@ -3349,7 +3703,11 @@ while (player_idle_mode && !filename) {
   mpctx->sh_video=NULL;
 
   current_module="open_stream";
-  mpctx->stream=open_stream(filename,0,&mpctx->file_format);
+  if(prefetch_take(filename,audio_id,video_id,dvdsub_id,
+                   &mpctx->stream,&mpctx->demuxer,&mpctx->file_format))
+    mp_msg(MSGT_CPLAYER,MSGL_V,"Using %s opened ahead.\n",filename_recode(filename));
+  else
+    mpctx->stream=open_stream(filename,0,&mpctx->file_format);
   if(!mpctx->stream) { // error...
     mpctx->eof = libmpdemux_was_interrupted(PT_NEXT_ENTRY);
     goto goto_next_file;
@@ -3442,7 +3800,7 @@ if(mpctx->stream->type==STREAMTYPE_DVDNAV){
 
 // CACHE2: initial prefill: 20%  later: 5%  (should be set by -cacheopts)
 goto_enable_cache:
-if(stream_cache_size>0){
+if(stream_cache_size>0 && !mpctx->demuxer){
   int res;
   current_module="enable_cache";
   res = stream_enable_cache(mpctx->stream,stream_cache_size*1024,
@@ -3455,7 +3813,8 @@ if(stream_cache_size>0){
 //============ Open DEMUXERS --- DETECT file type =======================
 current_module="demux_open";
 
-mpctx->demuxer=demux_open(mpctx->stream,mpctx->file_format,audio_id,video_id,dvdsub_id,filename);
+if(!mpctx->demuxer) // unless opened at the end of the previous file
+  mpctx->demuxer=demux_open(mpctx->stream,mpctx->file_format,audio_id,video_id,dvdsub_id,filename);
 
 // HACK to get MOV Reference Files working
 
@@ -3813,12 +4172,16 @@ mp_input_set_section(NULL);
 if (mpctx->stream->type==STREAMTYPE_TV) mp_input_set_section("tv");
 if (mpctx->stream->type==STREAMTYPE_DVDNAV) mp_input_set_section("dvdnav");
 
+if (gapless_audio)
+    prefetch_next_file();
+
 //==================== START PLAYING =======================
 
 if(mpctx->loop_times>1) mpctx->loop_times--; else
 if(mpctx->loop_times==1) mpctx->loop_times = -1;
 
 mp_msg(MSGT_CPLAYER,MSGL_INFO,MSGTR_StartPlaying);
+libmplayer_event(LIBMPLAYER_EVENT_PLAYBACK_START, 0, NULL);
 
 total_time_usage_start=GetTimer();
 audio_time_usage=0; video_time_usage=0; vout_time_usage=0;
@@ -3848,6 +4211,9 @@ if (mpctx->stream->type == STREAMTYPE_DVDNAV) {
 }
 #endif
 
+if (use_audio_thread && mpctx->sh_audio && mpctx->sh_video)
+    start_audio_thread();
+
 while(!mpctx->eof){
     float aq_sleep_time=0;
 
@@ -3857,6 +4223,11 @@ if(dvd_last_chapter>0) {
     goto goto_next_file;
 }
 
+#ifdef HAVE_PTHREADS
+if (audio_thread_error)
+    exit_player(EXIT_ERROR);
+#endif
+
 if(!mpctx->sh_audio && mpctx->d_audio->sh) {
   mpctx->sh_audio = mpctx->d_audio->sh;
   mpctx->sh_audio->ds = mpctx->d_audio;
@@ -3865,7 +4236,7 @@ if(!mpctx->sh_audio && mpctx->d_audio->sh) {
 
 /*========================== PLAY AUDIO ============================*/
 
-if (mpctx->sh_audio)
+if (mpctx->sh_audio && !audio_in_thread())
     if (!fill_audio_out_buffers())
 	// at eof, all audio at least written to ao
 	if (!mpctx->sh_video)
@@ -3956,7 +4327,9 @@ if (!edl_needs_reset) {
     if (!frame_time_remaining && blit_frame) {
         unsigned int t2=GetTimer();
 
+        yield_audio_lock();
         if(vo_config_count) mpctx->video_out->flip_page();
+        take_audio_lock();
         mpctx->num_buffered_frames--;
 
         vout_time_usage += (GetTimer() - t2) * 0.000001;
@@ -4122,6 +4495,8 @@ if(rel_seek_secs || abs_seek_pos){
 
 } // while(!mpctx->eof)
 
+stop_audio_thread();
+
 mp_msg(MSGT_GLOBAL,MSGL_V,"EOF code: %d  \n",mpctx->eof);
 
 #ifdef CONFIG_DVBIN
@@ -4138,7 +4513,10 @@ if(mpctx->dvbin_reopen)
 
 goto_next_file:  // don't jump here after ao/vo/getch initialization!
 
+stop_audio_thread();
+
 mp_msg(MSGT_CPLAYER,MSGL_INFO,"\n");
+libmplayer_event(LIBMPLAYER_EVENT_END_FILE, mpctx->eof, NULL);
 
 if(benchmark){
     double tot=video_time_usage+vout_time_usage+audio_time_usage;
@@ -4165,8 +4543,19 @@ if(benchmark){
                (total_time_usage>0.5)?(total_frame_cnt/total_time_usage):0);
 }
 
+// the audio of the next file continues where this one ended
+keep_ao = 0;
+if (mpctx->gapless_eof) {
+    if (prefetch_open_demuxer()) {
+        gapless_keep_audio();
+        keep_ao = INITIALIZED_AO;
+    } else
+        gapless_flush_audio();
+}
+mpctx->gapless_eof = 0;
+
 // time to uninit all, except global stuff:
-uninit_player(INITIALIZED_ALL-(INITIALIZED_GUI+INITIALIZED_INPUT+(fixed_vo?INITIALIZED_VO:0)));
+uninit_player(INITIALIZED_ALL-(INITIALIZED_GUI+INITIALIZED_INPUT+(fixed_vo?INITIALIZED_VO:0)+keep_ao));
 
 if(mpctx->set_of_sub_size > 0) {
     current_module="sub_free";
@@ -0,0 +1,184 @@
+/*
+ * opening the next playlist entry while the current one plays
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "mp_msg.h"
+#include "mplayer.h"
+#include "stream/stream.h"
+#include "libmpdemux/demuxer.h"
+#include "prefetch.h"
+
+/// bytes read in the background so that the demuxer headers are cached
+#define READ_AHEAD (1024 * 1024)
+
+#ifdef HAVE_PTHREADS
+static struct {
+    char *filename;
+    int aid, vid, sid;
+    pthread_t thread;
+    int running;                ///< thread started and not joined yet
+    int done;                   ///< thread finished, protected by lock
+    stream_t *stream;
+    int file_format;
+    demuxer_t *demuxer;         ///< opened by the main thread only
+} ahead;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Probing and demuxer headers use the option and state globals of the
+   player, so the thread only opens the stream and reads the start of the
+   file; the demuxer is opened at the file switch. */
+static void *prefetch_thread(void *arg)
+{
+    int file_format = DEMUXER_TYPE_UNKNOWN;
+    stream_t *stream = open_stream(ahead.filename, NULL, &file_format);
+    int len = 0;
+
+    if (stream && stream->type != STREAMTYPE_FILE) {
+        free_stream(stream);
+        stream = NULL;
+    }
+    if (stream && file_format != DEMUXER_TYPE_PLAYLIST) {
+        unsigned char *buf = malloc(READ_AHEAD);
+        if (buf) {
+            len = stream_read(stream, buf, READ_AHEAD);
+            free(buf);
+        }
+        stream_reset(stream);
+        stream_seek(stream, stream->start_pos);
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Opened next file %s ahead: %s, %d bytes read\n",
+           ahead.filename, stream ? "stream" : "failed", len);
+    pthread_mutex_lock(&lock);
+    ahead.stream = stream;
+    ahead.file_format = file_format;
+    ahead.done = 1;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void prefetch_join(void)
+{
+    if (ahead.running) {
+        pthread_join(ahead.thread, NULL);
+        ahead.running = 0;
+    }
+}
+#endif
+
+void prefetch_start(const char *filename, int aid, int vid, int sid)
+{
+#ifdef HAVE_PTHREADS
+    prefetch_cancel();
+    // anything else may block or can only be opened once
+    if (!strcmp(filename, "-") ||
+        (strstr(filename, "://") && strncmp(filename, "file://", 7)))
+        return;
+    ahead.filename = strdup(filename);
+    if (!ahead.filename)
+        return;
+    ahead.aid = aid;
+    ahead.vid = vid;
+    ahead.sid = sid;
+    ahead.done = 0;
+    if (pthread_create(&ahead.thread, NULL, prefetch_thread, NULL)) {
+        free(ahead.filename);
+        ahead.filename = NULL;
+        return;
+    }
+    ahead.running = 1;
+#endif
+}
+
+int prefetch_ready(void)
+{
+    int res = 0;
+#ifdef HAVE_PTHREADS
+    if (!ahead.filename)
+        return 0;
+    pthread_mutex_lock(&lock);
+    res = ahead.done && ahead.stream;
+    pthread_mutex_unlock(&lock);
+#endif
+    return res;
+}
+
+int prefetch_open_demuxer(void)
+{
+#ifdef HAVE_PTHREADS
+    if (!ahead.filename)
+        return 0;
+    prefetch_join();
+    // with a cache the player has to set it up before the demuxer reads
+    if (!ahead.demuxer && ahead.stream &&
+        ahead.file_format != DEMUXER_TYPE_PLAYLIST && stream_cache_size <= 0)
+        ahead.demuxer = demux_open(ahead.stream, ahead.file_format, ahead.aid,
+                                   ahead.vid, ahead.sid, ahead.filename);
+    return ahead.demuxer && ahead.demuxer->audio->sh;
+#else
+    return 0;
+#endif
+}
+
+int prefetch_take(const char *filename, int aid, int vid, int sid,
+                  stream_t **stream, demuxer_t **demuxer, int *file_format)
+{
+#ifdef HAVE_PTHREADS
+    if (!ahead.filename)
+        return 0;
+    prefetch_join();
+    if (!ahead.stream || strcmp(filename, ahead.filename) ||
+        aid != ahead.aid || vid != ahead.vid || sid != ahead.sid) {
+        prefetch_cancel();
+        return 0;
+    }
+    *stream = ahead.stream;
+    *demuxer = ahead.demuxer;
+    *file_format = ahead.file_format;
+    ahead.stream = NULL;
+    ahead.demuxer = NULL;
+    free(ahead.filename);
+    ahead.filename = NULL;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void prefetch_cancel(void)
+{
+#ifdef HAVE_PTHREADS
+    prefetch_join();
+    if (ahead.demuxer)
+        free_demuxer(ahead.demuxer);
+    if (ahead.stream)
+        free_stream(ahead.stream);
+    ahead.demuxer = NULL;
+    ahead.stream = NULL;
+    free(ahead.filename);
+    ahead.filename = NULL;
+#endif
+}
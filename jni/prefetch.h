@@ -0,0 +1,48 @@
+/*
+ * opening the next playlist entry while the current one plays
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_PREFETCH_H
+#define MPLAYER_PREFETCH_H
+
+#include "stream/stream.h"
+#include "libmpdemux/demuxer.h"
+
+/**
+ * \brief open the stream of a local file and read its start in a background
+ * thread, dropping whatever was opened before
+ */
+void prefetch_start(const char *filename, int aid, int vid, int sid);
+/// \return 1 if the stream is open, without waiting for it
+int prefetch_ready(void);
+/**
+ * \brief open the demuxer on the stream opened ahead, main thread only
+ * \return 1 if the file has audio
+ */
+int prefetch_open_demuxer(void);
+/**
+ * \brief take over what was opened if it is filename with the same ids
+ * \param demuxer set to NULL unless prefetch_open_demuxer() opened it
+ * \return 1 if stream, demuxer and file_format were set
+ */
+int prefetch_take(const char *filename, int aid, int vid, int sid,
+                  stream_t **stream, demuxer_t **demuxer, int *file_format);
+void prefetch_cancel(void);
+
+#endif /* MPLAYER_PREFETCH_H */
@@ -64,6 +64,7 @@ static void *ThreadProc(void *s);
 
 #include "stream.h"
 #include "cache2.h"
+#include "cache_disk.h"
 
 typedef struct {
   // constats:
@@ -85,6 +86,8 @@ typedef struct {
 //  int fifo_flag;  // 1 if we should use FIFO to notice cache about buffer reads.
   // callback
   stream_t* stream;
+  // persistent backing store, only touched by the filler
+  cache_disk_t *disk;
   volatile int control;
   volatile unsigned control_uint_arg;
   volatile double control_double_arg;
@@ -188,9 +191,13 @@ static int cache_fill(cache_vars_t *s)
       {
         s->offset= // FIXME!?
         s->min_filepos=s->max_filepos=read; // drop cache content :(
+        // with a disk cache the stream is only repositioned once we
+        // reach a range that was not fetched before
+        if(!s->disk){
         if(s->stream->eof) stream_reset(s->stream);
         stream_seek(s->stream,read);
         mp_msg(MSGT_CACHE,MSGL_DBG2,"Seek done. new pos: 0x%"PRIX64"  \n",(int64_t)stream_tell(s->stream));
+        }
       }
   }
 
@@ -238,7 +245,22 @@ static int cache_fill(cache_vars_t *s)
   //len=stream_fill_buffer(s->stream);
   //memcpy(&s->buffer[pos],s->stream->buffer,len); // avoid this extra copy!
   // ....
-  len=stream_read(s->stream,&s->buffer[pos],space);
+  len=0;
+  if(s->disk)
+    len=cache_disk_read(s->disk,s->max_filepos,&s->buffer[pos],space);
+  if(!len){
+    if(s->disk && stream_tell(s->stream)!=s->max_filepos){
+      if(s->stream->eof) stream_reset(s->stream);
+      if(!stream_seek(s->stream,s->max_filepos)){
+        s->eof=1;
+        return 0;
+      }
+      mp_msg(MSGT_CACHE,MSGL_DBG2,"Seek done. new pos: 0x%"PRIX64"  \n",(int64_t)stream_tell(s->stream));
+    }
+    len=stream_read(s->stream,&s->buffer[pos],space);
+    if(s->disk)
+      cache_disk_write(s->disk,s->max_filepos,&s->buffer[pos],len);
+  }
   s->eof= !len;
 
   s->max_filepos+=len;
@@ -370,6 +392,7 @@ static void cache_mainloop(cache_vars_t *s) {
     sa.sa_handler = SIG_IGN;
     sigaction(SIGUSR1, &sa, NULL);
 #endif
+    s->disk = cache_disk_open(s->stream);
     do {
         if (!cache_fill(s)) {
 #if FORKED_CACHE
@@ -392,6 +415,8 @@ static void cache_mainloop(cache_vars_t *s) {
             sleep_count = 0;
 //        cache_stats(s->cache_data);
     } while (cache_execute_control(s));
+    cache_disk_close(s->disk);
+    s->disk = NULL;
 }
 
 /**
@@ -0,0 +1,406 @@
+/*
+ * Persistent on-disk cache for network streams.
+ *
+ * Every cached resource is stored as a sparse data file plus a range map
+ * listing which byte ranges of the data file are valid. Both are named
+ * after a hash of the URL, the server validator (ETag/Last-Modified) and
+ * the resource size, so a changed resource never hits stale data.
+ * The total size of the cache directory is bounded by -cache-disk-size,
+ * least recently used entries are evicted when a stream is opened and
+ * again whenever the stream being cached runs into the cap.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "osdep/timer.h"
+#include "stream.h"
+#include "cache_disk.h"
+
+#define MAP_MAGIC "MPDC"
+#define MAP_VERSION 1
+// rewrite the range map at most this often while filling, the forked
+// cache process is killed without getting a chance to flush
+#define MAP_FLUSH_MS 1000
+
+char *stream_cache_dir = NULL;
+int stream_cache_disk_size = 256 * 1024;
+
+typedef struct {
+    off_t start, end;
+} cache_range_t;
+
+struct cache_disk {
+    int fd;
+    char *data_path;
+    char *map_path;
+    char *key;
+    off_t size;
+    cache_range_t *ranges;  // sorted, non-overlapping, non-adjacent
+    int num_ranges;
+    int max_ranges;
+    off_t cached_bytes;
+    off_t max_bytes;
+    off_t budget;           // bytes that can still be written before the cap
+    int full;               // the cap was hit with nothing left to evict
+    int dirty;
+    unsigned last_flush;
+};
+
+static uint64_t key_hash(const char *key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static char *path_join(const char *dir, uint64_t hash, const char *ext)
+{
+    char *path = malloc(strlen(dir) + 16 + strlen(ext) + 3);
+    if (path)
+        sprintf(path, "%s/%016"PRIx64"%s", dir, hash, ext);
+    return path;
+}
+
+/**
+ * \brief find the range containing pos or the first one after it
+ */
+static int find_range(cache_disk_t *d, off_t pos)
+{
+    int lo = 0, hi = d->num_ranges;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (d->ranges[mid].end <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void add_range(cache_disk_t *d, off_t start, off_t end)
+{
+    int i = find_range(d, start);
+    int j;
+    // ranges that only touch the new one are merged as well
+    if (i > 0 && d->ranges[i - 1].end == start)
+        i--;
+    j = i;
+    while (j < d->num_ranges && d->ranges[j].start <= end) {
+        if (d->ranges[j].start < start)
+            start = d->ranges[j].start;
+        if (d->ranges[j].end > end)
+            end = d->ranges[j].end;
+        d->cached_bytes -= d->ranges[j].end - d->ranges[j].start;
+        j++;
+    }
+    if (i == j) {
+        if (d->num_ranges == d->max_ranges) {
+            int n = d->max_ranges ? 2 * d->max_ranges : 16;
+            cache_range_t *r = realloc(d->ranges, n * sizeof(*r));
+            if (!r)
+                return;
+            d->ranges = r;
+            d->max_ranges = n;
+        }
+        memmove(d->ranges + i + 1, d->ranges + i,
+                (d->num_ranges - i) * sizeof(*d->ranges));
+        d->num_ranges++;
+    } else if (j - i > 1) {
+        memmove(d->ranges + i + 1, d->ranges + j,
+                (d->num_ranges - j) * sizeof(*d->ranges));
+        d->num_ranges -= j - i - 1;
+    }
+    d->ranges[i].start = start;
+    d->ranges[i].end   = end;
+    d->cached_bytes   += end - start;
+    d->dirty = 1;
+}
+
+static int load_map(cache_disk_t *d)
+{
+    char magic[4];
+    uint32_t version, key_len, count, i;
+    int64_t size, r[2];
+    char *key;
+    int res = 0;
+    FILE *f = fopen(d->map_path, "rb");
+    if (!f)
+        return 0;
+    if (fread(magic, 4, 1, f) != 1 || memcmp(magic, MAP_MAGIC, 4) ||
+        fread(&version, 4, 1, f) != 1 || version != MAP_VERSION ||
+        fread(&key_len, 4, 1, f) != 1 || key_len != strlen(d->key))
+        goto out;
+    key = malloc(key_len);
+    if (!key || fread(key, key_len, 1, f) != 1 || memcmp(key, d->key, key_len)) {
+        free(key);
+        goto out;
+    }
+    free(key);
+    if (fread(&size, 8, 1, f) != 1 || size != d->size ||
+        fread(&count, 4, 1, f) != 1)
+        goto out;
+    for (i = 0; i < count; i++) {
+        if (fread(r, 8, 2, f) != 2 || r[0] < 0 || r[1] <= r[0])
+            break;
+        add_range(d, r[0], r[1]);
+    }
+    res = 1;
+out:
+    fclose(f);
+    d->dirty = 0;
+    return res;
+}
+
+static void flush_map(cache_disk_t *d)
+{
+    uint32_t version = MAP_VERSION, key_len = strlen(d->key);
+    uint32_t count = d->num_ranges;
+    int64_t size = d->size;
+    int i, ok;
+    char *tmp = malloc(strlen(d->map_path) + 5);
+    FILE *f;
+    if (!tmp)
+        return;
+    sprintf(tmp, "%s.tmp", d->map_path);
+    f = fopen(tmp, "wb");
+    if (!f) {
+        free(tmp);
+        return;
+    }
+    fwrite(MAP_MAGIC, 4, 1, f);
+    fwrite(&version, 4, 1, f);
+    fwrite(&key_len, 4, 1, f);
+    fwrite(d->key, key_len, 1, f);
+    fwrite(&size, 8, 1, f);
+    fwrite(&count, 4, 1, f);
+    for (i = 0; i < d->num_ranges; i++) {
+        int64_t r[2] = { d->ranges[i].start, d->ranges[i].end };
+        fwrite(r, 8, 2, f);
+    }
+    ok = !ferror(f);
+    // the map must never describe data that is not on disk yet
+    fsync(d->fd);
+    if (fclose(f) || !ok || rename(tmp, d->map_path))
+        unlink(tmp);
+    free(tmp);
+    d->dirty = 0;
+    d->last_flush = GetTimerMS();
+}
+
+/**
+ * \brief evict least recently used entries until the directory fits into cap
+ * \return bytes left in the directory, keep included
+ */
+static off_t evict_entries(const char *dir, const char *keep, off_t cap)
+{
+    struct lru_entry {
+        char name[32];
+        time_t atime;
+        off_t bytes;
+    } *e = NULL;
+    int n = 0, max = 0, i;
+    off_t total = 0;
+    struct dirent *de;
+    DIR *dp = opendir(dir);
+    if (!dp)
+        return 0;
+    while ((de = readdir(dp))) {
+        char path[4096];
+        struct stat st;
+        size_t len = strlen(de->d_name);
+        if (len != 20 || strcmp(de->d_name + 16, ".map"))
+            continue;
+        if (n == max) {
+            struct lru_entry *t = realloc(e, (max = 2 * max + 16) * sizeof(*e));
+            if (!t)
+                break;
+            e = t;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (stat(path, &st))
+            continue;
+        strcpy(e[n].name, de->d_name);
+        e[n].atime = st.st_mtime;
+        e[n].bytes = 0;
+        strcpy(path + strlen(path) - 4, ".data");
+        if (!stat(path, &st))
+#ifdef __MINGW32__
+            e[n].bytes = st.st_size;
+#else
+            e[n].bytes = (off_t)st.st_blocks * 512; // data files are sparse
+#endif
+        total += e[n].bytes;
+        n++;
+    }
+    closedir(dp);
+    while (total > cap) {
+        char path[4096];
+        int oldest = -1;
+        for (i = 0; i < n; i++)
+            if (e[i].name[0] && strcmp(e[i].name, keep) &&
+                (oldest < 0 || e[i].atime < e[oldest].atime))
+                oldest = i;
+        if (oldest < 0)
+            break;
+        mp_msg(MSGT_CACHE, MSGL_V, "Disk cache: evicting %s\n", e[oldest].name);
+        snprintf(path, sizeof(path), "%s/%s", dir, e[oldest].name);
+        unlink(path);
+        strcpy(path + strlen(path) - 4, ".data");
+        unlink(path);
+        total -= e[oldest].bytes;
+        e[oldest].name[0] = 0;
+    }
+    free(e);
+    return total;
+}
+
+cache_disk_t *cache_disk_open(stream_t *stream)
+{
+    cache_disk_t *d;
+    const char *etag = NULL;
+    uint64_t hash;
+    char *map_name;
+
+    if (!stream_cache_dir || !*stream_cache_dir || stream_cache_disk_size <= 0 ||
+        !stream->url || !(stream->flags & MP_STREAM_SEEK))
+        return NULL;
+#ifdef CONFIG_NETWORKING
+    if (!stream->streaming_ctrl)
+        return NULL;
+    etag = stream->streaming_ctrl->etag;
+#else
+    return NULL;
+#endif
+#ifdef __MINGW32__
+    mkdir(stream_cache_dir);
+#else
+    mkdir(stream_cache_dir, 0700);
+#endif
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return NULL;
+    d->fd = -1;
+    d->size = stream->end_pos;
+    d->max_bytes = (off_t)stream_cache_disk_size * 1024;
+    d->key = malloc(strlen(stream->url) + (etag ? strlen(etag) : 0) + 32);
+    if (!d->key)
+        goto err_out;
+    sprintf(d->key, "%s\n%s\n%"PRId64, stream->url, etag ? etag : "",
+            (int64_t)d->size);
+    hash = key_hash(d->key);
+    d->data_path = path_join(stream_cache_dir, hash, ".data");
+    d->map_path  = path_join(stream_cache_dir, hash, ".map");
+    if (!d->data_path || !d->map_path)
+        goto err_out;
+
+    map_name = strrchr(d->map_path, '/') + 1;
+    d->budget = d->max_bytes - evict_entries(stream_cache_dir, map_name, d->max_bytes);
+
+    if (!load_map(d)) {
+        // unknown or stale entry, start over with an empty sparse file
+        unlink(d->data_path);
+        unlink(d->map_path);
+    }
+    d->fd = open(d->data_path, O_RDWR | O_CREAT | O_BINARY, 0600);
+    if (d->fd < 0) {
+        mp_msg(MSGT_CACHE, MSGL_WARN, "Disk cache: cannot open %s\n", d->data_path);
+        goto err_out;
+    }
+    if (!d->num_ranges)
+        flush_map(d);
+    else
+        utime(d->map_path, NULL); // mark as recently used
+    mp_msg(MSGT_CACHE, MSGL_V, "Disk cache: %s, %"PRId64" bytes in %d ranges\n",
+           d->data_path, (int64_t)d->cached_bytes, d->num_ranges);
+    return d;
+
+err_out:
+    cache_disk_close(d);
+    return NULL;
+}
+
+int cache_disk_read(cache_disk_t *d, off_t pos, unsigned char *buf, int len)
+{
+    int i = find_range(d, pos);
+    off_t avail;
+    if (i >= d->num_ranges || d->ranges[i].start > pos)
+        return 0;
+    avail = d->ranges[i].end - pos;
+    if (len > avail)
+        len = avail;
+    if (lseek(d->fd, pos, SEEK_SET) != pos)
+        return 0;
+    len = read(d->fd, buf, len);
+    return len < 0 ? 0 : len;
+}
+
+void cache_disk_write(cache_disk_t *d, off_t pos, const unsigned char *buf, int len)
+{
+    if (len <= 0 || d->full)
+        return;
+    if (len > d->budget) {
+        // make room by evicting other entries, the one being filled stays
+        char *map_name = strrchr(d->map_path, '/') + 1;
+        d->budget = d->max_bytes - evict_entries(stream_cache_dir, map_name,
+                                                 d->max_bytes - len);
+        if (len > d->budget) {
+            mp_msg(MSGT_CACHE, MSGL_WARN,
+                   "Disk cache: -cache-disk-size reached, not caching the rest of this stream.\n");
+            d->full = 1;
+            return;
+        }
+    }
+    if (lseek(d->fd, pos, SEEK_SET) != pos || write(d->fd, buf, len) != len)
+        return;
+    d->budget -= len;
+    add_range(d, pos, pos + len);
+    if (d->dirty && GetTimerMS() - d->last_flush > MAP_FLUSH_MS)
+        flush_map(d);
+}
+
+void cache_disk_close(cache_disk_t *d)
+{
+    if (!d)
+        return;
+    if (d->fd >= 0) {
+        if (d->dirty)
+            flush_map(d);
+        close(d->fd);
+    }
+    free(d->ranges);
+    free(d->key);
+    free(d->data_path);
+    free(d->map_path);
+    free(d);
+}
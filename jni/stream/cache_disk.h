@@ -0,0 +1,41 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_CACHE_DISK_H
+#define MPLAYER_CACHE_DISK_H
+
+#include <sys/types.h>
+#include "stream.h"
+
+typedef struct cache_disk cache_disk_t;
+
+/**
+ * Open (or create) the on-disk cache entry for a stream.
+ * \return NULL if the stream cannot be cached on disk or -cache-dir is unset
+ */
+cache_disk_t *cache_disk_open(stream_t *stream);
+/**
+ * Copy already fetched bytes starting at pos.
+ * \return number of bytes copied, 0 if pos is not cached
+ */
+int cache_disk_read(cache_disk_t *d, off_t pos, unsigned char *buf, int len);
+/// Store freshly fetched bytes and add them to the range map.
+void cache_disk_write(cache_disk_t *d, off_t pos, const unsigned char *buf, int len);
+void cache_disk_close(cache_disk_t *d);
+
+#endif /* MPLAYER_CACHE_DISK_H */
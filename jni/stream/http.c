@@ -840,6 +840,13 @@ static int http_streaming_start(stream_t *stream, int* file_format) {
 					mp_msg(MSGT_NETWORK,MSGL_V,"Content-Length: [%s]\n", content_length);
 					stream->end_pos = atoll(content_length);
 				}
+				if( !stream->streaming_ctrl->etag ) {
+					char *validator = http_get_field(http_hdr, "ETag");
+					if( validator==NULL )
+						validator = http_get_field(http_hdr, "Last-Modified");
+					if( validator!=NULL )
+						stream->streaming_ctrl->etag = strdup(validator);
+				}
 				// Look if we can use the Content-Type
 				content_type = http_get_field( http_hdr, "Content-Type" );
 				if( content_type!=NULL ) {
@@ -131,6 +131,7 @@ streaming_ctrl_free( streaming_ctrl_t *streaming_ctrl ) {
 	if( streaming_ctrl->url ) url_free( streaming_ctrl->url );
 	if( streaming_ctrl->buffer ) free( streaming_ctrl->buffer );
 	if( streaming_ctrl->data ) free( streaming_ctrl->data );
+	free( streaming_ctrl->etag );
 	free( streaming_ctrl );
 }
 
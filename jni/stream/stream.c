@@ -74,6 +74,7 @@ extern const stream_info_t stream_info_smb;
 extern const stream_info_t stream_info_sdp;
 extern const stream_info_t stream_info_rtsp_sip;
 
+extern const stream_info_t stream_info_concat;
 extern const stream_info_t stream_info_cue;
 extern const stream_info_t stream_info_null;
 extern const stream_info_t stream_info_mf;
@@ -126,6 +127,7 @@ static const stream_info_t* const auto_open_streams[] = {
 #ifdef CONFIG_LIBSMBCLIENT
   &stream_info_smb,
 #endif
+  &stream_info_concat,
   &stream_info_cue,
 #ifdef CONFIG_DVDREAD
   &stream_info_ifo,
@@ -269,8 +271,116 @@ stream_t* open_output_stream(const char* filename, char** options) {
 
 //=================== STREAMER =========================
 
+static int stream_seek_internal(stream_t *s, off_t newpos);
+
+/**
+ * Keep everything read from s in memory, up to max bytes from the current
+ * position, until stream_probe_end(). Format detection reads the start of
+ * the stream again for every demuxer it tries; with this only the first
+ * read reaches the source, which matters for slow and linear streams.
+ * Not needed with the cache, which does the same.
+ * @return 1 if a probe was started, 0 if not (or one is still in use)
+ */
+int stream_probe_begin(stream_t *s, int max){
+  if(s->probe_buf || s->cache_pid || s->mode != STREAM_READ) return 0;
+  switch(s->type){
+  case STREAMTYPE_FILE:
+  case STREAMTYPE_CONCAT:
+  case STREAMTYPE_VCD:
+  case STREAMTYPE_STREAM:
+  case STREAMTYPE_DVD:
+  case STREAMTYPE_CDDA:
+  case STREAMTYPE_SMB:
+  case STREAMTYPE_VCDBINCUE:
+  case STREAMTYPE_BLURAY:
+  case STREAMTYPE_BD:
+    break;
+  default:
+    return 0;
+  }
+  s->probe_max=max;
+  s->probe_size=FFMAX(s->buf_len,64*1024);
+  s->probe_buf=malloc(s->probe_size);
+  if(!s->probe_buf) return 0;
+  // the current buffer is the start of the probe
+  s->probe_pos=s->pos-s->buf_len;
+  s->probe_len=s->buf_len;
+  memcpy(s->probe_buf,s->buffer,s->buf_len);
+  s->probe_raw_pos=s->pos;
+  s->probe_ended=0;
+  return 1;
+}
+
+static void stream_probe_free(stream_t *s){
+  free(s->probe_buf);
+  s->probe_buf=NULL;
+  s->probe_len=0;
+}
+
+/**
+ * Stop recording. Reads are served from what was recorded until the reader
+ * passes it, since a linear source cannot go back there; after that, or
+ * right away if the reader is elsewhere, the source continues at the
+ * reader's position.
+ */
+void stream_probe_end(stream_t *s){
+  if(!s->probe_buf || s->probe_ended) return;
+  if(s->pos >= s->probe_pos && s->pos < s->probe_pos+s->probe_len){
+    s->probe_max=s->probe_len;
+    s->probe_ended=1;
+    return;
+  }
+  if(s->pos != s->probe_raw_pos){
+    off_t pos=s->pos;
+    s->pos=s->probe_raw_pos;
+    if((!(s->flags & MP_STREAM_SEEK_BW) && pos < s->probe_raw_pos) ||
+       stream_seek_internal(s,pos) >= 0){
+      mp_msg(MSGT_STREAM,MSGL_WARN,"stream_probe_end: can't continue at 0x%"PRIX64"\n",(int64_t)pos);
+      s->buf_pos=s->buf_len=0;
+    } else
+      s->pos=pos;
+  }
+  stream_probe_free(s);
+}
+
+/// add the data just read at s->pos to the probe buffer
+static void stream_probe_append(stream_t *s, int len){
+  if(s->pos != s->probe_pos+s->probe_len || s->probe_len+len > s->probe_max)
+    return;
+  if(s->probe_len+len > s->probe_size){
+    int size=FFMIN(FFMAX(2*s->probe_size,s->probe_len+len),s->probe_max);
+    unsigned char *buf=realloc(s->probe_buf,size);
+    if(!buf) return;
+    s->probe_buf=buf;
+    s->probe_size=size;
+  }
+  memcpy(s->probe_buf+s->probe_len,s->buffer,len);
+  s->probe_len+=len;
+}
+
 int stream_fill_buffer(stream_t *s){
   int len;
+  if(s->probe_buf){
+    off_t off=s->pos-s->probe_pos;
+    if(off >= 0 && off < s->probe_len){
+      len=FFMIN(s->probe_len-off,STREAM_BUFFER_SIZE);
+      memcpy(s->buffer,s->probe_buf+off,len);
+      s->eof=0;
+      s->buf_pos=0;
+      s->buf_len=len;
+      s->pos+=len;
+      return len;
+    }
+    // leaving the recorded data, the source may be elsewhere
+    if(s->pos != s->probe_raw_pos){
+      off_t pos=s->pos;
+      s->pos=s->probe_raw_pos;
+      if(stream_seek_internal(s,pos) >= 0){ s->eof=1; return 0; }
+      s->pos=pos;
+    }
+    if(s->probe_ended)
+      stream_probe_free(s);
+  }
   // we will retry even if we already reached EOF previously.
   switch(s->type){
   case STREAMTYPE_STREAM:
@@ -293,6 +403,10 @@ int stream_fill_buffer(stream_t *s){
     len= s->fill_buffer ? s->fill_buffer(s,s->buffer,STREAM_BUFFER_SIZE) : 0;
   }
   if(len<=0){ s->eof=1; return 0; }
+  if(s->probe_buf){
+    stream_probe_append(s,len);
+    s->probe_raw_pos=s->pos+len;
+  }
   // When reading succeeded we are obviously not at eof.
   // This e.g. avoids issues with eof getting stuck when lavf seeks in MPEG-TS
   s->eof=0;
@@ -314,30 +428,12 @@ int stream_write_buffer(stream_t *s, unsigned char *buf, int len) {
   return rd;
 }
 
-int stream_seek_long(stream_t *s,off_t pos){
-off_t newpos=0;
-
-//  if( mp_msg_test(MSGT_STREAM,MSGL_DBG3) ) printf("seek_long to 0x%X\n",(unsigned int)pos);
-
-  s->buf_pos=s->buf_len=0;
-
-  if(s->mode == STREAM_WRITE) {
-    if(!s->seek || !s->seek(s,pos))
-      return 0;
-    return 1;
-  }
-
-  if(s->sector_size)
-      newpos = (pos/s->sector_size)*s->sector_size;
-  else
-      newpos = pos&(~((off_t)STREAM_BUFFER_SIZE-1));
-
-if( mp_msg_test(MSGT_STREAM,MSGL_DBG3) ){
-  mp_msg(MSGT_STREAM,MSGL_DBG3, "s->pos=%"PRIX64"  newpos=%"PRIX64"  new_bufpos=%"PRIX64"  buflen=%X  \n",
-    (int64_t)s->pos,(int64_t)newpos,(int64_t)pos,s->buf_len);
-}
-  pos-=newpos;
-
+/**
+ * Position the source at newpos.
+ * @return -1 if the caller should fill the buffer from there, otherwise
+ *         the result of the seek
+ */
+static int stream_seek_internal(stream_t *s, off_t newpos){
 if(newpos==0 || newpos!=s->pos){
   switch(s->type){
   case STREAMTYPE_STREAM:
@@ -355,7 +451,7 @@ if(newpos==0 || newpos!=s->pos){
     }
 
     if( s->streaming_ctrl!=NULL && s->streaming_ctrl->streaming_seek ) {
-      if( s->streaming_ctrl->streaming_seek( s->fd, pos, s->streaming_ctrl )<0 ) {
+      if( s->streaming_ctrl->streaming_seek( s->fd, newpos, s->streaming_ctrl )<0 ) {
         mp_msg(MSGT_STREAM,MSGL_INFO,"Stream not seekable!\n");
         return 1;
       }
@@ -384,6 +480,42 @@ if(newpos==0 || newpos!=s->pos){
 //} else {
 //   putchar('%');fflush(stdout);
 }
+  return -1;
+}
+
+int stream_seek_long(stream_t *s,off_t pos){
+off_t newpos=0;
+int res;
+
+//  if( mp_msg_test(MSGT_STREAM,MSGL_DBG3) ) printf("seek_long to 0x%X\n",(unsigned int)pos);
+
+  s->buf_pos=s->buf_len=0;
+
+  if(s->mode == STREAM_WRITE) {
+    if(!s->seek || !s->seek(s,pos))
+      return 0;
+    return 1;
+  }
+
+  if(s->sector_size)
+      newpos = (pos/s->sector_size)*s->sector_size;
+  else
+      newpos = pos&(~((off_t)STREAM_BUFFER_SIZE-1));
+
+if( mp_msg_test(MSGT_STREAM,MSGL_DBG3) ){
+  mp_msg(MSGT_STREAM,MSGL_DBG3, "s->pos=%"PRIX64"  newpos=%"PRIX64"  new_bufpos=%"PRIX64"  buflen=%X  \n",
+    (int64_t)s->pos,(int64_t)newpos,(int64_t)pos,s->buf_len);
+}
+  pos-=newpos;
+
+  if(s->probe_buf && newpos >= s->probe_pos && newpos < s->probe_pos+s->probe_max){
+    // read up to newpos into the probe buffer if it is not there yet
+    s->pos=FFMIN(newpos,s->probe_pos+s->probe_len);
+    while(s->pos<newpos){
+      if(stream_fill_buffer(s)<=0) break; // EOF
+    }
+  } else if((res=stream_seek_internal(s,newpos)) >= 0)
+    return res;
 
 while(stream_fill_buffer(s) > 0 && pos >= 0) {
   if(pos<=s->buf_len){
@@ -480,6 +612,7 @@ void free_stream(stream_t *s){
   // streams should destroy their priv on close
   //if(s->priv) free(s->priv);
   if(s->url) free(s->url);
+  free(s->probe_buf);
   free(s);
 }
 
@@ -53,6 +53,7 @@
 #define STREAMTYPE_RADIO 19
 #define STREAMTYPE_BLURAY 20
 #define STREAMTYPE_BD 21
+#define STREAMTYPE_CONCAT 22   // seekable, files joined by stream_concat
 
 #define STREAM_BUFFER_SIZE 2048
 #define STREAM_MAX_SECTOR_SIZE (8*1024)
@@ -97,6 +98,7 @@
 #define STREAM_CTRL_GET_NUM_ANGLES 9
 #define STREAM_CTRL_GET_ANGLE 10
 #define STREAM_CTRL_SET_ANGLE 11
+#define STREAM_CTRL_GET_SEGMENTS 12
 
 
 typedef enum {
@@ -116,8 +118,16 @@ typedef struct streaming_control {
 	int (*streaming_read)( int fd, char *buffer, int buffer_size, struct streaming_control *stream_ctrl );
 	int (*streaming_seek)( int fd, off_t pos, struct streaming_control *stream_ctrl );
 	void *data;
+	char *etag;	// ETag or Last-Modified of the resource, identifies it in the disk cache
 } streaming_ctrl_t;
 
+/// answer to STREAM_CTRL_GET_SEGMENTS, owned by the stream
+typedef struct stream_segments {
+  int num;
+  char **urls;
+  off_t *start; // byte offset of each segment, start[num] is the total size
+} stream_segments_t;
+
 struct stream;
 typedef struct stream_info_st {
   const char *info;
@@ -164,6 +174,11 @@ typedef struct stream {
 #ifdef CONFIG_NETWORKING
   streaming_ctrl_t *streaming_ctrl;
 #endif
+  // see stream_probe_begin()
+  unsigned char *probe_buf;
+  int probe_len, probe_size, probe_max;
+  int probe_ended; ///< only served until the reader leaves it
+  off_t probe_pos, probe_raw_pos;
   unsigned char buffer[STREAM_BUFFER_SIZE>STREAM_MAX_SECTOR_SIZE?STREAM_BUFFER_SIZE:STREAM_MAX_SECTOR_SIZE];
 } stream_t;
 
@@ -173,8 +188,12 @@ typedef struct stream {
 
 int stream_fill_buffer(stream_t *s);
 int stream_seek_long(stream_t *s, off_t pos);
+int stream_probe_begin(stream_t *s, int max);
+void stream_probe_end(stream_t *s);
 
 #ifdef CONFIG_STREAM_CACHE
+extern char *stream_cache_dir;
+extern int stream_cache_disk_size;
 int stream_enable_cache(stream_t *stream,int size,int min,int prefill);
 int cache_stream_fill_buffer(stream_t *s);
 int cache_stream_seek_long(stream_t *s,off_t pos);
@@ -318,6 +337,17 @@ inline static int stream_skip(stream_t *s,off_t len){
   return 1;
 }
 
+/**
+ * \brief direct access to the buffered bytes at the read position, refilling
+ * the buffer if it is empty; consume them with stream_skip()
+ * \return number of bytes at *buf, 0 at EOF
+ */
+inline static int stream_peek_buffer(stream_t *s,unsigned char **buf){
+  if(s->buf_pos>=s->buf_len && !cache_stream_fill_buffer(s)) return 0;
+  *buf=s->buffer+s->buf_pos;
+  return s->buf_len-s->buf_pos;
+}
+
 void stream_reset(stream_t *s);
 int stream_control(stream_t *s, int cmd, void *arg);
 stream_t* new_stream(int fd,int type);
@@ -0,0 +1,267 @@
+/*
+ * concatenation of several files into one seekable stream
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "mp_msg.h"
+#include "stream.h"
+#include "m_option.h"
+#include "m_struct.h"
+
+#define MAX_SEGMENTS 4096
+
+static struct stream_priv_s {
+  char* filename;
+} stream_priv_dflts = {
+  NULL
+};
+
+#define ST_OFF(f) M_ST_OFF(struct stream_priv_s,f)
+/// URL definition
+static const m_option_t stream_opts_fields[] = {
+  { "string", ST_OFF(filename), CONF_TYPE_STRING, 0, 0 ,0, NULL},
+  { NULL, NULL, 0, 0, 0, 0,  NULL }
+};
+static const struct m_struct_st stream_opts = {
+  "concat",
+  sizeof(struct stream_priv_s),
+  &stream_priv_dflts,
+  stream_opts_fields
+};
+
+typedef struct concat_priv {
+  stream_segments_t seg;
+  int cur;      // index of the open segment
+  stream_t *s;  // only the current segment is kept open
+} concat_priv_t;
+
+static int add_segment(concat_priv_t *p, const char *url) {
+  char **urls;
+  off_t *start;
+  stream_t *s;
+
+  if(p->seg.num >= MAX_SEGMENTS)
+    return 0;
+  urls = realloc(p->seg.urls, (p->seg.num + 1) * sizeof(*urls));
+  if(!urls)
+    return 0;
+  p->seg.urls = urls;
+  start = realloc(p->seg.start, (p->seg.num + 2) * sizeof(*start));
+  if(!start)
+    return 0;
+  p->seg.start = start;
+  if(!p->seg.num)
+    start[0] = 0;
+
+  s = open_stream(url, NULL, NULL);
+  if(!s)
+    return 0;
+  if(s->end_pos <= 0 || !(s->flags & MP_STREAM_SEEK)) {
+    mp_msg(MSGT_OPEN,MSGL_ERR, "[concat] %s: segments must be seekable and of known size\n", url);
+    free_stream(s);
+    return 0;
+  }
+  urls[p->seg.num] = strdup(url);
+  start[p->seg.num + 1] = start[p->seg.num] + s->end_pos;
+  p->seg.num++;
+  // keep the first one, playback starts there
+  if(p->s)
+    free_stream(s);
+  else
+    p->s = s;
+  return 1;
+}
+
+/// name.001 also picks up name.002, name.003 and so on
+static int add_numbered(concat_priv_t *p, const char *name) {
+  const char *ext = strrchr(name, '.');
+  int digits, n, len;
+  struct stat st;
+  char *next;
+
+  if(!add_segment(p, name))
+    return 0;
+  if(!ext || !ext[1] || strchr(name, '|'))
+    return 1;
+  for(digits = 1; ext[digits]; digits++)
+    if(!isdigit((unsigned char)ext[digits]))
+      return 1;
+  digits--;
+  n = atoi(ext + 1);
+  len = ext + 1 - name;
+  next = malloc(len + digits + 12);
+  if(!next)
+    return 1;
+  while(1) {
+    snprintf(next, len + digits + 12, "%.*s%0*d", len, name, digits, ++n);
+    if(stat(next, &st) < 0 || !S_ISREG(st.st_mode) || !add_segment(p, next))
+      break;
+  }
+  free(next);
+  return 1;
+}
+
+static int open_segment(concat_priv_t *p, int i) {
+  if(p->s && p->cur == i)
+    return 1;
+  if(p->s)
+    free_stream(p->s);
+  p->cur = i;
+  p->s = open_stream(p->seg.urls[i], NULL, NULL);
+  return p->s != NULL;
+}
+
+static int fill_buffer(stream_t *s, char* buffer, int max_len) {
+  concat_priv_t *p = s->priv;
+  int len;
+
+  while(p->cur < p->seg.num) {
+    if(!open_segment(p, p->cur))
+      return -1;
+    len = stream_read(p->s, buffer, max_len);
+    if(len > 0)
+      return len;
+    // on to the next file, opening it is the only cost of the boundary
+    free_stream(p->s);
+    p->s = NULL;
+    p->cur++;
+    if(p->cur < p->seg.num)
+      mp_msg(MSGT_STREAM,MSGL_V, "[concat] segment %d: %s\n", p->cur + 1, p->seg.urls[p->cur]);
+  }
+  return -1;
+}
+
+static int seek(stream_t *s, off_t newpos) {
+  concat_priv_t *p = s->priv;
+  int lo = 0, hi = p->seg.num;
+
+  s->pos = newpos;
+  if(newpos < 0 || newpos >= p->seg.start[p->seg.num]) {
+    s->eof = 1;
+    return 0;
+  }
+  // last segment starting at or before newpos
+  while(hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if(p->seg.start[mid] <= newpos)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  if(!open_segment(p, lo) || !stream_seek(p->s, newpos - p->seg.start[lo])) {
+    s->eof = 1;
+    return 0;
+  }
+  return 1;
+}
+
+static int control(stream_t *s, int cmd, void *arg) {
+  concat_priv_t *p = s->priv;
+  switch(cmd) {
+    case STREAM_CTRL_GET_SIZE:
+      *(off_t *)arg = p->seg.start[p->seg.num];
+      return STREAM_OK;
+    case STREAM_CTRL_GET_SEGMENTS:
+      *(stream_segments_t **)arg = &p->seg;
+      return STREAM_OK;
+  }
+  return STREAM_UNSUPPORTED;
+}
+
+static void close_s(stream_t *s) {
+  concat_priv_t *p = s->priv;
+  int i;
+
+  if(p->s)
+    free_stream(p->s);
+  for(i = 0; i < p->seg.num; i++)
+    free(p->seg.urls[i]);
+  free(p->seg.urls);
+  free(p->seg.start);
+  free(p);
+}
+
+static int open_s(stream_t *stream, int mode, void* opts, int* file_format) {
+  struct stream_priv_s* opt = opts;
+  concat_priv_t *p;
+  char *list, *url, *sep;
+  int ok = 1;
+
+  if(mode != STREAM_READ || !opt->filename || !*opt->filename) {
+    m_struct_free(&stream_opts, opts);
+    return STREAM_UNSUPPORTED;
+  }
+  p = calloc(1, sizeof(*p));
+  list = strdup(opt->filename);
+  m_struct_free(&stream_opts, opts);
+  if(!p || !list) {
+    free(p);
+    free(list);
+    return STREAM_ERROR;
+  }
+
+  if(!strchr(list, '|'))
+    ok = add_numbered(p, list);
+  else
+    for(url = list; ok && url; url = sep) {
+      sep = strchr(url, '|');
+      if(sep)
+        *sep++ = 0;
+      if(*url)
+        ok = add_segment(p, url);
+    }
+  free(list);
+  if(!ok || !p->seg.num) {
+    stream->priv = p;
+    close_s(stream);
+    stream->priv = NULL;
+    return STREAM_ERROR;
+  }
+  mp_msg(MSGT_OPEN,MSGL_V, "[concat] %d segments, %"PRId64" bytes\n",
+         p->seg.num, (int64_t)p->seg.start[p->seg.num]);
+
+  stream->type = STREAMTYPE_CONCAT;
+  stream->flags |= MP_STREAM_SEEK;
+  stream->end_pos = p->seg.start[p->seg.num];
+  stream->fill_buffer = fill_buffer;
+  stream->seek = seek;
+  stream->control = control;
+  stream->close = close_s;
+  stream->priv = p;
+  return STREAM_OK;
+}
+
+const stream_info_t stream_info_concat = {
+  "Concatenated files",
+  "concat",
+  "",
+  "concat://file1|file2|... or concat://name.001 for numbered parts",
+  open_s,
+  { "concat", NULL },
+  &stream_opts,
+  1 // Urls are an option string
+};
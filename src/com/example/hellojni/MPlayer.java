@@ -0,0 +1,116 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+package com.example.hellojni;
+
+import java.nio.ByteBuffer;
+
+/**
+ * In-process player running on its own native thread.
+ *
+ * The native player keeps global state, so only one instance may be
+ * started at a time. Commands use the slave mode syntax, e.g.
+ * "loadfile /sdcard/movie.mkv" or "seek 10".
+ */
+public class MPlayer
+{
+    /* event codes, keep in sync with enum libmplayer_event */
+    public static final int EVENT_READY          = 0;
+    public static final int EVENT_START_FILE     = 1;
+    public static final int EVENT_PLAYBACK_START = 2;
+    public static final int EVENT_PAUSE          = 3;
+    public static final int EVENT_UNPAUSE        = 4;
+    public static final int EVENT_END_FILE       = 5;
+    public static final int EVENT_EXIT           = 6;
+
+    /* frame buffer formats, keep in sync with libmplayer_jni.c */
+    public static final int FORMAT_RGB565   = 0;
+    public static final int FORMAT_RGBA8888 = 1;
+
+    public interface Listener
+    {
+        /** Called on the player thread, must not block. */
+        void onEvent(int event, int arg, String str);
+        /** A frame of the given size was copied into the frame buffer. */
+        void onFrame(int width, int height);
+    }
+
+    private Listener mListener;
+
+    public MPlayer(Listener listener)
+    {
+        mListener = listener;
+    }
+
+    /** Start the player with extra command line options. */
+    public boolean start(String[] args)
+    {
+        return nativeCreate(args) == 0;
+    }
+
+    /** Quit and wait for the player thread. */
+    public void release()
+    {
+        nativeDestroy();
+    }
+
+    public boolean command(String cmd)
+    {
+        return nativeCommand(cmd) == 0;
+    }
+
+    /** @return the property as a string, or null if it is unavailable */
+    public String getProperty(String name)
+    {
+        return nativeGetProperty(name);
+    }
+
+    /**
+     * Decoded frames are copied into buf, which must be a direct buffer.
+     * Pass null to stop copying frames.
+     */
+    public boolean setFrameBuffer(ByteBuffer buf, int stride,
+                                  int width, int height, int format)
+    {
+        return nativeSetFrameBuffer(buf, stride, width, height, format) == 0;
+    }
+
+    /* called from native code */
+    private void onEvent(int event, int arg, String str)
+    {
+        if (mListener != null)
+            mListener.onEvent(event, arg, str);
+    }
+
+    private void onFrame(int width, int height)
+    {
+        if (mListener != null)
+            mListener.onFrame(width, height);
+    }
+
+    private native int     nativeCreate(String[] args);
+    private native void    nativeDestroy();
+    private native int     nativeCommand(String cmd);
+    private native String  nativeGetProperty(String name);
+    private native int     nativeSetFrameBuffer(ByteBuffer buf, int stride,
+                                                int width, int height,
+                                                int format);
+
+    static {
+        System.loadLibrary("mplayer_jni");
+    }
+}